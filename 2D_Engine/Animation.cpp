@@ -1,58 +1,93 @@
 #include "Animation.h"
+#include <algorithm>
 #include <assimp/scene.h>
 #include "MathFunctions.h"
+#include "JobSystem.h"
+
+// Number of keys searched forward from a cursor before falling back to binary search.
+#define ANIMATION_CURSOR_KEYS 4U
 
 using namespace Geometry;
 
+namespace {
+    // Find index of the key at or before animationTime, the last key if animationTime is outside the keys.
+    std::size_t FindKey(const std::vector<float>& times, float animationTime, std::size_t hint) {
+        assert(times.size() > 0);
+        const std::size_t lastKey = times.size() - 1;
+        if (animationTime < times[0] || animationTime >= times[lastKey])
+            return lastKey;
+
+        // Playback advances a key or two per frame.
+        if (hint < lastKey && times[hint] <= animationTime) {
+            const std::size_t endKey = std::min(hint + ANIMATION_CURSOR_KEYS, lastKey);
+            for (std::size_t i = hint; i < endKey; ++i)
+                if (animationTime < times[i + 1])
+                    return i;
+        }
+
+        // Seek.
+        return static_cast<std::size_t>(std::upper_bound(times.begin(), times.end(), animationTime) - times.begin()) - 1;
+    }
+}
+
 Animation::Animation() {
 
 }
 
-Animation::Animation(const aiAnimation* aAnimation) {
-    Load(aAnimation);
+Animation::Animation(const aiAnimation* aAnimation, JobSystem* jobSystem) {
+    Load(aAnimation, jobSystem);
 }
 
 Animation::~Animation() {
 
 }
 
-void Animation::Load(const aiAnimation* aAnimation) {
+void Animation::Load(const aiAnimation* aAnimation, JobSystem* jobSystem) {
     name = aAnimation->mName.data;
     duration = aAnimation->mDuration;
     ticksPerSecond = aAnimation->mTicksPerSecond;
     channels.resize(aAnimation->mNumChannels);
 
     // Load animation channels.
-    for (std::size_t c = 0; c < channels.size(); ++c) {
-        Animation::AnimChannel* channel = &channels[c];
-        const aiNodeAnim* aChannel = aAnimation->mChannels[c];
-        channel->trgNodeName = aChannel->mNodeName.data;
-        channelIndexMap[channel->trgNodeName] = c;
-        // Position
-        channel->posKeys.resize(aChannel->mNumPositionKeys);
-        for (std::size_t i = 0; i < channel->posKeys.size(); ++i) {
-            Animation::AnimChannel::VectorKey* posKey = &channel->posKeys[i];
-            aiVectorKey* aPosKey = &aChannel->mPositionKeys[i];
-            posKey->time = aPosKey->mTime;
-            CpyVec(posKey->value, aPosKey->mValue);
-        }
-        // Rotation
-        channel->rotKeys.resize(aChannel->mNumRotationKeys);
-        for (std::size_t i = 0; i < channel->rotKeys.size(); ++i) {
-            Animation::AnimChannel::QuatKey* rotKey = &channel->rotKeys[i];
-            aiQuatKey* aRotKey = &aChannel->mRotationKeys[i];
-            rotKey->time = aRotKey->mTime;
-            //CpyQuat(rotKey->value, aRotKey->mValue);
-            rotKey->value = aRotKey->mValue;
-        }
-        // Scale
-        channel->sclKeys.resize(aChannel->mNumScalingKeys);
-        for (std::size_t i = 0; i < channel->sclKeys.size(); ++i) {
-            Animation::AnimChannel::VectorKey* sclKey = &channel->sclKeys[i];
-            aiVectorKey* aSclKey = &aChannel->mScalingKeys[i];
-            sclKey->time = aSclKey->mTime;
-            CpyVec(sclKey->value, aSclKey->mValue);
-        }
+    auto loadChannels = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int c = begin; c < end; ++c)
+            LoadChannel(aAnimation->mChannels[c], static_cast<float>(aAnimation->mDuration), &channels[c]);
+    };
+    if (jobSystem != nullptr)
+        jobSystem->ParallelFor(0, aAnimation->mNumChannels, 1, loadChannels);
+    else
+        loadChannels(0, aAnimation->mNumChannels);
+
+    for (std::size_t c = 0; c < channels.size(); ++c)
+        channelIndexMap[channels[c].trgNodeName] = c;
+}
+
+void Animation::LoadChannel(const aiNodeAnim* aChannel, float duration, AnimChannel* channel) {
+    channel->trgNodeName = aChannel->mNodeName.data;
+    channel->duration = duration;
+    // Position
+    channel->posTimes.resize(aChannel->mNumPositionKeys);
+    channel->posValues.resize(aChannel->mNumPositionKeys);
+    for (std::size_t i = 0; i < channel->posTimes.size(); ++i) {
+        const aiVectorKey* aPosKey = &aChannel->mPositionKeys[i];
+        channel->posTimes[i] = static_cast<float>(aPosKey->mTime);
+        CpyVec(channel->posValues[i], aPosKey->mValue);
+    }
+    // Rotation
+    channel->rotTimes.resize(aChannel->mNumRotationKeys);
+    channel->rotValues.resize(aChannel->mNumRotationKeys);
+    for (std::size_t i = 0; i < channel->rotTimes.size(); ++i) {
+        const aiQuatKey* aRotKey = &aChannel->mRotationKeys[i];
+        channel->rotTimes[i] = static_cast<float>(aRotKey->mTime);
+        channel->rotValues[i] = aRotKey->mValue;
+    }
+    // Scale
+    channel->sclTimes.resize(aChannel->mNumScalingKeys);
+    channel->sclValues.resize(aChannel->mNumScalingKeys);
+    for (std::size_t i = 0; i < channel->sclTimes.size(); ++i) {
+        const aiVectorKey* aSclKey = &aChannel->mScalingKeys[i];
+        channel->sclTimes[i] = static_cast<float>(aSclKey->mTime);
+        CpyVec(channel->sclValues[i], aSclKey->mValue);
     }
 }
 
@@ -63,85 +98,103 @@ const Animation::AnimChannel* Animation::FindChannel(const std::string& name) co
     return nullptr;
 }
 
-void Animation::CalcInterpolatedRotation(aiQuaternion& rotation, float animationTime, const Animation::AnimChannel* channel) {
+std::size_t Animation::GetNumChannels() const {
+    return channels.size();
+}
+
+const Animation::AnimChannel& Animation::GetChannel(std::size_t index) const {
+    return channels[index];
+}
+
+std::size_t Animation::GetNumBytes() const {
+    std::size_t numBytes = 0;
+    for (const AnimChannel& channel : channels) {
+        numBytes += channel.rotTimes.size() * (sizeof(float) + sizeof(aiQuaternion));
+        numBytes += channel.posTimes.size() * (sizeof(float) + sizeof(glm::vec3));
+        numBytes += channel.sclTimes.size() * (sizeof(float) + sizeof(glm::vec3));
+    }
+    return numBytes;
+}
+
+void Animation::CalcInterpolatedRotation(aiQuaternion& rotation, float animationTime, const Animation::AnimChannel* channel, KeyCursor* cursor) {
     // We need two values to interpolate.
-    if (channel->rotKeys.size() == 1) {
-        rotation = channel->rotKeys[0].value;
+    if (channel->rotValues.size() == 1) {
+        rotation = channel->rotValues[0];
         return;
     }
 
-    std::size_t cKey = channel->FindRotKey(animationTime);
-    std::size_t nKey = (cKey + 1); // TODO % size()?
-    assert(nKey < channel->rotKeys.size());
-    float deltaTime = (float)(channel->rotKeys[nKey].time - channel->rotKeys[cKey].time);
-    float factor = (animationTime - (float)channel->rotKeys[cKey].time) / deltaTime;
-    //assert(factor >= 0.0f && factor <= 1.0f);
-    const aiQuaternion& startRotationQ = channel->rotKeys[cKey].value;
-    const aiQuaternion& endRotationQ = channel->rotKeys[nKey].value;
+    std::size_t cKey, nKey;
+    float factor = channel->FindKeys(channel->rotTimes, animationTime, cursor != nullptr ? cursor->rotKey : 0, cKey, nKey);
+    if (cursor != nullptr)
+        cursor->rotKey = cKey;
+    const aiQuaternion& startRotationQ = channel->rotValues[cKey];
+    const aiQuaternion& endRotationQ = channel->rotValues[nKey];
     aiQuaternion::Interpolate(rotation, startRotationQ, endRotationQ, factor);
     rotation = rotation.Normalize();
 }
 
-void Animation::CalcInterpolatedPosition(glm::vec3& translation, float animationTime, const Animation::AnimChannel* channel) {
+void Animation::CalcInterpolatedPosition(glm::vec3& translation, float animationTime, const Animation::AnimChannel* channel, KeyCursor* cursor) {
     // We need two values to interpolate.
-    if (channel->posKeys.size() == 1) {
-        translation = channel->posKeys[0].value;
+    if (channel->posValues.size() == 1) {
+        translation = channel->posValues[0];
         return;
     }
 
-    std::size_t cKey = channel->FindPosKey(animationTime);
-    std::size_t nKey = (cKey + 1); // TODO % size()?
-    assert(nKey < channel->posKeys.size());
-    float deltaTime = (float)(channel->posKeys[nKey].time - channel->posKeys[cKey].time);
-    float factor = (animationTime - (float)channel->posKeys[cKey].time) / deltaTime;
-    //assert(factor >= 0.0f && factor <= 1.0f);
-    const glm::vec3& start = channel->posKeys[cKey].value;
-    const glm::vec3& end = channel->posKeys[nKey].value;
+    std::size_t cKey, nKey;
+    float factor = channel->FindKeys(channel->posTimes, animationTime, cursor != nullptr ? cursor->posKey : 0, cKey, nKey);
+    if (cursor != nullptr)
+        cursor->posKey = cKey;
+    const glm::vec3& start = channel->posValues[cKey];
+    const glm::vec3& end = channel->posValues[nKey];
     const glm::vec3 delta = end - start;
     translation = start + factor * delta;
 }
 
-void Animation::CalcInterpolatedScaling(glm::vec3& scaling, float animationTime, const Animation::AnimChannel* channel) {
+void Animation::CalcInterpolatedScaling(glm::vec3& scaling, float animationTime, const Animation::AnimChannel* channel, KeyCursor* cursor) {
     // We need two values to interpolate.
-    if (channel->sclKeys.size() == 1) {
-        scaling = channel->sclKeys[0].value;
+    if (channel->sclValues.size() == 1) {
+        scaling = channel->sclValues[0];
         return;
     }
 
-    std::size_t cKey = channel->FindSclKey(animationTime);
-    std::size_t nKey = (cKey + 1); // TODO % size()?
-    assert(nKey < channel->sclKeys.size());
-    float deltaTime = (float)(channel->sclKeys[nKey].time - channel->sclKeys[cKey].time);
-    float factor = (animationTime - (float)channel->sclKeys[cKey].time) / deltaTime;
-    //assert(factor >= 0.0f && factor <= 1.0f);
-    const glm::vec3& start = channel->sclKeys[cKey].value;
-    const glm::vec3& end = channel->sclKeys[nKey].value;
+    std::size_t cKey, nKey;
+    float factor = channel->FindKeys(channel->sclTimes, animationTime, cursor != nullptr ? cursor->sclKey : 0, cKey, nKey);
+    if (cursor != nullptr)
+        cursor->sclKey = cKey;
+    const glm::vec3& start = channel->sclValues[cKey];
+    const glm::vec3& end = channel->sclValues[nKey];
     const glm::vec3 delta = end - start;
     scaling = start + factor * delta;
 }
 
-std::size_t Animation::AnimChannel::FindRotKey(float animationTime) const {
-    assert(rotKeys.size() > 0);
-    for (std::size_t i = 0; i < rotKeys.size() - 1; ++i)
-        if (animationTime < (float)rotKeys[i + 1].time)
-            return i;
-    assert(0);
-    return -1;
-}
-std::size_t Animation::AnimChannel::FindPosKey(float animationTime) const {
-    assert(posKeys.size() > 0);
-    for (std::size_t i = 0; i < posKeys.size() - 1; ++i)
-        if (animationTime < (float)posKeys[i + 1].time)
-            return i;
-    assert(0);
-    return -1;
-}
-
-std::size_t Animation::AnimChannel::FindSclKey(float animationTime) const {
-    assert(sclKeys.size() > 0);
-    for (std::size_t i = 0; i < sclKeys.size() - 1; ++i)
-        if (animationTime < (float)sclKeys[i + 1].time)
-            return i;
-    assert(0);
-    return -1;
+std::size_t Animation::AnimChannel::FindRotKey(float animationTime, std::size_t hint) const {
+    return FindKey(rotTimes, animationTime, hint);
+}
+
+std::size_t Animation::AnimChannel::FindPosKey(float animationTime, std::size_t hint) const {
+    return FindKey(posTimes, animationTime, hint);
+}
+
+std::size_t Animation::AnimChannel::FindSclKey(float animationTime, std::size_t hint) const {
+    return FindKey(sclTimes, animationTime, hint);
+}
+
+float Animation::AnimChannel::FindKeys(const std::vector<float>& times, float animationTime, std::size_t hint, std::size_t& key, std::size_t& nextKey) const {
+    key = FindKey(times, animationTime, hint);
+    nextKey = key + 1 < times.size() ? key + 1 : 0;
+    if (key == nextKey)
+        return 0.0f;
+
+    // The last key interpolates towards the first key across the end of the animation.
+    float startTime = times[key];
+    float endTime = times[nextKey];
+    if (nextKey == 0) {
+        if (animationTime < startTime)
+            startTime -= duration;
+        else
+            endTime += duration;
+    }
+    float deltaTime = endTime - startTime;
+    // Keys past the duration would extrapolate.
+    return deltaTime > 0.0f ? glm::clamp((animationTime - startTime) / deltaTime, 0.0f, 1.0f) : 0.0f;
 }
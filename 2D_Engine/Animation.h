@@ -7,6 +7,8 @@
 #include <vector>
 
 struct aiAnimation;
+struct aiNodeAnim;
+class JobSystem;
 
 namespace Geometry {
     /// An animation loaded from a file.
@@ -14,53 +16,80 @@ namespace Geometry {
     public:
         /// Animation channel representing rotation, position and scale transformations. Describes the animation of a single node.
         struct AnimChannel {
-            /// Rotation key.
-            struct QuatKey {
-                /// Time of this key.
-                double time;
-                /// Value of this key.
-                aiQuaternion value;
-            };
-            /// Scale and position keys.
-            struct VectorKey {
-                /// Time of this key.
-                double time;
-                /// Value of this key.
-                glm::vec3 value;
-            };
-
             /// Find rotation key index.
             /**
-            * @param animationTime Duration of the animation in seconds.
-            * @return Index of key.
+            * Keys are found in constant time when animationTime is at or shortly after the hint, else by binary search.
+            * @param animationTime Time of the animation in ticks.
+            * @param hint Key found for an earlier time.
+            * @return Index of key to interpolate from. The last key if animationTime is outside the keys, it interpolates towards the first key.
             */
-            std::size_t FindRotKey(float animationTime) const;
+            std::size_t FindRotKey(float animationTime, std::size_t hint = 0) const;
             /// Find position key index.
             /**
-            * @param animationTime Duration of the animation in seconds.
-            * @return Index of key.
+            * Keys are found in constant time when animationTime is at or shortly after the hint, else by binary search.
+            * @param animationTime Time of the animation in ticks.
+            * @param hint Key found for an earlier time.
+            * @return Index of key to interpolate from. The last key if animationTime is outside the keys, it interpolates towards the first key.
             */
-            std::size_t FindPosKey(float animationTime) const;
+            std::size_t FindPosKey(float animationTime, std::size_t hint = 0) const;
             /// Find scale key index.
             /**
-            * @param animationTime Duration of the animation in seconds.
-            * @return Index of key.
+            * Keys are found in constant time when animationTime is at or shortly after the hint, else by binary search.
+            * @param animationTime Time of the animation in ticks.
+            * @param hint Key found for an earlier time.
+            * @return Index of key to interpolate from. The last key if animationTime is outside the keys, it interpolates towards the first key.
+            */
+            std::size_t FindSclKey(float animationTime, std::size_t hint = 0) const;
+
+            /// Find the keys of a track to interpolate between.
+            /**
+            * @param times Key times of the track.
+            * @param animationTime Time of the animation in ticks.
+            * @param hint Key found for an earlier time.
+            * @param key Key to interpolate from.
+            * @param nextKey Key to interpolate to.
+            * @return Interpolation factor from key to nextKey.
             */
-            std::size_t FindSclKey(float animationTime) const;
+            float FindKeys(const std::vector<float>& times, float animationTime, std::size_t hint, std::size_t& key, std::size_t& nextKey) const;
+
+            /// Times of rotation keys in ticks, ascending.
+            std::vector<float> rotTimes;
+
+            /// Values of rotation keys.
+            std::vector<aiQuaternion> rotValues;
 
-            /// Vector containing rotation keys.
-            std::vector<QuatKey> rotKeys;
+            /// Times of position keys in ticks, ascending.
+            std::vector<float> posTimes;
 
-            /// Vector containing position keys.
-            std::vector<VectorKey> posKeys;
+            /// Values of position keys.
+            std::vector<glm::vec3> posValues;
 
-            /// Vector containing scale keys.
-            std::vector<VectorKey> sclKeys;
+            /// Times of scale keys in ticks, ascending.
+            std::vector<float> sclTimes;
+
+            /// Values of scale keys.
+            std::vector<glm::vec3> sclValues;
+
+            /// Duration of the animation in ticks, the last keys interpolate towards the first keys over the rest of it.
+            float duration = 0.0f;
 
             /// The name of the node affected by this animation.
             std::string trgNodeName = "";
         };
 
+        /// Keys found for the last sampled time of a channel.
+        /**
+        * Kept per playing instance, so the next sample continues searching from the last keys.
+        */
+        struct KeyCursor {
+            /// Rotation key index.
+            std::size_t rotKey = 0;
+            /// Position key index.
+            std::size_t posKey = 0;
+            /// Scale key index.
+            std::size_t sclKey = 0;
+        };
+
         /// Create new empty animation.
         /**
         * The created animation has to be loaded later using Load.
@@ -70,8 +99,9 @@ namespace Geometry {
         /// Create new animation.
         /**
         * @param aAnimation Pointer to assimp animation.
+        * @param jobSystem Job system to load channels in parallel, nullptr to load on the calling thread.
         */
-        Animation(const aiAnimation* aAnimation);
+        Animation(const aiAnimation* aAnimation, JobSystem* jobSystem = nullptr);
 
         /// Destructor.
         ~Animation();
@@ -79,8 +109,9 @@ namespace Geometry {
         /// Load animation.
         /**
         * @param aAnimation Pointer to assimp animation.
+        * @param jobSystem Job system to load channels in parallel, nullptr to load on the calling thread.
         */
-        void Load(const aiAnimation* aAnimation);
+        void Load(const aiAnimation* aAnimation, JobSystem* jobSystem = nullptr);
 
         /// Load animation.
         /**
@@ -89,29 +120,51 @@ namespace Geometry {
         */
         const AnimChannel* FindChannel(const std::string& name) const;
 
+        /// Get number of channels.
+        /**
+        * @return Number of channels.
+        */
+        std::size_t GetNumChannels() const;
+
+        /// Get channel.
+        /**
+        * @param index Channel index.
+        * @return Channel.
+        */
+        const AnimChannel& GetChannel(std::size_t index) const;
+
+        /// Get memory used by keys.
+        /**
+        * @return Size of key times and values in bytes.
+        */
+        std::size_t GetNumBytes() const;
+
         /// Interpolate animation channel.
         /**
         * @param scaling Target scaling vector.
         * @param animationTime Time fo animation.
         * @param channel Animation channel.
+        * @param cursor Cursor of the channel to search keys from and update, nullptr to search all keys.
         */
-        static void CalcInterpolatedScaling(glm::vec3& scaling, float animationTime, const AnimChannel* channel);
+        static void CalcInterpolatedScaling(glm::vec3& scaling, float animationTime, const AnimChannel* channel, KeyCursor* cursor = nullptr);
 
         /// Interpolate animation channel.
         /**
         * @param rotation Target rotation quaternion.
         * @param animationTime Time fo animation.
         * @param channel Animation channel.
+        * @param cursor Cursor of the channel to search keys from and update, nullptr to search all keys.
         */
-        static void CalcInterpolatedRotation(aiQuaternion& rotation, float animationTime, const Animation::AnimChannel* channel);
+        static void CalcInterpolatedRotation(aiQuaternion& rotation, float animationTime, const Animation::AnimChannel* channel, KeyCursor* cursor = nullptr);
 
         /// Interpolate animation channel.
         /**
         * @param translation Target translation vector.
         * @param animationTime Time fo animation.
         * @param channel Animation channel.
+        * @param cursor Cursor of the channel to search keys from and update, nullptr to search all keys.
         */
-        static void CalcInterpolatedPosition(glm::vec3& translation, float animationTime, const Animation::AnimChannel* channel);
+        static void CalcInterpolatedPosition(glm::vec3& translation, float animationTime, const Animation::AnimChannel* channel, KeyCursor* cursor = nullptr);
 
         /// Animation name.
         std::string name;
@@ -123,6 +176,8 @@ namespace Geometry {
         double ticksPerSecond;
 
     private:
+        static void LoadChannel(const aiNodeAnim* aChannel, float duration, AnimChannel* channel);
+
         std::map<std::string, std::size_t> channelIndexMap;
         std::vector<AnimChannel> channels;
     };
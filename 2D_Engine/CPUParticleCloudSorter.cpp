@@ -0,0 +1,96 @@
+#include "CPUParticleCloudSorter.h"
+
+#include "RadixSort.h"
+
+// Number of clouds per job.
+#define CPUPARTICLECLOUDSORTER_GRAIN 16384U
+
+CPUParticleCloudSorter::CPUParticleCloudSorter(unsigned int maxNumParticleClouds, JobSystem* jobSystem)
+{
+    mJobSystem = jobSystem;
+    mKeys.resize(maxNumParticleClouds);
+    mValues.resize(maxNumParticleClouds);
+    mTmpKeys.resize(maxNumParticleClouds);
+    mTmpValues.resize(maxNumParticleClouds);
+}
+
+CPUParticleCloudSorter::~CPUParticleCloudSorter()
+{
+
+}
+
+void CPUParticleCloudSorter::Sort(CPUScene& scene)
+{
+    Sort(scene, nullptr);
+}
+
+void CPUParticleCloudSorter::Sort(CPUSceneBatch& batch)
+{
+    Sort(*batch.mScene, batch.GetSceneIndices());
+}
+
+void CPUParticleCloudSorter::Sort(CPUScene& scene, const unsigned int* sceneIndices)
+{
+    unsigned int numClouds = scene.mMaxNumParticleClouds;
+
+    // Swap buffers.
+    scene.mParticleCloudsSwapBuffer->Swap();
+    const ParticleCloud* source = scene.mParticleCloudsSwapBuffer->GetSourceBuffer();
+    ParticleCloud* target = scene.mParticleCloudsSwapBuffer->GetTargetBuffer();
+
+    auto buildKeys = [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            mKeys[i] = RadixSort::FloatToKey(source[i].mPosition.x);
+            mValues[i] = i;
+        }
+    };
+    if (mJobSystem != nullptr)
+        mJobSystem->ParallelFor(0, numClouds, CPUPARTICLECLOUDSORTER_GRAIN, buildKeys);
+    else
+        buildKeys(0, numClouds);
+
+    unsigned int numPasses = 0;
+    const unsigned int* sortedIDs = RadixSort::Sort(mKeys.data(), mValues.data(), mTmpKeys.data(), mTmpValues.data(), numClouds, &numPasses);
+
+    // Stable sort on scene index groups clouds by scene, keeping x order within each scene.
+    // The pass is skipped when all clouds belong to one scene.
+    if (sceneIndices != nullptr)
+    {
+        bool sortedInValues = sortedIDs == mValues.data();
+        unsigned int* keys = sortedInValues ? mKeys.data() : mTmpKeys.data();
+        unsigned int* values = sortedInValues ? mValues.data() : mTmpValues.data();
+        auto buildSceneKeys = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; ++i)
+                keys[i] = sceneIndices[values[i]];
+        };
+        if (mJobSystem != nullptr)
+            mJobSystem->ParallelFor(0, numClouds, CPUPARTICLECLOUDSORTER_GRAIN, buildSceneKeys);
+        else
+            buildSceneKeys(0, numClouds);
+
+        unsigned int numScenePasses = 0;
+        if (sortedInValues)
+            sortedIDs = RadixSort::Sort(mKeys.data(), mValues.data(), mTmpKeys.data(), mTmpValues.data(), numClouds, &numScenePasses);
+        else
+            sortedIDs = RadixSort::Sort(mTmpKeys.data(), mTmpValues.data(), mKeys.data(), mValues.data(), numClouds, &numScenePasses);
+        numPasses += numScenePasses;
+    }
+
+    // Gather clouds in sorted order.
+    auto gather = [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+            target[i] = source[sortedIDs[i]];
+    };
+    if (mJobSystem != nullptr)
+        mJobSystem->ParallelFor(0, numClouds, CPUPARTICLECLOUDSORTER_GRAIN, gather);
+    else
+        gather(0, numClouds);
+
+    FrameWorkCounter sortPasses;
+    sortPasses.Add(numPasses);
+    scene.mWorkCounters.sortPasses += sortPasses.Get();
+}
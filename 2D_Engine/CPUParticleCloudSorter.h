@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "CPUScene.h"
+#include "CPUSceneBatch.h"
+#include "JobSystem.h"
+
+// Sorts particle clouds along the x-axis on the CPU. CPU counterpart of ParticleCloudSorter.
+class CPUParticleCloudSorter
+{
+    public:
+        // Constructor.
+        // maxNumParticleClouds Max number of particle clouds to sort.
+        // jobSystem Job system to build keys and gather clouds in parallel, nullptr to sort on the calling thread.
+        CPUParticleCloudSorter(unsigned int maxNumParticleClouds, JobSystem* jobSystem = nullptr);
+
+        // Destructor.
+        ~CPUParticleCloudSorter();
+
+        // Sort clouds. Radix sort on position x, one sort pass per radix pass.
+        // scene Scene to sort.
+        void Sort(CPUScene& scene);
+
+        // Sort clouds of all scenes of a batch in one pass. Clouds are sorted on position x, then stable on scene index,
+        // so each scene's clouds stay in its range and are ordered as if the scene were sorted alone.
+        // batch Batch to sort.
+        void Sort(CPUSceneBatch& batch);
+
+    private:
+        // Sort clouds by key.
+        // scene Scene to sort.
+        // sceneIndices Scene index of each cloud slot, nullptr to sort on position x only.
+        void Sort(CPUScene& scene, const unsigned int* sceneIndices);
+
+        JobSystem* mJobSystem;
+        std::vector<unsigned int> mKeys;
+        std::vector<unsigned int> mValues;
+        std::vector<unsigned int> mTmpKeys;
+        std::vector<unsigned int> mTmpValues;
+};
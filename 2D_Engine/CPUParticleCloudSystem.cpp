@@ -0,0 +1,267 @@
+#include "CPUParticleCloudSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define BATCHSIZE 256U
+#define BIAS 0.1F
+
+namespace
+{
+    // Boid data.
+    struct BoidData
+    {
+        float radius;
+        glm::vec3 center;
+        unsigned int n;
+        glm::vec3 separation;
+        glm::vec3 velocity;
+    };
+
+    // Check if clouds overlaps in x-axis.
+    bool XInstersect(float selfPosX, float selfRadius, float otherPosX, float otherRadius)
+    {
+        return std::abs(otherPosX - selfPosX) < selfRadius + otherRadius + BIAS;
+    }
+
+    // Check if clouds overlaps. Returns squared distance minus squared radii, overlap if not positive.
+    float Instersect(const glm::vec3& selfPos, float selfRadius, const glm::vec3& otherPos, float otherRadius)
+    {
+        float len = selfRadius + otherRadius;
+        glm::vec3 selfToOtherVec = otherPos - selfPos;
+        float distance = selfToOtherVec.x * selfToOtherVec.x + selfToOtherVec.y * selfToOtherVec.y + selfToOtherVec.z * selfToOtherVec.z;
+
+        return distance - len * len;
+    }
+
+    // Function called on clouds XIntersection.
+    void OnXIntersection(ParticleCloud& self, const ParticleCloud& other, BoidData& boidData)
+    {
+        float result = Instersect(self.mPosition, self.mRadius, other.mPosition, boidData.radius);
+        if (result <= 0.f)
+        {
+            self.mColor.x += 0.1f; // TMP
+
+            // ----- Boid ----- //
+            boidData.center += other.mPosition;
+            boidData.velocity += other.mVelocity;
+            ++boidData.n;
+            // Steer to avoid crowding local flockmates.
+            float distance = std::sqrt(-result);
+            if (distance < self.mRadius * 2.f)
+                boidData.separation -= other.mPosition - self.mPosition;
+        }
+    }
+}
+
+CPUParticleCloudSystem::CPUParticleCloudSystem(JobSystem* jobSystem)
+{
+    mJobSystem = jobSystem;
+    mThreadData.resize(mJobSystem != nullptr ? mJobSystem->GetNumThreads() : 1);
+}
+
+CPUParticleCloudSystem::~CPUParticleCloudSystem()
+{
+
+}
+
+template <typename Function>
+void CPUParticleCloudSystem::UpdateGroups(CPUScene& scene, unsigned int numGroups, Function update)
+{
+    // Swap buffers.
+    scene.mParticleCloudsSwapBuffer->Swap();
+    scene.mParticlesSwapBuffer->Swap();
+
+    for (ThreadData& threadData : mThreadData)
+        threadData.workCounters.Reset();
+
+    auto updateRange = [&](unsigned int begin, unsigned int end)
+    {
+        ThreadData& threadData = mThreadData[mJobSystem != nullptr ? mJobSystem->GetThreadIndex() : 0];
+        for (unsigned int g = begin; g < end; ++g)
+            update(g, threadData);
+    };
+    if (mJobSystem != nullptr)
+        mJobSystem->ParallelFor(0, numGroups, 1, updateRange);
+    else
+        updateRange(0, numGroups);
+
+    for (const ThreadData& threadData : mThreadData)
+    {
+        scene.mWorkCounters.pairTests += threadData.workCounters.pairTests;
+        scene.mWorkCounters.xIntersections += threadData.workCounters.xIntersections;
+        scene.mWorkCounters.batchesLoaded += threadData.workCounters.batchesLoaded;
+        scene.mWorkCounters.spawns += threadData.workCounters.spawns;
+    }
+}
+
+void CPUParticleCloudSystem::Update(CPUScene& scene, float dt)
+{
+    unsigned int numClouds = scene.mMaxNumParticleClouds;
+
+    // Groups of Dispatch(numClouds / BATCHSIZE + 1) holding live clouds. When numClouds is a multiple of BATCHSIZE the
+    // dispatch has one more group, which only duplicates the last cloud and counts no work.
+    unsigned int numGroups = (numClouds + BATCHSIZE - 1) / BATCHSIZE;
+    UpdateGroups(scene, numGroups, [&](unsigned int groupID, ThreadData& threadData)
+    {
+        UpdateGroup(scene, 0, numClouds, groupID, dt, threadData);
+    });
+}
+
+void CPUParticleCloudSystem::Update(CPUSceneBatch& batch, float dt)
+{
+    // Groups of all scenes. Capacity is kept, so only the first frame allocates.
+    mGroups.clear();
+    for (unsigned int s = 0; s < batch.GetNumScenes(); ++s)
+    {
+        for (unsigned int g = 0; g < (batch.GetRange(s).numParticleClouds + BATCHSIZE - 1) / BATCHSIZE; ++g)
+        {
+            Group group;
+            group.scene = s;
+            group.groupID = g;
+            mGroups.push_back(group);
+        }
+    }
+
+    CPUScene& scene = *batch.mScene;
+    UpdateGroups(scene, static_cast<unsigned int>(mGroups.size()), [&](unsigned int g, ThreadData& threadData)
+    {
+        const CPUSceneBatch::Range& range = batch.GetRange(mGroups[g].scene);
+        UpdateGroup(scene, range.firstParticleCloud, range.numParticleClouds, mGroups[g].groupID, dt, threadData);
+    });
+}
+
+void CPUParticleCloudSystem::UpdateGroup(CPUScene& scene, unsigned int firstCloud, unsigned int numClouds, unsigned int groupID, float dt, ThreadData& threadData)
+{
+    const ParticleCloud* sourceClouds = scene.mParticleCloudsSwapBuffer->GetSourceBuffer() + firstCloud;
+    ParticleCloud* targetClouds = scene.mParticleCloudsSwapBuffer->GetTargetBuffer() + firstCloud;
+    const Particle* sourceParticles = scene.mParticlesSwapBuffer->GetSourceBuffer();
+    Particle* targetParticles = scene.mParticlesSwapBuffer->GetTargetBuffer();
+
+    FrameWorkCounter pairTests;
+    FrameWorkCounter xIntersections;
+    FrameWorkCounter batchesLoaded;
+    FrameWorkCounter spawns;
+
+    float boidRadius = 10.0f;
+    unsigned int groupStartID = groupID * BATCHSIZE;
+    const ParticleCloud& first = sourceClouds[std::min(groupStartID, numClouds - 1)];
+    const ParticleCloud& last = sourceClouds[std::min(groupStartID + BATCHSIZE - 1, numClouds - 1)];
+    batchesLoaded.Add();
+
+    // Find batches loaded by the group, the test only depends on the group's first and last cloud.
+    std::vector<unsigned int>& loadedBatches = threadData.loadedBatches;
+    loadedBatches.clear();
+    for (unsigned int batchID = groupID + 1; batchID < numClouds / BATCHSIZE + 1; ++batchID)
+    {
+        unsigned int batchStartID = std::min(batchID * BATCHSIZE, numClouds - 1);
+        if (XInstersect(last.mPosition.x, last.mRadius, sourceClouds[batchStartID].mPosition.x, boidRadius))
+            loadedBatches.push_back(batchID);
+    }
+    unsigned int numForwardBatches = static_cast<unsigned int>(loadedBatches.size());
+    for (int batchID = static_cast<int>(groupID) - 1; batchID >= 0; --batchID)
+    {
+        unsigned int batchStartID = std::min(batchID * BATCHSIZE, numClouds - 1);
+        unsigned int batchEndID = std::min(batchStartID + BATCHSIZE - 1, numClouds - 1);
+        if (XInstersect(sourceClouds[batchEndID].mPosition.x, boidRadius, first.mPosition.x, first.mRadius))
+            loadedBatches.push_back(batchID);
+    }
+    batchesLoaded.Add(static_cast<unsigned int>(loadedBatches.size()));
+
+    for (unsigned int groupThreadID = 0; groupThreadID < BATCHSIZE; ++groupThreadID)
+    {
+        unsigned int pID = groupStartID + groupThreadID;
+        if (pID >= numClouds)
+            break;
+
+        // Boid.
+        BoidData boidData;
+        boidData.radius = boidRadius;
+        boidData.center = glm::vec3(0.f, 0.f, 0.f);
+        boidData.n = 0;
+        boidData.separation = glm::vec3(0.f, 0.f, 0.f);
+        boidData.velocity = glm::vec3(0.f, 0.f, 0.f);
+
+        // Self.
+        ParticleCloud self = sourceClouds[pID];
+        self.mColor = glm::vec3(0.f, 0.2f, 0.f); // TMP
+
+        // ----- Update ----- //
+        // Collision with own batch.
+        for (unsigned int otherID = 0; otherID < BATCHSIZE; ++otherID)
+        {
+            if (pID != groupStartID + otherID)
+            {
+                OnXIntersection(self, sourceClouds[std::min(groupStartID + otherID, numClouds - 1)], boidData);
+                pairTests.Add();
+            }
+        }
+
+        // Collision with loaded batches.
+        for (unsigned int b = 0; b < loadedBatches.size(); ++b)
+        {
+            unsigned int batchStartID = std::min(loadedBatches[b] * BATCHSIZE, numClouds - 1);
+            if (b < numForwardBatches)
+            {
+                // Same bounds as the shader's forward loop.
+                unsigned int gpID = std::min(groupThreadID + batchStartID, numClouds - 1);
+                for (unsigned int otherID = 0; otherID < BATCHSIZE - 1; ++otherID)
+                {
+                    if (gpID + otherID < numClouds)
+                    {
+                        OnXIntersection(self, sourceClouds[std::min(batchStartID + otherID, numClouds - 1)], boidData);
+                        pairTests.Add();
+                    }
+                }
+            }
+            else
+            {
+                for (unsigned int otherID = 0; otherID < BATCHSIZE; ++otherID)
+                {
+                    OnXIntersection(self, sourceClouds[std::min(batchStartID + otherID, numClouds - 1)], boidData);
+                    pairTests.Add();
+                }
+            }
+        }
+        xIntersections.Add(boidData.n);
+
+        // ----- Result ----- //
+        // Boid.
+        if (boidData.n > 0)
+        {
+            self.mVelocity += 0.05f * boidData.separation;
+            self.mVelocity += 0.001f * boidData.velocity / static_cast<float>(boidData.n);
+            self.mVelocity += 0.01f * (boidData.center / static_cast<float>(boidData.n) - self.mPosition);
+        }
+
+        // Update cloud.
+        self.mPosition += self.mVelocity * dt;
+        self.mColor.z = (float)pID / numClouds;
+        self.mTimer += dt;
+
+        // Update particles in cloud.
+        for (unsigned int i = self.mParticleStartID; i < self.mParticleStartID + self.mNumParticles; ++i)
+        {
+            Particle particle = sourceParticles[i];
+            if (self.mTimer > self.mSpawntime && particle.mLifetime < 0.f)
+            {
+                self.mTimer = 0.f;
+                particle.mLifetime = self.mSpawntime * self.mNumParticles;
+                particle.mPosition = self.mPosition;
+                particle.mVelocity = self.mVelocity;
+                particle.mScale = glm::vec2(self.mRadius, self.mRadius);
+                particle.mColor = self.mColor;
+                spawns.Add();
+            }
+            targetParticles[i] = particle;
+        }
+
+        // Final result.
+        targetClouds[pID] = self;
+    }
+
+    threadData.workCounters.pairTests += pairTests.Get();
+    threadData.workCounters.xIntersections += xIntersections.Get();
+    threadData.workCounters.batchesLoaded += batchesLoaded.Get();
+    threadData.workCounters.spawns += spawns.Get();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include "CPUScene.h"
+#include "CPUSceneBatch.h"
+#include "JobSystem.h"
+
+// Updates particle clouds on the CPU. Port of ParticleClouds_Update_CS.hlsl, clouds are processed in the same
+// batches of BATCHSIZE as the compute shader thread groups so results and work counters match the GPU.
+class CPUParticleCloudSystem
+{
+    public:
+        // Constructor.
+        // jobSystem Job system to update thread groups in parallel, nullptr to update on the calling thread.
+        CPUParticleCloudSystem(JobSystem* jobSystem = nullptr);
+
+        // Destructor.
+        ~CPUParticleCloudSystem();
+
+        // Update particles.
+        // scene Scene to update.
+        // dt Delta time.
+        void Update(CPUScene& scene, float dt);
+
+        // Update particle clouds of all scenes of a batch in one pass. Thread groups never span scenes and
+        // only load batches of their own scene, so each scene updates as if it were updated alone.
+        // batch Batch to update.
+        // dt Delta time.
+        void Update(CPUSceneBatch& batch, float dt);
+
+    private:
+        // State of one job system thread.
+        struct ThreadData
+        {
+            // Batches loaded by current group, forward batches first.
+            std::vector<unsigned int> loadedBatches;
+            // Work of groups updated by the thread.
+            WorkCounters workCounters;
+        };
+
+        // Thread group of a batch.
+        struct Group
+        {
+            // Scene index.
+            unsigned int scene;
+            // Thread group index within the scene.
+            unsigned int groupID;
+        };
+
+        // Swap buffers, update thread groups in parallel and add work counters to the scene.
+        // scene Scene to update.
+        // numGroups Number of thread groups.
+        // update Function updating one thread group, called with group index and data of calling thread.
+        template <typename Function>
+        void UpdateGroups(CPUScene& scene, unsigned int numGroups, Function update);
+
+        // Update clouds of one thread group.
+        // scene Scene to update.
+        // firstCloud Index of the first cloud of the group's scene.
+        // numClouds Number of clouds of the group's scene.
+        // groupID Thread group index within the scene.
+        // dt Delta time.
+        // threadData Data of calling thread.
+        void UpdateGroup(CPUScene& scene, unsigned int firstCloud, unsigned int numClouds, unsigned int groupID, float dt, ThreadData& threadData);
+
+        JobSystem* mJobSystem;
+        std::vector<ThreadData> mThreadData;
+        std::vector<Group> mGroups;
+};
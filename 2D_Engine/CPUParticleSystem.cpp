@@ -0,0 +1,54 @@
+#include "CPUParticleSystem.h"
+
+#include <atomic>
+
+// Number of particles per job.
+#define CPUPARTICLESYSTEM_GRAIN 16384U
+
+CPUParticleSystem::CPUParticleSystem(JobSystem* jobSystem)
+{
+    mJobSystem = jobSystem;
+}
+
+CPUParticleSystem::~CPUParticleSystem()
+{
+
+}
+
+void CPUParticleSystem::Update(CPUScene& scene, float dt)
+{
+    // Swap buffers.
+    scene.mParticlesSwapBuffer->Swap();
+
+    unsigned int numParticles = scene.mMaxNumParticles;
+    const Particle* source = scene.mParticlesSwapBuffer->GetSourceBuffer();
+    Particle* target = scene.mParticlesSwapBuffer->GetTargetBuffer();
+
+    std::atomic<unsigned int> numAlive(0);
+    auto update = [&](unsigned int begin, unsigned int end)
+    {
+        FrameWorkCounter aliveParticles;
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            Particle self = source[i];
+            self.mPosition += self.mVelocity * dt;
+            self.mVelocity -= self.mVelocity * dt;
+            self.mColor -= self.mColor * dt;
+            self.mScale -= self.mScale * dt;
+            self.mLifetime -= dt;
+
+            target[i] = self;
+
+            if (self.mLifetime >= 0.f)
+                aliveParticles.Add();
+        }
+        numAlive += aliveParticles.Get();
+    };
+
+    if (mJobSystem != nullptr)
+        mJobSystem->ParallelFor(0, numParticles, CPUPARTICLESYSTEM_GRAIN, update);
+    else
+        update(0, numParticles);
+
+    scene.mWorkCounters.aliveParticles += numAlive;
+}
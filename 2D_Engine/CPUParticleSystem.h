@@ -0,0 +1,24 @@
+#pragma once
+
+#include "CPUScene.h"
+#include "JobSystem.h"
+
+// Updates particles on the CPU. Port of Particles_Update_CS.hlsl.
+class CPUParticleSystem
+{
+    public:
+        // Constructor.
+        // jobSystem Job system to update particles in parallel, nullptr to update on the calling thread.
+        CPUParticleSystem(JobSystem* jobSystem = nullptr);
+
+        // Destructor.
+        ~CPUParticleSystem();
+
+        // Update particles.
+        // scene Scene to update.
+        // dt Delta time.
+        void Update(CPUScene& scene, float dt);
+
+    private:
+        JobSystem* mJobSystem;
+};
@@ -0,0 +1,18 @@
+#include "CPUScene.h"
+
+CPUScene::CPUScene(unsigned int maxNumParticles, unsigned int maxNumParticleClouds, const Particle* particles, const ParticleCloud* particleClouds)
+{
+    mMaxNumParticles = maxNumParticles;
+    mMaxNumParticleClouds = maxNumParticleClouds;
+
+    mParticlesSwapBuffer = new CPUSwapBuffer<Particle>(mMaxNumParticles, particles);
+    mParticleCloudsSwapBuffer = new CPUSwapBuffer<ParticleCloud>(mMaxNumParticleClouds, particleClouds);
+
+    mWorkCounters.Reset();
+}
+
+CPUScene::~CPUScene()
+{
+    delete mParticlesSwapBuffer;
+    delete mParticleCloudsSwapBuffer;
+}
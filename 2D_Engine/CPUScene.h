@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CPUSwapBuffer.h"
+#include "Particle.h"
+#include "ParticleCloud.h"
+#include "WorkCounters.h"
+
+// Scene simulated on the CPU. CPU counterpart of Scene, without device resources.
+class CPUScene
+{
+    public:
+        // Constructor.
+        // maxNumParticles Max number of particles.
+        // maxNumParticleClouds Max number of particle clouds.
+        // particles Init particle data, maxNumParticles elements.
+        // particleClouds Init particle cloud data, maxNumParticleClouds elements.
+        CPUScene(unsigned int maxNumParticles, unsigned int maxNumParticleClouds, const Particle* particles, const ParticleCloud* particleClouds);
+
+        // Destructor.
+        ~CPUScene();
+
+        // Max number paricles.
+        unsigned int mMaxNumParticles;
+
+        // Max number paricle clouds.
+        unsigned int mMaxNumParticleClouds;
+
+        // Partilce cloud swap buffer.
+        CPUSwapBuffer<ParticleCloud>* mParticleCloudsSwapBuffer;
+
+        // Particles swap buffer.
+        CPUSwapBuffer<Particle>* mParticlesSwapBuffer;
+
+        // Simulation work counters. Accumulated by the systems, reset by the caller. Stay zero if counters are compiled out.
+        WorkCounters mWorkCounters;
+};
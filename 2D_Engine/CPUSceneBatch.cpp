@@ -0,0 +1,41 @@
+#include "CPUSceneBatch.h"
+
+#include "SceneBuilder.h"
+
+CPUSceneBatch::CPUSceneBatch(const std::vector<unsigned int>& numParticleClouds, const Particle* particles, const ParticleCloud* particleClouds)
+{
+    unsigned int numTotalParticleClouds = 0;
+    for (unsigned int s = 0; s < numParticleClouds.size(); ++s)
+    {
+        Range range;
+        range.firstParticleCloud = numTotalParticleClouds;
+        range.numParticleClouds = numParticleClouds[s];
+        range.firstParticle = numTotalParticleClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+        range.numParticles = numParticleClouds[s] * SceneBuilder::PARTICLES_PER_CLOUD;
+        mRanges.push_back(range);
+        mSceneIndices.insert(mSceneIndices.end(), numParticleClouds[s], s);
+        numTotalParticleClouds += numParticleClouds[s];
+    }
+
+    mScene = new CPUScene(numTotalParticleClouds * SceneBuilder::PARTICLES_PER_CLOUD, numTotalParticleClouds, particles, particleClouds);
+}
+
+CPUSceneBatch::~CPUSceneBatch()
+{
+    delete mScene;
+}
+
+unsigned int CPUSceneBatch::GetNumScenes() const
+{
+    return static_cast<unsigned int>(mRanges.size());
+}
+
+const CPUSceneBatch::Range& CPUSceneBatch::GetRange(unsigned int scene) const
+{
+    return mRanges[scene];
+}
+
+const unsigned int* CPUSceneBatch::GetSceneIndices() const
+{
+    return mSceneIndices.data();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "CPUScene.h"
+
+// Independent scenes packed into the buffers of one CPUScene. Scene s owns a contiguous range of clouds and
+// particles, the batched sort and cloud update keep clouds inside their range, so scenes never interact.
+class CPUSceneBatch
+{
+    public:
+        // Clouds and particles of one scene in the packed buffers.
+        struct Range
+        {
+            // Index of first particle cloud.
+            unsigned int firstParticleCloud;
+            // Number of particle clouds.
+            unsigned int numParticleClouds;
+            // Index of first particle.
+            unsigned int firstParticle;
+            // Number of particles.
+            unsigned int numParticles;
+        };
+
+        // Constructor. Clouds must reference particles by their packed index.
+        // numParticleClouds Number of particle clouds of each scene, each cloud owns SceneBuilder::PARTICLES_PER_CLOUD particles.
+        // particles Packed init particle data of all scenes.
+        // particleClouds Packed init particle cloud data of all scenes.
+        CPUSceneBatch(const std::vector<unsigned int>& numParticleClouds, const Particle* particles, const ParticleCloud* particleClouds);
+
+        // Destructor.
+        ~CPUSceneBatch();
+
+        // Not copyable, the batch owns mScene.
+        CPUSceneBatch(const CPUSceneBatch&) = delete;
+        CPUSceneBatch& operator=(const CPUSceneBatch&) = delete;
+
+        // Get number of scenes.
+        unsigned int GetNumScenes() const;
+
+        // Get range of a scene.
+        // scene Scene index.
+        const Range& GetRange(unsigned int scene) const;
+
+        // Get scene index of each particle cloud slot.
+        const unsigned int* GetSceneIndices() const;
+
+        // Packed scene. The particle system updates it directly, particles have no per-scene state.
+        CPUScene* mScene;
+
+    private:
+        std::vector<Range> mRanges;
+        std::vector<unsigned int> mSceneIndices;
+};
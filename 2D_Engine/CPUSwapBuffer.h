@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+template <typename T>
+// Double-buffered swap buffer in system memory. CPU counterpart of GPUSwapBuffer.
+class CPUSwapBuffer
+{
+    public:
+        // Constructor.
+        // numOfElements Number of elements of type elements T.
+        // initData Init data.
+        CPUSwapBuffer(unsigned int numOfElements, const T* initData = nullptr);
+
+        // Destructor.
+        ~CPUSwapBuffer();
+
+        // Swap read/write buffers.
+        void Swap();
+
+        // Get source buffer (read buffer).
+        const T* GetSourceBuffer() const;
+
+        // Get target buffer (write buffer).
+        T* GetTargetBuffer();
+
+        // Get number of elements.
+        unsigned int GetSize() const;
+
+    private:
+        bool mState;
+        std::vector<T> mBuffers[2];
+};
+
+template <typename T>
+inline CPUSwapBuffer<T>::CPUSwapBuffer(unsigned int numOfElements, const T* initData)
+{
+    mState = 0;
+
+    if (initData == nullptr)
+    {
+        mBuffers[0].resize(numOfElements);
+        mBuffers[1].resize(numOfElements);
+    }
+    else
+    {
+        mBuffers[0].assign(initData, initData + numOfElements);
+        mBuffers[1].assign(initData, initData + numOfElements);
+    }
+}
+
+template <typename T>
+inline CPUSwapBuffer<T>::~CPUSwapBuffer()
+{
+
+}
+
+template <typename T>
+inline void CPUSwapBuffer<T>::Swap()
+{
+    mState = !mState;
+}
+
+template <typename T>
+inline const T* CPUSwapBuffer<T>::GetSourceBuffer() const
+{
+    return mBuffers[!mState].data();
+}
+
+template <typename T>
+inline T* CPUSwapBuffer<T>::GetTargetBuffer()
+{
+    return mBuffers[mState].data();
+}
+
+template <typename T>
+inline unsigned int CPUSwapBuffer<T>::GetSize() const
+{
+    return static_cast<unsigned int>(mBuffers[0].size());
+}
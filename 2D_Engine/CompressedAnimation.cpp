@@ -0,0 +1,367 @@
+#include "CompressedAnimation.h"
+#include <algorithm>
+#include <assimp/types.h>
+#include <cmath>
+#include "Animation.h"
+
+using namespace Geometry;
+
+namespace {
+    // Largest smallest-three component, 1 / sqrt(2).
+    const float kRotationRange = 0.70710678f;
+
+    // Find keys to keep, so interpolating between kept keys reproduces every removed key within tolerance.
+    template <typename T, typename Interpolate, typename Error>
+    std::vector<std::size_t> ReduceKeys(const std::vector<float>& times, const std::vector<T>& values, float tolerance, Interpolate interpolate, Error error) {
+        std::vector<std::size_t> kept;
+        if (values.empty())
+            return kept;
+
+        // Constant track.
+        bool constant = true;
+        for (std::size_t k = 1; k < values.size() && constant; ++k)
+            constant = error(values[0], values[k]) <= tolerance;
+        kept.push_back(0);
+        if (constant)
+            return kept;
+
+        std::size_t anchor = 0;
+        for (std::size_t end = 2; end < values.size(); ++end) {
+            bool fits = end - anchor <= COMPRESSEDANIMATION_MAX_RUN;
+            for (std::size_t k = anchor + 1; k < end && fits; ++k) {
+                float deltaTime = times[end] - times[anchor];
+                float factor = deltaTime > 0.0f ? (times[k] - times[anchor]) / deltaTime : 0.0f;
+                fits = error(interpolate(values[anchor], values[end], factor), values[k]) <= tolerance;
+            }
+            if (!fits) {
+                anchor = end - 1;
+                kept.push_back(anchor);
+            }
+        }
+        kept.push_back(values.size() - 1);
+        return kept;
+    }
+
+    // Animation interpolates from the last key back to the first over the rest of the duration, store that as a key.
+    template <typename T>
+    void AppendWrapKey(std::vector<float>& times, std::vector<T>& values, float duration) {
+        if (values.size() > 1 && times.back() < duration) {
+            times.push_back(duration);
+            values.push_back(values[0]);
+        }
+    }
+
+    aiQuaternion InterpolateRotation(const aiQuaternion& start, const aiQuaternion& end, float factor) {
+        aiQuaternion rotation;
+        aiQuaternion::Interpolate(rotation, start, end, factor);
+        return rotation.Normalize();
+    }
+
+    float RotationError(const aiQuaternion& a, const aiQuaternion& b) {
+        float dot = std::abs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+        return 2.0f * std::acos(std::min(dot, 1.0f));
+    }
+
+    glm::vec3 InterpolateVector(const glm::vec3& start, const glm::vec3& end, float factor) {
+        return start + factor * (end - start);
+    }
+
+    float VectorError(const glm::vec3& a, const glm::vec3& b) {
+        return glm::length(a - b);
+    }
+
+    // Round value to the nearest integer in [0, max].
+    std::uint16_t Quantize(float value, float max) {
+        return static_cast<std::uint16_t>(std::min(std::max(std::floor(value + 0.5f), 0.0f), max));
+    }
+
+    // Smallest three: the largest component is dropped and restored from unit length. Each kept component takes
+    // 15 bits of a value, the low bits of the first two values hold the dropped component's index.
+    void QuantizeRotation(const aiQuaternion& rotation, std::uint16_t* value) {
+        const float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+        unsigned int largest = 0;
+        for (unsigned int i = 1; i < 4; ++i)
+            if (std::abs(components[i]) > std::abs(components[largest]))
+                largest = i;
+        // q and -q are the same rotation, so the dropped component is always positive.
+        float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+        float magnitude = std::sqrt(components[0] * components[0] + components[1] * components[1] + components[2] * components[2] + components[3] * components[3]);
+        unsigned int v = 0;
+        for (unsigned int i = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            float component = components[i] * sign / magnitude;
+            value[v] = static_cast<std::uint16_t>(Quantize(((component / kRotationRange) * 0.5f + 0.5f) * 32767.0f, 32767.0f) << 1);
+            ++v;
+        }
+        value[0] |= largest & 1;
+        value[1] |= (largest >> 1) & 1;
+    }
+
+    void DequantizeRotation(const std::uint16_t* value, float* rotation) {
+        unsigned int largest = (value[0] & 1) | ((value[1] & 1) << 1);
+        float sum = 0.0f;
+        unsigned int v = 0;
+        for (unsigned int i = 0; i < 4; ++i) {
+            if (i == largest)
+                continue;
+            rotation[i] = ((value[v] >> 1) / 32767.0f * 2.0f - 1.0f) * kRotationRange;
+            sum += rotation[i] * rotation[i];
+            ++v;
+        }
+        rotation[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    }
+}
+
+CompressedAnimation::CompressedAnimation() {
+    duration = 0.0;
+    ticksPerSecond = 0.0;
+    timeScale = 1.0f;
+    blockTicks = 1.0f;
+    statistics = Statistics();
+}
+
+CompressedAnimation::CompressedAnimation(const Animation& animation, const Settings& settings) {
+    Compress(animation, settings);
+}
+
+CompressedAnimation::~CompressedAnimation() {
+
+}
+
+void CompressedAnimation::Compress(const Animation& animation, const Settings& settings) {
+    name = animation.name;
+    duration = animation.duration;
+    ticksPerSecond = animation.ticksPerSecond;
+    statistics = Statistics();
+
+    // Times are stored in 1 / timeScale ticks. Power of two scales keep integer tick times exact.
+    timeScale = 1.0f;
+    if (duration > 0.0) {
+        while (duration * timeScale * 2.0 <= 65535.0 && timeScale < 65536.0f)
+            timeScale *= 2.0f;
+        if (duration * timeScale > 65535.0)
+            timeScale = static_cast<float>(65535.0 / duration);
+    }
+    blockTicks = std::max(settings.blockDuration * timeScale, 1.0f);
+
+    // Reduce and quantize the keys of every track.
+    const std::size_t numChannels = animation.GetNumChannels();
+    channelIndexMap.clear();
+    ranges.assign(numChannels * 3, Range());
+    constantKeys.clear();
+    std::vector<std::vector<Key>> trackKeys(numChannels * 3);
+    std::vector<float> times;
+    std::vector<aiQuaternion> rotations;
+    std::vector<glm::vec3> values;
+    for (std::size_t c = 0; c < numChannels; ++c) {
+        const Animation::AnimChannel& channel = animation.GetChannel(c);
+        channelIndexMap[channel.trgNodeName] = c;
+        statistics.numSourceKeys += channel.rotTimes.size() + channel.posTimes.size() + channel.sclTimes.size();
+
+        for (unsigned int t = 0; t < 3; ++t) {
+            const std::size_t track = c * 3 + t;
+            times = t == 0 ? channel.rotTimes : (t == 1 ? channel.posTimes : channel.sclTimes);
+            std::vector<std::size_t> kept;
+            if (t == 0) {
+                rotations = channel.rotValues;
+                AppendWrapKey(times, rotations, channel.duration);
+                kept = ReduceKeys(times, rotations, settings.rotationTolerance, InterpolateRotation, RotationError);
+            } else {
+                values = t == 1 ? channel.posValues : channel.sclValues;
+                AppendWrapKey(times, values, channel.duration);
+                kept = ReduceKeys(times, values, t == 1 ? settings.translationTolerance : settings.scaleTolerance, InterpolateVector, VectorError);
+                Range& range = ranges[track];
+                if (!kept.empty()) {
+                    glm::vec3 min = values[kept[0]];
+                    glm::vec3 max = min;
+                    for (std::size_t k : kept) {
+                        min = glm::min(min, values[k]);
+                        max = glm::max(max, values[k]);
+                    }
+                    range.min = min;
+                    range.extent = max - min;
+                }
+            }
+
+            for (std::size_t k : kept) {
+                Key key;
+                key.time = Quantize(times[k] * timeScale, 65535.0f);
+                key.track = static_cast<std::uint16_t>(track);
+                if (t == 0) {
+                    QuantizeRotation(rotations[k], key.value);
+                } else {
+                    const glm::vec3& value = values[k];
+                    const Range& range = ranges[track];
+                    for (unsigned int i = 0; i < 3; ++i)
+                        key.value[i] = range.extent[i] > 0.0f ? Quantize((value[i] - range.min[i]) / range.extent[i] * 65535.0f, 65535.0f) : 0;
+                }
+                trackKeys[track].push_back(key);
+            }
+            statistics.numKeys += kept.size();
+            if (kept.size() == 1) {
+                constantKeys.push_back(trackKeys[track][0]);
+                trackKeys[track].clear();
+                ++statistics.numConstantTracks;
+            }
+        }
+    }
+
+    // Each block holds, per track, the keys in its span plus the keys around it. Keys are ordered by the time of
+    // the previous key of their track, which is when a forward playing decoder first needs them.
+    const unsigned int numBlocks = static_cast<unsigned int>(duration * timeScale / blockTicks) + 1;
+    struct PendingKey {
+        float neededTime;
+        Key key;
+    };
+    std::vector<PendingKey> pending;
+    keys.clear();
+    blockOffsets.clear();
+    for (unsigned int b = 0; b < numBlocks; ++b) {
+        const float startTime = b * blockTicks;
+        const float endTime = b + 1 < numBlocks ? startTime + blockTicks : 65536.0f;
+        pending.clear();
+        for (const std::vector<Key>& track : trackKeys) {
+            if (track.empty())
+                continue;
+            std::size_t first = 0;
+            while (first + 1 < track.size() && track[first + 1].time <= startTime)
+                ++first;
+            for (std::size_t k = first; k < track.size(); ++k) {
+                PendingKey pendingKey;
+                pendingKey.neededTime = k == first ? -1.0f : track[k - 1].time;
+                pendingKey.key = track[k];
+                pending.push_back(pendingKey);
+                if (track[k].time >= endTime)
+                    break;
+            }
+        }
+        std::stable_sort(pending.begin(), pending.end(), [](const PendingKey& a, const PendingKey& b) {
+            return a.neededTime < b.neededTime;
+        });
+
+        blockOffsets.push_back(static_cast<std::uint32_t>(keys.size()));
+        for (const PendingKey& pendingKey : pending)
+            keys.push_back(pendingKey.key);
+    }
+    blockOffsets.push_back(static_cast<std::uint32_t>(keys.size()));
+    statistics.numStoredKeys = keys.size() + constantKeys.size();
+}
+
+std::size_t CompressedAnimation::FindChannel(const std::string& name) const {
+    const auto& it = channelIndexMap.find(name);
+    if (it != channelIndexMap.end())
+        return it->second;
+    return -1;
+}
+
+std::size_t CompressedAnimation::GetNumChannels() const {
+    return ranges.size() / 3;
+}
+
+std::size_t CompressedAnimation::GetNumBytes() const {
+    return ranges.size() * sizeof(Range) + (constantKeys.size() + keys.size()) * sizeof(Key) + blockOffsets.size() * sizeof(std::uint32_t);
+}
+
+const CompressedAnimation::Statistics& CompressedAnimation::GetStatistics() const {
+    return statistics;
+}
+
+void CompressedAnimation::DecodeKey(const Key& key, float* value) const {
+    if (key.track % 3 == 0) {
+        DequantizeRotation(key.value, value);
+    } else {
+        const Range& range = ranges[key.track];
+        for (unsigned int i = 0; i < 3; ++i)
+            value[i] = range.min[i] + range.extent[i] * (key.value[i] / 65535.0f);
+    }
+}
+
+CompressedAnimation::Decoder::Decoder(const CompressedAnimation& animation) : animation(animation) {
+    const std::size_t numChannels = animation.GetNumChannels();
+    tracks.resize(numChannels * 3);
+    scalings.resize(numChannels);
+    rotations.resize(numChannels);
+    translations.resize(numChannels);
+    Reset(0);
+}
+
+CompressedAnimation::Decoder::~Decoder() {
+
+}
+
+void CompressedAnimation::Decoder::Sample(float animationTime) {
+    if (animation.blockOffsets.empty())
+        return;
+
+    const float time = animationTime * animation.timeScale;
+    const unsigned int numBlocks = static_cast<unsigned int>(animation.blockOffsets.size() - 1);
+    const unsigned int sampleBlock = std::min(static_cast<unsigned int>(std::max(time, 0.0f) / animation.blockTicks), numBlocks - 1);
+    if (sampleBlock != block || time < lastTime)
+        Reset(sampleBlock);
+    lastTime = time;
+
+    // Advance every track whose next key has been passed, keys are stored in the order they are needed.
+    const std::size_t endKey = animation.blockOffsets[block + 1];
+    while (nextKey < endKey) {
+        const Key& key = animation.keys[nextKey];
+        TrackState& track = tracks[key.track];
+        if (track.valid[1] && time < track.time[1])
+            break;
+        track.time[0] = track.time[1];
+        std::copy(track.value[1], track.value[1] + 4, track.value[0]);
+        track.valid[0] = track.valid[1];
+        track.time[1] = key.time;
+        animation.DecodeKey(key, track.value[1]);
+        track.valid[1] = true;
+        ++nextKey;
+    }
+
+    for (std::size_t c = 0; c < rotations.size(); ++c) {
+        for (unsigned int t = 0; t < 3; ++t) {
+            const TrackState& track = tracks[c * 3 + t];
+            float factor = 1.0f;
+            if (track.valid[0] && time < track.time[1]) {
+                float deltaTime = track.time[1] - track.time[0];
+                factor = deltaTime > 0.0f ? std::min(std::max((time - track.time[0]) / deltaTime, 0.0f), 1.0f) : 1.0f;
+            }
+            const float* start = track.valid[0] ? track.value[0] : track.value[1];
+            const float* end = track.value[1];
+            if (t == 0) {
+                aiQuaternion startQ(start[3], start[0], start[1], start[2]);
+                aiQuaternion endQ(end[3], end[0], end[1], end[2]);
+                rotations[c] = InterpolateRotation(startQ, endQ, factor);
+            } else {
+                glm::vec3& value = t == 1 ? translations[c] : scalings[c];
+                for (unsigned int i = 0; i < 3; ++i)
+                    value[i] = start[i] + factor * (end[i] - start[i]);
+            }
+        }
+    }
+}
+
+const glm::vec3& CompressedAnimation::Decoder::GetScaling(std::size_t channel) const {
+    return scalings[channel];
+}
+
+const aiQuaternion& CompressedAnimation::Decoder::GetRotation(std::size_t channel) const {
+    return rotations[channel];
+}
+
+const glm::vec3& CompressedAnimation::Decoder::GetTranslation(std::size_t channel) const {
+    return translations[channel];
+}
+
+void CompressedAnimation::Decoder::Reset(unsigned int sampleBlock) {
+    for (TrackState& track : tracks)
+        track.valid[0] = track.valid[1] = false;
+    for (const Key& key : animation.constantKeys) {
+        TrackState& track = tracks[key.track];
+        track.time[1] = 0.0f;
+        animation.DecodeKey(key, track.value[1]);
+        track.valid[1] = true;
+    }
+    block = sampleBlock;
+    nextKey = animation.blockOffsets.empty() ? 0 : animation.blockOffsets[block];
+    lastTime = -1.0f;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <assimp/quaternion.h>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+// Max number of keys a removed run may span, bounds the cost of key reduction.
+#define COMPRESSEDANIMATION_MAX_RUN 64U
+
+namespace Geometry {
+
+    class Animation;
+
+    /// An animation compressed for memory.
+    /**
+    * Keys that interpolation reproduces within a tolerance are removed and constant tracks keep a single key.
+    * Rotations are quantized to 48 bits storing the three smallest components, positions and scales to 16 bits per
+    * component in the range of their track, and times to 16 bits. Keys are split into blocks of fixed duration,
+    * each block holds the keys of all tracks interleaved in the order a forward playing Decoder needs them.
+    */
+    class CompressedAnimation {
+    public:
+        /// Compression tolerances.
+        struct Settings {
+            /// Max rotation error of removed keys in radians.
+            float rotationTolerance = 0.001f;
+            /// Max position error of removed keys.
+            float translationTolerance = 0.001f;
+            /// Max scale error of removed keys.
+            float scaleTolerance = 0.001f;
+            /// Duration of a block in ticks.
+            float blockDuration = 32.0f;
+        };
+
+        /// Compression statistics.
+        struct Statistics {
+            /// Number of keys of the source animation.
+            std::size_t numSourceKeys;
+            /// Number of keys kept.
+            std::size_t numKeys;
+            /// Number of keys stored, kept keys plus keys repeated at block boundaries.
+            std::size_t numStoredKeys;
+            /// Number of tracks reduced to a single key.
+            std::size_t numConstantTracks;
+        };
+
+        /// Samples a compressed animation, fastest when played forward.
+        class Decoder {
+        public:
+            /// Create new decoder.
+            /**
+            * @param animation Animation to sample, must outlive the decoder.
+            */
+            Decoder(const CompressedAnimation& animation);
+
+            /// Destructor.
+            ~Decoder();
+
+            /// Sample all channels.
+            /**
+            * Continues from the last sample when time moves forward inside a block, else restarts at the block.
+            * Times before the first or after the last key of a track hold that key.
+            * @param animationTime Time of the animation in ticks.
+            */
+            void Sample(float animationTime);
+
+            /// Get sampled scaling of a channel.
+            /**
+            * @param channel Channel index.
+            * @return Scaling vector.
+            */
+            const glm::vec3& GetScaling(std::size_t channel) const;
+
+            /// Get sampled rotation of a channel.
+            /**
+            * @param channel Channel index.
+            * @return Rotation quaternion.
+            */
+            const aiQuaternion& GetRotation(std::size_t channel) const;
+
+            /// Get sampled translation of a channel.
+            /**
+            * @param channel Channel index.
+            * @return Translation vector.
+            */
+            const glm::vec3& GetTranslation(std::size_t channel) const;
+
+        private:
+            struct TrackState {
+                float time[2];
+                float value[2][4];
+                bool valid[2];
+            };
+
+            void Reset(unsigned int block);
+
+            const CompressedAnimation& animation;
+            std::vector<TrackState> tracks;
+            std::vector<glm::vec3> scalings;
+            std::vector<aiQuaternion> rotations;
+            std::vector<glm::vec3> translations;
+            unsigned int block;
+            std::size_t nextKey;
+            float lastTime;
+        };
+
+        /// Create new empty compressed animation.
+        /**
+        * The created animation has to be compressed later using Compress.
+        */
+        CompressedAnimation();
+
+        /// Create new compressed animation.
+        /**
+        * @param animation Animation to compress.
+        * @param settings Compression tolerances.
+        */
+        CompressedAnimation(const Animation& animation, const Settings& settings);
+
+        /// Destructor.
+        ~CompressedAnimation();
+
+        /// Compress animation.
+        /**
+        * @param animation Animation to compress.
+        * @param settings Compression tolerances.
+        */
+        void Compress(const Animation& animation, const Settings& settings);
+
+        /// Find channel.
+        /**
+        * @param name Name of the node affected by the channel.
+        * @return Channel index, if not found -1.
+        */
+        std::size_t FindChannel(const std::string& name) const;
+
+        /// Get number of channels.
+        /**
+        * @return Number of channels.
+        */
+        std::size_t GetNumChannels() const;
+
+        /// Get memory used by keys.
+        /**
+        * @return Size of keys, track ranges and block offsets in bytes.
+        */
+        std::size_t GetNumBytes() const;
+
+        /// Get compression statistics.
+        /**
+        * @return Statistics of the last Compress.
+        */
+        const Statistics& GetStatistics() const;
+
+        /// Animation name.
+        std::string name;
+
+        /// Duration of the animation in ticks.
+        double duration;
+
+        /// Animation ticks per second.
+        double ticksPerSecond;
+
+    private:
+        friend class CookedAsset;
+
+        // Quantized key of a track. Tracks 3c, 3c + 1 and 3c + 2 are rotation, translation and scaling of channel c.
+        struct Key {
+            std::uint16_t time;
+            std::uint16_t track;
+            std::uint16_t value[3];
+        };
+
+        // Dequantization range of a translation or scaling track.
+        struct Range {
+            glm::vec3 min;
+            glm::vec3 extent;
+        };
+
+        void DecodeKey(const Key& key, float* value) const;
+
+        std::map<std::string, std::size_t> channelIndexMap;
+        std::vector<Range> ranges;
+        std::vector<Key> constantKeys;
+        std::vector<Key> keys;
+        std::vector<std::uint32_t> blockOffsets;
+        float timeScale;
+        float blockTicks;
+        Statistics statistics;
+    };
+}
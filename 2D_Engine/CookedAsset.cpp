@@ -0,0 +1,422 @@
+#include "CookedAsset.h"
+#include <algorithm>
+#include <assimp/scene.h>
+#include <cstdio>
+#include <cstring>
+#include "Animation.h"
+#include "MathFunctions.h"
+#include "Skeleton.h"
+
+using namespace Geometry;
+
+namespace {
+    // Round offset up to COOKEDASSET_ALIGNMENT.
+    std::uint64_t Align(std::uint64_t offset) {
+        return (offset + COOKEDASSET_ALIGNMENT - 1) / COOKEDASSET_ALIGNMENT * COOKEDASSET_ALIGNMENT;
+    }
+
+    // Append array to the file at the next aligned offset.
+    template <typename T>
+    std::uint64_t Append(std::vector<char>& buffer, const T* data, std::size_t count) {
+        const std::uint64_t offset = Align(buffer.size());
+        buffer.resize(static_cast<std::size_t>(offset + sizeof(T) * count));
+        if (count > 0)
+            memcpy(&buffer[static_cast<std::size_t>(offset)], data, sizeof(T) * count);
+        return offset;
+    }
+
+    // Add null terminated name to the name table.
+    std::uint32_t AddName(std::vector<char>& names, const std::string& name) {
+        const std::uint32_t offset = static_cast<std::uint32_t>(names.size());
+        names.insert(names.end(), name.begin(), name.end());
+        names.push_back('\0');
+        return offset;
+    }
+}
+
+CookedAsset::CookedAsset() {
+    header = nullptr;
+}
+
+CookedAsset::~CookedAsset() {
+
+}
+
+bool CookedAsset::Cook(const aiScene* aScene, const CompressedAnimation::Settings& settings, const std::string& path) {
+    Skeleton skeleton(aScene);
+    std::vector<Mesh> meshes;
+    std::vector<SkinVertex> vertices;
+    std::vector<std::uint32_t> indices;
+    ConvertMeshes(aScene, skeleton, meshes, vertices, indices);
+
+    Header fileHeader = Header();
+    fileHeader.magic = COOKEDASSET_MAGIC;
+    fileHeader.version = COOKEDASSET_VERSION;
+    fileHeader.headerSize = sizeof(Header);
+    fileHeader.clipSize = sizeof(Clip);
+    fileHeader.vertexSize = sizeof(SkinVertex);
+    fileHeader.keySize = sizeof(CompressedAnimation::Key);
+    fileHeader.numMeshes = static_cast<std::uint32_t>(meshes.size());
+    fileHeader.numVertices = static_cast<std::uint32_t>(vertices.size());
+    fileHeader.numIndices = static_cast<std::uint32_t>(indices.size());
+    fileHeader.numNodes = static_cast<std::uint32_t>(skeleton.nodeParents.size());
+    fileHeader.numBones = static_cast<std::uint32_t>(skeleton.bones.size());
+    fileHeader.numClips = aScene->mNumAnimations;
+    fileHeader.globalInverseTransform = skeleton.globalInverseTransform;
+
+    // The header is filled in last.
+    std::vector<char> buffer(sizeof(Header));
+    std::vector<char> names;
+    fileHeader.meshesOffset = Append(buffer, meshes.data(), meshes.size());
+    fileHeader.verticesOffset = Append(buffer, vertices.data(), vertices.size());
+    fileHeader.indicesOffset = Append(buffer, indices.data(), indices.size());
+
+    // Flattened skeleton, bones without a node are marked -1.
+    std::vector<std::uint32_t> nameOffsets(skeleton.nodeNames.size());
+    for (std::size_t i = 0; i < nameOffsets.size(); ++i)
+        nameOffsets[i] = AddName(names, skeleton.nodeNames[i]);
+    fileHeader.nodeNamesOffset = Append(buffer, nameOffsets.data(), nameOffsets.size());
+    std::vector<std::int32_t> nodeParents(skeleton.nodeParents.begin(), skeleton.nodeParents.end());
+    fileHeader.nodeParentsOffset = Append(buffer, nodeParents.data(), nodeParents.size());
+    fileHeader.nodeTransformsOffset = Append(buffer, skeleton.nodeTransforms.data(), skeleton.nodeTransforms.size());
+    std::vector<std::int32_t> nodeBones(skeleton.nodeBones.size());
+    for (std::size_t i = 0; i < nodeBones.size(); ++i)
+        nodeBones[i] = skeleton.nodeBones[i] != static_cast<std::size_t>(-1) ? static_cast<std::int32_t>(skeleton.nodeBones[i]) : -1;
+    fileHeader.nodeBonesOffset = Append(buffer, nodeBones.data(), nodeBones.size());
+    nameOffsets.assign(skeleton.bones.size(), 0);
+    for (const auto& it : skeleton.boneIndexMap)
+        nameOffsets[it.second] = AddName(names, it.first);
+    fileHeader.boneNamesOffset = Append(buffer, nameOffsets.data(), nameOffsets.size());
+    fileHeader.bonesOffset = Append(buffer, skeleton.bones.data(), skeleton.bones.size());
+
+    // Compressed animations.
+    std::vector<Clip> clips(aScene->mNumAnimations);
+    for (unsigned int a = 0; a < aScene->mNumAnimations; ++a) {
+        Animation animation(aScene->mAnimations[a]);
+        CompressedAnimation compressed(animation, settings);
+        Clip& clip = clips[a];
+        clip.name = AddName(names, compressed.name);
+        clip.numChannels = static_cast<std::uint32_t>(compressed.GetNumChannels());
+        clip.numKeys = static_cast<std::uint32_t>(compressed.keys.size());
+        clip.numConstantKeys = static_cast<std::uint32_t>(compressed.constantKeys.size());
+        clip.numBlocks = static_cast<std::uint32_t>(compressed.blockOffsets.size() - 1);
+        clip.timeScale = compressed.timeScale;
+        clip.blockTicks = compressed.blockTicks;
+        clip.reserved = 0;
+        clip.duration = compressed.duration;
+        clip.ticksPerSecond = compressed.ticksPerSecond;
+        clip.numSourceKeys = compressed.statistics.numSourceKeys;
+        clip.numReducedKeys = compressed.statistics.numKeys;
+        clip.numConstantTracks = compressed.statistics.numConstantTracks;
+
+        nameOffsets.assign(clip.numChannels, 0);
+        for (const auto& it : compressed.channelIndexMap)
+            nameOffsets[it.second] = AddName(names, it.first);
+        clip.channelNamesOffset = Append(buffer, nameOffsets.data(), nameOffsets.size());
+        clip.rangesOffset = Append(buffer, compressed.ranges.data(), compressed.ranges.size());
+        clip.constantKeysOffset = Append(buffer, compressed.constantKeys.data(), compressed.constantKeys.size());
+        clip.keysOffset = Append(buffer, compressed.keys.data(), compressed.keys.size());
+        clip.blockOffsetsOffset = Append(buffer, compressed.blockOffsets.data(), compressed.blockOffsets.size());
+    }
+    fileHeader.clipsOffset = Append(buffer, clips.data(), clips.size());
+    fileHeader.namesSize = static_cast<std::uint32_t>(names.size());
+    fileHeader.namesOffset = Append(buffer, names.data(), names.size());
+    fileHeader.fileSize = buffer.size();
+    memcpy(buffer.data(), &fileHeader, sizeof(Header));
+
+    std::string temporaryPath = path + ".tmp";
+    FILE* cookedFile = fopen(temporaryPath.c_str(), "wb");
+    if (cookedFile == nullptr)
+        return false;
+    bool written = fwrite(buffer.data(), 1, buffer.size(), cookedFile) == buffer.size();
+    written &= fclose(cookedFile) == 0;
+
+    // Rename does not replace existing files on Windows.
+    if (written) {
+        remove(path.c_str());
+        written = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!written)
+        remove(temporaryPath.c_str());
+    return written;
+}
+
+void CookedAsset::ConvertMeshes(const aiScene* aScene, Skeleton& skeleton, std::vector<Mesh>& meshes, std::vector<SkinVertex>& vertices, std::vector<std::uint32_t>& indices) {
+    meshes.resize(aScene->mNumMeshes);
+    vertices.clear();
+    indices.clear();
+    for (unsigned int m = 0; m < aScene->mNumMeshes; ++m) {
+        const aiMesh* aMesh = aScene->mMeshes[m];
+        Mesh& mesh = meshes[m];
+        mesh.firstVertex = static_cast<std::uint32_t>(vertices.size());
+        mesh.numVertices = aMesh->mNumVertices;
+        mesh.firstIndex = static_cast<std::uint32_t>(indices.size());
+
+        vertices.resize(vertices.size() + aMesh->mNumVertices);
+        SkinVertex* meshVertices = &vertices[mesh.firstVertex];
+        for (unsigned int v = 0; v < aMesh->mNumVertices; ++v) {
+            SkinVertex& vertex = meshVertices[v];
+            CpyVec(vertex.position, aMesh->mVertices[v]);
+            vertex.textureCoordinate = glm::vec2(0.0f);
+            if (aMesh->HasTextureCoords(0))
+                CpyVec(vertex.textureCoordinate, aMesh->mTextureCoords[0][v]);
+            vertex.normal = glm::vec3(0.0f);
+            if (aMesh->HasNormals())
+                CpyVec(vertex.normal, aMesh->mNormals[v]);
+            vertex.tangent = glm::vec3(0.0f);
+            if (aMesh->HasTangentsAndBitangents())
+                CpyVec(vertex.tangent, aMesh->mTangents[v]);
+            vertex.boneIDs = glm::ivec4(0);
+            vertex.weights = glm::vec4(0.0f);
+        }
+
+        // Keep the largest weights, sorted in descending order.
+        for (unsigned int b = 0; b < aMesh->mNumBones; ++b) {
+            const aiBone* aBone = aMesh->mBones[b];
+            const int boneID = static_cast<int>(skeleton.FindBoneIndex(aBone->mName.data));
+            for (unsigned int w = 0; w < aBone->mNumWeights; ++w) {
+                const aiVertexWeight& aWeight = aBone->mWeights[w];
+                SkinVertex& vertex = meshVertices[aWeight.mVertexId];
+                int slot = 4;
+                while (slot > 0 && vertex.weights[slot - 1] < aWeight.mWeight)
+                    --slot;
+                if (slot == 4)
+                    continue;
+                for (int i = 3; i > slot; --i) {
+                    vertex.weights[i] = vertex.weights[i - 1];
+                    vertex.boneIDs[i] = vertex.boneIDs[i - 1];
+                }
+                vertex.weights[slot] = aWeight.mWeight;
+                vertex.boneIDs[slot] = boneID;
+            }
+        }
+        for (unsigned int v = 0; v < aMesh->mNumVertices; ++v) {
+            SkinVertex& vertex = meshVertices[v];
+            const float sum = vertex.weights.x + vertex.weights.y + vertex.weights.z + vertex.weights.w;
+            if (sum > 0.0f)
+                vertex.weights /= sum;
+        }
+
+        for (unsigned int f = 0; f < aMesh->mNumFaces; ++f) {
+            const aiFace& aFace = aMesh->mFaces[f];
+            if (aFace.mNumIndices == 3)
+                indices.insert(indices.end(), aFace.mIndices, aFace.mIndices + 3);
+        }
+        mesh.numIndices = static_cast<std::uint32_t>(indices.size()) - mesh.firstIndex;
+    }
+}
+
+bool CookedAsset::Load(const std::string& path) {
+    header = nullptr;
+    if (!file.Open(path))
+        return false;
+
+    if (file.GetSize() < sizeof(Header) || !Validate()) {
+        file.Close();
+        return false;
+    }
+
+    header = static_cast<const Header*>(file.GetData());
+    return true;
+}
+
+const CookedAsset::Header& CookedAsset::GetHeader() const {
+    return *header;
+}
+
+const CookedAsset::Mesh* CookedAsset::GetMeshes() const {
+    return GetArray<Mesh>(header->meshesOffset);
+}
+
+const SkinVertex* CookedAsset::GetVertices() const {
+    return GetArray<SkinVertex>(header->verticesOffset);
+}
+
+const std::uint32_t* CookedAsset::GetIndices() const {
+    return GetArray<std::uint32_t>(header->indicesOffset);
+}
+
+const char* CookedAsset::GetClipName(std::size_t clip) const {
+    return GetName(GetArray<Clip>(header->clipsOffset)[clip].name);
+}
+
+void CookedAsset::LoadSkeleton(Skeleton& skeleton) const {
+    const std::size_t numNodes = header->numNodes;
+    const std::size_t numBones = header->numBones;
+    skeleton.globalInverseTransform = header->globalInverseTransform;
+    skeleton.rootNode = Skeleton::Node();
+
+    const glm::mat4* bones = GetArray<glm::mat4>(header->bonesOffset);
+    skeleton.bones.assign(bones, bones + numBones);
+    skeleton.finalTransforms.assign(numBones, glm::mat4());
+    skeleton.finalTransformsIT.assign(numBones, glm::mat3());
+    const std::uint32_t* boneNames = GetArray<std::uint32_t>(header->boneNamesOffset);
+    skeleton.boneIndexMap.clear();
+    for (std::size_t b = 0; b < numBones; ++b)
+        skeleton.boneIndexMap[GetName(boneNames[b])] = b;
+
+    const std::uint32_t* nodeNames = GetArray<std::uint32_t>(header->nodeNamesOffset);
+    const std::int32_t* nodeParents = GetArray<std::int32_t>(header->nodeParentsOffset);
+    const glm::mat4* nodeTransforms = GetArray<glm::mat4>(header->nodeTransformsOffset);
+    const std::int32_t* nodeBones = GetArray<std::int32_t>(header->nodeBonesOffset);
+    skeleton.nodeNames.resize(numNodes);
+    skeleton.nodeBones.resize(numNodes);
+    for (std::size_t i = 0; i < numNodes; ++i) {
+        skeleton.nodeNames[i] = GetName(nodeNames[i]);
+        skeleton.nodeBones[i] = nodeBones[i] >= 0 ? static_cast<std::size_t>(nodeBones[i]) : static_cast<std::size_t>(-1);
+    }
+    skeleton.nodeParents.assign(nodeParents, nodeParents + numNodes);
+    skeleton.nodeTransforms.assign(nodeTransforms, nodeTransforms + numNodes);
+    skeleton.ResolveBones();
+}
+
+void CookedAsset::LoadClip(std::size_t clip, CompressedAnimation& animation) const {
+    const Clip& cookedClip = GetArray<Clip>(header->clipsOffset)[clip];
+    animation.name = GetName(cookedClip.name);
+    animation.duration = cookedClip.duration;
+    animation.ticksPerSecond = cookedClip.ticksPerSecond;
+    animation.timeScale = cookedClip.timeScale;
+    animation.blockTicks = cookedClip.blockTicks;
+
+    const std::uint32_t* channelNames = GetArray<std::uint32_t>(cookedClip.channelNamesOffset);
+    animation.channelIndexMap.clear();
+    for (std::size_t c = 0; c < cookedClip.numChannels; ++c)
+        animation.channelIndexMap[GetName(channelNames[c])] = c;
+
+    const CompressedAnimation::Range* ranges = GetArray<CompressedAnimation::Range>(cookedClip.rangesOffset);
+    const CompressedAnimation::Key* constantKeys = GetArray<CompressedAnimation::Key>(cookedClip.constantKeysOffset);
+    const CompressedAnimation::Key* keys = GetArray<CompressedAnimation::Key>(cookedClip.keysOffset);
+    const std::uint32_t* blockOffsets = GetArray<std::uint32_t>(cookedClip.blockOffsetsOffset);
+    animation.ranges.assign(ranges, ranges + cookedClip.numChannels * 3);
+    animation.constantKeys.assign(constantKeys, constantKeys + cookedClip.numConstantKeys);
+    animation.keys.assign(keys, keys + cookedClip.numKeys);
+    animation.blockOffsets.assign(blockOffsets, blockOffsets + cookedClip.numBlocks + 1);
+
+    animation.statistics.numSourceKeys = static_cast<std::size_t>(cookedClip.numSourceKeys);
+    animation.statistics.numKeys = static_cast<std::size_t>(cookedClip.numReducedKeys);
+    animation.statistics.numStoredKeys = cookedClip.numKeys + cookedClip.numConstantKeys;
+    animation.statistics.numConstantTracks = static_cast<std::size_t>(cookedClip.numConstantTracks);
+}
+
+template <typename T>
+const T* CookedAsset::GetArray(std::uint64_t offset) const {
+    return reinterpret_cast<const T*>(static_cast<const char*>(file.GetData()) + offset);
+}
+
+const char* CookedAsset::GetName(std::uint32_t offset) const {
+    return GetArray<char>(header->namesOffset) + offset;
+}
+
+bool CookedAsset::Validate() const {
+    // Check layout before any array is touched.
+    const Header& fileHeader = *static_cast<const Header*>(file.GetData());
+    if (fileHeader.magic != COOKEDASSET_MAGIC ||
+        fileHeader.version != COOKEDASSET_VERSION ||
+        fileHeader.headerSize != sizeof(Header) ||
+        fileHeader.clipSize != sizeof(Clip) ||
+        fileHeader.vertexSize != sizeof(SkinVertex) ||
+        fileHeader.keySize != sizeof(CompressedAnimation::Key) ||
+        fileHeader.fileSize > file.GetSize())
+        return false;
+
+    // Arrays are aligned and inside the file.
+    auto inside = [&fileHeader](std::uint64_t offset, std::uint64_t count, std::uint64_t size) {
+        return offset % COOKEDASSET_ALIGNMENT == 0 && offset >= sizeof(Header) && offset <= fileHeader.fileSize && count * size <= fileHeader.fileSize - offset;
+    };
+    bool valid = inside(fileHeader.meshesOffset, fileHeader.numMeshes, sizeof(Mesh)) &&
+        inside(fileHeader.verticesOffset, fileHeader.numVertices, sizeof(SkinVertex)) &&
+        inside(fileHeader.indicesOffset, fileHeader.numIndices, sizeof(std::uint32_t)) &&
+        inside(fileHeader.nodeNamesOffset, fileHeader.numNodes, sizeof(std::uint32_t)) &&
+        inside(fileHeader.nodeParentsOffset, fileHeader.numNodes, sizeof(std::int32_t)) &&
+        inside(fileHeader.nodeTransformsOffset, fileHeader.numNodes, sizeof(glm::mat4)) &&
+        inside(fileHeader.nodeBonesOffset, fileHeader.numNodes, sizeof(std::int32_t)) &&
+        inside(fileHeader.boneNamesOffset, fileHeader.numBones, sizeof(std::uint32_t)) &&
+        inside(fileHeader.bonesOffset, fileHeader.numBones, sizeof(glm::mat4)) &&
+        inside(fileHeader.clipsOffset, fileHeader.numClips, sizeof(Clip)) &&
+        inside(fileHeader.namesOffset, fileHeader.namesSize, 1);
+    if (!valid)
+        return false;
+
+    // Names end inside the table and nodes follow their parents, as Skeleton evaluates them in order.
+    const char* data = static_cast<const char*>(file.GetData());
+    const char* names = data + fileHeader.namesOffset;
+    if (fileHeader.namesSize > 0 && names[fileHeader.namesSize - 1] != '\0')
+        return false;
+    auto isName = [&fileHeader](std::uint32_t offset) {
+        return offset < fileHeader.namesSize;
+    };
+    const std::uint32_t* nodeNames = reinterpret_cast<const std::uint32_t*>(data + fileHeader.nodeNamesOffset);
+    const std::int32_t* nodeParents = reinterpret_cast<const std::int32_t*>(data + fileHeader.nodeParentsOffset);
+    const std::int32_t* nodeBones = reinterpret_cast<const std::int32_t*>(data + fileHeader.nodeBonesOffset);
+    for (std::uint32_t i = 0; i < fileHeader.numNodes; ++i) {
+        if (!isName(nodeNames[i]) || nodeParents[i] >= static_cast<std::int32_t>(i) || (i > 0 && nodeParents[i] < 0) ||
+            nodeBones[i] >= static_cast<std::int32_t>(fileHeader.numBones))
+            return false;
+    }
+    const std::uint32_t* boneNames = reinterpret_cast<const std::uint32_t*>(data + fileHeader.boneNamesOffset);
+    for (std::uint32_t b = 0; b < fileHeader.numBones; ++b) {
+        if (!isName(boneNames[b]))
+            return false;
+    }
+
+    // Meshes lie inside the streams and their indices inside the mesh, as they are used in place.
+    const Mesh* meshes = reinterpret_cast<const Mesh*>(data + fileHeader.meshesOffset);
+    const std::uint32_t* indices = reinterpret_cast<const std::uint32_t*>(data + fileHeader.indicesOffset);
+    for (std::uint32_t m = 0; m < fileHeader.numMeshes; ++m) {
+        const Mesh& mesh = meshes[m];
+        if (static_cast<std::uint64_t>(mesh.firstVertex) + mesh.numVertices > fileHeader.numVertices ||
+            static_cast<std::uint64_t>(mesh.firstIndex) + mesh.numIndices > fileHeader.numIndices)
+            return false;
+        for (std::uint32_t i = mesh.firstIndex; i < mesh.firstIndex + mesh.numIndices; ++i) {
+            if (indices[i] >= mesh.numVertices)
+                return false;
+        }
+    }
+
+    // Skinning indexes the bone palette with every bone ID. Files without bones hold unskinned meshes with zero IDs.
+    const SkinVertex* vertices = reinterpret_cast<const SkinVertex*>(data + fileHeader.verticesOffset);
+    const int numBoneIDs = static_cast<int>(std::max(fileHeader.numBones, 1U));
+    for (std::uint32_t v = 0; v < fileHeader.numVertices; ++v) {
+        for (int k = 0; k < 4; ++k) {
+            if (vertices[v].boneIDs[k] < 0 || vertices[v].boneIDs[k] >= numBoneIDs)
+                return false;
+        }
+    }
+
+    const Clip* clips = reinterpret_cast<const Clip*>(data + fileHeader.clipsOffset);
+    for (std::uint32_t c = 0; c < fileHeader.numClips; ++c) {
+        const Clip& clip = clips[c];
+        valid = isName(clip.name) &&
+            inside(clip.channelNamesOffset, clip.numChannels, sizeof(std::uint32_t)) &&
+            inside(clip.rangesOffset, clip.numChannels * 3ULL, sizeof(CompressedAnimation::Range)) &&
+            inside(clip.constantKeysOffset, clip.numConstantKeys, sizeof(CompressedAnimation::Key)) &&
+            inside(clip.keysOffset, clip.numKeys, sizeof(CompressedAnimation::Key)) &&
+            inside(clip.blockOffsetsOffset, clip.numBlocks + 1ULL, sizeof(std::uint32_t));
+        if (!valid)
+            return false;
+        const std::uint32_t* channelNames = reinterpret_cast<const std::uint32_t*>(data + clip.channelNamesOffset);
+        for (std::uint32_t i = 0; i < clip.numChannels; ++i) {
+            if (!isName(channelNames[i]))
+                return false;
+        }
+        const std::uint32_t* blockOffsets = reinterpret_cast<const std::uint32_t*>(data + clip.blockOffsetsOffset);
+        for (std::uint32_t b = 0; b < clip.numBlocks; ++b) {
+            if (blockOffsets[b] > blockOffsets[b + 1] || blockOffsets[b + 1] > clip.numKeys)
+                return false;
+        }
+
+        // The decoder indexes its tracks with the track of every key.
+        const std::uint64_t numTracks = clip.numChannels * 3ULL;
+        const CompressedAnimation::Key* constantKeys = reinterpret_cast<const CompressedAnimation::Key*>(data + clip.constantKeysOffset);
+        for (std::uint32_t k = 0; k < clip.numConstantKeys; ++k) {
+            if (constantKeys[k].track >= numTracks)
+                return false;
+        }
+        const CompressedAnimation::Key* keys = reinterpret_cast<const CompressedAnimation::Key*>(data + clip.keysOffset);
+        for (std::uint32_t k = 0; k < clip.numKeys; ++k) {
+            if (keys[k].track >= numTracks)
+                return false;
+        }
+    }
+    return true;
+}
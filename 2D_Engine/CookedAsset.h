@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "CompressedAnimation.h"
+#include "MappedFile.h"
+#include "SkinVertex.h"
+
+struct aiScene;
+
+// Cooked asset file identifier, "PCKA" in a little-endian file.
+#define COOKEDASSET_MAGIC 0x414B4350U
+
+// Cooked asset format version. Increment when the header, SkinVertex or compressed key layout changes.
+#define COOKEDASSET_VERSION 1U
+
+// Alignment of arrays in a cooked asset file, a cache line.
+#define COOKEDASSET_ALIGNMENT 64U
+
+namespace Geometry {
+
+    class Skeleton;
+
+    /// Meshes, skeleton and compressed animations of a scene, cooked offline into one memory mapped file.
+    /**
+    * Every array sits at an aligned offset and has the layout used at runtime, so loading maps the file and checks
+    * the header. Vertex and index streams are used in place, skeleton and animations are filled with one copy per
+    * array.
+    */
+    class CookedAsset {
+    public:
+        /// Range of a mesh in the vertex and index streams.
+        struct Mesh {
+            /// First vertex, indices are relative to it.
+            std::uint32_t firstVertex;
+            /// Number of vertices.
+            std::uint32_t numVertices;
+            /// First index.
+            std::uint32_t firstIndex;
+            /// Number of indices, three per triangle.
+            std::uint32_t numIndices;
+        };
+
+        /// Compressed animation stored in the file.
+        struct Clip {
+            /// Offset of the name in the name table.
+            std::uint32_t name;
+            /// Number of channels, keys, constant keys and blocks.
+            std::uint32_t numChannels;
+            std::uint32_t numKeys;
+            std::uint32_t numConstantKeys;
+            std::uint32_t numBlocks;
+            /// Time quantization and block duration of the compressed animation.
+            float timeScale;
+            float blockTicks;
+            std::uint32_t reserved;
+            /// Duration in ticks and ticks per second.
+            double duration;
+            double ticksPerSecond;
+            /// Compression statistics.
+            std::uint64_t numSourceKeys;
+            std::uint64_t numReducedKeys;
+            std::uint64_t numConstantTracks;
+            /// Byte offsets of the channel name offsets, track ranges, constant keys, keys and block offsets.
+            std::uint64_t channelNamesOffset;
+            std::uint64_t rangesOffset;
+            std::uint64_t constantKeysOffset;
+            std::uint64_t keysOffset;
+            std::uint64_t blockOffsetsOffset;
+        };
+
+        /// Header at the start of a cooked asset file, the arrays follow at aligned offsets.
+        struct Header {
+            /// COOKEDASSET_MAGIC.
+            std::uint32_t magic;
+            /// COOKEDASSET_VERSION.
+            std::uint32_t version;
+            /// sizeof(Header), sizeof(Clip), sizeof(SkinVertex) and sizeof of a compressed key of the writer.
+            std::uint32_t headerSize;
+            std::uint32_t clipSize;
+            std::uint32_t vertexSize;
+            std::uint32_t keySize;
+            /// Number of meshes, vertices and indices.
+            std::uint32_t numMeshes;
+            std::uint32_t numVertices;
+            std::uint32_t numIndices;
+            /// Number of skeleton nodes and bones.
+            std::uint32_t numNodes;
+            std::uint32_t numBones;
+            /// Number of clips.
+            std::uint32_t numClips;
+            /// Size of the name table in bytes, names are null terminated.
+            std::uint32_t namesSize;
+            std::uint32_t reserved;
+            /// Inverse root transformation of the skeleton.
+            glm::mat4 globalInverseTransform;
+            /// Byte offsets of the arrays.
+            std::uint64_t meshesOffset;
+            std::uint64_t verticesOffset;
+            std::uint64_t indicesOffset;
+            std::uint64_t nodeNamesOffset;
+            std::uint64_t nodeParentsOffset;
+            std::uint64_t nodeTransformsOffset;
+            std::uint64_t nodeBonesOffset;
+            std::uint64_t boneNamesOffset;
+            std::uint64_t bonesOffset;
+            std::uint64_t clipsOffset;
+            std::uint64_t namesOffset;
+            /// Size of the file in bytes.
+            std::uint64_t fileSize;
+        };
+
+        /// Create new cooked asset.
+        /**
+        * The created asset has to be loaded later using Load.
+        */
+        CookedAsset();
+
+        /// Destructor. Unmaps file, arrays become invalid.
+        ~CookedAsset();
+
+        /// Cook scene into a file.
+        /**
+        * Import the scene with triangulation and tangents for complete vertices, missing attributes are zero.
+        * @param aScene Pointer to assimp scene.
+        * @param settings Compression tolerances of the animations.
+        * @param path File path, written through a temporary file.
+        * @return Whether file could be written.
+        */
+        static bool Cook(const aiScene* aScene, const CompressedAnimation::Settings& settings, const std::string& path);
+
+        /// Convert meshes of a scene to skin vertices.
+        /**
+        * Keeps the four largest bone weights of every vertex and normalizes them. Faces other than triangles are
+        * skipped.
+        * @param aScene Pointer to assimp scene.
+        * @param skeleton Skeleton of the scene, bone IDs index its bones.
+        * @param meshes Ranges of the meshes.
+        * @param vertices Vertices of all meshes.
+        * @param indices Indices of all meshes.
+        */
+        static void ConvertMeshes(const aiScene* aScene, Skeleton& skeleton, std::vector<Mesh>& meshes, std::vector<SkinVertex>& vertices, std::vector<std::uint32_t>& indices);
+
+        /// Map and validate cooked asset file.
+        /**
+        * Checks layout, array bounds, names, node order, mesh ranges, indices, bone IDs, key tracks and block offsets.
+        * Key values and vertex attributes other than bone IDs are trusted.
+        * @param path File path.
+        * @return Whether file is a valid cooked asset of this version and layout.
+        */
+        bool Load(const std::string& path);
+
+        /// Get header.
+        /**
+        * @return Header, valid after a successful Load.
+        */
+        const Header& GetHeader() const;
+
+        /// Get meshes.
+        /**
+        * @return Array of GetHeader().numMeshes meshes.
+        */
+        const Mesh* GetMeshes() const;
+
+        /// Get vertex stream.
+        /**
+        * @return Array of GetHeader().numVertices vertices in the mapping.
+        */
+        const SkinVertex* GetVertices() const;
+
+        /// Get index stream.
+        /**
+        * @return Array of GetHeader().numIndices indices in the mapping.
+        */
+        const std::uint32_t* GetIndices() const;
+
+        /// Get clip name.
+        /**
+        * @param clip Clip index.
+        * @return Null terminated name in the mapping.
+        */
+        const char* GetClipName(std::size_t clip) const;
+
+        /// Fill skeleton from the file.
+        /**
+        * The node tree is not stored, so AnimateHierarchy of the filled skeleton evaluates nothing.
+        * @param skeleton Skeleton to fill.
+        */
+        void LoadSkeleton(Skeleton& skeleton) const;
+
+        /// Fill compressed animation from the file.
+        /**
+        * @param clip Clip index.
+        * @param animation Compressed animation to fill.
+        */
+        void LoadClip(std::size_t clip, CompressedAnimation& animation) const;
+
+    private:
+        template <typename T>
+        const T* GetArray(std::uint64_t offset) const;
+        const char* GetName(std::uint32_t offset) const;
+        bool Validate() const;
+
+        MappedFile file;
+        const Header* header;
+    };
+}
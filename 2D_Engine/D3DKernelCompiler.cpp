@@ -0,0 +1,68 @@
+#include "D3DKernelCompiler.h"
+
+namespace
+{
+    // Print compiler message of a failed kernel.
+    bool CheckKernel(const Kernel& kernel)
+    {
+        if (!kernel.blob.empty())
+            return true;
+
+        std::string message = kernel.desc.path + ": " + kernel.error + "\n";
+        OutputDebugStringA(message.c_str());
+        return false;
+    }
+}
+
+bool D3DKernelCompiler::Compile(const KernelDesc& desc, const std::string& source, std::vector<unsigned char>& blob, std::string& error)
+{
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const std::pair<std::string, std::string>& define : desc.defines)
+        defines.push_back({ define.first.c_str(), define.second.c_str() });
+    defines.push_back({ NULL, NULL });
+
+    // Compiles from memory so the hashed source is the compiled source.
+    ID3DBlob* shaderBlob = nullptr;
+    ID3DBlob* errorBlob = nullptr;
+    HRESULT hr = D3DCompile(source.data(), source.size(), desc.path.c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, desc.entryPoint.c_str(), desc.target.c_str(), D3DCOMPILE_OPTIMIZATION_LEVEL1, 0, &shaderBlob, &errorBlob);
+    if (errorBlob != nullptr)
+    {
+        error.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+        errorBlob->Release();
+    }
+    if (FAILED(hr))
+    {
+        if (shaderBlob != nullptr)
+            shaderBlob->Release();
+        return false;
+    }
+
+    const unsigned char* data = static_cast<const unsigned char*>(shaderBlob->GetBufferPointer());
+    blob.assign(data, data + shaderBlob->GetBufferSize());
+    shaderBlob->Release();
+    return true;
+}
+
+bool D3DKernelCompiler::CreateComputeShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11ComputeShader** shader)
+{
+    *shader = nullptr;
+    return CheckKernel(kernel) && SUCCEEDED(pDevice->CreateComputeShader(kernel.blob.data(), kernel.blob.size(), nullptr, shader));
+}
+
+bool D3DKernelCompiler::CreateVertexShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11VertexShader** shader)
+{
+    *shader = nullptr;
+    return CheckKernel(kernel) && SUCCEEDED(pDevice->CreateVertexShader(kernel.blob.data(), kernel.blob.size(), nullptr, shader));
+}
+
+bool D3DKernelCompiler::CreateGeometryShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11GeometryShader** shader)
+{
+    *shader = nullptr;
+    return CheckKernel(kernel) && SUCCEEDED(pDevice->CreateGeometryShader(kernel.blob.data(), kernel.blob.size(), nullptr, shader));
+}
+
+bool D3DKernelCompiler::CreatePixelShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11PixelShader** shader)
+{
+    *shader = nullptr;
+    return CheckKernel(kernel) && SUCCEEDED(pDevice->CreatePixelShader(kernel.blob.data(), kernel.blob.size(), nullptr, shader));
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+#include "KernelCache.h"
+
+// Compiler name and flags, part of the kernel cache key. Change together with the flags.
+#define D3DKERNELCOMPILER_NAME "d3dcompiler_47 O1"
+
+// Cache directory of compiled kernels, relative to the working directory.
+#define D3DKERNELCOMPILER_CACHE_DIRECTORY "KernelCache"
+
+// HLSL backend of the kernel cache.
+namespace D3DKernelCompiler
+{
+    // Compile HLSL source. Matches KernelCompileFunction.
+    // desc Kernel description.
+    // source Source file contents.
+    // blob Compiled blob.
+    // error Compiler message on failure.
+    // Returns whether compilation succeeded.
+    bool Compile(const KernelDesc& desc, const std::string& source, std::vector<unsigned char>& blob, std::string& error);
+
+    // Create compute shader from a built kernel. Prints the compiler message of failed kernels.
+    // pDevice Pointer to D3D11 device.
+    // kernel Built kernel.
+    // shader Created shader, nullptr on failure.
+    // Returns whether shader was created.
+    bool CreateComputeShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11ComputeShader** shader);
+
+    // Create vertex shader from a built kernel. Prints the compiler message of failed kernels.
+    // pDevice Pointer to D3D11 device.
+    // kernel Built kernel.
+    // shader Created shader, nullptr on failure.
+    // Returns whether shader was created.
+    bool CreateVertexShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11VertexShader** shader);
+
+    // Create geometry shader from a built kernel. Prints the compiler message of failed kernels.
+    // pDevice Pointer to D3D11 device.
+    // kernel Built kernel.
+    // shader Created shader, nullptr on failure.
+    // Returns whether shader was created.
+    bool CreateGeometryShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11GeometryShader** shader);
+
+    // Create pixel shader from a built kernel. Prints the compiler message of failed kernels.
+    // pDevice Pointer to D3D11 device.
+    // kernel Built kernel.
+    // shader Created shader, nullptr on failure.
+    // Returns whether shader was created.
+    bool CreatePixelShader(ID3D11Device* pDevice, const Kernel& kernel, ID3D11PixelShader** shader);
+}
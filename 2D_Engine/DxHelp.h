@@ -16,6 +16,13 @@ namespace DxHelp
     template <typename T>
     void CreateVertexBuffer(ID3D11Device* device, unsigned int numOfElements, ID3D11Buffer** vBuffer);
 
+    // Creates dynamic index buffer (CPU write, GPU read).
+    // device D3D11 device.
+    // numOfElements Maximum number of indices (size of buffer equals sizeOf(T) * numOfElements).
+    // iBuffer Index buffer.
+    template <typename T>
+    void CreateDynamicIndexBuffer(ID3D11Device* device, unsigned int numOfElements, ID3D11Buffer** iBuffer);
+
     // Creates constant buffer.
     // device D3D11 device.
     // data Pointer to data.
@@ -75,6 +82,20 @@ inline void DxHelp::CreateVertexBuffer(ID3D11Device* device, unsigned int numOfE
     DxAssert(device->CreateBuffer(&buffDesc, NULL, vBuffer), S_OK);
 }
 
+template <typename T>
+inline void DxHelp::CreateDynamicIndexBuffer(ID3D11Device* device, unsigned int numOfElements, ID3D11Buffer** iBuffer)
+{
+    D3D11_BUFFER_DESC buffDesc;
+    ZeroMemory(&buffDesc, sizeof(D3D11_BUFFER_DESC));
+    buffDesc.ByteWidth = sizeof(T) * numOfElements;
+    buffDesc.Usage = D3D11_USAGE_DYNAMIC;
+    buffDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    buffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    buffDesc.MiscFlags = 0;
+    buffDesc.StructureByteStride = 0;
+    DxAssert(device->CreateBuffer(&buffDesc, NULL, iBuffer), S_OK);
+}
+
 template <typename T>
 inline void DxHelp::CreateConstantBuffer(ID3D11Device* device, T* data, ID3D11Buffer** cBuffer)
 {
@@ -1,57 +1,269 @@
 #pragma once
 
+#include <algorithm>
+#include <assert.h>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "JobSystem.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Storage alignment in bytes. A cache line, and wide enough for any SIMD load.
+#define DYNAMICARRAY_ALIGNMENT 64U
+
+// Capacity allocated by the first growth of an empty array.
+#define DYNAMICARRAY_MIN_CAPACITY 16U
+
+// Min number of elements sorted in parallel, smaller arrays are sorted on the calling thread.
+#define DYNAMICARRAY_PARALLEL_SORT_SIZE 65536U
+
+// Growable array with aligned storage. Capacity at least doubles when full, elements are moved on growth.
 template <typename T>
-class DynamicArray 
-{
-public:
-    DynamicArray(const unsigned int capacity);
-    ~DynamicArray();
-    T& Push(const T& data);
-    T Pop();
-    T& At(const unsigned int index);
-    void SetAt(const T& data, const unsigned int index);
-    const unsigned int Size();
-    const unsigned int Capacity();
-    T* GetArrPointer();
-    void SetArrPointer(T* pArr, unsigned int nrOfElements);
-    void Clear();
-    void Delete();
-    void Sort();
-private:
-    T* mArr;
-    unsigned int mCapacity;
-    unsigned int mNrOfElements;
-    void QuickSort(T* arr, int left, int right);
+class DynamicArray
+{
+    public:
+        // Constructor.
+        // capacity Initial capacity.
+        DynamicArray(unsigned int capacity = 0);
+
+        // Copy constructor.
+        DynamicArray(const DynamicArray& other);
+
+        // Move constructor. Takes the storage of other, which is left empty.
+        DynamicArray(DynamicArray&& other);
+
+        // Destructor. Destroys elements and frees storage.
+        ~DynamicArray();
+
+        // Copy assignment.
+        DynamicArray& operator=(const DynamicArray& other);
+
+        // Move assignment. Takes the storage of other, which is left empty.
+        DynamicArray& operator=(DynamicArray&& other);
+
+        // Append element.
+        // data Element to copy, may be an element of this array.
+        // Returns appended element.
+        T& Push(const T& data);
+
+        // Append element.
+        // data Element to move.
+        // Returns appended element.
+        T& Push(T&& data);
+
+        // Construct element in place at the end.
+        // args Constructor arguments.
+        // Returns appended element.
+        template <typename... Args>
+        T& Emplace(Args&&... args);
+
+        // Append elements without initialising them, to be filled in bulk. Only for trivially copyable types.
+        // count Number of elements.
+        // Returns first appended element.
+        T* AppendUninitialized(unsigned int count);
+
+        // Remove last element.
+        // Returns removed element, default constructed if the array is empty.
+        T Pop();
+
+        // Get element.
+        // index Element index.
+        T& At(const unsigned int index);
+
+        // Get element.
+        // index Element index.
+        const T& At(const unsigned int index) const;
+
+        // Set element.
+        // data Element to copy.
+        // index Element index.
+        void SetAt(const T& data, const unsigned int index);
+
+        // Get number of elements.
+        unsigned int Size() const;
+
+        // Get number of elements that fit before storage grows.
+        unsigned int Capacity() const;
+
+        // Get storage, aligned to DYNAMICARRAY_ALIGNMENT.
+        T* GetArrPointer();
+
+        // Get storage, aligned to DYNAMICARRAY_ALIGNMENT.
+        const T* GetArrPointer() const;
+
+        // Grow storage to hold at least capacity elements.
+        // capacity Min capacity.
+        void Reserve(unsigned int capacity);
+
+        // Set number of elements. New elements are value initialised.
+        // size Number of elements.
+        void Resize(unsigned int size);
+
+        // Destroy elements. Capacity is kept.
+        void Clear();
+
+        // Destroy elements and free storage.
+        void Delete();
+
+        // Sort elements ascending with std::sort on the aligned storage.
+        void Sort();
+
+        // Sort elements with std::sort.
+        // less Strict weak ordering.
+        template <typename Compare>
+        void Sort(Compare less);
+
+        // Sort elements ascending. Chunks are sorted on the job system threads and merged in parallel rounds.
+        // jobSystem Job system.
+        void ParallelSort(JobSystem& jobSystem);
+
+        // Sort elements on the job system threads.
+        // jobSystem Job system.
+        // less Strict weak ordering.
+        template <typename Compare>
+        void ParallelSort(JobSystem& jobSystem, Compare less);
+
+    private:
+        // Grow capacity geometrically to hold at least minCapacity elements.
+        void Grow(unsigned int minCapacity);
+
+        // Allocate aligned storage for capacity elements.
+        static T* Allocate(unsigned int capacity);
+
+        // Free storage returned by Allocate.
+        static void Free(T* arr);
+
+        T* mArr;
+        unsigned int mCapacity;
+        unsigned int mNrOfElements;
 };
 
 template <typename T>
-inline DynamicArray<T>::DynamicArray(const unsigned int capacity)
+inline DynamicArray<T>::DynamicArray(unsigned int capacity)
 {
-    mArr = new T[capacity];
+    mArr = capacity > 0 ? Allocate(capacity) : nullptr;
     mCapacity = capacity;
     mNrOfElements = 0;
 }
 
+template <typename T>
+inline DynamicArray<T>::DynamicArray(const DynamicArray& other) : DynamicArray(other.mNrOfElements)
+{
+    std::uninitialized_copy(other.mArr, other.mArr + other.mNrOfElements, mArr);
+    mNrOfElements = other.mNrOfElements;
+}
+
+template <typename T>
+inline DynamicArray<T>::DynamicArray(DynamicArray&& other)
+{
+    mArr = other.mArr;
+    mCapacity = other.mCapacity;
+    mNrOfElements = other.mNrOfElements;
+    other.mArr = nullptr;
+    other.mCapacity = 0;
+    other.mNrOfElements = 0;
+}
+
 template <typename T>
 inline DynamicArray<T>::~DynamicArray()
 {
+    Delete();
+}
+
+template <typename T>
+inline DynamicArray<T>& DynamicArray<T>::operator=(const DynamicArray& other)
+{
+    if (this != &other)
+    {
+        Clear();
+        Reserve(other.mNrOfElements);
+        std::uninitialized_copy(other.mArr, other.mArr + other.mNrOfElements, mArr);
+        mNrOfElements = other.mNrOfElements;
+    }
+    return *this;
+}
 
+template <typename T>
+inline DynamicArray<T>& DynamicArray<T>::operator=(DynamicArray&& other)
+{
+    if (this != &other)
+    {
+        Delete();
+        std::swap(mArr, other.mArr);
+        std::swap(mCapacity, other.mCapacity);
+        std::swap(mNrOfElements, other.mNrOfElements);
+    }
+    return *this;
 }
 
 template <typename T>
 inline T& DynamicArray<T>::Push(const T& data)
 {
-    assert(mNrOfElements < mCapacity);
-    mArr[mNrOfElements] = data;
-    return mArr[mNrOfElements++];
+    if (mNrOfElements == mCapacity)
+    {
+        // Copy before growing, data may live in the old storage.
+        T copy(data);
+        Grow(mNrOfElements + 1);
+        return *new (mArr + mNrOfElements++) T(std::move(copy));
+    }
+    return *new (mArr + mNrOfElements++) T(data);
+}
+
+template <typename T>
+inline T& DynamicArray<T>::Push(T&& data)
+{
+    if (mNrOfElements == mCapacity)
+    {
+        T moved(std::move(data));
+        Grow(mNrOfElements + 1);
+        return *new (mArr + mNrOfElements++) T(std::move(moved));
+    }
+    return *new (mArr + mNrOfElements++) T(std::move(data));
+}
+
+template <typename T>
+template <typename... Args>
+inline T& DynamicArray<T>::Emplace(Args&&... args)
+{
+    if (mNrOfElements == mCapacity)
+    {
+        // Construct before growing, arguments may refer to the old storage.
+        T data(std::forward<Args>(args)...);
+        Grow(mNrOfElements + 1);
+        return *new (mArr + mNrOfElements++) T(std::move(data));
+    }
+    return *new (mArr + mNrOfElements++) T(std::forward<Args>(args)...);
+}
+
+template <typename T>
+inline T* DynamicArray<T>::AppendUninitialized(unsigned int count)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Uninitialised elements are only valid for trivially copyable types.");
+    if (mNrOfElements + count > mCapacity)
+        Grow(mNrOfElements + count);
+    T* first = mArr + mNrOfElements;
+    mNrOfElements += count;
+    return first;
 }
 
 template <typename T>
 inline T DynamicArray<T>::Pop()
 {
-    if (mNrOfElements > 0)
-        return mArr[--mNrOfElements];
-    return T();
+    if (mNrOfElements == 0)
+        return T();
+
+    T* last = mArr + --mNrOfElements;
+    T data(std::move(*last));
+    last->~T();
+    return data;
 }
 
 template <typename T>
@@ -61,6 +273,13 @@ inline T& DynamicArray<T>::At(const unsigned int index)
     return mArr[index];
 }
 
+template <typename T>
+inline const T& DynamicArray<T>::At(const unsigned int index) const
+{
+    assert(index < mNrOfElements);
+    return mArr[index];
+}
+
 template <typename T>
 inline void DynamicArray<T>::SetAt(const T& data, const unsigned int index)
 {
@@ -69,13 +288,13 @@ inline void DynamicArray<T>::SetAt(const T& data, const unsigned int index)
 }
 
 template <typename T>
-inline const unsigned int DynamicArray<T>::Size()
+inline unsigned int DynamicArray<T>::Size() const
 {
     return mNrOfElements;
 }
 
 template <typename T>
-inline const unsigned int DynamicArray<T>::Capacity()
+inline unsigned int DynamicArray<T>::Capacity() const
 {
     return mCapacity;
 }
@@ -87,60 +306,161 @@ inline T* DynamicArray<T>::GetArrPointer()
 }
 
 template <typename T>
-inline void DynamicArray<T>::SetArrPointer(T* pArr, unsigned int nrOfElements)
+inline const T* DynamicArray<T>::GetArrPointer() const
 {
-    Clear();
-    mArr = pArr;
-    mNrOfElements = nrOfElements;
+    return mArr;
+}
+
+template <typename T>
+inline void DynamicArray<T>::Reserve(unsigned int capacity)
+{
+    if (capacity <= mCapacity)
+        return;
+
+    T* arr = Allocate(capacity);
+    for (unsigned int i = 0; i < mNrOfElements; ++i)
+    {
+        new (arr + i) T(std::move(mArr[i]));
+        mArr[i].~T();
+    }
+    Free(mArr);
+    mArr = arr;
+    mCapacity = capacity;
+}
+
+template <typename T>
+inline void DynamicArray<T>::Resize(unsigned int size)
+{
+    if (size > mCapacity)
+        Grow(size);
+    for (unsigned int i = size; i < mNrOfElements; ++i)
+        mArr[i].~T();
+    for (unsigned int i = mNrOfElements; i < size; ++i)
+        new (mArr + i) T();
+    mNrOfElements = size;
 }
 
 template <typename T>
 inline void DynamicArray<T>::Clear()
 {
+    for (unsigned int i = 0; i < mNrOfElements; ++i)
+        mArr[i].~T();
     mNrOfElements = 0;
 }
 
 template <typename T>
 inline void DynamicArray<T>::Delete()
 {
-    mNrOfElements = 0;
-    delete[] mArr;
+    Clear();
+    Free(mArr);
     mArr = nullptr;
+    mCapacity = 0;
 }
 
 template <typename T>
 inline void DynamicArray<T>::Sort()
 {
-    assert(mNrOfElements != 0);
-    QuickSort(mArr, 0, mNrOfElements);
-}
-
-template <typename T>
-inline void DynamicArray<T>::QuickSort(T* arr, int left, int right)
-{
-    /* http://www.algolist.net/Algorithms/Sorting/Quicksort */
-    int i = left, j = right;
-    T tmp;
-    T pivot = arr[(left + right) / 2];
-
-    /* partition */
-    while (i <= j) {
-        while (arr[i] < pivot)
-            i++;
-        while (arr[j] > pivot)
-            j--;
-        if (i <= j) {
-            tmp = arr[i];
-            arr[i] = arr[j];
-            arr[j] = tmp;
-            i++;
-            j--;
-        }
-    };
-
-    /* recursion */
-    if (left < j)
-        QuickSort(arr, left, j);
-    if (i < right)
-        QuickSort(arr, i, right);
+    Sort(std::less<T>());
+}
+
+template <typename T>
+template <typename Compare>
+inline void DynamicArray<T>::Sort(Compare less)
+{
+    std::sort(mArr, mArr + mNrOfElements, less);
+}
+
+template <typename T>
+inline void DynamicArray<T>::ParallelSort(JobSystem& jobSystem)
+{
+    ParallelSort(jobSystem, std::less<T>());
+}
+
+template <typename T>
+template <typename Compare>
+inline void DynamicArray<T>::ParallelSort(JobSystem& jobSystem, Compare less)
+{
+    unsigned int numThreads = jobSystem.GetNumThreads();
+    if (mNrOfElements < DYNAMICARRAY_PARALLEL_SORT_SIZE || numThreads == 1)
+    {
+        Sort(less);
+        return;
+    }
+
+    // Power of two chunks, so every merge round pairs all runs.
+    unsigned int numChunks = 2;
+    while (numChunks < numThreads)
+        numChunks *= 2;
+    unsigned long long size = mNrOfElements;
+    auto chunkBegin = [size, numChunks](unsigned int chunk) { return static_cast<unsigned int>(size * chunk / numChunks); };
+
+    T* arr = mArr;
+    jobSystem.ParallelFor(0, numChunks, 1, [arr, &less, &chunkBegin](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int chunk = begin; chunk < end; ++chunk)
+            std::sort(arr + chunkBegin(chunk), arr + chunkBegin(chunk + 1), less);
+    });
+
+    // Merge runs pairwise, alternating between the array and the scratch buffer.
+    DynamicArray<T> scratch;
+    scratch.Resize(mNrOfElements);
+    T* source = mArr;
+    T* target = scratch.mArr;
+    for (unsigned int run = 1; run < numChunks; run *= 2)
+    {
+        jobSystem.ParallelFor(0, numChunks / (2 * run), 1, [source, target, run, &less, &chunkBegin](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int pair = begin; pair < end; ++pair)
+            {
+                unsigned int first = chunkBegin(2 * pair * run);
+                unsigned int middle = chunkBegin((2 * pair + 1) * run);
+                unsigned int last = chunkBegin((2 * pair + 2) * run);
+                std::merge(std::make_move_iterator(source + first), std::make_move_iterator(source + middle),
+                    std::make_move_iterator(source + middle), std::make_move_iterator(source + last), target + first, less);
+            }
+        });
+        std::swap(source, target);
+    }
+
+    // Keep whichever buffer holds the result, the other is destroyed with scratch.
+    if (source != mArr)
+    {
+        std::swap(mArr, scratch.mArr);
+        std::swap(mCapacity, scratch.mCapacity);
+    }
+}
+
+template <typename T>
+inline void DynamicArray<T>::Grow(unsigned int minCapacity)
+{
+    unsigned long long capacity = std::max(static_cast<unsigned long long>(mCapacity) * 2, static_cast<unsigned long long>(DYNAMICARRAY_MIN_CAPACITY));
+    capacity = std::min(capacity, 0xFFFFFFFFULL);
+    Reserve(std::max(static_cast<unsigned int>(capacity), minCapacity));
+}
+
+template <typename T>
+inline T* DynamicArray<T>::Allocate(unsigned int capacity)
+{
+    size_t alignment = std::max(static_cast<size_t>(DYNAMICARRAY_ALIGNMENT), alignof(T));
+    size_t bytes = static_cast<size_t>(capacity) * sizeof(T);
+#ifdef _WIN32
+    void* arr = _aligned_malloc(bytes, alignment);
+#else
+    void* arr = nullptr;
+    if (posix_memalign(&arr, alignment, bytes) != 0)
+        arr = nullptr;
+#endif
+    if (arr == nullptr)
+        throw std::bad_alloc();
+    return static_cast<T*>(arr);
+}
+
+template <typename T>
+inline void DynamicArray<T>::Free(T* arr)
+{
+#ifdef _WIN32
+    _aligned_free(arr);
+#else
+    free(arr);
+#endif
 }
@@ -0,0 +1,144 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+    // Allocate memory aligned to FRAMEARENA_ALIGNMENT.
+    void* AlignedAllocate(size_t size)
+    {
+#ifdef _WIN32
+        void* memory = _aligned_malloc(size, FRAMEARENA_ALIGNMENT);
+#else
+        void* memory = nullptr;
+        if (posix_memalign(&memory, FRAMEARENA_ALIGNMENT, size) != 0)
+            memory = nullptr;
+#endif
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return memory;
+    }
+
+    // Free memory returned by AlignedAllocate.
+    void AlignedFree(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+}
+
+FrameArena::FrameArena(unsigned int blockSize, unsigned int numFrames)
+{
+    mNumFrames = std::max(numFrames, 1U);
+    mFrames = new Frame[mNumFrames];
+    for (unsigned int i = 0; i < mNumFrames; ++i)
+    {
+        Frame& frame = mFrames[i];
+        frame.blockSize = std::max(blockSize, FRAMEARENA_ALIGNMENT);
+        frame.block = static_cast<unsigned char*>(AlignedAllocate(frame.blockSize));
+        frame.offset = 0;
+        frame.numAllocations = 0;
+        frame.overflowBytes = 0;
+    }
+    mFrameIndex = 0;
+    mLastFrame = Statistics();
+}
+
+FrameArena::~FrameArena()
+{
+    for (unsigned int i = 0; i < mNumFrames; ++i)
+    {
+        Reset(mFrames[i]);
+        AlignedFree(mFrames[i].block);
+    }
+    delete[] mFrames;
+}
+
+void FrameArena::BeginFrame()
+{
+    mLastFrame = GetFrameStatistics();
+    mFrameIndex = (mFrameIndex + 1) % mNumFrames;
+    Reset(mFrames[mFrameIndex]);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+    Frame& frame = mFrames[mFrameIndex];
+    ++frame.numAllocations;
+
+    // Bump offset, the block is aligned so aligned offsets are aligned addresses.
+    size_t offset = frame.offset.load(std::memory_order_relaxed);
+    while (true)
+    {
+        size_t begin = (offset + alignment - 1) & ~(alignment - 1);
+        size_t end = begin + size;
+        if (end > frame.blockSize)
+            break;
+        if (frame.offset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+            return frame.block + begin;
+    }
+
+    // Block is full.
+    void* memory = AlignedAllocate(std::max(size, static_cast<size_t>(1)));
+    std::lock_guard<std::mutex> lock(mOverflowMutex);
+    frame.overflows.push_back(memory);
+    frame.overflowBytes += (size + FRAMEARENA_ALIGNMENT - 1) & ~static_cast<size_t>(FRAMEARENA_ALIGNMENT - 1);
+    return memory;
+}
+
+FrameArena::Statistics FrameArena::GetFrameStatistics() const
+{
+    const Frame& frame = mFrames[mFrameIndex];
+    Statistics statistics;
+    statistics.numAllocations = frame.numAllocations;
+    statistics.numBytes = std::min(frame.offset.load(), frame.blockSize) + frame.overflowBytes;
+    statistics.numOverflows = static_cast<unsigned int>(frame.overflows.size());
+    statistics.blockSize = frame.blockSize;
+    return statistics;
+}
+
+const FrameArena::Statistics& FrameArena::GetLastFrameStatistics() const
+{
+    return mLastFrame;
+}
+
+void FrameArena::PrintStatistics(std::ostream& stream) const
+{
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(1)
+        << "Frame arena: " << mLastFrame.numAllocations << " allocations, " << mLastFrame.numBytes / 1024.0 << " KB of " << mLastFrame.blockSize / 1024.0
+        << " KB block, " << mLastFrame.numOverflows << " heap overflows" << std::endl;
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+void FrameArena::Reset(Frame& frame)
+{
+    for (void* memory : frame.overflows)
+        AlignedFree(memory);
+    frame.overflows.clear();
+
+    // Grow to the peak, with headroom so a slowly growing frame does not reallocate every time.
+    if (frame.overflowBytes > 0)
+    {
+        size_t blockSize = std::max(frame.blockSize + frame.overflowBytes, frame.blockSize * 2);
+        AlignedFree(frame.block);
+        frame.block = static_cast<unsigned char*>(AlignedAllocate(blockSize));
+        frame.blockSize = blockSize;
+    }
+
+    frame.offset = 0;
+    frame.numAllocations = 0;
+    frame.overflowBytes = 0;
+}
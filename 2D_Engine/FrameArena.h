@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "FramePipeline.h"
+
+// Default number of frames whose allocations stay valid: frames in flight plus the frame being built.
+#define FRAMEARENA_NUM_FRAMES (FRAME_PIPELINE_LATENCY + 1U)
+
+// Default initial block size per frame in bytes.
+#define FRAMEARENA_BLOCK_SIZE (256U * 1024U)
+
+// Alignment of blocks and default alignment of allocations in bytes.
+#define FRAMEARENA_ALIGNMENT 64U
+
+// Linear allocator for transient per-frame data. Each frame bumps through its own block, allocations are released
+// together when the frame's block is reused numFrames frames later. Allocations that do not fit go to the heap and
+// the block grows to the frame's peak when it is reused, so steady state frames never touch the heap.
+class FrameArena
+{
+    public:
+        // Allocation statistics of a frame.
+        struct Statistics
+        {
+            // Number of allocations.
+            unsigned int numAllocations;
+            // Number of allocated bytes including alignment padding.
+            unsigned long long numBytes;
+            // Number of allocations that did not fit the block and went to the heap.
+            unsigned int numOverflows;
+            // Block size in bytes.
+            unsigned long long blockSize;
+        };
+
+        // Constructor.
+        // blockSize Initial block size per frame in bytes.
+        // numFrames Number of frames whose allocations stay valid, at least 1.
+        FrameArena(unsigned int blockSize = FRAMEARENA_BLOCK_SIZE, unsigned int numFrames = FRAMEARENA_NUM_FRAMES);
+
+        // Destructor.
+        ~FrameArena();
+
+        // Start next frame and release the allocations made numFrames frames ago. Not thread safe against Allocate.
+        void BeginFrame();
+
+        // Allocate memory valid until the frame's block is reused. Thread safe.
+        // size Size in bytes.
+        // alignment Alignment in bytes, power of two up to FRAMEARENA_ALIGNMENT.
+        // Returns uninitialised memory.
+        void* Allocate(size_t size, size_t alignment = FRAMEARENA_ALIGNMENT);
+
+        // Allocate array. Elements are not constructed and never destroyed.
+        // count Number of elements.
+        // Returns uninitialised array.
+        template <typename T>
+        T* Allocate(unsigned int count);
+
+        // Get statistics of the current frame so far.
+        Statistics GetFrameStatistics() const;
+
+        // Get statistics of the last finished frame.
+        const Statistics& GetLastFrameStatistics() const;
+
+        // Print statistics of the last finished frame.
+        // stream Output stream.
+        void PrintStatistics(std::ostream& stream) const;
+
+    private:
+        struct Frame
+        {
+            unsigned char* block;
+            size_t blockSize;
+            std::atomic<size_t> offset;
+            std::atomic<unsigned int> numAllocations;
+            // Heap allocations of this frame, guarded by mOverflowMutex.
+            std::vector<void*> overflows;
+            size_t overflowBytes;
+        };
+
+        // Release the frame's overflows and grow its block to the frame's peak.
+        void Reset(Frame& frame);
+
+        Frame* mFrames;
+        unsigned int mNumFrames;
+        unsigned int mFrameIndex;
+        std::mutex mOverflowMutex;
+        Statistics mLastFrame;
+};
+
+template <typename T>
+inline T* FrameArena::Allocate(unsigned int count)
+{
+    static_assert(std::is_trivially_destructible<T>::value, "Frame arena elements are never destroyed.");
+    return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+// Default number of snapshot slots, max number of simulated frames waiting for or being rendered.
+#define FRAME_PIPELINE_LATENCY 2U
+
+template <typename T>
+// Ring of frame snapshots handed from a producer thread (simulation) to a consumer thread (render).
+// Slots are preallocated. The producer writes a slot, publishes it and may not touch it again until the consumer has released it.
+class FramePipeline
+{
+    public:
+        // Constructor.
+        // latency Number of slots, max number of published frames not yet released by the consumer.
+        FramePipeline(unsigned int latency = FRAME_PIPELINE_LATENCY);
+
+        // Destructor.
+        ~FramePipeline();
+
+        // Wait for a free slot to write.
+        // Returns slot, nullptr if pipeline was closed.
+        T* BeginWrite();
+
+        // Publish slot returned by BeginWrite.
+        void EndWrite();
+
+        // Wait for a published slot to read.
+        // Returns slot, nullptr if pipeline was closed and all published slots were read.
+        const T* BeginRead();
+
+        // Release slot returned by BeginRead.
+        void EndRead();
+
+        // Close pipeline. Wakes up both threads, published slots can still be read.
+        void Close();
+
+        // Get slot for initialization before any thread uses the pipeline.
+        // index Slot index.
+        T& GetSlot(unsigned int index);
+
+        // Get number of slots.
+        unsigned int GetLatency() const;
+
+    private:
+        std::vector<T> mSlots;
+        unsigned int mWriteIndex;
+        unsigned int mReadIndex;
+        unsigned int mNumPublished;
+        bool mClosed;
+        std::mutex mMutex;
+        std::condition_variable mWritable;
+        std::condition_variable mReadable;
+};
+
+template <typename T>
+inline FramePipeline<T>::FramePipeline(unsigned int latency)
+{
+    mSlots.resize(latency > 0 ? latency : 1);
+    mWriteIndex = 0;
+    mReadIndex = 0;
+    mNumPublished = 0;
+    mClosed = false;
+}
+
+template <typename T>
+inline FramePipeline<T>::~FramePipeline()
+{
+
+}
+
+template <typename T>
+inline T* FramePipeline<T>::BeginWrite()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWritable.wait(lock, [this] { return mClosed || mNumPublished < mSlots.size(); });
+    return mClosed ? nullptr : &mSlots[mWriteIndex];
+}
+
+template <typename T>
+inline void FramePipeline<T>::EndWrite()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWriteIndex = (mWriteIndex + 1) % mSlots.size();
+        ++mNumPublished;
+    }
+    mReadable.notify_one();
+}
+
+template <typename T>
+inline const T* FramePipeline<T>::BeginRead()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mReadable.wait(lock, [this] { return mClosed || mNumPublished > 0; });
+    return mNumPublished > 0 ? &mSlots[mReadIndex] : nullptr;
+}
+
+template <typename T>
+inline void FramePipeline<T>::EndRead()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReadIndex = (mReadIndex + 1) % mSlots.size();
+        --mNumPublished;
+    }
+    mWritable.notify_one();
+}
+
+template <typename T>
+inline void FramePipeline<T>::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+    }
+    mWritable.notify_all();
+    mReadable.notify_all();
+}
+
+template <typename T>
+inline T& FramePipeline<T>::GetSlot(unsigned int index)
+{
+    return mSlots[index];
+}
+
+template <typename T>
+inline unsigned int FramePipeline<T>::GetLatency() const
+{
+    return static_cast<unsigned int>(mSlots.size());
+}
@@ -0,0 +1,110 @@
+#include "GPUStageTimer.h"
+
+#include "DxAssert.h"
+
+GPUStageTimer::GPUStageTimer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+{
+    mpDevice = pDevice;
+    mpDeviceContext = pDeviceContext;
+    mNumWritten = 0;
+    mNumRead = 0;
+
+    // Create queries.
+    D3D11_QUERY_DESC qDesc;
+    ZeroMemory(&qDesc, sizeof(D3D11_QUERY_DESC));
+    for (unsigned int i = 0; i < GPU_STAGE_TIMER_READBACK_LATENCY; ++i)
+    {
+        Frame& frame = mFrames[i];
+        qDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+        DxAssert(mpDevice->CreateQuery(&qDesc, &frame.disjoint), S_OK);
+        qDesc.Query = D3D11_QUERY_TIMESTAMP;
+        for (unsigned int s = 0; s < Telemetry::NUM_STAGES; ++s)
+        {
+            DxAssert(mpDevice->CreateQuery(&qDesc, &frame.begin[s]), S_OK);
+            DxAssert(mpDevice->CreateQuery(&qDesc, &frame.end[s]), S_OK);
+            frame.issued[s] = false;
+        }
+        frame.index = 0;
+    }
+}
+
+GPUStageTimer::~GPUStageTimer()
+{
+    for (unsigned int i = 0; i < GPU_STAGE_TIMER_READBACK_LATENCY; ++i)
+    {
+        Frame& frame = mFrames[i];
+        frame.disjoint->Release();
+        for (unsigned int s = 0; s < Telemetry::NUM_STAGES; ++s)
+        {
+            frame.begin[s]->Release();
+            frame.end[s]->Release();
+        }
+    }
+}
+
+void GPUStageTimer::BeginFrame(unsigned long long frame)
+{
+    Frame& current = mFrames[mNumWritten % GPU_STAGE_TIMER_READBACK_LATENCY];
+    current.index = frame;
+    for (unsigned int s = 0; s < Telemetry::NUM_STAGES; ++s)
+        current.issued[s] = false;
+    mpDeviceContext->Begin(current.disjoint);
+}
+
+void GPUStageTimer::BeginStage(Telemetry::Stage stage)
+{
+    Frame& current = mFrames[mNumWritten % GPU_STAGE_TIMER_READBACK_LATENCY];
+    mpDeviceContext->End(current.begin[stage]);
+}
+
+void GPUStageTimer::EndStage(Telemetry::Stage stage)
+{
+    Frame& current = mFrames[mNumWritten % GPU_STAGE_TIMER_READBACK_LATENCY];
+    mpDeviceContext->End(current.end[stage]);
+    current.issued[stage] = true;
+}
+
+void GPUStageTimer::EndFrame(Telemetry& telemetry)
+{
+    mpDeviceContext->End(mFrames[mNumWritten % GPU_STAGE_TIMER_READBACK_LATENCY].disjoint);
+    ++mNumWritten;
+
+    // Read back oldest frames that are ready, all queries in flight wait for the oldest.
+    if (mNumWritten - mNumRead == GPU_STAGE_TIMER_READBACK_LATENCY)
+    {
+        Resolve(mFrames[mNumRead % GPU_STAGE_TIMER_READBACK_LATENCY], true, telemetry);
+        ++mNumRead;
+    }
+    while (mNumRead < mNumWritten && Resolve(mFrames[mNumRead % GPU_STAGE_TIMER_READBACK_LATENCY], false, telemetry))
+        ++mNumRead;
+}
+
+bool GPUStageTimer::Resolve(Frame& frame, bool wait, Telemetry& telemetry)
+{
+    // The disjoint query finishes after all timestamps of the frame.
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    UINT flags = wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH;
+    HRESULT result = mpDeviceContext->GetData(frame.disjoint, &disjoint, sizeof(disjoint), flags);
+    while (result == S_FALSE && wait)
+        result = mpDeviceContext->GetData(frame.disjoint, &disjoint, sizeof(disjoint), flags);
+    if (result != S_OK)
+        return false;
+    if (disjoint.Disjoint)
+        return true;
+
+    // Stages the frame did not run are negative.
+    long long stageTimes[Telemetry::NUM_STAGES];
+    for (unsigned int s = 0; s < Telemetry::NUM_STAGES; ++s)
+    {
+        stageTimes[s] = -1;
+        if (!frame.issued[s])
+            continue;
+        UINT64 begin = 0;
+        UINT64 end = 0;
+        DxAssert(mpDeviceContext->GetData(frame.begin[s], &begin, sizeof(begin), 0), S_OK);
+        DxAssert(mpDeviceContext->GetData(frame.end[s], &end, sizeof(end), 0), S_OK);
+        stageTimes[s] = end > begin ? static_cast<long long>((end - begin) * 1000000000.0 / disjoint.Frequency) : 0;
+    }
+    telemetry.AddStageTimes(frame.index, stageTimes);
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#pragma comment(lib, "d3d11.lib")
+#include <d3d11.h>
+
+#include "Telemetry.h"
+
+// Number of frames between writing and reading back timestamps. Avoids stalling on the GPU.
+#define GPU_STAGE_TIMER_READBACK_LATENCY 3U
+
+// Measures GPU time of telemetry stages with timestamp queries. Dispatches run asynchronously, so timing their
+// submission on the CPU would put the GPU work into whichever call waits for it, usually Present.
+class GPUStageTimer
+{
+    public:
+        // Constructor.
+        // pDevice Pointer to D3D11 device.
+        // pDeviceContext Pointer to D3D11 device context.
+        GPUStageTimer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+
+        // Destructor.
+        ~GPUStageTimer();
+
+        // Begin frame. Call before the first stage.
+        // frame Telemetry frame index, Telemetry::GetNumFrames() before the frame's EndFrame.
+        void BeginFrame(unsigned long long frame);
+
+        // Insert timestamp before the commands of stage.
+        // stage Stage to begin.
+        void BeginStage(Telemetry::Stage stage);
+
+        // Insert timestamp after the commands of stage.
+        // stage Stage to end.
+        void EndStage(Telemetry::Stage stage);
+
+        // End frame and pass stage times of finished frames to telemetry. Waits for the oldest frame when all are
+        // in flight. Frames the GPU clock was disjoint for are dropped.
+        // telemetry Telemetry created with deferred stages.
+        void EndFrame(Telemetry& telemetry);
+
+        // Scoped stage.
+        class StageScope
+        {
+            public:
+                StageScope(GPUStageTimer& timer, Telemetry::Stage stage) : mTimer(timer), mStage(stage) { mTimer.BeginStage(mStage); }
+                ~StageScope() { mTimer.EndStage(mStage); }
+            private:
+                GPUStageTimer& mTimer;
+                Telemetry::Stage mStage;
+        };
+
+    private:
+        // Queries of a frame in flight.
+        struct Frame
+        {
+            ID3D11Query* disjoint;
+            ID3D11Query* begin[Telemetry::NUM_STAGES];
+            ID3D11Query* end[Telemetry::NUM_STAGES];
+            bool issued[Telemetry::NUM_STAGES];
+            unsigned long long index;
+        };
+
+        // Read back frame.
+        // frame Frame to read back.
+        // wait Whether to wait for the GPU to finish the frame.
+        // telemetry Telemetry to pass the stage times to.
+        // Returns whether frame was finished.
+        bool Resolve(Frame& frame, bool wait, Telemetry& telemetry);
+
+        ID3D11Device* mpDevice;
+        ID3D11DeviceContext* mpDeviceContext;
+        Frame mFrames[GPU_STAGE_TIMER_READBACK_LATENCY];
+        unsigned long long mNumWritten;
+        unsigned long long mNumRead;
+};
@@ -9,6 +9,7 @@
 
 template <typename T>
 // Double-buffered swap buffer. Allocate two pars of read and write buffer on the GPU.
+// Capacity grows geometrically on Reserve, live contents are copied on the GPU.
 class GPUSwapBuffer 
 {
     public:
@@ -17,7 +18,7 @@ class GPUSwapBuffer
         // pDeviceContext Pointer to D3D11 device context.
         // numOfElements Number of elements of type elements T.
         // initData Init data.
-        GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int numOfElements, T* initData = nullptr);
+        GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int numOfElements, const T* initData = nullptr);
 
         // Destructor.
         ~GPUSwapBuffer();
@@ -37,7 +38,37 @@ class GPUSwapBuffer
         // Get vertex buffer.
         ID3D11Buffer* GetVertexBuffer();
 
+        // Get number of elements the buffers hold.
+        unsigned int GetCapacity() const;
+
+        // Grow buffers to hold at least numOfElements elements, at least doubling the capacity. Views and vertex buffer are recreated.
+        // numOfElements Min number of elements.
+        // numOfLiveElements Number of leading elements copied to the new buffers.
+        void Reserve(unsigned int numOfElements, unsigned int numOfLiveElements);
+
+        // Write elements to both buffers, so they are live whichever buffer is read next.
+        // data Source of numOfElements elements.
+        // first Index of first element written.
+        // numOfElements Number of elements.
+        void Write(const T* data, unsigned int first, unsigned int numOfElements);
+
+        // Copy target buffer (last written) to CPU memory. Stalls until the GPU has finished writing it.
+        // data Destination of numOfElements elements.
+        // numOfElements Number of leading elements to copy, at most the capacity.
+        void ReadBack(T* data, unsigned int numOfElements);
+
+        // Overwrite target buffer (last written) with CPU memory.
+        // data Source of numOfElements elements.
+        // numOfElements Number of leading elements to overwrite, at most the capacity.
+        void Upload(const T* data, unsigned int numOfElements);
+
     private:
+        // Create buffers, views and vertex buffer.
+        void Create(unsigned int numOfElements, const T* initData);
+
+        // Release buffers, views, vertex buffer and staging buffer.
+        void Release();
+
         bool mState;
         ID3D11Device* mpDevice;
         ID3D11DeviceContext* mpDeviceContext;
@@ -45,15 +76,148 @@ class GPUSwapBuffer
         ID3D11ShaderResourceView* mSourceBuffers[2];
         ID3D11UnorderedAccessView* mTargetBuffers[2];
         ID3D11Buffer* mVertexBuffer;
+        ID3D11Buffer* mStagingBuffer;
+        unsigned int mNumOfElements;
 };
 
 template <typename T>
-inline GPUSwapBuffer<T>::GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int numOfElements, T* initData)
+inline GPUSwapBuffer<T>::GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int numOfElements, const T* initData)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
 
     mState = 0;
+    Create(numOfElements, initData);
+}
+
+template <typename T>
+inline GPUSwapBuffer<T>::~GPUSwapBuffer()
+{
+    Release();
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::Swap()
+{
+    mState = !mState;
+}
+
+template <typename T>
+inline ID3D11ShaderResourceView* GPUSwapBuffer<T>::GetSourceBuffer()
+{
+    return mSourceBuffers[!mState];
+}
+
+template <typename T>
+inline ID3D11UnorderedAccessView* GPUSwapBuffer<T>::GetTargetBuffer()
+{
+    return mTargetBuffers[mState];
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::UpdateVertexBuffer()
+{
+    mpDeviceContext->CopyResource(mVertexBuffer, mBuffers[mState]);
+}
+
+template <typename T>
+inline ID3D11Buffer* GPUSwapBuffer<T>::GetVertexBuffer()
+{
+    return mVertexBuffer;
+}
+
+template <typename T>
+inline unsigned int GPUSwapBuffer<T>::GetCapacity() const
+{
+    return mNumOfElements;
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::Reserve(unsigned int numOfElements, unsigned int numOfLiveElements)
+{
+    if (numOfElements <= mNumOfElements)
+        return;
+
+    // Keep old buffers until live contents are copied.
+    ID3D11Buffer* oldBuffers[2] = { mBuffers[0], mBuffers[1] };
+    mBuffers[0]->AddRef();
+    mBuffers[1]->AddRef();
+    unsigned int numOfOldElements = mNumOfElements;
+    Release();
+    Create(numOfElements > numOfOldElements * 2 ? numOfElements : numOfOldElements * 2, nullptr);
+
+    D3D11_BOX box;
+    box.left = 0;
+    box.right = sizeof(T) * (numOfLiveElements < numOfOldElements ? numOfLiveElements : numOfOldElements);
+    box.top = 0;
+    box.bottom = 1;
+    box.front = 0;
+    box.back = 1;
+    if (box.right > 0)
+    {
+        mpDeviceContext->CopySubresourceRegion(mBuffers[0], 0, 0, 0, 0, oldBuffers[0], 0, &box);
+        mpDeviceContext->CopySubresourceRegion(mBuffers[1], 0, 0, 0, 0, oldBuffers[1], 0, &box);
+    }
+    oldBuffers[0]->Release();
+    oldBuffers[1]->Release();
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::Write(const T* data, unsigned int first, unsigned int numOfElements)
+{
+    D3D11_BOX box;
+    box.left = sizeof(T) * first;
+    box.right = sizeof(T) * (first + numOfElements);
+    box.top = 0;
+    box.bottom = 1;
+    box.front = 0;
+    box.back = 1;
+    mpDeviceContext->UpdateSubresource(mBuffers[0], 0, &box, data, 0, 0);
+    mpDeviceContext->UpdateSubresource(mBuffers[1], 0, &box, data, 0, 0);
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::ReadBack(T* data, unsigned int numOfElements)
+{
+    // Create staging buffer on first read back.
+    if (mStagingBuffer == nullptr)
+    {
+        D3D11_BUFFER_DESC bDesc;
+        ZeroMemory(&bDesc, sizeof(D3D11_BUFFER_DESC));
+        bDesc.ByteWidth = sizeof(T) * mNumOfElements;
+        bDesc.Usage = D3D11_USAGE_STAGING;
+        bDesc.BindFlags = 0;
+        bDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        bDesc.MiscFlags = 0;
+        bDesc.StructureByteStride = 0;
+        DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mStagingBuffer), S_OK);
+    }
+
+    mpDeviceContext->CopyResource(mStagingBuffer, mBuffers[mState]);
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    DxAssert(mpDeviceContext->Map(mStagingBuffer, 0, D3D11_MAP_READ, 0, &mappedResource), S_OK);
+    memcpy(data, mappedResource.pData, sizeof(T) * numOfElements);
+    mpDeviceContext->Unmap(mStagingBuffer, 0);
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::Upload(const T* data, unsigned int numOfElements)
+{
+    D3D11_BOX box;
+    box.left = 0;
+    box.right = sizeof(T) * numOfElements;
+    box.top = 0;
+    box.bottom = 1;
+    box.front = 0;
+    box.back = 1;
+    mpDeviceContext->UpdateSubresource(mBuffers[mState], 0, &box, data, 0, 0);
+}
+
+template <typename T>
+inline void GPUSwapBuffer<T>::Create(unsigned int numOfElements, const T* initData)
+{
+    mStagingBuffer = nullptr;
+    mNumOfElements = numOfElements;
 
     // Create source and target buffers.
     {
@@ -67,16 +231,18 @@ inline GPUSwapBuffer<T>::GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContex
         bDesc.StructureByteStride = sizeof(T);
         if (initData == nullptr)
         {
-            DxAssert(pDevice->CreateBuffer(&bDesc, NULL, &mBuffers[0]), S_OK);
-            DxAssert(pDevice->CreateBuffer(&bDesc, NULL, &mBuffers[1]), S_OK);
+            DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mBuffers[0]), S_OK);
+            DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mBuffers[1]), S_OK);
         }
         else
         {
+            // Upload init data once, second buffer is copied on the GPU.
             D3D11_SUBRESOURCE_DATA sData;
             ZeroMemory(&sData, sizeof(D3D11_SUBRESOURCE_DATA));
             sData.pSysMem = initData;
-            DxAssert(pDevice->CreateBuffer(&bDesc, &sData, &mBuffers[0]), S_OK);
-            DxAssert(pDevice->CreateBuffer(&bDesc, &sData, &mBuffers[1]), S_OK);
+            DxAssert(mpDevice->CreateBuffer(&bDesc, &sData, &mBuffers[0]), S_OK);
+            DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mBuffers[1]), S_OK);
+            mpDeviceContext->CopyResource(mBuffers[1], mBuffers[0]);
         }
 
         D3D11_SHADER_RESOURCE_VIEW_DESC srcDesc;
@@ -86,8 +252,8 @@ inline GPUSwapBuffer<T>::GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContex
         srcDesc.Buffer.FirstElement = 0;
         srcDesc.Buffer.ElementOffset = 0;
         srcDesc.Buffer.NumElements = numOfElements;
-        DxAssert(pDevice->CreateShaderResourceView(mBuffers[0], &srcDesc, &mSourceBuffers[0]), S_OK);
-        DxAssert(pDevice->CreateShaderResourceView(mBuffers[1], &srcDesc, &mSourceBuffers[1]), S_OK);
+        DxAssert(mpDevice->CreateShaderResourceView(mBuffers[0], &srcDesc, &mSourceBuffers[0]), S_OK);
+        DxAssert(mpDevice->CreateShaderResourceView(mBuffers[1], &srcDesc, &mSourceBuffers[1]), S_OK);
 
         D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
         ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
@@ -96,18 +262,18 @@ inline GPUSwapBuffer<T>::GPUSwapBuffer(ID3D11Device* pDevice, ID3D11DeviceContex
         uavDesc.Buffer.FirstElement = 0;
         uavDesc.Buffer.NumElements = numOfElements;
         uavDesc.Buffer.Flags = 0;
-        DxAssert(pDevice->CreateUnorderedAccessView(mBuffers[0], &uavDesc, &mTargetBuffers[0]), S_OK);
-        DxAssert(pDevice->CreateUnorderedAccessView(mBuffers[1], &uavDesc, &mTargetBuffers[1]), S_OK);
+        DxAssert(mpDevice->CreateUnorderedAccessView(mBuffers[0], &uavDesc, &mTargetBuffers[0]), S_OK);
+        DxAssert(mpDevice->CreateUnorderedAccessView(mBuffers[1], &uavDesc, &mTargetBuffers[1]), S_OK);
     }
-    
+
     // Create vertex buffer.
     {
-        DxHelp::CreateVertexBuffer<Particle>(mpDevice, numOfElements, &mVertexBuffer);
+        DxHelp::CreateVertexBuffer<T>(mpDevice, numOfElements, &mVertexBuffer);
     }
- }
+}
 
 template <typename T>
-inline GPUSwapBuffer<T>::~GPUSwapBuffer()
+inline void GPUSwapBuffer<T>::Release()
 {
     mSourceBuffers[0]->Release();
     mSourceBuffers[1]->Release();
@@ -116,34 +282,7 @@ inline GPUSwapBuffer<T>::~GPUSwapBuffer()
     mBuffers[0]->Release();
     mBuffers[1]->Release();
     mVertexBuffer->Release();
-}
-
-template <typename T>
-inline void GPUSwapBuffer<T>::Swap()
-{
-    mState = !mState;
-}
-
-template <typename T>
-inline ID3D11ShaderResourceView* GPUSwapBuffer<T>::GetSourceBuffer()
-{
-    return mSourceBuffers[!mState];
-}
-
-template <typename T>
-inline ID3D11UnorderedAccessView* GPUSwapBuffer<T>::GetTargetBuffer()
-{
-    return mTargetBuffers[mState];
-}
-
-template <typename T>
-inline void GPUSwapBuffer<T>::UpdateVertexBuffer()
-{
-    mpDeviceContext->CopyResource(mVertexBuffer, mBuffers[mState]);
-}
-
-template <typename T>
-inline ID3D11Buffer* GPUSwapBuffer<T>::GetVertexBuffer()
-{
-    return mVertexBuffer;
+    if (mStagingBuffer != nullptr)
+        mStagingBuffer->Release();
+    mStagingBuffer = nullptr;
 }
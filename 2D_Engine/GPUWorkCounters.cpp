@@ -0,0 +1,106 @@
+#include "GPUWorkCounters.h"
+
+#include "DxAssert.h"
+
+#include <cstring>
+
+#define WORK_COUNTERS_NUM_ELEMENTS (sizeof(WorkCounters) / sizeof(unsigned int))
+
+GPUWorkCounters::GPUWorkCounters(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+{
+    mpDevice = pDevice;
+    mpDeviceContext = pDeviceContext;
+    mNumWritten = 0;
+    mNumRead = 0;
+    mCounters.Reset();
+
+    // Create counter buffer.
+    D3D11_BUFFER_DESC bDesc;
+    ZeroMemory(&bDesc, sizeof(D3D11_BUFFER_DESC));
+    bDesc.ByteWidth = sizeof(WorkCounters);
+    bDesc.Usage = D3D11_USAGE_DEFAULT;
+    bDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    bDesc.CPUAccessFlags = 0;
+    bDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bDesc.StructureByteStride = sizeof(unsigned int);
+    DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mBuffer), S_OK);
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+    ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+    uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.FirstElement = 0;
+    uavDesc.Buffer.NumElements = WORK_COUNTERS_NUM_ELEMENTS;
+    uavDesc.Buffer.Flags = 0;
+    DxAssert(mpDevice->CreateUnorderedAccessView(mBuffer, &uavDesc, &mUAV), S_OK);
+
+    // Create staging buffers.
+    ZeroMemory(&bDesc, sizeof(D3D11_BUFFER_DESC));
+    bDesc.ByteWidth = sizeof(WorkCounters);
+    bDesc.Usage = D3D11_USAGE_STAGING;
+    bDesc.BindFlags = 0;
+    bDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    for (unsigned int i = 0; i < WORK_COUNTERS_READBACK_LATENCY; ++i)
+        DxAssert(mpDevice->CreateBuffer(&bDesc, NULL, &mStagingBuffers[i]), S_OK);
+}
+
+GPUWorkCounters::~GPUWorkCounters()
+{
+    mUAV->Release();
+    mBuffer->Release();
+    for (unsigned int i = 0; i < WORK_COUNTERS_READBACK_LATENCY; ++i)
+        mStagingBuffers[i]->Release();
+}
+
+void GPUWorkCounters::BeginFrame()
+{
+    const UINT zero[4] = { 0, 0, 0, 0 };
+    mpDeviceContext->ClearUnorderedAccessViewUint(mUAV, zero);
+}
+
+void GPUWorkCounters::EndFrame()
+{
+    // Read back oldest frames that are ready.
+    if (mNumWritten - mNumRead == WORK_COUNTERS_READBACK_LATENCY)
+    {
+        // All staging buffers in flight, wait for oldest.
+        ID3D11Buffer* stagingBuffer = mStagingBuffers[mNumRead % WORK_COUNTERS_READBACK_LATENCY];
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        DxAssert(mpDeviceContext->Map(stagingBuffer, 0, D3D11_MAP_READ, 0, &mappedResource), S_OK);
+        memcpy(&mCounters, mappedResource.pData, sizeof(WorkCounters));
+        mpDeviceContext->Unmap(stagingBuffer, 0);
+        ++mNumRead;
+    }
+    while (mNumRead < mNumWritten)
+    {
+        ID3D11Buffer* stagingBuffer = mStagingBuffers[mNumRead % WORK_COUNTERS_READBACK_LATENCY];
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        if (mpDeviceContext->Map(stagingBuffer, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mappedResource) != S_OK)
+            break;
+        memcpy(&mCounters, mappedResource.pData, sizeof(WorkCounters));
+        mpDeviceContext->Unmap(stagingBuffer, 0);
+        ++mNumRead;
+    }
+
+    // Queue this frame.
+    mpDeviceContext->CopyResource(mStagingBuffers[mNumWritten % WORK_COUNTERS_READBACK_LATENCY], mBuffer);
+    ++mNumWritten;
+}
+
+ID3D11UnorderedAccessView* GPUWorkCounters::GetBuffer()
+{
+    return mUAV;
+}
+
+const WorkCounters& GPUWorkCounters::GetCounters() const
+{
+    return mCounters;
+}
+
+void GPUWorkCounters::AddKernelOptions(KernelDesc& desc)
+{
+    desc.includes.push_back("WorkCounters.hlsli");
+#if WORK_COUNTERS
+    desc.defines.push_back(std::make_pair(std::string("WORK_COUNTERS"), std::string("1")));
+#endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+#include "KernelCache.h"
+#include "WorkCounters.h"
+
+// Number of frames between writing and reading back counters. Avoids stalling on the GPU.
+#define WORK_COUNTERS_READBACK_LATENCY 3U
+
+// Counter buffer atomically updated by the compute shaders (bound as RWStructuredBuffer<uint>).
+class GPUWorkCounters
+{
+    public:
+        // Constructor.
+        // pDevice Pointer to D3D11 device.
+        // pDeviceContext Pointer to D3D11 device context.
+        GPUWorkCounters(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+
+        // Destructor.
+        ~GPUWorkCounters();
+
+        // Clear counters. Call before the simulation passes.
+        void BeginFrame();
+
+        // Queue counters for read back and resolve finished frames. Call after the simulation passes.
+        void EndFrame();
+
+        // Get counter buffer.
+        ID3D11UnorderedAccessView* GetBuffer();
+
+        // Get counters of last resolved frame.
+        const WorkCounters& GetCounters() const;
+
+        // Add the counter include of compute shaders including WorkCounters.hlsli, and the define enabling the counters
+        // unless they are compiled out.
+        // desc Kernel description.
+        static void AddKernelOptions(KernelDesc& desc);
+
+    private:
+        ID3D11Device* mpDevice;
+        ID3D11DeviceContext* mpDeviceContext;
+        ID3D11Buffer* mBuffer;
+        ID3D11UnorderedAccessView* mUAV;
+        ID3D11Buffer* mStagingBuffers[WORK_COUNTERS_READBACK_LATENCY];
+        unsigned long long mNumWritten;
+        unsigned long long mNumRead;
+        WorkCounters mCounters;
+};
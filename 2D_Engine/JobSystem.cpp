@@ -0,0 +1,254 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    // Job system owning the calling thread and index of the thread.
+    thread_local const JobSystem* tJobSystem = nullptr;
+    thread_local unsigned int tThreadIndex = 0;
+}
+
+JobCounter::JobCounter() : mCount(0)
+{
+
+}
+
+JobCounter::~JobCounter()
+{
+
+}
+
+bool JobCounter::Done() const
+{
+    return mCount.load() == 0;
+}
+
+JobSystem::JobSystem(unsigned int numThreads) : mQueues(numThreads > 0 ? numThreads : std::max(std::thread::hardware_concurrency(), 1U)), mNumQueued(0), mNumSleeping(0), mQuit(false)
+{
+    for (Queue& queue : mQueues)
+    {
+        queue.jobs.resize(JOBSYSTEM_QUEUE_SIZE);
+        queue.head = 0;
+        queue.size = 0;
+    }
+
+    mThreadId = std::this_thread::get_id();
+    tJobSystem = this;
+    tThreadIndex = 0;
+    for (unsigned int i = 1; i < mQueues.size(); ++i)
+        mThreads.push_back(std::thread(&JobSystem::WorkerThread, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    mQuit = true;
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mWakeUp.notify_all();
+    }
+    for (std::thread& thread : mThreads)
+        thread.join();
+
+    if (tJobSystem == this)
+        tJobSystem = nullptr;
+}
+
+void JobSystem::Run(JobFunction function, const void* data, unsigned int begin, unsigned int end, unsigned int grain, JobCounter* counter)
+{
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.begin = begin;
+    job.end = end;
+    job.grain = grain;
+    job.counter = counter;
+
+    if (counter != nullptr)
+        ++counter->mCount;
+    if (!Push(job))
+        Execute(job);
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, JobFunction function, const void* data, unsigned int begin, unsigned int end, unsigned int grain, JobCounter* counter)
+{
+    Job job;
+    job.function = function;
+    job.data = data;
+    job.begin = begin;
+    job.end = end;
+    job.grain = grain;
+    job.counter = counter;
+
+    if (counter != nullptr)
+        ++counter->mCount;
+    {
+        // Finish takes the same lock after the count reached zero, so the job is either queued here or run by Finish.
+        std::lock_guard<std::mutex> lock(dependency.mMutex);
+        if (dependency.mCount.load() > 0)
+        {
+            dependency.mContinuations.push_back(job);
+            return;
+        }
+    }
+    if (!Push(job))
+        Execute(job);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    unsigned int threadIndex = GetThreadIndex();
+    while (counter.mCount.load() > 0)
+    {
+        Job job;
+        if (Pop(threadIndex, job))
+            Execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // Finish holds the lock from the last decrement until it no longer touches the counter.
+    std::lock_guard<std::mutex> lock(counter.mMutex);
+}
+
+unsigned int JobSystem::GetNumThreads() const
+{
+    return static_cast<unsigned int>(mQueues.size());
+}
+
+unsigned int JobSystem::GetThreadIndex() const
+{
+    if (tJobSystem == this)
+        return tThreadIndex;
+
+    // Foreign threads would share slot 0 with thread 0.
+    assert(std::this_thread::get_id() == mThreadId);
+    return 0;
+}
+
+bool JobSystem::Push(const Job& job)
+{
+    Queue& queue = mQueues[GetThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size == JOBSYSTEM_QUEUE_SIZE)
+            return false;
+        queue.jobs[(queue.head + queue.size) % JOBSYSTEM_QUEUE_SIZE] = job;
+        ++queue.size;
+        ++mNumQueued;
+    }
+
+    // Sleeping workers increment mNumSleeping before they check mNumQueued, so either they see the job or we see them.
+    if (mNumSleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mWakeUp.notify_one();
+    }
+    return true;
+}
+
+bool JobSystem::Pop(unsigned int threadIndex, Job& job)
+{
+    if (mNumQueued.load() == 0)
+        return false;
+
+    // Newest job of own queue.
+    {
+        Queue& queue = mQueues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size > 0)
+        {
+            --queue.size;
+            job = queue.jobs[(queue.head + queue.size) % JOBSYSTEM_QUEUE_SIZE];
+            --mNumQueued;
+            return true;
+        }
+    }
+
+    // Oldest job of other queues.
+    unsigned int numQueues = static_cast<unsigned int>(mQueues.size());
+    for (unsigned int i = 1; i < numQueues; ++i)
+    {
+        Queue& queue = mQueues[(threadIndex + i) % numQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.size > 0)
+        {
+            job = queue.jobs[queue.head];
+            queue.head = (queue.head + 1) % JOBSYSTEM_QUEUE_SIZE;
+            --queue.size;
+            --mNumQueued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Execute(Job job)
+{
+    // Split off upper halves for other threads to steal.
+    while (job.grain > 0 && job.end - job.begin > job.grain)
+    {
+        Job upper = job;
+        upper.begin = job.begin + (job.end - job.begin) / 2;
+        job.end = upper.begin;
+        if (upper.counter != nullptr)
+            ++upper.counter->mCount;
+        if (!Push(upper))
+        {
+            // Queue full, run this half now.
+            Execute(upper);
+        }
+    }
+
+    job.function(job.data, job.begin, job.end);
+    Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+    if (counter == nullptr)
+        return;
+
+    // Continuations are moved out under the lock and run after it, an inline continuation may use the same counter.
+    std::vector<Job> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->mMutex);
+        if (--counter->mCount > 0)
+            return;
+        continuations.swap(counter->mContinuations);
+    }
+    for (const Job& job : continuations)
+        if (!Push(job))
+            Execute(job);
+}
+
+void JobSystem::WorkerThread(unsigned int threadIndex)
+{
+    tJobSystem = this;
+    tThreadIndex = threadIndex;
+
+    unsigned int numSpins = 0;
+    while (!mQuit.load())
+    {
+        Job job;
+        if (Pop(threadIndex, job))
+        {
+            Execute(job);
+            numSpins = 0;
+        }
+        else if (++numSpins < JOBSYSTEM_SPIN_COUNT)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            ++mNumSleeping;
+            mWakeUp.wait(lock, [this] { return mQuit.load() || mNumQueued.load() > 0; });
+            --mNumSleeping;
+            numSpins = 0;
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Max number of queued jobs per thread. Jobs pushed to a full queue run immediately.
+#define JOBSYSTEM_QUEUE_SIZE 4096U
+
+// Number of failed steal attempts before an idle worker sleeps.
+#define JOBSYSTEM_SPIN_COUNT 64U
+
+class JobCounter;
+
+// Function run by a job on index range [begin, end).
+typedef void (*JobFunction)(const void* data, unsigned int begin, unsigned int end);
+
+// Job. The range is split in halves until it is at most grain, the halves may be stolen by other threads.
+struct Job
+{
+    JobFunction function;
+    const void* data;
+    unsigned int begin;
+    unsigned int end;
+    unsigned int grain;
+    JobCounter* counter;
+};
+
+// Counts unfinished jobs. Used to wait for jobs and as dependency of other jobs.
+class JobCounter
+{
+    public:
+        // Constructor.
+        JobCounter();
+
+        // Destructor.
+        ~JobCounter();
+
+        // Get whether all jobs have finished.
+        bool Done() const;
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<unsigned int> mCount;
+        std::mutex mMutex;
+        // Jobs run when count reaches zero.
+        std::vector<Job> mContinuations;
+};
+
+// Work-stealing job system. Each thread owns a job queue, idle threads steal the oldest jobs of other threads.
+// The thread creating the job system is thread 0 and runs jobs while it waits. Only thread 0 and the worker threads
+// may use the job system, callers index per-thread data with GetThreadIndex.
+class JobSystem
+{
+    public:
+        // Constructor.
+        // numThreads Number of threads including the calling thread, 0 for one per hardware thread.
+        JobSystem(unsigned int numThreads = 0);
+
+        // Destructor. Waits for worker threads to finish their current job.
+        ~JobSystem();
+
+        // Run job.
+        // function Function to run.
+        // data Data passed to function, has to outlive the job.
+        // begin First index.
+        // end Index after last index.
+        // grain Max number of indices per call to function, 0 to never split the range.
+        // counter Counter incremented until job has finished, can be nullptr.
+        void Run(JobFunction function, const void* data, unsigned int begin, unsigned int end, unsigned int grain, JobCounter* counter);
+
+        // Run job after all jobs of dependency have finished.
+        // dependency Counter to wait for.
+        // function Function to run.
+        // data Data passed to function, has to outlive the job.
+        // begin First index.
+        // end Index after last index.
+        // grain Max number of indices per call to function, 0 to never split the range.
+        // counter Counter incremented until job has finished, can be nullptr.
+        void RunAfter(JobCounter& dependency, JobFunction function, const void* data, unsigned int begin, unsigned int end, unsigned int grain, JobCounter* counter);
+
+        // Wait for jobs of counter to finish. The calling thread runs jobs while waiting.
+        // counter Counter to wait for.
+        void Wait(JobCounter& counter);
+
+        // Run function on index range in parallel and wait for it to finish.
+        // begin First index.
+        // end Index after last index.
+        // grain Max number of indices per call to function.
+        // function Function called as function(begin, end) on sub ranges.
+        template <typename Function>
+        void ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, const Function& function);
+
+        // Get number of threads including thread 0.
+        unsigned int GetNumThreads() const;
+
+        // Get index of calling thread. Asserts that the calling thread is thread 0 or a worker thread.
+        unsigned int GetThreadIndex() const;
+
+    private:
+        // Job queue of one thread.
+        struct Queue
+        {
+            std::mutex mutex;
+            std::vector<Job> jobs;
+            unsigned int head;
+            unsigned int size;
+        };
+
+        template <typename Function>
+        static void Invoke(const void* data, unsigned int begin, unsigned int end);
+
+        // Push job to queue of calling thread.
+        // Returns whether queue had space.
+        bool Push(const Job& job);
+
+        // Pop newest job of own queue or steal oldest job of another queue.
+        // Returns whether a job was found.
+        bool Pop(unsigned int threadIndex, Job& job);
+
+        // Split and run job.
+        void Execute(Job job);
+
+        // Decrement counter and run its continuations when it reaches zero.
+        void Finish(JobCounter* counter);
+
+        void WorkerThread(unsigned int threadIndex);
+
+        std::vector<Queue> mQueues;
+        std::vector<std::thread> mThreads;
+        // Thread 0, identified by id since another job system may have been created on it since.
+        std::thread::id mThreadId;
+        std::atomic<unsigned int> mNumQueued;
+        std::atomic<unsigned int> mNumSleeping;
+        std::atomic<bool> mQuit;
+        std::mutex mSleepMutex;
+        std::condition_variable mWakeUp;
+};
+
+template <typename Function>
+inline void JobSystem::ParallelFor(unsigned int begin, unsigned int end, unsigned int grain, const Function& function)
+{
+    if (begin >= end)
+        return;
+
+    if (mQueues.size() == 1)
+    {
+        function(begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    Run(&Invoke<Function>, &function, begin, end, grain > 0 ? grain : 1, &counter);
+    Wait(counter);
+}
+
+template <typename Function>
+inline void JobSystem::Invoke(const void* data, unsigned int begin, unsigned int end)
+{
+    (*static_cast<const Function*>(data))(begin, end);
+}
@@ -0,0 +1,314 @@
+#include "KernelCache.h"
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // Header at the start of a cached blob file.
+    struct KernelCacheHeader
+    {
+        // KERNELCACHE_MAGIC.
+        unsigned int magic;
+        // KERNELCACHE_VERSION.
+        unsigned int version;
+        // Hash the blob was compiled for.
+        unsigned long long hash;
+        // Blob size in bytes.
+        unsigned long long size;
+    };
+
+    // FNV-1a 64 bit.
+    void HashBytes(unsigned long long& hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ULL;
+        }
+    }
+
+    // Hash string with its length, so adjacent strings can not alias.
+    void HashString(unsigned long long& hash, const std::string& string)
+    {
+        unsigned long long size = string.size();
+        HashBytes(hash, &size, sizeof(size));
+        HashBytes(hash, string.data(), string.size());
+    }
+
+    // Read whole file.
+    bool ReadFile(const std::string& path, std::string& contents)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+            return false;
+
+        contents.clear();
+        char buffer[4096];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            contents.append(buffer, size);
+        bool read = ferror(file) == 0;
+        fclose(file);
+        return read;
+    }
+
+    // Compare kernel descriptions.
+    bool Equal(const KernelDesc& a, const KernelDesc& b)
+    {
+        return a.path == b.path && a.entryPoint == b.entryPoint && a.target == b.target && a.defines == b.defines && a.includes == b.includes;
+    }
+}
+
+KernelCache::KernelCache(KernelCompileFunction compile, const std::string& compilerName, const std::string& directory)
+{
+    mCompile = compile;
+    mCompilerName = compilerName;
+    mDirectory = directory;
+    mStatistics = Statistics();
+
+    // Fails if the directory exists, missing directories show up as store failures.
+    if (!mDirectory.empty())
+    {
+#ifdef _WIN32
+        _mkdir(mDirectory.c_str());
+#else
+        mkdir(mDirectory.c_str(), 0755);
+#endif
+    }
+}
+
+KernelCache::~KernelCache()
+{
+
+}
+
+unsigned int KernelCache::Add(const KernelDesc& desc)
+{
+    for (unsigned int i = 0; i < mKernels.size(); ++i)
+        if (Equal(mKernels[i].desc, desc))
+            return i;
+
+    Kernel kernel = Kernel();
+    kernel.desc = desc;
+    mKernels.push_back(kernel);
+    return static_cast<unsigned int>(mKernels.size() - 1);
+}
+
+bool KernelCache::Build(JobSystem* jobSystem)
+{
+    long long startTime = Profiler::Now();
+
+    std::vector<Kernel*> kernels;
+    for (Kernel& kernel : mKernels)
+        if (!kernel.built)
+            kernels.push_back(&kernel);
+
+    // One job per kernel, compile times are too uneven to batch.
+    auto buildKernels = [this, &kernels](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+            BuildKernel(*kernels[i]);
+    };
+    if (jobSystem != nullptr)
+        jobSystem->ParallelFor(0, static_cast<unsigned int>(kernels.size()), 1, buildKernels);
+    else
+        buildKernels(0, static_cast<unsigned int>(kernels.size()));
+
+    bool valid = true;
+    for (const Kernel* kernel : kernels)
+    {
+        if (kernel->cached)
+        {
+            ++mStatistics.numHits;
+            mStatistics.loadTime += kernel->buildTime;
+        }
+        else
+        {
+            ++mStatistics.numMisses;
+            mStatistics.compileTime += kernel->buildTime;
+        }
+        if (kernel->blob.empty())
+        {
+            ++mStatistics.numFailures;
+            valid = false;
+        }
+    }
+    mStatistics.buildTime += Profiler::Now() - startTime;
+
+    return valid;
+}
+
+const Kernel& KernelCache::Get(unsigned int id)
+{
+    if (!mKernels[id].built)
+        Build();
+    return mKernels[id];
+}
+
+unsigned int KernelCache::GetNumKernels() const
+{
+    return static_cast<unsigned int>(mKernels.size());
+}
+
+const KernelCache::Statistics& KernelCache::GetStatistics() const
+{
+    return mStatistics;
+}
+
+void KernelCache::PrintStatistics(std::ostream& stream) const
+{
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3)
+        << "Kernels: " << mKernels.size() << ", cached " << mStatistics.numHits << ", compiled " << mStatistics.numMisses << ", failed " << mStatistics.numFailures
+        << ", load " << mStatistics.loadTime / 1e6 << " ms, compile " << mStatistics.compileTime / 1e6 << " ms, total " << mStatistics.buildTime / 1e6 << " ms" << std::endl;
+
+    for (const Kernel& kernel : mKernels)
+        if (kernel.built && kernel.blob.empty())
+            stream << kernel.desc.path << " (" << kernel.desc.entryPoint << ", " << kernel.desc.target << "): " << kernel.error << std::endl;
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+unsigned long long KernelCache::Hash(const std::string& compilerName, const KernelDesc& desc, const std::string& source, const std::vector<std::string>& includeSources)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    unsigned int version = KERNELCACHE_VERSION;
+    HashBytes(hash, &version, sizeof(version));
+    HashString(hash, compilerName);
+    // The path is part of the blob's debug info and keeps equal sources from sharing a cache file.
+    HashString(hash, desc.path);
+    HashString(hash, desc.entryPoint);
+    HashString(hash, desc.target);
+    for (const std::pair<std::string, std::string>& define : desc.defines)
+    {
+        HashString(hash, define.first);
+        HashString(hash, define.second);
+    }
+    HashString(hash, source);
+    for (unsigned int i = 0; i < desc.includes.size(); ++i)
+    {
+        HashString(hash, desc.includes[i]);
+        HashString(hash, includeSources[i]);
+    }
+    return hash;
+}
+
+void KernelCache::BuildKernel(Kernel& kernel) const
+{
+    long long startTime = Profiler::Now();
+    kernel.built = true;
+    kernel.cached = false;
+    kernel.blob.clear();
+    kernel.error.clear();
+
+    std::string source;
+    std::vector<std::string> includeSources(kernel.desc.includes.size());
+    bool read = ReadFile(kernel.desc.path, source);
+    for (unsigned int i = 0; read && i < kernel.desc.includes.size(); ++i)
+        read = ReadFile(kernel.desc.includes[i], includeSources[i]);
+    if (!read)
+    {
+        kernel.error = "Failed to read source";
+        kernel.hashTime = Profiler::Now() - startTime;
+        kernel.buildTime = 0;
+        return;
+    }
+    kernel.hash = Hash(mCompilerName, kernel.desc, source, includeSources);
+
+    long long buildTime = Profiler::Now();
+    kernel.hashTime = buildTime - startTime;
+    if (Load(kernel.hash, kernel.blob))
+    {
+        kernel.cached = true;
+    }
+    else if (mCompile(kernel.desc, source, kernel.blob, kernel.error))
+    {
+        // A failed store only costs a compile on the next start.
+        Store(kernel.hash, kernel.blob);
+    }
+    else
+    {
+        kernel.blob.clear();
+        if (kernel.error.empty())
+            kernel.error = "Compilation failed";
+    }
+    kernel.buildTime = Profiler::Now() - buildTime;
+}
+
+std::string KernelCache::GetPath(unsigned long long hash) const
+{
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", hash);
+    return mDirectory + "/" + name + KERNELCACHE_EXTENSION;
+}
+
+bool KernelCache::Load(unsigned long long hash, std::vector<unsigned char>& blob) const
+{
+    if (mDirectory.empty())
+        return false;
+
+    FILE* file = fopen(GetPath(hash).c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    // Truncated or foreign files are recompiled and overwritten.
+    KernelCacheHeader header;
+    bool valid = fread(&header, sizeof(KernelCacheHeader), 1, file) == 1 &&
+        header.magic == KERNELCACHE_MAGIC &&
+        header.version == KERNELCACHE_VERSION &&
+        header.hash == hash &&
+        header.size > 0;
+    if (valid)
+    {
+        blob.resize(static_cast<size_t>(header.size));
+        valid = fread(blob.data(), 1, blob.size(), file) == blob.size();
+    }
+    fclose(file);
+
+    if (!valid)
+        blob.clear();
+    return valid;
+}
+
+bool KernelCache::Store(unsigned long long hash, const std::vector<unsigned char>& blob) const
+{
+    if (mDirectory.empty())
+        return false;
+
+    std::string path = GetPath(hash);
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    KernelCacheHeader header;
+    header.magic = KERNELCACHE_MAGIC;
+    header.version = KERNELCACHE_VERSION;
+    header.hash = hash;
+    header.size = blob.size();
+    bool written = fwrite(&header, sizeof(KernelCacheHeader), 1, file) == 1 &&
+        fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    written &= fclose(file) == 0;
+
+    // Rename does not replace existing files on Windows.
+    if (written)
+    {
+        remove(path.c_str());
+        written = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!written)
+        remove(temporaryPath.c_str());
+    return written;
+}
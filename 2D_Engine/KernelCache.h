@@ -0,0 +1,145 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+
+// Cached blob file identifier, "KBLB" in a little-endian file.
+#define KERNELCACHE_MAGIC 0x424C424BU
+
+// Cache format version. Increment when the key or file layout changes, stale blobs are then recompiled.
+#define KERNELCACHE_VERSION 2U
+
+// Extension of cached blob files.
+#define KERNELCACHE_EXTENSION ".cso"
+
+// Kernel to compile: source file, entry point, target profile, preprocessor defines and included files.
+struct KernelDesc
+{
+    // Source file path.
+    std::string path;
+    // Entry point function.
+    std::string entryPoint;
+    // Target profile, e.g. cs_5_0.
+    std::string target;
+    // Preprocessor defines as name and value.
+    std::vector<std::pair<std::string, std::string>> defines;
+    // Paths of files the source includes, hashed with the source so edits to them rebuild the kernel.
+    std::vector<std::string> includes;
+};
+
+// Registered kernel and its compiled blob.
+struct Kernel
+{
+    // Kernel description.
+    KernelDesc desc;
+    // Compiled blob, empty if compilation failed.
+    std::vector<unsigned char> blob;
+    // Compiler or file error message.
+    std::string error;
+    // Content hash of compiler, source, entry point, target, defines and includes.
+    unsigned long long hash;
+    // Time spent reading source and hashing in nanoseconds.
+    long long hashTime;
+    // Time spent loading or compiling and storing the blob in nanoseconds.
+    long long buildTime;
+    // Whether blob was loaded from the cache.
+    bool cached;
+    // Whether kernel has been built, successfully or not.
+    bool built;
+};
+
+// Compile kernel source into a blob. Called concurrently from worker threads.
+// desc Kernel description.
+// source Source file contents.
+// blob Compiled blob.
+// error Compiler message on failure.
+// Returns whether compilation succeeded.
+typedef bool (*KernelCompileFunction)(const KernelDesc& desc, const std::string& source, std::vector<unsigned char>& blob, std::string& error);
+
+// Registry of kernels compiled through a backend compile function.
+// Blobs are stored on disk keyed by a hash of the source contents and compile options, so unchanged kernels load
+// instead of compiling. Misses compile in parallel on the job system.
+// Includes are only hashed if listed in KernelDesc::includes, edits to unlisted includes load stale blobs.
+class KernelCache
+{
+    public:
+        // Startup statistics of Build.
+        struct Statistics
+        {
+            // Number of blobs loaded from the cache.
+            unsigned int numHits;
+            // Number of kernels compiled.
+            unsigned int numMisses;
+            // Number of kernels that failed to compile.
+            unsigned int numFailures;
+            // Wall time of Build in nanoseconds.
+            long long buildTime;
+            // Sum of per-kernel compile and store times in nanoseconds.
+            long long compileTime;
+            // Sum of per-kernel load times in nanoseconds.
+            long long loadTime;
+        };
+
+        // Constructor.
+        // compile Backend compile function.
+        // compilerName Name and options of the compiler, part of the key so blobs of other compilers are not loaded.
+        // directory Cache directory, created if missing. Empty to disable the on-disk cache.
+        KernelCache(KernelCompileFunction compile, const std::string& compilerName, const std::string& directory);
+
+        // Destructor.
+        ~KernelCache();
+
+        // Register kernel. Registering an equal description again returns the existing ID.
+        // desc Kernel description.
+        // Returns kernel ID.
+        unsigned int Add(const KernelDesc& desc);
+
+        // Load or compile every registered kernel that has not been built.
+        // jobSystem Job system to build kernels in parallel, nullptr to build on the calling thread.
+        // Returns whether every kernel has a blob.
+        bool Build(JobSystem* jobSystem = nullptr);
+
+        // Get kernel. Builds the kernel on the calling thread if Build has not.
+        // id Kernel ID returned by Add.
+        const Kernel& Get(unsigned int id);
+
+        // Get number of registered kernels.
+        unsigned int GetNumKernels() const;
+
+        // Get statistics of all Build calls.
+        const Statistics& GetStatistics() const;
+
+        // Print statistics and errors of failed kernels.
+        // stream Output stream.
+        void PrintStatistics(std::ostream& stream) const;
+
+        // Hash kernel as used for the cache key.
+        // compilerName Compiler name and options.
+        // desc Kernel description.
+        // source Source file contents.
+        // includeSources Contents of the files listed in desc.includes.
+        static unsigned long long Hash(const std::string& compilerName, const KernelDesc& desc, const std::string& source, const std::vector<std::string>& includeSources);
+
+    private:
+        // Hash source and load blob from the cache or compile and store it.
+        void BuildKernel(Kernel& kernel) const;
+
+        // Get cache file path of hash.
+        std::string GetPath(unsigned long long hash) const;
+
+        // Read cached blob.
+        bool Load(unsigned long long hash, std::vector<unsigned char>& blob) const;
+
+        // Write blob to the cache.
+        bool Store(unsigned long long hash, const std::vector<unsigned char>& blob) const;
+
+        KernelCompileFunction mCompile;
+        std::string mCompilerName;
+        std::string mDirectory;
+        std::vector<Kernel> mKernels;
+        Statistics mStatistics;
+};
@@ -0,0 +1,114 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    mData = nullptr;
+    mSize = 0;
+#ifdef _WIN32
+    mFile = INVALID_HANDLE_VALUE;
+    mMapping = NULL;
+#else
+    mFile = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mMapping == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    mData = MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+    if (mData == nullptr)
+    {
+        Close();
+        return false;
+    }
+    mSize = static_cast<std::size_t>(size.QuadPart);
+#else
+    mFile = open(path.c_str(), O_RDONLY);
+    if (mFile < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(mFile, &status) != 0 || status.st_size == 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, mFile, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    mData = data;
+    mSize = static_cast<std::size_t>(status.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != NULL)
+        CloseHandle(mMapping);
+    if (mFile != INVALID_HANDLE_VALUE)
+        CloseHandle(mFile);
+    mMapping = NULL;
+    mFile = INVALID_HANDLE_VALUE;
+#else
+    if (mData != nullptr)
+        munmap(const_cast<void*>(mData), mSize);
+    if (mFile >= 0)
+        close(mFile);
+    mFile = -1;
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
+
+const void* MappedFile::GetData() const
+{
+    return mData;
+}
+
+std::size_t MappedFile::GetSize() const
+{
+    return mSize;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapped file.
+class MappedFile
+{
+    public:
+        // Constructor.
+        MappedFile();
+
+        // Destructor. Unmaps file.
+        ~MappedFile();
+
+        // Map file. Maps the whole file read-only, a mapped file is closed first.
+        // path File path.
+        // Returns whether file could be mapped.
+        bool Open(const std::string& path);
+
+        // Unmap file.
+        void Close();
+
+        // Get mapped data, nullptr if no file is mapped.
+        const void* GetData() const;
+
+        // Get size of mapped data in bytes.
+        std::size_t GetSize() const;
+
+    private:
+        const void* mData;
+        std::size_t mSize;
+#ifdef _WIN32
+        void* mFile;
+        void* mMapping;
+#else
+        int mFile;
+#endif
+};
@@ -1,6 +1,63 @@
 #include "MathFunctions.h"
+#include <algorithm>
+#include <cmath>
 #include <glm/gtc/quaternion.hpp>
 
+// SSE2 is part of every x64 target, 32-bit builds need /arch:SSE2 or -msse2. Other targets use the scalar loops.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATHFUNCTIONS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+#ifdef MATHFUNCTIONS_SSE
+    // Dot product of four quaternions, summed in the order of DotQuat.
+    inline __m128 DotQuats4(__m128 x1, __m128 y1, __m128 z1, __m128 w1, __m128 x2, __m128 y2, __m128 z2, __m128 w2) {
+        return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x2), _mm_mul_ps(y1, y2)), _mm_mul_ps(z1, z2)), _mm_mul_ps(w1, w2));
+    }
+
+    // Normalize four quaternions as NormalizeQuat. No float lies between 0.00001f and the double 0.00001
+    // NormalizeQuat compares with, so greater than 0.00001f is the same test.
+    inline void NormalizeQuats4(__m128& x, __m128& y, __m128& z, __m128& w) {
+        __m128 d = _mm_sqrt_ps(DotQuats4(x, y, z, w, x, y, z, w));
+        __m128 valid = _mm_cmpgt_ps(d, _mm_set1_ps(0.00001f));
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), d);
+        x = _mm_and_ps(valid, _mm_mul_ps(x, inv));
+        y = _mm_and_ps(valid, _mm_mul_ps(y, inv));
+        z = _mm_and_ps(valid, _mm_mul_ps(z, inv));
+        w = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(w, inv)), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+    }
+
+    // a.yzx * b.zxy - a.zxy * b.yzx, the w component is 0 when both w are.
+    inline __m128 Cross(__m128 a, __m128 b) {
+        __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+        return _mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX));
+    }
+
+    // x + y + z of a vector, summed left to right.
+    inline float Sum3(__m128 v) {
+        __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+        return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(v, y), z));
+    }
+
+    inline void StoreMat3Column(__m128 column, float* result) {
+        float values[4];
+        _mm_storeu_ps(values, column);
+        result[0] = values[0];
+        result[1] = values[1];
+        result[2] = values[2];
+    }
+#endif
+
+    inline glm::vec3 Cross(const glm::vec3& a, const glm::vec3& b) {
+        return glm::vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+    }
+}
+
 void Geometry::MixVec(const glm::vec3& v1, const glm::vec3& v2, float t, glm::vec3& result) {
     result.x = v1.x + t * (v2.x - v1.x);
     result.y = v1.y + t * (v2.y - v1.y);
@@ -147,3 +204,192 @@ void Geometry::CpyQuat(glm::quat &glmQuat, const aiQuaternion& aiQuat) {
     glmQuat.z = aiQuat.z;
     glmQuat.w = aiQuat.w;
 }
+
+void Geometry::MixQuats(const float* const q1[4], const float* const q2[4], const float* t, float* const result[4], std::size_t count) {
+    std::size_t i = 0;
+#ifdef MATHFUNCTIONS_SSE
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x1 = _mm_loadu_ps(q1[0] + i), y1 = _mm_loadu_ps(q1[1] + i), z1 = _mm_loadu_ps(q1[2] + i), w1 = _mm_loadu_ps(q1[3] + i);
+        __m128 x2 = _mm_loadu_ps(q2[0] + i), y2 = _mm_loadu_ps(q2[1] + i), z2 = _mm_loadu_ps(q2[2] + i), w2 = _mm_loadu_ps(q2[3] + i);
+        __m128 factor = _mm_loadu_ps(t + i);
+
+        // Negate q1 where the dot product is negative.
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(DotQuats4(x1, y1, z1, w1, x2, y2, z2, w2), _mm_setzero_ps()), signBit);
+        x1 = _mm_xor_ps(x1, flip);
+        y1 = _mm_xor_ps(y1, flip);
+        z1 = _mm_xor_ps(z1, flip);
+        w1 = _mm_xor_ps(w1, flip);
+
+        __m128 x = _mm_add_ps(x1, _mm_mul_ps(factor, _mm_sub_ps(x2, x1)));
+        __m128 y = _mm_add_ps(y1, _mm_mul_ps(factor, _mm_sub_ps(y2, y1)));
+        __m128 z = _mm_add_ps(z1, _mm_mul_ps(factor, _mm_sub_ps(z2, z1)));
+        __m128 w = _mm_add_ps(w1, _mm_mul_ps(factor, _mm_sub_ps(w2, w1)));
+        NormalizeQuats4(x, y, z, w);
+        _mm_storeu_ps(result[0] + i, x);
+        _mm_storeu_ps(result[1] + i, y);
+        _mm_storeu_ps(result[2] + i, z);
+        _mm_storeu_ps(result[3] + i, w);
+    }
+#endif
+    for (; i < count; ++i) {
+        glm::quat mixed;
+        MixQuat(glm::quat(q1[3][i], q1[0][i], q1[1][i], q1[2][i]), glm::quat(q2[3][i], q2[0][i], q2[1][i], q2[2][i]), t[i], mixed);
+        result[0][i] = mixed.x;
+        result[1][i] = mixed.y;
+        result[2][i] = mixed.z;
+        result[3][i] = mixed.w;
+    }
+}
+
+void Geometry::SlerpQuats(const float* const q1[4], const float* const q2[4], const float* t, float* const result[4], std::size_t count) {
+    // SSE has no trigonometry, so this is a plain loop kept free of branches for the compiler to vectorize.
+    for (std::size_t i = 0; i < count; ++i) {
+        const float start[4] = { q1[0][i], q1[1][i], q1[2][i], q1[3][i] };
+        const float end[4] = { q2[0][i], q2[1][i], q2[2][i], q2[3][i] };
+        float cosom = start[0] * end[0] + start[1] * end[1] + start[2] * end[2] + start[3] * end[3];
+        // Take the short way around.
+        float sign = cosom < 0.0f ? -1.0f : 1.0f;
+        cosom *= sign;
+        // Nearly equal rotations interpolate linearly, both branches are evaluated so the loop stays branch free.
+        float omega = std::acos(std::min(cosom, 1.0f));
+        float sinom = std::sin(omega);
+        bool slerp = 1.0f - cosom > 0.0001f;
+        float sclp = slerp ? std::sin((1.0f - t[i]) * omega) / sinom : 1.0f - t[i];
+        float sclq = (slerp ? std::sin(t[i] * omega) / sinom : t[i]) * sign;
+        float value[4];
+        for (unsigned int c = 0; c < 4; ++c)
+            value[c] = sclp * start[c] + sclq * end[c];
+
+        float magnitude = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2] + value[3] * value[3]);
+        float invMagnitude = magnitude != 0.0f ? 1.0f / magnitude : 1.0f;
+        for (unsigned int c = 0; c < 4; ++c)
+            result[c][i] = value[c] * invMagnitude;
+    }
+}
+
+void Geometry::NormalizeQuats(float* const q[4], std::size_t count) {
+    std::size_t i = 0;
+#ifdef MATHFUNCTIONS_SSE
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(q[0] + i), y = _mm_loadu_ps(q[1] + i), z = _mm_loadu_ps(q[2] + i), w = _mm_loadu_ps(q[3] + i);
+        NormalizeQuats4(x, y, z, w);
+        _mm_storeu_ps(q[0] + i, x);
+        _mm_storeu_ps(q[1] + i, y);
+        _mm_storeu_ps(q[2] + i, z);
+        _mm_storeu_ps(q[3] + i, w);
+    }
+#endif
+    for (; i < count; ++i) {
+        glm::quat normalized(q[3][i], q[0][i], q[1][i], q[2][i]);
+        NormalizeQuat(normalized);
+        q[0][i] = normalized.x;
+        q[1][i] = normalized.y;
+        q[2][i] = normalized.z;
+        q[3][i] = normalized.w;
+    }
+}
+
+void Geometry::ComposeMatrices(const float* const p[3], const float* const r[4], const float* const s[3], glm::mat4* m, std::size_t count) {
+    std::size_t i = 0;
+#ifdef MATHFUNCTIONS_SSE
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(r[0] + i), y = _mm_loadu_ps(r[1] + i), z = _mm_loadu_ps(r[2] + i), w = _mm_loadu_ps(r[3] + i);
+
+        // Elements of ComposeMatrix, in its order of operations.
+        __m128 rotation[3][3];
+        rotation[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+        rotation[0][1] = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, y), _mm_mul_ps(z, w)));
+        rotation[0][2] = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, z), _mm_mul_ps(y, w)));
+        rotation[1][0] = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, y), _mm_mul_ps(z, w)));
+        rotation[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z))));
+        rotation[1][2] = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(y, z), _mm_mul_ps(x, w)));
+        rotation[2][0] = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(x, z), _mm_mul_ps(y, w)));
+        rotation[2][1] = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(y, z), _mm_mul_ps(x, w)));
+        rotation[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+
+        // Column c of the four matrices is the transpose of its four element vectors.
+        for (unsigned int c = 0; c < 3; ++c) {
+            __m128 scale = _mm_loadu_ps(s[c] + i);
+            __m128 row0 = _mm_mul_ps(rotation[c][0], scale);
+            __m128 row1 = _mm_mul_ps(rotation[c][1], scale);
+            __m128 row2 = _mm_mul_ps(rotation[c][2], scale);
+            __m128 row3 = _mm_loadu_ps(p[c] + i);
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+            _mm_storeu_ps(&m[i][c][0], row0);
+            _mm_storeu_ps(&m[i + 1][c][0], row1);
+            _mm_storeu_ps(&m[i + 2][c][0], row2);
+            _mm_storeu_ps(&m[i + 3][c][0], row3);
+        }
+        for (unsigned int j = 0; j < 4; ++j)
+            m[i + j][3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+#endif
+    for (; i < count; ++i) {
+        glm::quat rotation(r[3][i], r[0][i], r[1][i], r[2][i]);
+        ComposeMatrix(glm::vec3(p[0][i], p[1][i], p[2][i]), rotation, glm::vec3(s[0][i], s[1][i], s[2][i]), m[i]);
+    }
+}
+
+void Geometry::InverseTransposeAffine(const glm::mat4* m, glm::mat3* result, std::size_t count, bool uniformScale) {
+    // The inverse transpose of columns c0, c1, c2 is (c1 x c2, c2 x c0, c0 x c1) / determinant, of a rotation times
+    // a uniform scale it is the matrix divided by the squared scale.
+#ifdef MATHFUNCTIONS_SSE
+    const __m128 columnMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    for (std::size_t i = 0; i < count; ++i) {
+        __m128 c0 = _mm_and_ps(_mm_loadu_ps(&m[i][0][0]), columnMask);
+        __m128 c1 = _mm_and_ps(_mm_loadu_ps(&m[i][1][0]), columnMask);
+        __m128 c2 = _mm_and_ps(_mm_loadu_ps(&m[i][2][0]), columnMask);
+        __m128 r0, r1, r2;
+        if (uniformScale) {
+            __m128 inv = _mm_set1_ps(1.0f / Sum3(_mm_mul_ps(c0, c0)));
+            r0 = _mm_mul_ps(c0, inv);
+            r1 = _mm_mul_ps(c1, inv);
+            r2 = _mm_mul_ps(c2, inv);
+        } else {
+            r0 = Cross(c1, c2);
+            r1 = Cross(c2, c0);
+            r2 = Cross(c0, c1);
+            __m128 inv = _mm_set1_ps(1.0f / Sum3(_mm_mul_ps(c0, r0)));
+            r0 = _mm_mul_ps(r0, inv);
+            r1 = _mm_mul_ps(r1, inv);
+            r2 = _mm_mul_ps(r2, inv);
+        }
+        StoreMat3Column(r0, &result[i][0][0]);
+        StoreMat3Column(r1, &result[i][1][0]);
+        StoreMat3Column(r2, &result[i][2][0]);
+    }
+#else
+    for (std::size_t i = 0; i < count; ++i) {
+        const glm::vec3 c0(m[i][0]), c1(m[i][1]), c2(m[i][2]);
+        if (uniformScale) {
+            float inv = 1.0f / (c0.x * c0.x + c0.y * c0.y + c0.z * c0.z);
+            result[i] = glm::mat3(c0 * inv, c1 * inv, c2 * inv);
+        } else {
+            const glm::vec3 r0 = Cross(c1, c2);
+            float inv = 1.0f / (c0.x * r0.x + c0.y * r0.y + c0.z * r0.z);
+            result[i] = glm::mat3(r0 * inv, Cross(c2, c0) * inv, Cross(c0, c1) * inv);
+        }
+    }
+#endif
+}
+
+bool Geometry::IsUniformScale(const glm::mat3& m, float tolerance) {
+    float lengths[3];
+    for (unsigned int c = 0; c < 3; ++c)
+        lengths[c] = glm::length(m[c]);
+    if (lengths[0] == 0.0f)
+        return false;
+    for (unsigned int c = 1; c < 3; ++c) {
+        if (std::abs(lengths[c] - lengths[0]) > tolerance * lengths[0])
+            return false;
+    }
+    for (unsigned int c = 0; c < 3; ++c) {
+        const glm::vec3& a = m[c];
+        const glm::vec3& b = m[(c + 1) % 3];
+        if (std::abs(glm::dot(a, b)) > tolerance * lengths[c] * lengths[(c + 1) % 3])
+            return false;
+    }
+    return true;
+}
@@ -5,6 +5,7 @@
 #include <assimp/matrix3x3.h>
 #include <assimp/matrix4x4.h>
 #include <assimp/quaternion.h>
+#include <cstddef>
 #include <glm/glm.hpp>
 
 namespace Geometry {
@@ -56,6 +57,66 @@ namespace Geometry {
     */
     void QuatToMat(glm::mat4& m, const glm::quat& q);
 
+    /// Mix arrays of quaternions, as MixQuat per element.
+    /**
+    * Quaternions are in structure of arrays form, one array of count floats per component x, y, z and w.
+    * Results equal MixQuat.
+    * @param q1 First quaternions.
+    * @param q2 Second quaternions.
+    * @param t Mix factors.
+    * @param result Mixed quaternions, may alias q1 or q2.
+    * @param count Number of quaternions.
+    */
+    void MixQuats(const float* const q1[4], const float* const q2[4], const float* t, float* const result[4], std::size_t count);
+
+    /// Spherically interpolate arrays of quaternions, as aiQuaternion::Interpolate followed by Normalize per element.
+    /**
+    * Quaternions are in structure of arrays form, one array of count floats per component x, y, z and w.
+    * @param q1 First quaternions.
+    * @param q2 Second quaternions.
+    * @param t Interpolation factors.
+    * @param result Interpolated quaternions, may alias q1 or q2.
+    * @param count Number of quaternions.
+    */
+    void SlerpQuats(const float* const q1[4], const float* const q2[4], const float* t, float* const result[4], std::size_t count);
+
+    /// Normalize array of quaternions, as NormalizeQuat per element.
+    /**
+    * @param q Quaternions in structure of arrays form, one array of count floats per component x, y, z and w.
+    * @param count Number of quaternions.
+    */
+    void NormalizeQuats(float* const q[4], std::size_t count);
+
+    /// Create matrices from arrays of positions, rotations and scales, as ComposeMatrix per element.
+    /**
+    * Inputs are in structure of arrays form, one array of count floats per component.
+    * @param p Positions.
+    * @param r Rotations.
+    * @param s Scales.
+    * @param m Transform matrices, count elements.
+    * @param count Number of matrices.
+    */
+    void ComposeMatrices(const float* const p[3], const float* const r[4], const float* const s[3], glm::mat4* m, std::size_t count);
+
+    /// Calculate inverse transpose of the upper 3x3 of affine matrices.
+    /**
+    * Matches glm::mat3(glm::transpose(glm::inverse(m))) for matrices whose row 3 is (0, 0, 0, 1).
+    * @param m Affine matrices.
+    * @param result Inverse transpose matrices.
+    * @param count Number of matrices.
+    * @param uniformScale All matrices are a rotation times a uniform scale, the inverse transpose is then the matrix
+    * divided by its squared scale.
+    */
+    void InverseTransposeAffine(const glm::mat4* m, glm::mat3* result, std::size_t count, bool uniformScale);
+
+    /// Check if matrix is a rotation times a uniform scale.
+    /**
+    * @param m Matrix.
+    * @param tolerance Max relative difference of column lengths and max cosine between columns.
+    * @return Whether scale is uniform.
+    */
+    bool IsUniformScale(const glm::mat3& m, float tolerance);
+
     /// Convert from assimp quaternion to glm quaternion.
     /**
     * @param glmQuat Glm quaternion.
@@ -1,30 +1,56 @@
 #include "ParticleCloudSorter.h"
 
+#include "D3DKernelCompiler.h"
 #include "DxAssert.h"
 #include "DxHelp.h"
+#include "GPUWorkCounters.h"
 
-ParticleCloudSorter::ParticleCloudSorter(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+namespace
+{
+    // Sort compute shaders.
+    const char* SORT_KERNEL_PATHS[] = { "ParticleClouds_Sort_01_CS.hlsl", "ParticleClouds_Sort_02_CS.hlsl", "ParticleClouds_Sort_03_CS.hlsl" };
+
+    // Sort compute shader.
+    // path Source file path.
+    KernelDesc CreateSortKernelDesc(const char* path)
+    {
+        KernelDesc desc;
+        desc.path = path;
+        desc.entryPoint = "main";
+        desc.target = "cs_5_0";
+        GPUWorkCounters::AddKernelOptions(desc);
+        return desc;
+    }
+}
+
+ParticleCloudSorter::ParticleCloudSorter(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
 
     // Create buffers.
-    Initialise();
+    Initialise(kernelCache);
 }
 
 ParticleCloudSorter::~ParticleCloudSorter()
 {
-    mMetaDataBuffer->Release();
+    delete mMetaDataHeap;
     mParticleCloudSort01CS->Release();
     mParticleCloudSort02CS->Release();
     mParticleCloudSort03CS->Release();
 }
 
-void ParticleCloudSorter::Bind(ID3D11ShaderResourceView* sourceBuffer, ID3D11UnorderedAccessView* targetBuffer, ID3D11ComputeShader* computeShader)
+void ParticleCloudSorter::AddKernels(KernelCache& kernelCache)
+{
+    for (const char* path : SORT_KERNEL_PATHS)
+        kernelCache.Add(CreateSortKernelDesc(path));
+}
+
+void ParticleCloudSorter::Bind(ID3D11ShaderResourceView* sourceBuffer, ID3D11UnorderedAccessView* targetBuffer, ID3D11ComputeShader* computeShader, ID3D11ShaderResourceView* metaData)
 {
     mpDeviceContext->CSSetShader(computeShader, NULL, NULL);
     mpDeviceContext->CSSetShaderResources(0, 1, &sourceBuffer);
-    mpDeviceContext->CSSetShaderResources(1, 1, &mMetaDataBuffer);
+    mpDeviceContext->CSSetShaderResources(1, 1, &metaData);
     mpDeviceContext->CSSetUnorderedAccessViews(0, 1, &targetBuffer, NULL);
 }
 
@@ -37,110 +63,90 @@ void ParticleCloudSorter::Unbind()
     mpDeviceContext->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)p, NULL);
 }
 
-void ParticleCloudSorter::Sort(Scene& scene)
+void ParticleCloudSorter::Sort(Scene& scene, FrameArena& frameArena)
 {
-    unsigned int numClouds = scene.mMaxNumParticleClouds;
+    unsigned int numClouds = scene.mNumParticleClouds;
 
     unsigned int numThreads = RoofPow2(numClouds) / 2;
-
-    mMetaData.numClouds = numClouds;
-    mMetaData.numThreads = numThreads;
-    mMetaData.init = true;
+    assert(scene.mParticleCloudsGPUSwapBuffer->GetCapacity() >= GetCapacity(numClouds));
+
+    // Stage passes. Init stays set until the first TONIC INIT pass has run.
+    MetaData* metaData = frameArena.Allocate<MetaData>(PARTICLECLOUDSORTER_MAX_PASSES);
+    ID3D11ComputeShader** shaders = frameArena.Allocate<ID3D11ComputeShader*>(PARTICLECLOUDSORTER_MAX_PASSES);
+    unsigned int numPasses = 0;
+    bool init = true;
+    auto addPass = [&](unsigned int step, ID3D11ComputeShader* computeShader)
+    {
+        metaData[numPasses].step = step;
+        metaData[numPasses].numClouds = numClouds;
+        metaData[numPasses].numThreads = numThreads;
+        metaData[numPasses].init = init;
+        shaders[numPasses] = computeShader;
+        ++numPasses;
+    };
 
     // TONIC INIT
     for (unsigned int step = 1; step <= numThreads / 4; step *= 2)
     {
-        // Swap buffers.
-        scene.mParticleCloudsGPUSwapBuffer->Swap();
-
-        // Update meta buffer.
-        mMetaData.step = step;
-        DxHelp::WriteStructuredBuffer<MetaData>(mpDeviceContext, &mMetaData, 1, mMetaDataBuffer);
-
-        Bind(scene.mParticleCloudsGPUSwapBuffer->GetSourceBuffer(), scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), mParticleCloudSort01CS);
-
-        mpDeviceContext->Dispatch(numThreads / 256 + 1, 1, 1);
-
-        Unbind();
-
-        // Update init.
-        mMetaData.init = false;
+        addPass(step, mParticleCloudSort01CS);
+        init = false;
     }
 
     // TONIC SWAP
     for (unsigned int step = numThreads / 2; step >= 1; step /= 2)
-    {
-        // Swap buffers.
-        scene.mParticleCloudsGPUSwapBuffer->Swap();
+        addPass(step, mParticleCloudSort02CS);
 
-        // Update meta buffer.
-        mMetaData.step = step;
-        DxHelp::WriteStructuredBuffer<MetaData>(mpDeviceContext, &mMetaData, 1, mMetaDataBuffer);
+    // TONIC MERGE
+    for (unsigned int step = numThreads; step >= 1; step /= 2)
+        addPass(step, mParticleCloudSort03CS);
 
-        Bind(scene.mParticleCloudsGPUSwapBuffer->GetSourceBuffer(), scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), mParticleCloudSort02CS);
+    assert(numPasses <= PARTICLECLOUDSORTER_MAX_PASSES);
+    if (numPasses == 0)
+        return;
 
-        mpDeviceContext->Dispatch(numThreads / 256 + 1, 1, 1);
+    // Update meta buffer.
+    mMetaDataHeap->Upload(metaData, numPasses);
 
-        Unbind();
-    }
+#if WORK_COUNTERS
+    ID3D11UnorderedAccessView* workCounters = scene.mWorkCounters->GetBuffer();
+    mpDeviceContext->CSSetUnorderedAccessViews(1, 1, &workCounters, NULL);
+#endif
 
-    // TONIC MERGE
-    for (unsigned int step = numThreads; step >= 1; step /= 2)
+    for (unsigned int pass = 0; pass < numPasses; ++pass)
     {
         // Swap buffers.
         scene.mParticleCloudsGPUSwapBuffer->Swap();
 
-        // Update meta buffer.
-        mMetaData.step = step;
-        DxHelp::WriteStructuredBuffer<MetaData>(mpDeviceContext, &mMetaData, 1, mMetaDataBuffer);
-
-        Bind(scene.mParticleCloudsGPUSwapBuffer->GetSourceBuffer(), scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), mParticleCloudSort03CS);
+        Bind(scene.mParticleCloudsGPUSwapBuffer->GetSourceBuffer(), scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), shaders[pass], mMetaDataHeap->GetView(pass));
 
         mpDeviceContext->Dispatch(numThreads / 256 + 1, 1, 1);
 
         Unbind();
     }
+
+#if WORK_COUNTERS
+    void *const p[1] = { NULL };
+    mpDeviceContext->CSSetUnorderedAccessViews(1, 1, (ID3D11UnorderedAccessView**)p, NULL);
+#endif
 }
 
-void ParticleCloudSorter::Initialise()
+void ParticleCloudSorter::Initialise(KernelCache& kernelCache)
 {
-    // Create meta buffer.
-    DxHelp::CreateCPUwriteGPUreadStructuredBuffer<MetaData>(mpDevice, 1, &mMetaDataBuffer);
-
-    // Create compute shader.
-    ID3DBlob* errorBlob = nullptr;
-    ID3DBlob* shaderBlob = nullptr;
-    HRESULT hr;
-        
-    hr = D3DCompileFromFile(L"ParticleClouds_Sort_01_CS.hlsl", nullptr, nullptr, "main", "cs_5_0", 0, NULL, &shaderBlob, &errorBlob);
-    if (FAILED(hr))
-    {
-        char* errorMsg = (char*)errorBlob->GetBufferPointer();
-        OutputDebugStringA(errorMsg);
-        shaderBlob->Release();
-    }
-    DxAssert(mpDevice->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &mParticleCloudSort01CS), S_OK);
-    shaderBlob->Release();
+    // Create meta buffer, one slot per pass.
+    mMetaDataHeap = new UploadHeap<MetaData>(mpDevice, mpDeviceContext, PARTICLECLOUDSORTER_MAX_PASSES);
 
-    hr = D3DCompileFromFile(L"ParticleClouds_Sort_02_CS.hlsl", nullptr, nullptr, "main", "cs_5_0", 0, NULL, &shaderBlob, &errorBlob);
-    if (FAILED(hr))
+    // Create compute shaders.
+    ID3D11ComputeShader** shaders[] = { &mParticleCloudSort01CS, &mParticleCloudSort02CS, &mParticleCloudSort03CS };
+    for (unsigned int i = 0; i < 3; ++i)
     {
-        char* errorMsg = (char*)errorBlob->GetBufferPointer();
-        OutputDebugStringA(errorMsg);
-        shaderBlob->Release();
+        const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateSortKernelDesc(SORT_KERNEL_PATHS[i])));
+        DxAssert(D3DKernelCompiler::CreateComputeShader(mpDevice, kernel, shaders[i]), true);
     }
-    DxAssert(mpDevice->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &mParticleCloudSort02CS), S_OK);
-    shaderBlob->Release();
+}
 
-    hr = D3DCompileFromFile(L"ParticleClouds_Sort_03_CS.hlsl", nullptr, nullptr, "main", "cs_5_0", 0, NULL, &shaderBlob, &errorBlob);
-    if (FAILED(hr))
-    {
-        char* errorMsg = (char*)errorBlob->GetBufferPointer();
-        OutputDebugStringA(errorMsg);
-        shaderBlob->Release();
-    }
-    DxAssert(mpDevice->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &mParticleCloudSort03CS), S_OK);
-    shaderBlob->Release();
+unsigned int ParticleCloudSorter::GetCapacity(unsigned int numClouds)
+{
+    return numClouds > 1 ? RoofPow2(numClouds) : 1;
 }
 
 unsigned int ParticleCloudSorter::RoofPow2(unsigned int v)
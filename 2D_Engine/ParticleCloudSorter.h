@@ -7,9 +7,15 @@
 
 #include <glm/glm.hpp>
 
+#include "KernelCache.h"
 #include "Particle.h"
 #include "Camera.h"
+#include "FrameArena.h"
 #include "Scene.h"
+#include "UploadHeap.h"
+
+// Max number of sort passes, enough for 2^32 clouds.
+#define PARTICLECLOUDSORTER_MAX_PASSES 96U
 
 class ParticleCloudSorter
 {
@@ -17,14 +23,25 @@ class ParticleCloudSorter
         // Constructor.
         // pDevice Pointer to D3D11 device.
         // pDeviceContext Pointer to D3D11 device context.
-        ParticleCloudSorter(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+        // kernelCache Kernel cache holding the kernels registered by AddKernels.
+        ParticleCloudSorter(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache);
 
         // Destructor.
         ~ParticleCloudSorter();
 
-        // Sort clouds.
+        // Register kernels, so they are built together with the kernels of other systems.
+        // kernelCache Kernel cache.
+        static void AddKernels(KernelCache& kernelCache);
+
+        // Sort clouds. Meta data of all passes is staged in the frame arena and uploaded with one map.
         // scene Scene to sort.
-        void Sort(Scene& scene);
+        // frameArena Arena of the current frame.
+        void Sort(Scene& scene, FrameArena& frameArena);
+
+        // Get number of elements a particle cloud buffer needs to sort numClouds clouds. Bitonic passes read and write
+        // every element up to the next power of two, the first pass fills elements past numClouds with sentinels.
+        // numClouds Number of live particle clouds.
+        static unsigned int GetCapacity(unsigned int numClouds);
 
         // MetaData.
         struct MetaData
@@ -33,28 +50,30 @@ class ParticleCloudSorter
             unsigned int numClouds;
             unsigned int numThreads;
             bool init;
-        } mMetaData;
+        };
 
     private:
         // Initialise buffers and compute shader.
-        void Initialise();
+        // kernelCache Kernel cache.
+        void Initialise(KernelCache& kernelCache);
 
         // Bind pipeline.
         // sourceBuffer Buffer to read from.
         // targetBuffer Buffer to write to.
         // computeShader Shader to use.
-        void Bind(ID3D11ShaderResourceView* sourceBuffer, ID3D11UnorderedAccessView* targetBuffer, ID3D11ComputeShader* computeShader);
+        // metaData Meta data of the pass.
+        void Bind(ID3D11ShaderResourceView* sourceBuffer, ID3D11UnorderedAccessView* targetBuffer, ID3D11ComputeShader* computeShader, ID3D11ShaderResourceView* metaData);
 
         // Unbind pipeline.
         void Unbind();
 
         // Returns closest factor to pow 2.
-        unsigned int RoofPow2(unsigned int v);
+        static unsigned int RoofPow2(unsigned int v);
 
         ID3D11Device* mpDevice;
         ID3D11DeviceContext* mpDeviceContext;
         ID3D11ComputeShader* mParticleCloudSort01CS;
         ID3D11ComputeShader* mParticleCloudSort02CS;
         ID3D11ComputeShader* mParticleCloudSort03CS;
-        ID3D11ShaderResourceView* mMetaDataBuffer;
+        UploadHeap<MetaData>* mMetaDataHeap;
 };
@@ -1,13 +1,29 @@
 #include "ParticleCloudSystem.h"
 
+#include "D3DKernelCompiler.h"
 #include "DxHelp.h"
+#include "GPUWorkCounters.h"
 
-ParticleCloudSystem::ParticleCloudSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+namespace
+{
+    // Update compute shader.
+    KernelDesc CreateUpdateKernelDesc()
+    {
+        KernelDesc desc;
+        desc.path = "ParticleClouds_Update_CS.hlsl";
+        desc.entryPoint = "main";
+        desc.target = "cs_5_0";
+        GPUWorkCounters::AddKernelOptions(desc);
+        return desc;
+    }
+}
+
+ParticleCloudSystem::ParticleCloudSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
 
-    Initialise();
+    Initialise(kernelCache);
 }
 
 ParticleCloudSystem::~ParticleCloudSystem()
@@ -16,6 +32,11 @@ ParticleCloudSystem::~ParticleCloudSystem()
     mMetaDataBuffer->Release();
 }
 
+void ParticleCloudSystem::AddKernels(KernelCache& kernelCache)
+{
+    kernelCache.Add(CreateUpdateKernelDesc());
+}
+
 void ParticleCloudSystem::Bind(ID3D11ShaderResourceView** sourceBuffer, unsigned int numSRVs, ID3D11UnorderedAccessView** targetBuffer, unsigned int numUAVs)
 {
     mpDeviceContext->CSSetShader(mParticleUpdateCS, NULL, NULL);
@@ -40,7 +61,7 @@ void ParticleCloudSystem::Update(Scene& scene, float dt)
     scene.mParticleCloudsGPUSwapBuffer->Swap();
     scene.mParticlesGPUSwapBuffer->Swap();
 
-    unsigned int numClouds = scene.mMaxNumParticleClouds;
+    unsigned int numClouds = scene.mNumParticleClouds;
 
     // Update meta buffer.
     mMetaData.dt = dt;
@@ -48,29 +69,26 @@ void ParticleCloudSystem::Update(Scene& scene, float dt)
     DxHelp::WriteStructuredBuffer<MetaData>(mpDeviceContext, &mMetaData, 1, mMetaDataBuffer);
 
     ID3D11ShaderResourceView* SRVs[2] = { scene.mParticleCloudsGPUSwapBuffer->GetSourceBuffer(), scene.mParticlesGPUSwapBuffer->GetSourceBuffer() };
+#if WORK_COUNTERS
+    ID3D11UnorderedAccessView* UAVs[3] = { scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), scene.mParticlesGPUSwapBuffer->GetTargetBuffer(), scene.mWorkCounters->GetBuffer() };
+    unsigned int numUAVs = 3;
+#else
     ID3D11UnorderedAccessView* UAVs[2] = { scene.mParticleCloudsGPUSwapBuffer->GetTargetBuffer(), scene.mParticlesGPUSwapBuffer->GetTargetBuffer() };
-    Bind(SRVs, 2, UAVs, 2);
+    unsigned int numUAVs = 2;
+#endif
+    Bind(SRVs, 2, UAVs, numUAVs);
 
     mpDeviceContext->Dispatch(numClouds / 256 + 1, 1, 1);
 
-    Unbind(2, 2);
+    Unbind(2, numUAVs);
 }
 
-void ParticleCloudSystem::Initialise()
+void ParticleCloudSystem::Initialise(KernelCache& kernelCache)
 {
     // Create meta buffer.
     DxHelp::CreateCPUwriteGPUreadStructuredBuffer<MetaData>(mpDevice, 1, &mMetaDataBuffer);
 
     // Create compute shader.
-    ID3DBlob* errorBlob = nullptr;
-    ID3DBlob* shaderBlob = nullptr;
-    HRESULT hr = D3DCompileFromFile(L"ParticleClouds_Update_CS.hlsl", nullptr, nullptr, "main", "cs_5_0", 0, NULL, &shaderBlob, &errorBlob);
-    if (FAILED(hr))
-    {
-        char* errorMsg = (char*)errorBlob->GetBufferPointer();
-        OutputDebugStringA(errorMsg);
-        shaderBlob->Release();
-    }
-    DxAssert(mpDevice->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &mParticleUpdateCS), S_OK);
-    shaderBlob->Release();
+    const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateUpdateKernelDesc()));
+    DxAssert(D3DKernelCompiler::CreateComputeShader(mpDevice, kernel, &mParticleUpdateCS), true);
 }
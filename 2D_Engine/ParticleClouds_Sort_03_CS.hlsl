@@ -30,6 +30,10 @@ StructuredBuffer<MetaData> g_MetaBuffer : register(t1);
 // Output.
 RWStructuredBuffer<ParticleCloud> g_Target : register(u0);
 
+// Work counters.
+#define WORK_COUNTERS_REGISTER u1
+#include "WorkCounters.hlsli"
+
 // 16x16
 [numthreads(256, 1, 1)]
 void main(uint3 threadID : SV_DispatchThreadID)
@@ -40,6 +44,10 @@ void main(uint3 threadID : SV_DispatchThreadID)
     uint numClouds = metaData.numClouds;
     uint numThreads = metaData.numThreads;
 
+    // One pass per dispatch.
+    if (tID == 0)
+        WORK_COUNT(SORT_PASSES, 1);
+
     if (tID < numThreads)
     {
         uint tOffset = (tID % stepLen) + (tID / stepLen) * (2 * stepLen);
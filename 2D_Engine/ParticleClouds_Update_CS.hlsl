@@ -59,6 +59,10 @@ RWStructuredBuffer<ParticleCloud> g_TargetClouds : register(u0);
 // Output particles.
 RWStructuredBuffer<Particle> g_TargetParticles : register(u1);
 
+// Work counters.
+#define WORK_COUNTERS_REGISTER u2
+#include "WorkCounters.hlsli"
+
 // Check if clouds overlaps in x-axis.
 // selfPosX This cloud x-coordinate.
 // selfRadius This cloud radius.
@@ -109,6 +113,12 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
     boidData.separation = float3(0.f, 0.f, 0.f);
     boidData.velocity = float3(0.f, 0.f, 0.f);
 
+    // Work counted per thread, added once to the counter buffer (compiled out without WORK_COUNTERS).
+    // Dispatch(numClouds / BATCHSIZE + 1) has a group past the last cloud when numClouds is a multiple of BATCHSIZE, its
+    // batch loads only duplicate the last cloud and are not counted.
+    uint pairTests = 0;
+    bool countBatches = gtID == 0 && gID * BATCHSIZE < numClouds;
+
     // Self.
     ParticleCloud self = g_SourceClouds[pID];
     self.color = float3(0.f, 0.2f, 0.f); // TMP
@@ -119,13 +129,18 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
     if (gtID == BATCHSIZE - 1)
         gs_last = self;
     GroupMemoryBarrierWithGroupSync();
+    if (countBatches)
+        WORK_COUNT(BATCHES_LOADED, 1);
 
     // ----- Update ----- //
     // Collision.
     //[unroll(BATCHSIZE)]
     for (uint otherID = 0; otherID < BATCHSIZE; ++otherID)
         if (pID != gID * BATCHSIZE + otherID && tID < numClouds)
+        {
             OnXIntersection(self, gs_clouds[otherID], metaData, boidData);
+            ++pairTests;
+        }
     GroupMemoryBarrierWithGroupSync();
 
     for (uint batchID = gID + 1; batchID < numClouds / BATCHSIZE + 1; ++batchID)
@@ -138,11 +153,16 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
             uint gpID = min(gtID + batchStartID, numClouds - 1);
             gs_clouds[gtID] = g_SourceClouds[gpID];
             GroupMemoryBarrierWithGroupSync();
+            if (countBatches)
+                WORK_COUNT(BATCHES_LOADED, 1);
 
             //[unroll(BATCHSIZE)]
             for (uint otherID = 0; otherID < BATCHSIZE - 1; ++otherID)
                 if (gpID + otherID < numClouds)
+                {
                     OnXIntersection(self, gs_clouds[otherID], metaData, boidData);
+                    ++pairTests;
+                }
             GroupMemoryBarrierWithGroupSync();  
         }
     }
@@ -157,10 +177,15 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
             uint gpID = min(gtID + batchStartID, numClouds - 1);
             gs_clouds[gtID] = g_SourceClouds[gpID];
             GroupMemoryBarrierWithGroupSync();
+            if (countBatches)
+                WORK_COUNT(BATCHES_LOADED, 1);
 
             //[unroll(BATCHSIZE)]
             for (uint otherID = 0; otherID < BATCHSIZE; ++otherID)
+            {
                 OnXIntersection(self, gs_clouds[otherID], metaData, boidData);
+                ++pairTests;
+            }
             GroupMemoryBarrierWithGroupSync();
         }
     }
@@ -222,6 +247,7 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
     //self.velocity -= self.velocity * dt/4.f;
 
     // Update particles in cloud.
+    uint numSpawns = 0;
     for (uint i = self.particleStartID; i < self.particleStartID + self.numParticles; ++i)
     {
         Particle particle = g_SourceParticles[i];
@@ -233,6 +259,7 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
             particle.velocity = self.velocity;
             particle.scale = float2(self.radius, self.radius);
             particle.color = self.color;
+            ++numSpawns;
         }
         //particle.color = float3(1.f, 1.f, 1.f) * particle.lifetime / self.spawntime * self.numParticles;
         g_TargetParticles[i] = particle;
@@ -240,6 +267,14 @@ void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
 
     // Final result.
     g_TargetClouds[pID] = self;
+
+    // Work counters. Threads past the last cloud only duplicate it and are not counted.
+    if (tID < numClouds)
+    {
+        WORK_COUNT(PAIR_TESTS, pairTests);
+        WORK_COUNT(X_INTERSECTIONS, boidData.n);
+        WORK_COUNT(SPAWNS, numSpawns);
+    }
 }
 
 bool XInstersect(float selfPosX, float selfRadius, float otherPosX, float otherRadius)
@@ -0,0 +1,84 @@
+#include "ParticleDepthSorter.h"
+
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cmath>
+#include <assert.h>
+
+ParticleDepthSorter::ParticleDepthSorter(unsigned int maxNumParticles)
+{
+    mMaxNumParticles = maxNumParticles;
+    mKeys.resize(maxNumParticles);
+    mValues.resize(maxNumParticles);
+    mTmpKeys.resize(maxNumParticles);
+    mTmpValues.resize(maxNumParticles);
+    mSortedIndices = mValues.data();
+    mNumSortedIndices = 0;
+    mNumPasses = 0;
+}
+
+ParticleDepthSorter::~ParticleDepthSorter()
+{
+
+}
+
+unsigned int ParticleDepthSorter::Sort(const Particle* particles, unsigned int numParticles, const glm::mat4& vpMatrix, bool visibleOnly)
+{
+    assert(numParticles <= mMaxNumParticles);
+
+    // Rows of the view projection matrix. Clip w equals view depth.
+    glm::vec4 rowX(vpMatrix[0][0], vpMatrix[1][0], vpMatrix[2][0], vpMatrix[3][0]);
+    glm::vec4 rowY(vpMatrix[0][1], vpMatrix[1][1], vpMatrix[2][1], vpMatrix[3][1]);
+    glm::vec4 rowW(vpMatrix[0][3], vpMatrix[1][3], vpMatrix[2][3], vpMatrix[3][3]);
+
+    // Projection scale used to expand the frustum by particle size.
+    float scaleX = glm::length(glm::vec3(rowX));
+    float scaleY = glm::length(glm::vec3(rowY));
+
+    unsigned int* keys = mKeys.data();
+    unsigned int* values = mValues.data();
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < numParticles; ++i)
+    {
+        const Particle& particle = particles[i];
+        glm::vec4 position(particle.mPosition, 1.f);
+        float depth = glm::dot(rowW, position);
+
+        if (visibleOnly)
+        {
+            if (particle.mLifetime < 0.f || depth <= 0.f)
+                continue;
+            float radius = std::max(particle.mScale.x, particle.mScale.y);
+            float x = glm::dot(rowX, position);
+            float y = glm::dot(rowY, position);
+            if (fabs(x) > depth + radius * scaleX || fabs(y) > depth + radius * scaleY)
+                continue;
+        }
+
+        // Largest depth first.
+        keys[count] = ~RadixSort::FloatToKey(depth);
+        values[count] = i;
+        ++count;
+    }
+
+    mSortedIndices = RadixSort::Sort(keys, values, mTmpKeys.data(), mTmpValues.data(), count, &mNumPasses);
+    mNumSortedIndices = count;
+
+    return count;
+}
+
+const unsigned int* ParticleDepthSorter::GetSortedIndices() const
+{
+    return mSortedIndices;
+}
+
+unsigned int ParticleDepthSorter::GetNumSortedIndices() const
+{
+    return mNumSortedIndices;
+}
+
+unsigned int ParticleDepthSorter::GetNumPasses() const
+{
+    return mNumPasses;
+}
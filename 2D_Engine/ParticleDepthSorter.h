@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Particle.h"
+
+// Sorts particles back to front along the view direction, needed by order-dependent blend modes.
+class ParticleDepthSorter
+{
+    public:
+        // Constructor.
+        // maxNumParticles Max number of particles to sort.
+        ParticleDepthSorter(unsigned int maxNumParticles);
+
+        // Destructor.
+        ~ParticleDepthSorter();
+
+        // Sort particles back to front.
+        // particles Array of particles.
+        // numParticles Number of particles.
+        // vpMatrix View projection matrix (not transposed).
+        // visibleOnly Whether to skip inactive particles and particles outside the view frustum.
+        // Returns number of sorted indices.
+        unsigned int Sort(const Particle* particles, unsigned int numParticles, const glm::mat4& vpMatrix, bool visibleOnly);
+
+        // Get particle indices sorted back to front.
+        const unsigned int* GetSortedIndices() const;
+
+        // Get number of sorted indices.
+        unsigned int GetNumSortedIndices() const;
+
+        // Get number of radix passes used by the last sort.
+        unsigned int GetNumPasses() const;
+
+    private:
+        unsigned int mMaxNumParticles;
+        std::vector<unsigned int> mKeys;
+        std::vector<unsigned int> mValues;
+        std::vector<unsigned int> mTmpKeys;
+        std::vector<unsigned int> mTmpValues;
+        const unsigned int* mSortedIndices;
+        unsigned int mNumSortedIndices;
+        unsigned int mNumPasses;
+};
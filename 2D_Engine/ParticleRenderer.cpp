@@ -1,15 +1,34 @@
 #include "ParticleRenderer.h"
 
+#include "D3DKernelCompiler.h"
 #include "DxAssert.h"
 #include "DxHelp.h"
 
-ParticleRenderer::ParticleRenderer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+namespace
+{
+    // Render pipeline shader.
+    // path Source file path.
+    // target Target profile.
+    KernelDesc CreateKernelDesc(const char* path, const char* target)
+    {
+        KernelDesc desc;
+        desc.path = path;
+        desc.entryPoint = "main";
+        desc.target = target;
+        return desc;
+    }
+}
+
+ParticleRenderer::ParticleRenderer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
+    mBlendMode = ADDITIVE;
+    mIndexBuffer = nullptr;
+    mIndexBufferCapacity = 0;
 
     // Create pipeline.
-    Initialise();
+    Initialise(kernelCache);
 
     // Create meta data buffer.
     DxHelp::CreateCPUwriteGPUreadStructuredBuffer<MetaData>(mpDevice, 1, &mMetaDataBuffer);
@@ -23,12 +42,27 @@ ParticleRenderer::~ParticleRenderer()
     mPixelShader->Release();
     mSamplerState->Release();
     mBlendState->Release();
+    mAlphaBlendState->Release();
+    if (mIndexBuffer != nullptr)
+        mIndexBuffer->Release();
     mDepthSencilState->Release();
     mRasterizerState->Release();
 
     mMetaDataBuffer->Release();
 }
 
+void ParticleRenderer::AddKernels(KernelCache& kernelCache)
+{
+    kernelCache.Add(CreateKernelDesc("Particles_Render_VS.hlsl", "vs_5_0"));
+    kernelCache.Add(CreateKernelDesc("Particles_Render_GS.hlsl", "gs_5_0"));
+    kernelCache.Add(CreateKernelDesc("Particles_Render_PS.hlsl", "ps_5_0"));
+}
+
+void ParticleRenderer::SetBlendMode(BlendMode blendMode)
+{
+    mBlendMode = blendMode;
+}
+
 void ParticleRenderer::Bind(ID3D11RenderTargetView* renderTargetView, ID3D11DepthStencilView* depthStencilView)
 {
     mpDeviceContext->VSSetShader(mVertexShader, NULL, NULL);
@@ -37,7 +71,7 @@ void ParticleRenderer::Bind(ID3D11RenderTargetView* renderTargetView, ID3D11Dept
     mpDeviceContext->PSSetSamplers(0, 1, &mSamplerState);
     float blendFactor[] = { 0.f, 0.f, 0.f, 0.f };
     UINT sampleMask = 0xffffffff;
-    mpDeviceContext->OMSetBlendState(mBlendState, blendFactor, sampleMask);
+    mpDeviceContext->OMSetBlendState(mBlendMode == ALPHA ? mAlphaBlendState : mBlendState, blendFactor, sampleMask);
     mpDeviceContext->OMSetDepthStencilState(mDepthSencilState, NULL);
     mpDeviceContext->RSSetState(mRasterizerState);
     mpDeviceContext->IASetInputLayout(mInputLayout);
@@ -60,10 +94,43 @@ void ParticleRenderer::Unbind()
     UINT vbStride = sizeof(Particle);
     UINT vbOffset = 0;
     mpDeviceContext->IASetVertexBuffers(0, 1, (ID3D11Buffer**)p, &vbStride, &vbOffset);
+    mpDeviceContext->IASetIndexBuffer(NULL, DXGI_FORMAT_R32_UINT, 0);
     mpDeviceContext->OMSetRenderTargets(1, (ID3D11RenderTargetView**)p, nullptr);
 }
 
 void ParticleRenderer::Render(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene)
+{
+    Prepare(vpMatix, lensPostion, scene);
+
+    // Draw particles.
+    mpDeviceContext->Draw(scene.mNumParticles, 0);
+}
+
+void ParticleRenderer::Render(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene, const unsigned int* sortedIndices, unsigned int numIndices)
+{
+    if (numIndices == 0)
+        return;
+
+    // Grow index buffer.
+    if (numIndices > mIndexBufferCapacity)
+    {
+        if (mIndexBuffer != nullptr)
+            mIndexBuffer->Release();
+        mIndexBufferCapacity = scene.mMaxNumParticles > numIndices ? scene.mMaxNumParticles : numIndices;
+        DxHelp::CreateDynamicIndexBuffer<unsigned int>(mpDevice, mIndexBufferCapacity, &mIndexBuffer);
+    }
+
+    Prepare(vpMatix, lensPostion, scene);
+
+    // Upload draw order.
+    DxHelp::WriteBuffer<const unsigned int>(mpDeviceContext, sortedIndices, numIndices, mIndexBuffer);
+    mpDeviceContext->IASetIndexBuffer(mIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+
+    // Draw particles.
+    mpDeviceContext->DrawIndexed(numIndices, 0, 0);
+}
+
+void ParticleRenderer::Prepare(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene)
 {
     // Update buffers.
     mMetaData.vpMatrix = vpMatix;
@@ -79,12 +146,9 @@ void ParticleRenderer::Render(const glm::mat4& vpMatix, const glm::vec3& lensPos
     ID3D11Buffer* vBuffer = scene.mParticlesGPUSwapBuffer->GetVertexBuffer();
     mpDeviceContext->IASetVertexBuffers(0, 1, &vBuffer, &vbStride, &vbOffset);
     mpDeviceContext->GSSetShaderResources(0, 1, &mMetaDataBuffer);
-
-    // Draw particles.
-    mpDeviceContext->Draw(scene.mMaxNumParticles, 0);
 }
 
-void ParticleRenderer::Initialise()
+void ParticleRenderer::Initialise(KernelCache& kernelCache)
 {
     // Create pipeline.
     {
@@ -99,101 +163,29 @@ void ParticleRenderer::Initialise()
                 { "LIFETIME", 0, DXGI_FORMAT_R32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT , D3D11_INPUT_PER_VERTEX_DATA, 0 },
             };
 
-            ID3DBlob* compiledShader = nullptr;
-            ID3DBlob* errorBlob = nullptr;
-            HRESULT hr = D3DCompileFromFile(
-                L"Particles_Render_VS.hlsl",
-                nullptr,
-                nullptr,
-                "main",
-                "vs_5_0",
-                0,
-                0,
-                &compiledShader,
-                &errorBlob
-            );
-            if (FAILED(hr)) {
-                char* errorMsg = (char*)errorBlob->GetBufferPointer();
-                OutputDebugStringA(errorMsg);
-                errorBlob->Release();
-            }
-
-            DxAssert(mpDevice->CreateVertexShader(
-                compiledShader->GetBufferPointer(),
-                compiledShader->GetBufferSize(),
-                NULL,
-                &mVertexShader
-            ), S_OK);
+            const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateKernelDesc("Particles_Render_VS.hlsl", "vs_5_0")));
+            DxAssert(D3DKernelCompiler::CreateVertexShader(mpDevice, kernel, &mVertexShader), true);
 
             int inputLayoutSize = sizeof(inputDesc) / sizeof(D3D11_INPUT_ELEMENT_DESC);
-            mpDevice->CreateInputLayout(
+            DxAssert(mpDevice->CreateInputLayout(
                 inputDesc,
                 inputLayoutSize,
-                compiledShader->GetBufferPointer(),
-                compiledShader->GetBufferSize(),
+                kernel.blob.data(),
+                kernel.blob.size(),
                 &mInputLayout
-            );
-            compiledShader->Release();
+            ), S_OK);
         }
 
         // Create geometry shader.
         {
-        ID3DBlob* compiledShader = nullptr;
-        ID3DBlob* errorBlob = nullptr;
-        HRESULT hr = D3DCompileFromFile(
-            L"Particles_Render_GS.hlsl",
-            nullptr,
-            nullptr,
-            "main",
-            "gs_5_0",
-            0,
-            0,
-            &compiledShader,
-            &errorBlob
-        );
-        if (FAILED(hr)) {
-            char* errorMsg = (char*)errorBlob->GetBufferPointer();
-            OutputDebugStringA(errorMsg);
-            errorBlob->Release();
-        }
-
-        DxAssert(mpDevice->CreateGeometryShader(
-            compiledShader->GetBufferPointer(),
-            compiledShader->GetBufferSize(),
-            NULL,
-            &mGeometryShader
-        ), S_OK);
-        compiledShader->Release();
+            const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateKernelDesc("Particles_Render_GS.hlsl", "gs_5_0")));
+            DxAssert(D3DKernelCompiler::CreateGeometryShader(mpDevice, kernel, &mGeometryShader), true);
         }
 
         // Create pixel shader.
         {
-            ID3DBlob* compiledShader = nullptr;
-            ID3DBlob* errorBlob = nullptr;
-            HRESULT hr = D3DCompileFromFile(
-                L"Particles_Render_PS.hlsl",
-                nullptr,
-                nullptr,
-                "main",
-                "ps_5_0",
-                0,
-                0,
-                &compiledShader,
-                &errorBlob
-            );
-            if (FAILED(hr)) {
-                char* errorMsg = (char*)errorBlob->GetBufferPointer();
-                OutputDebugStringA(errorMsg);
-                errorBlob->Release();
-            }
-
-            DxAssert(mpDevice->CreatePixelShader(
-                compiledShader->GetBufferPointer(),
-                compiledShader->GetBufferSize(),
-                NULL,
-                &mPixelShader
-            ), S_OK);
-            compiledShader->Release();
+            const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateKernelDesc("Particles_Render_PS.hlsl", "ps_5_0")));
+            DxAssert(D3DKernelCompiler::CreatePixelShader(mpDevice, kernel, &mPixelShader), true);
         }
     }
 
@@ -235,6 +227,11 @@ void ParticleRenderer::Initialise()
         blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
         DxAssert(mpDevice->CreateBlendState(&blendDesc, &mBlendState), S_OK);
+
+        blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+        blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+
+        DxAssert(mpDevice->CreateBlendState(&blendDesc, &mAlphaBlendState), S_OK);
     }
 
     // Create depth sencil state.
@@ -7,6 +7,7 @@
 
 #include <glm/glm.hpp>
 
+#include "KernelCache.h"
 #include "Particle.h"
 #include "Camera.h"
 #include "Scene.h"
@@ -17,11 +18,29 @@ class ParticleRenderer
         // Constructor.
         // pDevice Pointer to D3D11 device.
         // pDeviceContext Pointer to D3D11 device context.
-        ParticleRenderer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+        // kernelCache Kernel cache holding the kernels registered by AddKernels.
+        ParticleRenderer(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache);
 
         // Destructor.
         ~ParticleRenderer();
 
+        // Register shaders, so they are built together with the kernels of other systems.
+        // kernelCache Kernel cache.
+        static void AddKernels(KernelCache& kernelCache);
+
+        // Blend mode.
+        enum BlendMode
+        {
+            // Order-independent additive blending.
+            ADDITIVE,
+            // Alpha blending. Particles have to be rendered back to front.
+            ALPHA
+        };
+
+        // Set blend mode. Takes effect on next Bind.
+        // blendMode Blend mode.
+        void SetBlendMode(BlendMode blendMode);
+
         // Bind pipeline.
         // renderTargetView Render taget.
         // depthStencilView Depth buffer.
@@ -36,9 +55,24 @@ class ParticleRenderer
         // scene Scene.
         void Render(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene);
 
+        // Render particles in given order.
+        // vpMatix View projection matrix.
+        // lensPostion Camera world position.
+        // scene Scene.
+        // sortedIndices Particle indices sorted back to front, see ParticleDepthSorter.
+        // numIndices Number of indices.
+        void Render(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene, const unsigned int* sortedIndices, unsigned int numIndices);
+
     private:
         // Initialise shaders and states.
-        void Initialise();
+        // kernelCache Kernel cache.
+        void Initialise(KernelCache& kernelCache);
+
+        // Update meta buffer and bind particle vertex buffer.
+        // vpMatix View projection matrix.
+        // lensPostion Camera world position.
+        // scene Scene.
+        void Prepare(const glm::mat4& vpMatix, const glm::vec3& lensPostion, Scene& scene);
 
         ID3D11Device* mpDevice;
         ID3D11DeviceContext* mpDeviceContext;
@@ -48,6 +82,10 @@ class ParticleRenderer
         ID3D11PixelShader* mPixelShader;
         ID3D11SamplerState* mSamplerState;
         ID3D11BlendState* mBlendState;
+        ID3D11BlendState* mAlphaBlendState;
+        BlendMode mBlendMode;
+        ID3D11Buffer* mIndexBuffer;
+        unsigned int mIndexBufferCapacity;
         ID3D11DepthStencilState* mDepthSencilState;
         ID3D11RasterizerState* mRasterizerState;
 
@@ -1,13 +1,29 @@
 #include "ParticleSystem.h"
 
+#include "D3DKernelCompiler.h"
 #include "DxHelp.h"
+#include "GPUWorkCounters.h"
 
-ParticleSystem::ParticleSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+namespace
+{
+    // Update compute shader.
+    KernelDesc CreateUpdateKernelDesc()
+    {
+        KernelDesc desc;
+        desc.path = "Particles_Update_CS.hlsl";
+        desc.entryPoint = "main";
+        desc.target = "cs_5_0";
+        GPUWorkCounters::AddKernelOptions(desc);
+        return desc;
+    }
+}
+
+ParticleSystem::ParticleSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
 
-    Initialise();
+    Initialise(kernelCache);
 }
 
 ParticleSystem::~ParticleSystem()
@@ -16,6 +32,11 @@ ParticleSystem::~ParticleSystem()
     mMetaDataBuffer->Release();
 }
 
+void ParticleSystem::AddKernels(KernelCache& kernelCache)
+{
+    kernelCache.Add(CreateUpdateKernelDesc());
+}
+
 void ParticleSystem::Bind(ID3D11ShaderResourceView* sourceBuffer, ID3D11UnorderedAccessView* targetBuffer)
 {
     mpDeviceContext->CSSetShader(mParticleUpdateCS, NULL, NULL);
@@ -38,7 +59,7 @@ void ParticleSystem::Update(Scene& scene, float dt)
     // Swap buffers.
     scene.mParticlesGPUSwapBuffer->Swap();
 
-    unsigned int numParticles = scene.mMaxNumParticles;
+    unsigned int numParticles = scene.mNumParticles;
 
     // Update meta buffer.
     mMetaData.dt = dt;
@@ -46,27 +67,26 @@ void ParticleSystem::Update(Scene& scene, float dt)
     DxHelp::WriteStructuredBuffer<MetaData>(mpDeviceContext, &mMetaData, 1, mMetaDataBuffer);
 
     Bind(scene.mParticlesGPUSwapBuffer->GetSourceBuffer(), scene.mParticlesGPUSwapBuffer->GetTargetBuffer());
+#if WORK_COUNTERS
+    ID3D11UnorderedAccessView* workCounters = scene.mWorkCounters->GetBuffer();
+    mpDeviceContext->CSSetUnorderedAccessViews(1, 1, &workCounters, NULL);
+#endif
 
     mpDeviceContext->Dispatch(numParticles / 256 + 1, 1, 1);
 
+#if WORK_COUNTERS
+    void *const p[1] = { NULL };
+    mpDeviceContext->CSSetUnorderedAccessViews(1, 1, (ID3D11UnorderedAccessView**)p, NULL);
+#endif
     Unbind();
 }
 
-void ParticleSystem::Initialise()
+void ParticleSystem::Initialise(KernelCache& kernelCache)
 {
     // Create meta buffer.
     DxHelp::CreateCPUwriteGPUreadStructuredBuffer<MetaData>(mpDevice, 1, &mMetaDataBuffer);
 
     // Create compute shader.
-    ID3DBlob* errorBlob = nullptr;
-    ID3DBlob* shaderBlob = nullptr;
-    HRESULT hr = D3DCompileFromFile(L"Particles_Update_CS.hlsl", nullptr, nullptr, "main", "cs_5_0", 0, NULL, &shaderBlob, &errorBlob);
-    if (FAILED(hr))
-    {
-        char* errorMsg = (char*)errorBlob->GetBufferPointer();
-        OutputDebugStringA(errorMsg);
-        shaderBlob->Release();
-    }
-    DxAssert(mpDevice->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &mParticleUpdateCS), S_OK);
-    shaderBlob->Release();
+    const Kernel& kernel = kernelCache.Get(kernelCache.Add(CreateUpdateKernelDesc()));
+    DxAssert(D3DKernelCompiler::CreateComputeShader(mpDevice, kernel, &mParticleUpdateCS), true);
 }
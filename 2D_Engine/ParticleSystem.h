@@ -5,6 +5,7 @@
 #include <d3d11.h>
 #include <d3dcompiler.inl>
 
+#include "KernelCache.h"
 #include "Particle.h"
 #include "Scene.h"
 
@@ -14,11 +15,16 @@ class ParticleSystem
         // Constructor.
         // pDevice Pointer to D3D11 device.
         // pDeviceContext Pointer to D3D11 device context.
-        ParticleSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext);
+        // kernelCache Kernel cache holding the kernels registered by AddKernels.
+        ParticleSystem(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, KernelCache& kernelCache);
 
         // Destructor.
         ~ParticleSystem();
 
+        // Register kernels, so they are built together with the kernels of other systems.
+        // kernelCache Kernel cache.
+        static void AddKernels(KernelCache& kernelCache);
+
         // Bind pipeline.
         // sourceBuffer Buffer to read from.
         // targetBuffer Buffer to write to.
@@ -42,7 +48,8 @@ class ParticleSystem
 
     private:
         // Initialise buffers and compute shader.
-        void Initialise();
+        // kernelCache Kernel cache.
+        void Initialise(KernelCache& kernelCache);
 
         ID3D11Device* mpDevice;
         ID3D11DeviceContext* mpDeviceContext;
@@ -27,14 +27,28 @@ StructuredBuffer<MetaData> g_MetaBuffer : register(t1);
 // Output.
 RWStructuredBuffer<Particle> g_Target : register(u0);
 
+// Work counters.
+#define WORK_COUNTERS_REGISTER u1
+#include "WorkCounters.hlsli"
+
+// Alive particles in group.
+groupshared uint gs_numAlive;
+
 // 16x16
 [numthreads(BATCHSIZE, 1, 1)]
-void main(uint3 threadID : SV_DispatchThreadID)
+void main(uint3 threadID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupThreadID)
 {
     MetaData metaData = g_MetaBuffer[0];
     float dt = metaData.dt;
     uint numParticles = metaData.numParticles;
     uint tID = threadID.x;
+    uint gtID = groupThreadID.x;
+
+#ifdef WORK_COUNTERS
+    if (gtID == 0)
+        gs_numAlive = 0;
+    GroupMemoryBarrierWithGroupSync();
+#endif
 
     if (tID < numParticles)
     {
@@ -46,5 +60,17 @@ void main(uint3 threadID : SV_DispatchThreadID)
         self.lifetime -= dt;
 
         g_Target[tID] = self;
+
+        // Count alive particles in groupshared memory, one global atomic per group.
+#ifdef WORK_COUNTERS
+        if (self.lifetime >= 0.f)
+            InterlockedAdd(gs_numAlive, 1);
+#endif
     }
+
+#ifdef WORK_COUNTERS
+    GroupMemoryBarrierWithGroupSync();
+    if (gtID == 0)
+        WORK_COUNT(ALIVE_PARTICLES, gs_numAlive);
+#endif
 }
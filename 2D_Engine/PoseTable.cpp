@@ -0,0 +1,149 @@
+#include "PoseTable.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+#include "Animation.h"
+#include "MathFunctions.h"
+#include "Skeleton.h"
+
+using namespace Geometry;
+
+namespace {
+    // Floats of a bone transformation in each format.
+    const std::size_t kAffineStride = 12;
+    const std::size_t kQuaternionStride = 8;
+
+    void StoreAffine(const glm::mat4& matrix, float* bone) {
+        for (unsigned int r = 0; r < 3; ++r)
+            for (unsigned int c = 0; c < 4; ++c)
+                bone[r * 4 + c] = matrix[c][r];
+    }
+
+    // Split the matrix into a rotation and the uniform scale of equal determinant. The rotation is flipped to the
+    // hemisphere of the previous frame, so blending frames never takes the long way round.
+    void StoreQuaternion(const glm::mat4& matrix, const float* previousBone, float* bone) {
+        glm::mat3 linear(matrix);
+        float scale = std::cbrt(glm::determinant(linear));
+        if (scale == 0.0f)
+            scale = 1.0f;
+        glm::quat rotation = glm::quat_cast(linear / scale);
+        if (previousBone != nullptr && rotation.x * previousBone[0] + rotation.y * previousBone[1] + rotation.z * previousBone[2] + rotation.w * previousBone[3] < 0.0f)
+            rotation = -rotation;
+        bone[0] = rotation.x;
+        bone[1] = rotation.y;
+        bone[2] = rotation.z;
+        bone[3] = rotation.w;
+        bone[4] = matrix[3][0];
+        bone[5] = matrix[3][1];
+        bone[6] = matrix[3][2];
+        bone[7] = scale;
+    }
+}
+
+PoseTable::PoseTable() {
+    durationInSeconds = 0.0f;
+    numBones = 0;
+    numFrames = 0;
+    frameRate = 0.0f;
+    format = FORMAT_AFFINE;
+    interpolate = true;
+}
+
+PoseTable::PoseTable(Skeleton& skeleton, const Animation& animation, const Settings& settings) {
+    Bake(skeleton, animation, settings);
+}
+
+PoseTable::~PoseTable() {
+
+}
+
+void PoseTable::Bake(Skeleton& skeleton, const Animation& animation, const Settings& settings) {
+    name = animation.name;
+    format = settings.format;
+    interpolate = settings.interpolate;
+    numBones = skeleton.GetNumBones();
+
+    float ticksPerSecond = (float)(animation.ticksPerSecond != 0 ? animation.ticksPerSecond : 25.0f);
+    durationInSeconds = static_cast<float>(animation.duration) / ticksPerSecond;
+    numFrames = std::max(static_cast<std::size_t>(std::ceil(durationInSeconds * settings.framesPerSecond)), static_cast<std::size_t>(1));
+    frameRate = durationInSeconds > 0.0f ? numFrames / durationInSeconds : 0.0f;
+
+    const std::size_t boneStride = GetBoneStride();
+    const std::size_t frameStride = numBones * boneStride;
+    frames.assign((numFrames + 1) * frameStride, 0.0f);
+    for (std::size_t f = 0; f <= numFrames; ++f) {
+        // The frame after the last is the first again.
+        skeleton.Animate(&animation, f < numFrames && frameRate > 0.0f ? f / frameRate : 0.0f);
+        const std::vector<glm::mat4>& finalTransforms = skeleton.GetFinalTransformations();
+        float* frame = &frames[f * frameStride];
+        for (std::size_t b = 0; b < numBones; ++b) {
+            float* bone = frame + b * boneStride;
+            if (format == FORMAT_AFFINE)
+                StoreAffine(finalTransforms[b], bone);
+            else
+                StoreQuaternion(finalTransforms[b], f > 0 ? bone - frameStride : nullptr, bone);
+        }
+    }
+}
+
+void PoseTable::Sample(float timeInSeconds, glm::mat4* finalTransforms, glm::mat3* finalTransformsIT) const {
+    if (numFrames == 0)
+        return;
+
+    float time = durationInSeconds > 0.0f ? std::fmod(timeInSeconds, durationInSeconds) : 0.0f;
+    if (time < 0.0f)
+        time += durationInSeconds;
+    float position = time * frameRate;
+    std::size_t frame = std::min(static_cast<std::size_t>(position), numFrames - 1);
+    float factor = std::min(position - frame, 1.0f);
+    if (!interpolate) {
+        if (factor >= 0.5f)
+            ++frame;
+        factor = 0.0f;
+    }
+
+    const std::size_t boneStride = GetBoneStride();
+    const float* start = &frames[frame * numBones * boneStride];
+    const float* end = factor > 0.0f ? start + numBones * boneStride : start;
+    float bone[kAffineStride];
+    for (std::size_t b = 0; b < numBones; ++b) {
+        for (std::size_t i = 0; i < boneStride; ++i)
+            bone[i] = start[i] + factor * (end[i] - start[i]);
+        start += boneStride;
+        end += boneStride;
+
+        glm::mat4& matrix = finalTransforms[b];
+        if (format == FORMAT_AFFINE) {
+            for (unsigned int c = 0; c < 4; ++c)
+                matrix[c] = glm::vec4(bone[c], bone[4 + c], bone[8 + c], c == 3 ? 1.0f : 0.0f);
+        } else {
+            // Linear blend of neighbouring frames, renormalized.
+            glm::mat3 rotation = glm::mat3_cast(glm::normalize(glm::quat(bone[3], bone[0], bone[1], bone[2])));
+            float scale = bone[7];
+            matrix = glm::mat4(rotation * scale);
+            matrix[3] = glm::vec4(bone[4], bone[5], bone[6], 1.0f);
+            if (finalTransformsIT != nullptr)
+                finalTransformsIT[b] = rotation / scale;
+        }
+    }
+
+    // Affine bones may be sheared or non-uniformly scaled.
+    if (format == FORMAT_AFFINE && finalTransformsIT != nullptr)
+        InverseTransposeAffine(finalTransforms, finalTransformsIT, numBones, false);
+}
+
+std::size_t PoseTable::GetNumBones() const {
+    return numBones;
+}
+
+std::size_t PoseTable::GetNumFrames() const {
+    return numFrames;
+}
+
+std::size_t PoseTable::GetNumBytes() const {
+    return frames.size() * sizeof(float);
+}
+
+std::size_t PoseTable::GetBoneStride() const {
+    return format == FORMAT_AFFINE ? kAffineStride : kQuaternionStride;
+}
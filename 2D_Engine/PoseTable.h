@@ -0,0 +1,106 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace Geometry {
+
+    class Animation;
+    class Skeleton;
+
+    /// An animation of a skeleton sampled at a fixed rate into bone transformation tables.
+    /**
+    * Sampling a pose fetches the two frames around the time and optionally blends them, instead of interpolating
+    * keys and concatenating the node tree. Frames are contiguous, with the first frame repeated after the last so
+    * looping needs no special case.
+    */
+    class PoseTable {
+    public:
+        /// Storage of a bone transformation.
+        enum Format {
+            /// Rows 0 to 2 of the affine matrix, 48 bytes. Reproduces the skeleton exactly at frame times.
+            FORMAT_AFFINE,
+            /// Rotation quaternion, translation and uniform scale, 32 bytes. Non-uniform scale and shear are lost.
+            FORMAT_QUATERNION
+        };
+
+        /// Baking settings.
+        struct Settings {
+            /// Frames per second, rounded so frames divide the animation duration evenly.
+            float framesPerSecond = 30.0f;
+            /// Storage of bone transformations.
+            Format format = FORMAT_AFFINE;
+            /// Blend the two frames around the sampled time, else take the nearest frame.
+            bool interpolate = true;
+        };
+
+        /// Create new empty pose table.
+        /**
+        * The created table has to be baked later using Bake.
+        */
+        PoseTable();
+
+        /// Create new pose table.
+        /**
+        * @param skeleton Skeleton to animate, left in the pose of the last baked frame.
+        * @param animation Animation to bake.
+        * @param settings Baking settings.
+        */
+        PoseTable(Skeleton& skeleton, const Animation& animation, const Settings& settings);
+
+        /// Destructor.
+        ~PoseTable();
+
+        /// Bake pose table.
+        /**
+        * @param skeleton Skeleton to animate, left in the pose of the last baked frame.
+        * @param animation Animation to bake.
+        * @param settings Baking settings.
+        */
+        void Bake(Skeleton& skeleton, const Animation& animation, const Settings& settings);
+
+        /// Sample pose.
+        /**
+        * Thread safe, the table is not modified.
+        * @param timeInSeconds Time to find animation frame, wraps at the end of the animation.
+        * @param finalTransforms Bone transformations, GetNumBones elements.
+        * @param finalTransformsIT Bone inverse transpose transformations, GetNumBones elements, nullptr to skip.
+        */
+        void Sample(float timeInSeconds, glm::mat4* finalTransforms, glm::mat3* finalTransformsIT = nullptr) const;
+
+        /// Get number of bones.
+        /**
+        * @return Number of bones.
+        */
+        std::size_t GetNumBones() const;
+
+        /// Get number of frames.
+        /**
+        * @return Number of frames in one loop of the animation.
+        */
+        std::size_t GetNumFrames() const;
+
+        /// Get memory used by frames.
+        /**
+        * @return Size of frames in bytes.
+        */
+        std::size_t GetNumBytes() const;
+
+        /// Animation name.
+        std::string name;
+
+        /// Duration of the animation in seconds.
+        float durationInSeconds;
+
+    private:
+        std::size_t GetBoneStride() const;
+
+        std::vector<float> frames;
+        std::size_t numBones;
+        std::size_t numFrames;
+        float frameRate;
+        Format format;
+        bool interpolate;
+    };
+}
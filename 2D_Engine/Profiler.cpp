@@ -1,20 +1,267 @@
 #include "Profiler.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_TSC
+#endif
 
 using namespace std::chrono;
 
-Profiler::Profiler(const std::string& name, bool dump)
+static_assert((PROFILER_EVENTS_PER_THREAD & (PROFILER_EVENTS_PER_THREAD - 1)) == 0, "PROFILER_EVENTS_PER_THREAD has to be a power of two.");
+
+namespace
+{
+    // Read raw timestamp. Uses the time stamp counter where available, it is cheaper than the OS clock.
+    inline long long ReadTicks()
+    {
+#ifdef PROFILER_TSC
+        return static_cast<long long>(__rdtsc());
+#else
+        return Profiler::Now();
+#endif
+    }
+}
+
+// Per-thread event ring buffer and zone depth. Only written by its owning thread.
+struct ProfilerThreadBuffer
+{
+    // Recorded zone. Timestamps in ticks.
+    struct Event
+    {
+        long long start;
+        long long end;
+        unsigned int zoneID;
+        unsigned int depth;
+    };
+
+    unsigned int threadID;
+    unsigned int depth;
+    std::atomic<unsigned long long> count;
+    std::vector<Event> events;
+};
+
+namespace
+{
+    typedef ProfilerThreadBuffer ThreadBuffer;
+    typedef ProfilerThreadBuffer::Event Event;
+
+    // Zones and thread buffers. Thread buffers outlive their threads so events can be collected later.
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<const ProfileZone*> zones;
+        std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+        long long startTime = Profiler::Now();
+        long long startTicks = ReadTicks();
+
+        // Convert ticks to nanoseconds since start, calibrated against the steady clock.
+        double ticksToNs = 1.0;
+        void Calibrate()
+        {
+            long long elapsedTime = Profiler::Now() - startTime;
+            long long elapsedTicks = ReadTicks() - startTicks;
+            if (elapsedTime > 0 && elapsedTicks > 0)
+                ticksToNs = static_cast<double>(elapsedTime) / static_cast<double>(elapsedTicks);
+        }
+    };
+
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local ThreadBuffer* tThreadBuffer = nullptr;
+
+    inline ThreadBuffer* GetThreadBuffer()
+    {
+        if (tThreadBuffer == nullptr)
+        {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+            buffer->threadID = static_cast<unsigned int>(registry.threadBuffers.size());
+            buffer->depth = 0;
+            buffer->count = 0;
+            buffer->events.resize(PROFILER_EVENTS_PER_THREAD);
+            tThreadBuffer = buffer.get();
+            registry.threadBuffers.push_back(std::move(buffer));
+        }
+        return tThreadBuffer;
+    }
+
+    // Nearest-rank percentile of sorted durations.
+    double Percentile(const std::vector<long long>& sorted, double p)
+    {
+        std::size_t rank = static_cast<std::size_t>(p * sorted.size() + 0.999999);
+        return static_cast<double>(sorted[std::min(std::max(rank, (std::size_t)1), sorted.size()) - 1]);
+    }
+
+    // Write string as JSON string.
+    void WriteJSONString(std::ostream& stream, const char* str)
+    {
+        stream << '"';
+        for (; *str != '\0'; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+                stream << '\\';
+            stream << *str;
+        }
+        stream << '"';
+    }
+}
+
+ProfileZone::ProfileZone(const char* name, const char* file, unsigned int line)
 {
     mName = name;
-    mStart = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-    mDump = dump;
+    mFile = file;
+    mLine = line;
+
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    mID = static_cast<unsigned int>(registry.zones.size());
+    registry.zones.push_back(this);
+}
+
+Profiler::Profiler(const ProfileZone& zone)
+{
+    mBuffer = GetThreadBuffer();
+    mZone = &zone;
+    mDepth = mBuffer->depth++;
+    mStart = ReadTicks();
 }
 
 Profiler::~Profiler()
 {
-    long long deltaTime = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count() - mStart;
-    if (mDump)
-        std::cout << mName << " : " << deltaTime << " ms." << std::endl;
+    long long end = ReadTicks();
+    ThreadBuffer* buffer = mBuffer;
+    --buffer->depth;
+
+    unsigned long long count = buffer->count.load(std::memory_order_relaxed);
+    Event& event = buffer->events[count & (PROFILER_EVENTS_PER_THREAD - 1)];
+    event.start = mStart;
+    event.end = end;
+    event.zoneID = mZone->mID;
+    event.depth = mDepth;
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+long long Profiler::Now()
+{
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<Profiler::ZoneStats> Profiler::CollectStats()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.Calibrate();
+
+    // Gather durations per zone.
+    std::vector<std::vector<long long>> durations(registry.zones.size());
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.threadBuffers)
+    {
+        unsigned long long count = std::min(buffer->count.load(std::memory_order_acquire), (unsigned long long)PROFILER_EVENTS_PER_THREAD);
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            const Event& event = buffer->events[i];
+            durations[event.zoneID].push_back(static_cast<long long>((event.end - event.start) * registry.ticksToNs));
+        }
+    }
+
+    std::vector<ZoneStats> stats;
+    for (std::size_t z = 0; z < durations.size(); ++z)
+    {
+        std::vector<long long>& zoneDurations = durations[z];
+        if (zoneDurations.empty())
+            continue;
+
+        std::sort(zoneDurations.begin(), zoneDurations.end());
+        double sum = 0.0;
+        for (long long duration : zoneDurations)
+            sum += static_cast<double>(duration);
+
+        ZoneStats zoneStats;
+        zoneStats.zone = registry.zones[z];
+        zoneStats.count = zoneDurations.size();
+        zoneStats.mean = sum / zoneDurations.size();
+        zoneStats.p50 = Percentile(zoneDurations, 0.50);
+        zoneStats.p95 = Percentile(zoneDurations, 0.95);
+        zoneStats.p99 = Percentile(zoneDurations, 0.99);
+        zoneStats.max = static_cast<double>(zoneDurations.back());
+        stats.push_back(zoneStats);
+    }
+
+    return stats;
+}
+
+void Profiler::DumpStats(std::ostream& stream)
+{
+    std::vector<ZoneStats> stats = CollectStats();
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+    for (const ZoneStats& zoneStats : stats)
+    {
+        stream << zoneStats.zone->mName << " : " << zoneStats.count << " calls"
+            << ", mean " << zoneStats.mean / 1000000.0 << " ms"
+            << ", p50 " << zoneStats.p50 / 1000000.0 << " ms"
+            << ", p95 " << zoneStats.p95 / 1000000.0 << " ms"
+            << ", p99 " << zoneStats.p99 / 1000000.0 << " ms"
+            << ", max " << zoneStats.max / 1000000.0 << " ms." << std::endl;
+    }
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.Calibrate();
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.threadBuffers)
+    {
+        unsigned long long count = std::min(buffer->count.load(std::memory_order_acquire), (unsigned long long)PROFILER_EVENTS_PER_THREAD);
+        for (unsigned long long i = 0; i < count; ++i)
+        {
+            const Event& event = buffer->events[i];
+            file << (first ? "\n" : ",\n") << "{\"name\":";
+            WriteJSONString(file, registry.zones[event.zoneID]->mName);
+            file << ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadID
+                << ",\"ts\":" << (event.start - registry.startTicks) * registry.ticksToNs / 1000.0
+                << ",\"dur\":" << (event.end - event.start) * registry.ticksToNs / 1000.0
+                << ",\"args\":{\"depth\":" << event.depth << "}}";
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+
+    return file.good();
+}
+
+void Profiler::Reset()
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.threadBuffers)
+        buffer->count.store(0, std::memory_order_release);
 }
@@ -1,20 +1,94 @@
 #pragma once
 
+#include <ostream>
 #include <string>
+#include <vector>
 
-// Profiler.
-class Profiler {
+// Max number of events kept per thread. Older events are overwritten.
+#define PROFILER_EVENTS_PER_THREAD 65536U
+
+// Per-thread event buffer, defined in Profiler.cpp.
+struct ProfilerThreadBuffer;
+
+// Static description of a profiled zone, one per PROFILE site.
+class ProfileZone
+{
+    public:
+        // Constructor. Registers zone with the profiler.
+        // name Zone name, has to outlive the zone (string literal).
+        // file Source file.
+        // line Source line.
+        ProfileZone(const char* name, const char* file, unsigned int line);
+
+        // Zone name.
+        const char* mName;
+
+        // Source file.
+        const char* mFile;
+
+        // Source line.
+        unsigned int mLine;
+
+        // Zone index.
+        unsigned int mID;
+};
+
+// Scoped profiler. Records begin and end of a zone into a per-thread event buffer.
+class Profiler
+{
     public:
-        // Constructor.
-        Profiler(const std::string& name, bool dump);
+        // Constructor. Begins zone.
+        // zone Zone to record.
+        Profiler(const ProfileZone& zone);
 
-        // Destructor.
+        // Destructor. Ends zone.
         ~Profiler();
 
+        // Aggregated zone statistics. Durations in nanoseconds.
+        struct ZoneStats
+        {
+            const ProfileZone* zone;
+            unsigned long long count;
+            double mean;
+            double p50;
+            double p95;
+            double p99;
+            double max;
+        };
+
+        // Get current time in nanoseconds from a steady clock.
+        static long long Now();
+
+        // Collect statistics of all zones from recorded events.
+        // Should be called while no zones are being recorded, e.g. between frames.
+        static std::vector<ZoneStats> CollectStats();
+
+        // Print statistics of all zones.
+        // stream Output stream.
+        static void DumpStats(std::ostream& stream);
+
+        // Export recorded events as Chrome trace JSON (chrome://tracing).
+        // path File path.
+        // Returns whether file could be written.
+        static bool ExportChromeTrace(const std::string& path);
+
+        // Discard all recorded events.
+        static void Reset();
+
     private:
-        std::string mName;
+        // Buffer of the recording thread, looked up once per zone.
+        ProfilerThreadBuffer* mBuffer;
+        const ProfileZone* mZone;
         long long mStart;
-        bool mDump;
+        unsigned int mDepth;
 };
 
-#define PROFILE(name, dump) Profiler __profileInstance(name, dump)
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef PROFILER_DISABLED
+#define PROFILE(name)
+#else
+// Profile scope. name String literal.
+#define PROFILE(name) static const ProfileZone PROFILE_CONCAT(__profileZone, __LINE__)(name, __FILE__, __LINE__); Profiler PROFILE_CONCAT(__profileInstance, __LINE__)(PROFILE_CONCAT(__profileZone, __LINE__))
+#endif
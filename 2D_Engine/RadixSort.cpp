@@ -0,0 +1,74 @@
+#include "RadixSort.h"
+
+#include <cstring>
+
+#define RADIX_BITS 11U
+#define RADIX_SIZE (1U << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1U)
+#define RADIX_PASSES 3U
+
+unsigned int RadixSort::FloatToKey(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(unsigned int));
+    // Flip sign bit of positive floats and all bits of negative floats.
+    unsigned int mask = static_cast<unsigned int>(-static_cast<int>(bits >> 31)) | 0x80000000U;
+    return bits ^ mask;
+}
+
+unsigned int* RadixSort::Sort(unsigned int* keys, unsigned int* values, unsigned int* tmpKeys, unsigned int* tmpValues, unsigned int numOfElements, unsigned int* numPasses)
+{
+    // Build histograms of all passes in one read.
+    unsigned int histograms[RADIX_PASSES][RADIX_SIZE];
+    memset(histograms, 0, sizeof(histograms));
+    for (unsigned int i = 0; i < numOfElements; ++i)
+    {
+        unsigned int key = keys[i];
+        ++histograms[0][key & RADIX_MASK];
+        ++histograms[1][(key >> RADIX_BITS) & RADIX_MASK];
+        ++histograms[2][key >> (2 * RADIX_BITS)];
+    }
+
+    unsigned int passes = 0;
+    unsigned int* srcKeys = keys;
+    unsigned int* srcValues = values;
+    unsigned int* dstKeys = tmpKeys;
+    unsigned int* dstValues = tmpValues;
+    for (unsigned int pass = 0; pass < RADIX_PASSES; ++pass)
+    {
+        unsigned int* histogram = histograms[pass];
+        unsigned int shift = pass * RADIX_BITS;
+
+        // Skip pass if all keys share the same digit.
+        if (numOfElements == 0 || histogram[(srcKeys[0] >> shift) & RADIX_MASK] == numOfElements)
+            continue;
+
+        // Exclusive prefix sum.
+        unsigned int sum = 0;
+        for (unsigned int b = 0; b < RADIX_SIZE; ++b)
+        {
+            unsigned int count = histogram[b];
+            histogram[b] = sum;
+            sum += count;
+        }
+
+        // Scatter.
+        for (unsigned int i = 0; i < numOfElements; ++i)
+        {
+            unsigned int key = srcKeys[i];
+            unsigned int dstID = histogram[(key >> shift) & RADIX_MASK]++;
+            dstKeys[dstID] = key;
+            dstValues[dstID] = srcValues[i];
+        }
+
+        // Swap source and target.
+        unsigned int* tmp = srcKeys; srcKeys = dstKeys; dstKeys = tmp;
+        tmp = srcValues; srcValues = dstValues; dstValues = tmp;
+        ++passes;
+    }
+
+    if (numPasses != nullptr)
+        *numPasses = passes;
+
+    return srcValues;
+}
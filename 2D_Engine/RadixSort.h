@@ -0,0 +1,20 @@
+#pragma once
+
+namespace RadixSort
+{
+    // Convert float to unsigned key with the same ordering.
+    // value Float value.
+    // Returns sortable key.
+    unsigned int FloatToKey(float value);
+
+    // LSD radix sort of 32-bit key/value pairs (three passes of 11 bits).
+    // Passes where every key shares the same digit are skipped.
+    // keys Array of keys.
+    // values Array of values.
+    // tmpKeys Scratch array of same size as keys.
+    // tmpValues Scratch array of same size as values.
+    // numOfElements Number of elements.
+    // numPasses Number of passes performed (optional).
+    // Returns pointer to sorted values, either values or tmpValues. Sorted keys are stored in the matching keys array.
+    unsigned int* Sort(unsigned int* keys, unsigned int* values, unsigned int* tmpKeys, unsigned int* tmpValues, unsigned int numOfElements, unsigned int* numPasses = nullptr);
+}
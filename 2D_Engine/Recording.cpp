@@ -0,0 +1,885 @@
+#include "Recording.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "Profiler.h"
+
+// Quantization steps of particle scale, colors and lifetime.
+#define RECORDING_SCALE_STEP (1.f / 8192.f)
+#define RECORDING_COLOR_STEP (1.f / 256.f)
+#define RECORDING_LIFETIME_STEP (1.f / 4096.f)
+
+// Number of differences sharing a bit width. At most 256, exception indices are bytes.
+#define RECORDING_GROUP_SIZE 64U
+
+// Min number of zero bytes stored as a run instead of literals.
+#define RECORDING_MIN_ZERO_RUN 4U
+
+// Max number of bytes of a literal run.
+#define RECORDING_MAX_LITERAL_RUN 128U
+
+// Seek index identifier, "PIDX" in a little-endian file.
+#define RECORDING_INDEX_MAGIC 0x58444950U
+
+namespace
+{
+    // Stored before each encoded frame.
+    struct FrameHeader
+    {
+        // Size of the compressed and of the bit packed frame.
+        unsigned int encodedSize;
+        unsigned int packedSize;
+        double time;
+        glm::vec3 cameraPosition;
+        glm::vec3 cameraFrontDirection;
+        glm::vec3 cameraUpDirection;
+    };
+
+    // Stored at the end of the file, after the seek index.
+    struct Footer
+    {
+        unsigned int magic;
+        unsigned int numChunks;
+        unsigned long long indexOffset;
+    };
+
+    // Columns of a quantized frame. 32-bit columns come first, so every column is aligned.
+    enum Column
+    {
+        BLOCK_MIN_X, BLOCK_MIN_Y, BLOCK_MIN_Z,
+        CLOUD_POSITION_X, CLOUD_POSITION_Y, CLOUD_POSITION_Z,
+        PARTICLE_OFFSET_X, PARTICLE_OFFSET_Y, PARTICLE_OFFSET_Z,
+        PARTICLE_SCALE_X, PARTICLE_SCALE_Y,
+        PARTICLE_COLOR_R, PARTICLE_COLOR_G, PARTICLE_COLOR_B,
+        PARTICLE_LIFETIME,
+        CLOUD_RADIUS,
+        CLOUD_COLOR_R, CLOUD_COLOR_G, CLOUD_COLOR_B,
+        BLOCK_SHIFT,
+        NUM_COLUMNS
+    };
+
+    // Byte offsets, element sizes and lengths of the columns of a quantized frame.
+    struct Layout
+    {
+        size_t offsets[NUM_COLUMNS];
+        unsigned int elementSizes[NUM_COLUMNS];
+        unsigned int counts[NUM_COLUMNS];
+        size_t size;
+    };
+
+    Layout GetLayout(unsigned int numParticles, unsigned int numParticleClouds)
+    {
+        unsigned int numBlocks = (numParticles + RECORDING_BLOCK_SIZE - 1) / RECORDING_BLOCK_SIZE;
+        Layout layout;
+        layout.size = 0;
+        for (unsigned int c = 0; c < NUM_COLUMNS; ++c)
+        {
+            layout.elementSizes[c] = c <= CLOUD_POSITION_Z ? 4 : c < BLOCK_SHIFT ? 2 : 1;
+            layout.counts[c] = c <= BLOCK_MIN_Z || c == BLOCK_SHIFT ? numBlocks : (c >= CLOUD_POSITION_X && c <= CLOUD_POSITION_Z) || c >= CLOUD_RADIUS ? numParticleClouds : numParticles;
+            layout.offsets[c] = layout.size;
+            layout.size += static_cast<size_t>(layout.elementSizes[c]) * layout.counts[c];
+        }
+        return layout;
+    }
+
+    template <typename T>
+    T* GetColumn(unsigned char* data, const Layout& layout, Column column)
+    {
+        return reinterpret_cast<T*>(data + layout.offsets[column]);
+    }
+
+    template <typename T>
+    const T* GetColumn(const unsigned char* data, const Layout& layout, Column column)
+    {
+        return reinterpret_cast<const T*>(data + layout.offsets[column]);
+    }
+
+    // Quantize position to the grid of step.
+    int QuantizePosition(float value, float step)
+    {
+        double q = std::floor(static_cast<double>(value) / step + 0.5);
+        return static_cast<int>(std::max(std::min(q, static_cast<double>(INT_MAX)), static_cast<double>(INT_MIN)));
+    }
+
+    // Quantize non-negative value, clamped to 16 bits.
+    unsigned short QuantizeUnsigned(float value, float step)
+    {
+        return static_cast<unsigned short>(std::max(std::min(std::floor(value / step + 0.5f), 65535.f), 0.f));
+    }
+
+    void Quantize(const RecordingFrame& frame, float positionStep, const Layout& layout, unsigned char* data)
+    {
+        unsigned int numParticles = static_cast<unsigned int>(frame.particles.size());
+        unsigned int numBlocks = layout.counts[BLOCK_MIN_X];
+        int* minX = GetColumn<int>(data, layout, BLOCK_MIN_X);
+        int* minY = GetColumn<int>(data, layout, BLOCK_MIN_Y);
+        int* minZ = GetColumn<int>(data, layout, BLOCK_MIN_Z);
+        unsigned char* shifts = GetColumn<unsigned char>(data, layout, BLOCK_SHIFT);
+        unsigned short* offsetX = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_X);
+        unsigned short* offsetY = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_Y);
+        unsigned short* offsetZ = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_Z);
+        unsigned short* scaleX = GetColumn<unsigned short>(data, layout, PARTICLE_SCALE_X);
+        unsigned short* scaleY = GetColumn<unsigned short>(data, layout, PARTICLE_SCALE_Y);
+        unsigned short* colorR = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_R);
+        unsigned short* colorG = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_G);
+        unsigned short* colorB = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_B);
+        unsigned short* lifetimes = GetColumn<unsigned short>(data, layout, PARTICLE_LIFETIME);
+
+        // Positions relative to the bounds of the block's active particles.
+        for (unsigned int b = 0; b < numBlocks; ++b)
+        {
+            unsigned int begin = b * RECORDING_BLOCK_SIZE;
+            unsigned int end = std::min(begin + RECORDING_BLOCK_SIZE, numParticles);
+            int q[RECORDING_BLOCK_SIZE][3];
+            long long lo[3] = { LLONG_MAX, LLONG_MAX, LLONG_MAX };
+            long long hi[3] = { LLONG_MIN, LLONG_MIN, LLONG_MIN };
+            for (unsigned int i = begin; i < end; ++i)
+            {
+                const Particle& particle = frame.particles[i];
+                if (particle.mLifetime < 0.f)
+                    continue;
+                for (unsigned int a = 0; a < 3; ++a)
+                {
+                    q[i - begin][a] = QuantizePosition(particle.mPosition[a], positionStep);
+                    lo[a] = std::min(lo[a], static_cast<long long>(q[i - begin][a]));
+                    hi[a] = std::max(hi[a], static_cast<long long>(q[i - begin][a]));
+                }
+            }
+            if (lo[0] > hi[0])
+            {
+                for (unsigned int a = 0; a < 3; ++a)
+                    lo[a] = hi[a] = 0;
+            }
+
+            // Coarser steps for blocks spread wider than 16 bits.
+            long long range = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+            unsigned char shift = 0;
+            while ((range >> shift) > 65535)
+                ++shift;
+            minX[b] = static_cast<int>(lo[0]);
+            minY[b] = static_cast<int>(lo[1]);
+            minZ[b] = static_cast<int>(lo[2]);
+            shifts[b] = shift;
+
+            for (unsigned int i = begin; i < end; ++i)
+            {
+                bool active = frame.particles[i].mLifetime >= 0.f;
+                offsetX[i] = active ? static_cast<unsigned short>((q[i - begin][0] - lo[0]) >> shift) : 0;
+                offsetY[i] = active ? static_cast<unsigned short>((q[i - begin][1] - lo[1]) >> shift) : 0;
+                offsetZ[i] = active ? static_cast<unsigned short>((q[i - begin][2] - lo[2]) >> shift) : 0;
+            }
+        }
+
+        // Attributes of inactive particles still decay but are not rendered, they store zero.
+        for (unsigned int i = 0; i < numParticles; ++i)
+        {
+            Particle particle = frame.particles[i].mLifetime >= 0.f ? frame.particles[i] : Particle();
+            scaleX[i] = QuantizeUnsigned(particle.mScale.x, RECORDING_SCALE_STEP);
+            scaleY[i] = QuantizeUnsigned(particle.mScale.y, RECORDING_SCALE_STEP);
+            colorR[i] = QuantizeUnsigned(particle.mColor.r, RECORDING_COLOR_STEP);
+            colorG[i] = QuantizeUnsigned(particle.mColor.g, RECORDING_COLOR_STEP);
+            colorB[i] = QuantizeUnsigned(particle.mColor.b, RECORDING_COLOR_STEP);
+            lifetimes[i] = particle.mLifetime < 0.f ? 0 : std::max(QuantizeUnsigned(particle.mLifetime, RECORDING_LIFETIME_STEP), static_cast<unsigned short>(1));
+        }
+
+        int* cloudX = GetColumn<int>(data, layout, CLOUD_POSITION_X);
+        int* cloudY = GetColumn<int>(data, layout, CLOUD_POSITION_Y);
+        int* cloudZ = GetColumn<int>(data, layout, CLOUD_POSITION_Z);
+        unsigned short* radii = GetColumn<unsigned short>(data, layout, CLOUD_RADIUS);
+        unsigned short* cloudR = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_R);
+        unsigned short* cloudG = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_G);
+        unsigned short* cloudB = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_B);
+        for (unsigned int i = 0; i < layout.counts[CLOUD_RADIUS]; ++i)
+        {
+            const ParticleCloud& particleCloud = frame.particleClouds[i];
+            cloudX[i] = QuantizePosition(particleCloud.mPosition.x, positionStep);
+            cloudY[i] = QuantizePosition(particleCloud.mPosition.y, positionStep);
+            cloudZ[i] = QuantizePosition(particleCloud.mPosition.z, positionStep);
+            radii[i] = QuantizeUnsigned(particleCloud.mRadius, RECORDING_SCALE_STEP);
+            cloudR[i] = QuantizeUnsigned(particleCloud.mColor.r, RECORDING_COLOR_STEP);
+            cloudG[i] = QuantizeUnsigned(particleCloud.mColor.g, RECORDING_COLOR_STEP);
+            cloudB[i] = QuantizeUnsigned(particleCloud.mColor.b, RECORDING_COLOR_STEP);
+        }
+    }
+
+    void Dequantize(const unsigned char* data, float positionStep, const Layout& layout, RecordingFrame& frame)
+    {
+        unsigned int numParticles = static_cast<unsigned int>(frame.particles.size());
+        const int* minX = GetColumn<int>(data, layout, BLOCK_MIN_X);
+        const int* minY = GetColumn<int>(data, layout, BLOCK_MIN_Y);
+        const int* minZ = GetColumn<int>(data, layout, BLOCK_MIN_Z);
+        const unsigned char* shifts = GetColumn<unsigned char>(data, layout, BLOCK_SHIFT);
+        const unsigned short* offsetX = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_X);
+        const unsigned short* offsetY = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_Y);
+        const unsigned short* offsetZ = GetColumn<unsigned short>(data, layout, PARTICLE_OFFSET_Z);
+        const unsigned short* scaleX = GetColumn<unsigned short>(data, layout, PARTICLE_SCALE_X);
+        const unsigned short* scaleY = GetColumn<unsigned short>(data, layout, PARTICLE_SCALE_Y);
+        const unsigned short* colorR = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_R);
+        const unsigned short* colorG = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_G);
+        const unsigned short* colorB = GetColumn<unsigned short>(data, layout, PARTICLE_COLOR_B);
+        const unsigned short* lifetimes = GetColumn<unsigned short>(data, layout, PARTICLE_LIFETIME);
+        for (unsigned int i = 0; i < numParticles; ++i)
+        {
+            unsigned int b = i / RECORDING_BLOCK_SIZE;
+            Particle& particle = frame.particles[i];
+            particle.mPosition.x = (minX[b] + (static_cast<long long>(offsetX[i]) << shifts[b])) * positionStep;
+            particle.mPosition.y = (minY[b] + (static_cast<long long>(offsetY[i]) << shifts[b])) * positionStep;
+            particle.mPosition.z = (minZ[b] + (static_cast<long long>(offsetZ[i]) << shifts[b])) * positionStep;
+            particle.mScale = glm::vec2(scaleX[i], scaleY[i]) * RECORDING_SCALE_STEP;
+            particle.mColor = glm::vec3(colorR[i], colorG[i], colorB[i]) * RECORDING_COLOR_STEP;
+            particle.mVelocity = glm::vec3(0.f, 0.f, 0.f);
+            particle.mLifetime = lifetimes[i] == 0 ? -1.f : lifetimes[i] * RECORDING_LIFETIME_STEP;
+        }
+
+        const int* cloudX = GetColumn<int>(data, layout, CLOUD_POSITION_X);
+        const int* cloudY = GetColumn<int>(data, layout, CLOUD_POSITION_Y);
+        const int* cloudZ = GetColumn<int>(data, layout, CLOUD_POSITION_Z);
+        const unsigned short* radii = GetColumn<unsigned short>(data, layout, CLOUD_RADIUS);
+        const unsigned short* cloudR = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_R);
+        const unsigned short* cloudG = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_G);
+        const unsigned short* cloudB = GetColumn<unsigned short>(data, layout, CLOUD_COLOR_B);
+        for (unsigned int i = 0; i < layout.counts[CLOUD_RADIUS]; ++i)
+        {
+            ParticleCloud& particleCloud = frame.particleClouds[i];
+            particleCloud = ParticleCloud();
+            particleCloud.mPosition = glm::vec3(cloudX[i], cloudY[i], cloudZ[i]) * positionStep;
+            particleCloud.mRadius = radii[i] * RECORDING_SCALE_STEP;
+            particleCloud.mColor = glm::vec3(cloudR[i], cloudG[i], cloudB[i]) * RECORDING_COLOR_STEP;
+        }
+    }
+
+    // Appends values to bytes, least significant bit first.
+    class BitWriter
+    {
+        public:
+            BitWriter(std::vector<unsigned char>& out) : mOut(out), mBuffer(0), mNumBits(0)
+            {
+
+            }
+
+            // Append the low width bits of value, width at most 32.
+            void Write(unsigned int value, unsigned int width)
+            {
+                mBuffer |= static_cast<unsigned long long>(value) << mNumBits;
+                mNumBits += width;
+                for (; mNumBits >= 8; mNumBits -= 8, mBuffer >>= 8)
+                    mOut.push_back(static_cast<unsigned char>(mBuffer));
+            }
+
+            // Pad to a whole byte.
+            void Flush()
+            {
+                if (mNumBits > 0)
+                    mOut.push_back(static_cast<unsigned char>(mBuffer));
+                mBuffer = 0;
+                mNumBits = 0;
+            }
+
+        private:
+            std::vector<unsigned char>& mOut;
+            unsigned long long mBuffer;
+            unsigned int mNumBits;
+    };
+
+    // Reads values written by BitWriter.
+    class BitReader
+    {
+        public:
+            BitReader(const unsigned char*& in, const unsigned char* end) : mIn(in), mEnd(end), mBuffer(0), mNumBits(0)
+            {
+
+            }
+
+            // Read value of width bits, width at most 32.
+            // Returns false at the end of the data.
+            bool Read(unsigned int width, unsigned int& value)
+            {
+                for (; mNumBits < width; mNumBits += 8)
+                {
+                    if (mIn >= mEnd)
+                        return false;
+                    mBuffer |= static_cast<unsigned long long>(*mIn++) << mNumBits;
+                }
+                value = static_cast<unsigned int>(mBuffer & ((1ULL << width) - 1));
+                mBuffer >>= width;
+                mNumBits -= width;
+                return true;
+            }
+
+            // Skip padding to the next byte.
+            void Flush()
+            {
+                mBuffer = 0;
+                mNumBits = 0;
+            }
+
+        private:
+            const unsigned char*& mIn;
+            const unsigned char* mEnd;
+            unsigned long long mBuffer;
+            unsigned int mNumBits;
+    };
+
+    // Get number of significant bits of value.
+    unsigned int GetWidth(unsigned int value)
+    {
+        unsigned int width = 0;
+        for (; value != 0; value >>= 1)
+            ++width;
+        return width;
+    }
+
+    // Encode values as zigzag differences to their linear prediction from the two previous frames, so values moving
+    // at constant speed encode to zero. Differences are bit packed in groups of RECORDING_GROUP_SIZE with a width that
+    // fits most of them. Spawned and killed particles jump, those differences are stored as exceptions holding the
+    // index and the bits above the width.
+    // Group: width byte, exception count byte, [exception width byte], low bits, [exception indices], [exception high bits].
+    template <typename T>
+    void DeltaEncode(const unsigned char* current, const unsigned char* previous, const unsigned char* previous2, unsigned int count, std::vector<unsigned char>& out)
+    {
+        const T* c = reinterpret_cast<const T*>(current);
+        const T* p = reinterpret_cast<const T*>(previous);
+        const T* p2 = reinterpret_cast<const T*>(previous2);
+        const unsigned int maxWidth = sizeof(T) * 8;
+        BitWriter writer(out);
+        for (unsigned int begin = 0; begin < count; begin += RECORDING_GROUP_SIZE)
+        {
+            unsigned int n = std::min(RECORDING_GROUP_SIZE, count - begin);
+            unsigned int zigzags[RECORDING_GROUP_SIZE];
+            unsigned int numWithWidth[sizeof(T) * 8 + 1] = {};
+            for (unsigned int i = 0; i < n; ++i)
+            {
+                T d = static_cast<T>(c[begin + i] - static_cast<T>(2 * p[begin + i] - p2[begin + i]));
+                zigzags[i] = static_cast<T>(static_cast<T>(d << 1) ^ static_cast<T>(0 - (d >> (maxWidth - 1))));
+                ++numWithWidth[GetWidth(zigzags[i])];
+            }
+
+            // Choose width with the smallest size, wider values become exceptions.
+            unsigned int groupWidth = maxWidth;
+            while (numWithWidth[groupWidth] == 0 && groupWidth > 0)
+                --groupWidth;
+            unsigned int width = groupWidth;
+            unsigned int numExceptions = 0;
+            unsigned int bestSize = n * groupWidth;
+            for (unsigned int w = groupWidth, wider = 0; w-- > 0; )
+            {
+                wider += numWithWidth[w + 1];
+                unsigned int size = n * w + wider * (8 + groupWidth - w);
+                if (size < bestSize)
+                {
+                    bestSize = size;
+                    width = w;
+                    numExceptions = wider;
+                }
+            }
+
+            out.push_back(static_cast<unsigned char>(width));
+            out.push_back(static_cast<unsigned char>(numExceptions));
+            if (numExceptions > 0)
+                out.push_back(static_cast<unsigned char>(groupWidth));
+            for (unsigned int i = 0; i < n; ++i)
+                writer.Write(zigzags[i] & ((1ULL << width) - 1), width);
+            writer.Flush();
+            if (numExceptions > 0)
+            {
+                for (unsigned int i = 0; i < n; ++i)
+                    if (GetWidth(zigzags[i]) > width)
+                        out.push_back(static_cast<unsigned char>(i));
+                for (unsigned int i = 0; i < n; ++i)
+                    if (GetWidth(zigzags[i]) > width)
+                        writer.Write(zigzags[i] >> width, groupWidth - width);
+                writer.Flush();
+            }
+        }
+    }
+
+    // Decode differences encoded by DeltaEncode. Values advance to the decoded frame, previous2 to the frame before.
+    // Returns whether the encoded data was valid.
+    template <typename T>
+    bool DeltaDecode(const unsigned char*& in, const unsigned char* inEnd, unsigned char* values, unsigned char* previous2, unsigned int count)
+    {
+        T* v = reinterpret_cast<T*>(values);
+        T* p2 = reinterpret_cast<T*>(previous2);
+        const unsigned int maxWidth = sizeof(T) * 8;
+        BitReader reader(in, inEnd);
+        for (unsigned int begin = 0; begin < count; begin += RECORDING_GROUP_SIZE)
+        {
+            unsigned int n = std::min(RECORDING_GROUP_SIZE, count - begin);
+            if (inEnd - in < 2)
+                return false;
+            unsigned int width = *in++;
+            unsigned int numExceptions = *in++;
+            unsigned int groupWidth = width;
+            if (numExceptions > 0)
+                groupWidth = in < inEnd ? *in++ : maxWidth + 1;
+            if (groupWidth > maxWidth || width > groupWidth || numExceptions > n)
+                return false;
+
+            unsigned int zigzags[RECORDING_GROUP_SIZE];
+            for (unsigned int i = 0; i < n; ++i)
+                if (!reader.Read(width, zigzags[i]))
+                    return false;
+            reader.Flush();
+            if (numExceptions > 0)
+            {
+                if (static_cast<unsigned int>(inEnd - in) < numExceptions)
+                    return false;
+                const unsigned char* indices = in;
+                in += numExceptions;
+                for (unsigned int e = 0; e < numExceptions; ++e)
+                {
+                    unsigned int high;
+                    if (indices[e] >= n || !reader.Read(groupWidth - width, high))
+                        return false;
+                    zigzags[indices[e]] |= high << width;
+                }
+                reader.Flush();
+            }
+
+            for (unsigned int i = 0; i < n; ++i)
+            {
+                T zigzag = static_cast<T>(zigzags[i]);
+                T d = static_cast<T>((zigzag >> 1) ^ static_cast<T>(0 - (zigzag & 1)));
+                T previous = v[begin + i];
+                v[begin + i] = static_cast<T>(static_cast<T>(2 * previous - p2[begin + i]) + d);
+                p2[begin + i] = previous;
+            }
+        }
+        return true;
+    }
+
+    void DeltaEncode(const unsigned char* current, const unsigned char* previous, const unsigned char* previous2, const Layout& layout, std::vector<unsigned char>& out)
+    {
+        out.clear();
+        for (unsigned int c = 0; c < NUM_COLUMNS; ++c)
+        {
+            size_t offset = layout.offsets[c];
+            if (layout.elementSizes[c] == 4)
+                DeltaEncode<unsigned int>(current + offset, previous + offset, previous2 + offset, layout.counts[c], out);
+            else if (layout.elementSizes[c] == 2)
+                DeltaEncode<unsigned short>(current + offset, previous + offset, previous2 + offset, layout.counts[c], out);
+            else
+                DeltaEncode<unsigned char>(current + offset, previous + offset, previous2 + offset, layout.counts[c], out);
+        }
+    }
+
+    bool DeltaDecode(const std::vector<unsigned char>& in, const Layout& layout, unsigned char* values, unsigned char* previous2)
+    {
+        const unsigned char* data = in.data();
+        const unsigned char* dataEnd = data + in.size();
+        for (unsigned int c = 0; c < NUM_COLUMNS; ++c)
+        {
+            size_t offset = layout.offsets[c];
+            bool valid;
+            if (layout.elementSizes[c] == 4)
+                valid = DeltaDecode<unsigned int>(data, dataEnd, values + offset, previous2 + offset, layout.counts[c]);
+            else if (layout.elementSizes[c] == 2)
+                valid = DeltaDecode<unsigned short>(data, dataEnd, values + offset, previous2 + offset, layout.counts[c]);
+            else
+                valid = DeltaDecode<unsigned char>(data, dataEnd, values + offset, previous2 + offset, layout.counts[c]);
+            if (!valid)
+                return false;
+        }
+        return data == dataEnd;
+    }
+
+    // Append literal bytes in runs of at most RECORDING_MAX_LITERAL_RUN, each prefixed by its length - 1.
+    void AppendLiterals(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        while (size > 0)
+        {
+            size_t length = std::min(size, static_cast<size_t>(RECORDING_MAX_LITERAL_RUN));
+            out.push_back(static_cast<unsigned char>(length - 1));
+            out.insert(out.end(), data, data + length);
+            data += length;
+            size -= length;
+        }
+    }
+
+    // Run-length compress zero bytes. Tokens are literal runs (0x00 - 0x7F, length - 1) or zero runs (0x80, length as varint).
+    void Compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+    {
+        out.clear();
+        size_t literalStart = 0;
+        size_t i = 0;
+        while (i < size)
+        {
+            if (data[i] != 0)
+            {
+                ++i;
+                continue;
+            }
+
+            size_t runEnd = i;
+            while (runEnd < size && data[runEnd] == 0)
+                ++runEnd;
+            if (runEnd - i < RECORDING_MIN_ZERO_RUN)
+            {
+                i = runEnd;
+                continue;
+            }
+
+            AppendLiterals(data + literalStart, i - literalStart, out);
+            out.push_back(0x80);
+            for (size_t length = runEnd - i; ; length >>= 7)
+            {
+                if (length < 0x80)
+                {
+                    out.push_back(static_cast<unsigned char>(length));
+                    break;
+                }
+                out.push_back(static_cast<unsigned char>(0x80 | (length & 0x7F)));
+            }
+            i = runEnd;
+            literalStart = i;
+        }
+        AppendLiterals(data + literalStart, size - literalStart, out);
+    }
+
+    // Decompress data compressed by Compress.
+    // Returns whether data decompressed to exactly size bytes.
+    bool Decompress(const unsigned char* in, size_t inSize, unsigned char* data, size_t size)
+    {
+        size_t i = 0;
+        size_t o = 0;
+        while (i < inSize)
+        {
+            unsigned char token = in[i++];
+            if (token < 0x80)
+            {
+                size_t length = static_cast<size_t>(token) + 1;
+                if (i + length > inSize || o + length > size)
+                    return false;
+                memcpy(data + o, in + i, length);
+                i += length;
+                o += length;
+            }
+            else
+            {
+                size_t length = 0;
+                for (unsigned int shift = 0; ; shift += 7)
+                {
+                    if (i >= inSize || shift > 56)
+                        return false;
+                    unsigned char byte = in[i++];
+                    length |= static_cast<size_t>(byte & 0x7F) << shift;
+                    if (byte < 0x80)
+                        break;
+                }
+                if (o + length > size)
+                    return false;
+                memset(data + o, 0, length);
+                o += length;
+            }
+        }
+        return o == size;
+    }
+
+    bool Seek(FILE* file, long long offset, int origin)
+    {
+#ifdef _WIN32
+        return _fseeki64(file, offset, origin) == 0;
+#else
+        return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+    }
+}
+
+Recorder::Recorder(const std::string& path, unsigned int numParticles, unsigned int numParticleClouds, float positionStep, unsigned int chunkFrames, unsigned int latency) : mPipeline(latency)
+{
+    mHeader.magic = RECORDING_MAGIC;
+    mHeader.version = RECORDING_VERSION;
+    mHeader.numParticles = numParticles;
+    mHeader.numParticleClouds = numParticleClouds;
+    mHeader.chunkFrames = chunkFrames > 0 ? chunkFrames : 1;
+    mHeader.positionStep = positionStep;
+
+    mOffset = 0;
+    mNumFrames = 0;
+    mEncodedBytes = 0;
+    mEncodeTime = 0;
+    mFailed = false;
+    mClosed = false;
+
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile != nullptr)
+    {
+        mFailed = fwrite(&mHeader, sizeof(RecordingHeader), 1, mFile) != 1;
+        mOffset = sizeof(RecordingHeader);
+    }
+
+    // Preallocate slots and encoder buffers.
+    for (unsigned int i = 0; i < mPipeline.GetLatency(); ++i)
+    {
+        mPipeline.GetSlot(i).particles.resize(numParticles);
+        mPipeline.GetSlot(i).particleClouds.resize(numParticleClouds);
+    }
+    size_t size = GetLayout(numParticles, numParticleClouds).size;
+    mQuantized.resize(size);
+    mPrevious.resize(size);
+    mPrevious2.resize(size);
+    mDelta.reserve(size + size / RECORDING_GROUP_SIZE + NUM_COLUMNS);
+    mCompressed.reserve(mDelta.capacity() + mDelta.capacity() / RECORDING_MAX_LITERAL_RUN + 16);
+
+    mThread = std::thread(&Recorder::EncoderThread, this);
+}
+
+Recorder::~Recorder()
+{
+    Close();
+}
+
+bool Recorder::IsOpen() const
+{
+    return mFile != nullptr;
+}
+
+const RecordingHeader& Recorder::GetHeader() const
+{
+    return mHeader;
+}
+
+RecordingFrame* Recorder::BeginFrame()
+{
+    return mPipeline.BeginWrite();
+}
+
+void Recorder::EndFrame()
+{
+    mPipeline.EndWrite();
+}
+
+bool Recorder::Close()
+{
+    if (mClosed)
+        return !mFailed;
+    mClosed = true;
+
+    mPipeline.Close();
+    mThread.join();
+    if (mFile == nullptr)
+        return false;
+
+    // Seek index and footer.
+    Footer footer;
+    footer.magic = RECORDING_INDEX_MAGIC;
+    footer.numChunks = static_cast<unsigned int>(mChunks.size());
+    footer.indexOffset = mOffset;
+    if (!mChunks.empty() && fwrite(mChunks.data(), sizeof(RecordingChunk), mChunks.size(), mFile) != mChunks.size())
+        mFailed = true;
+    if (fwrite(&footer, sizeof(Footer), 1, mFile) != 1)
+        mFailed = true;
+    if (fclose(mFile) != 0)
+        mFailed = true;
+    mFile = nullptr;
+    return !mFailed;
+}
+
+unsigned int Recorder::GetNumFrames() const
+{
+    return mNumFrames;
+}
+
+unsigned long long Recorder::GetRawBytes() const
+{
+    return static_cast<unsigned long long>(mNumFrames) * (sizeof(Particle) * mHeader.numParticles + sizeof(ParticleCloud) * mHeader.numParticleClouds);
+}
+
+unsigned long long Recorder::GetEncodedBytes() const
+{
+    return mEncodedBytes;
+}
+
+long long Recorder::GetEncodeTime() const
+{
+    return mEncodeTime;
+}
+
+void Recorder::EncoderThread()
+{
+    Layout layout = GetLayout(mHeader.numParticles, mHeader.numParticleClouds);
+    const RecordingFrame* frame;
+    while ((frame = mPipeline.BeginRead()) != nullptr)
+    {
+        long long startTime = Profiler::Now();
+
+        // First frame of a chunk is encoded against zeros.
+        bool keyframe = mNumFrames % mHeader.chunkFrames == 0;
+        if (keyframe)
+        {
+            RecordingChunk chunk;
+            chunk.offset = mOffset;
+            chunk.firstFrame = mNumFrames;
+            chunk.numFrames = 0;
+            mChunks.push_back(chunk);
+            std::fill(mPrevious.begin(), mPrevious.end(), static_cast<unsigned char>(0));
+            std::fill(mPrevious2.begin(), mPrevious2.end(), static_cast<unsigned char>(0));
+        }
+
+        // Release slot as soon as it is quantized.
+        FrameHeader frameHeader;
+        frameHeader.time = frame->time;
+        frameHeader.cameraPosition = frame->cameraPosition;
+        frameHeader.cameraFrontDirection = frame->cameraFrontDirection;
+        frameHeader.cameraUpDirection = frame->cameraUpDirection;
+        Quantize(*frame, mHeader.positionStep, layout, mQuantized.data());
+        mPipeline.EndRead();
+
+        DeltaEncode(mQuantized.data(), mPrevious.data(), mPrevious2.data(), layout, mDelta);
+        Compress(mDelta.data(), mDelta.size(), mCompressed);
+        frameHeader.encodedSize = static_cast<unsigned int>(mCompressed.size());
+        frameHeader.packedSize = static_cast<unsigned int>(mDelta.size());
+
+        if (mFile != nullptr && !mFailed)
+        {
+            mFailed = fwrite(&frameHeader, sizeof(FrameHeader), 1, mFile) != 1 ||
+                fwrite(mCompressed.data(), 1, mCompressed.size(), mFile) != mCompressed.size();
+        }
+        mOffset += sizeof(FrameHeader) + mCompressed.size();
+        mEncodedBytes += sizeof(FrameHeader) + mCompressed.size();
+        ++mChunks.back().numFrames;
+        ++mNumFrames;
+        // The frame after a keyframe is predicted without motion.
+        mPrevious2.swap(mPrevious);
+        mPrevious.swap(mQuantized);
+        if (keyframe)
+            mPrevious2 = mPrevious;
+
+        mEncodeTime += Profiler::Now() - startTime;
+    }
+}
+
+RecordingPlayer::RecordingPlayer()
+{
+    mFile = nullptr;
+    mNumFrames = 0;
+    mNextFrame = 0;
+}
+
+RecordingPlayer::~RecordingPlayer()
+{
+    if (mFile != nullptr)
+        fclose(mFile);
+}
+
+bool RecordingPlayer::Open(const std::string& path)
+{
+    if (mFile != nullptr)
+        fclose(mFile);
+    mChunks.clear();
+    mNumFrames = 0;
+
+    mFile = fopen(path.c_str(), "rb");
+    if (mFile == nullptr)
+        return false;
+
+    Footer footer;
+    bool valid = fread(&mHeader, sizeof(RecordingHeader), 1, mFile) == 1 &&
+        mHeader.magic == RECORDING_MAGIC &&
+        mHeader.version == RECORDING_VERSION &&
+        mHeader.chunkFrames > 0 &&
+        Seek(mFile, -static_cast<long long>(sizeof(Footer)), SEEK_END) &&
+        fread(&footer, sizeof(Footer), 1, mFile) == 1 &&
+        footer.magic == RECORDING_INDEX_MAGIC;
+    if (valid)
+    {
+        mChunks.resize(footer.numChunks);
+        valid = !mChunks.empty() &&
+            Seek(mFile, static_cast<long long>(footer.indexOffset), SEEK_SET) &&
+            fread(mChunks.data(), sizeof(RecordingChunk), mChunks.size(), mFile) == mChunks.size();
+    }
+    // A recording without frames has nothing to play.
+    if (valid)
+    {
+        for (const RecordingChunk& chunk : mChunks)
+            mNumFrames += chunk.numFrames;
+        valid = mNumFrames > 0;
+    }
+    if (!valid)
+    {
+        fclose(mFile);
+        mFile = nullptr;
+        mChunks.clear();
+        mNumFrames = 0;
+        return false;
+    }
+
+    size_t size = GetLayout(mHeader.numParticles, mHeader.numParticleClouds).size;
+    mQuantized.resize(size);
+    mPrevious2.resize(size);
+    // Force seek on first read.
+    mNextFrame = UINT_MAX;
+    return true;
+}
+
+const RecordingHeader& RecordingPlayer::GetHeader() const
+{
+    return mHeader;
+}
+
+unsigned int RecordingPlayer::GetNumFrames() const
+{
+    return mNumFrames;
+}
+
+bool RecordingPlayer::ReadFrame(unsigned int index, RecordingFrame& frame)
+{
+    if (mFile == nullptr || index >= mNumFrames)
+        return false;
+
+    // Seek to start of chunk unless the frame continues the current chunk.
+    const RecordingChunk& chunk = mChunks[index / mHeader.chunkFrames];
+    if (mNextFrame > index || mNextFrame < chunk.firstFrame)
+    {
+        if (!Seek(mFile, static_cast<long long>(chunk.offset), SEEK_SET))
+            return false;
+        mNextFrame = chunk.firstFrame;
+    }
+
+    while (mNextFrame <= index)
+    {
+        bool keyframe = mNextFrame % mHeader.chunkFrames == 0;
+        if (keyframe)
+        {
+            std::fill(mQuantized.begin(), mQuantized.end(), static_cast<unsigned char>(0));
+            std::fill(mPrevious2.begin(), mPrevious2.end(), static_cast<unsigned char>(0));
+        }
+        if (!DecodeNext(frame))
+        {
+            mNextFrame = UINT_MAX;
+            return false;
+        }
+        if (keyframe)
+            mPrevious2 = mQuantized;
+        ++mNextFrame;
+    }
+
+    frame.particles.resize(mHeader.numParticles);
+    frame.particleClouds.resize(mHeader.numParticleClouds);
+    Dequantize(mQuantized.data(), mHeader.positionStep, GetLayout(mHeader.numParticles, mHeader.numParticleClouds), frame);
+    return true;
+}
+
+bool RecordingPlayer::DecodeNext(RecordingFrame& frame)
+{
+    FrameHeader frameHeader;
+    if (fread(&frameHeader, sizeof(FrameHeader), 1, mFile) != 1)
+        return false;
+    mCompressed.resize(frameHeader.encodedSize);
+    if (frameHeader.encodedSize > 0 && fread(mCompressed.data(), 1, mCompressed.size(), mFile) != mCompressed.size())
+        return false;
+    mDelta.resize(frameHeader.packedSize);
+    if (!Decompress(mCompressed.data(), mCompressed.size(), mDelta.data(), mDelta.size()))
+        return false;
+    if (!DeltaDecode(mDelta, GetLayout(mHeader.numParticles, mHeader.numParticleClouds), mQuantized.data(), mPrevious2.data()))
+        return false;
+
+    frame.time = frameHeader.time;
+    frame.cameraPosition = frameHeader.cameraPosition;
+    frame.cameraFrontDirection = frameHeader.cameraFrontDirection;
+    frame.cameraUpDirection = frameHeader.cameraUpDirection;
+    return true;
+}
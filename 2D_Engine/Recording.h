@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdio>
+#include <glm/glm.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FramePipeline.h"
+#include "Particle.h"
+#include "ParticleCloud.h"
+
+// Recording file identifier, "PREC" in a little-endian file.
+#define RECORDING_MAGIC 0x43455250U
+
+// Recording format version. Increment when the quantization or file layout changes.
+#define RECORDING_VERSION 1U
+
+// Default position quantization step in world units.
+#define RECORDING_POSITION_STEP (1.f / 1024.f)
+
+// Default number of frames per chunk. The first frame of a chunk is stored without delta, so chunks decode on their own.
+#define RECORDING_CHUNK_FRAMES 64U
+
+// Number of consecutive particles sharing position bounds. Matches the particles owned by one cloud.
+#define RECORDING_BLOCK_SIZE 8U
+
+// Particles and particle clouds of a recorded frame, with the camera it was viewed from.
+// Decoded frames hold quantized values: particle velocities and cloud simulation fields are not recorded and are zero.
+struct RecordingFrame
+{
+    std::vector<Particle> particles;
+    std::vector<ParticleCloud> particleClouds;
+    // Simulated time in seconds.
+    double time;
+    // Camera.
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraFrontDirection;
+    glm::vec3 cameraUpDirection;
+};
+
+// Header at the start of a recording file.
+struct RecordingHeader
+{
+    // RECORDING_MAGIC.
+    unsigned int magic;
+    // RECORDING_VERSION.
+    unsigned int version;
+    // Number of particles and particle clouds per frame.
+    unsigned int numParticles;
+    unsigned int numParticleClouds;
+    // Number of frames per chunk.
+    unsigned int chunkFrames;
+    // Position quantization step in world units.
+    float positionStep;
+};
+
+// Seek index entry of a chunk.
+struct RecordingChunk
+{
+    // Byte offset of the chunk's first frame.
+    unsigned long long offset;
+    // Index of the chunk's first frame.
+    unsigned int firstFrame;
+    // Number of frames in the chunk.
+    unsigned int numFrames;
+};
+
+// Records particle and particle cloud state every frame into a chunked, compressed file.
+// Positions are quantized relative to the bounds of each block of particles, every field is delta encoded against
+// its linear prediction from the previous two frames, bit packed and run-length compressed.
+// The frame loop only copies state into a pipeline slot, encoding and writing happen on a background thread.
+class Recorder
+{
+    public:
+        // Constructor. Creates file and starts encoder thread.
+        // path File path.
+        // numParticles Number of particles per frame.
+        // numParticleClouds Number of particle clouds per frame.
+        // positionStep Position quantization step in world units.
+        // chunkFrames Number of frames per chunk.
+        // latency Number of frames that may wait for the encoder before BeginFrame blocks.
+        Recorder(const std::string& path, unsigned int numParticles, unsigned int numParticleClouds, float positionStep = RECORDING_POSITION_STEP, unsigned int chunkFrames = RECORDING_CHUNK_FRAMES, unsigned int latency = FRAME_PIPELINE_LATENCY);
+
+        // Destructor. Closes recording.
+        ~Recorder();
+
+        // Get whether file could be created.
+        bool IsOpen() const;
+
+        // Get header, holding the number of particles and particle clouds of every frame.
+        const RecordingHeader& GetHeader() const;
+
+        // Get slot to fill with the next frame. Blocks while the encoder is behind by latency frames.
+        // Returns slot with arrays sized to the recorded counts, nullptr if recording is closed.
+        RecordingFrame* BeginFrame();
+
+        // Queue slot returned by BeginFrame for encoding.
+        void EndFrame();
+
+        // Encode queued frames, write seek index and close file.
+        // Returns whether every frame was written.
+        bool Close();
+
+        // Get number of recorded frames. Statistics are valid after Close.
+        unsigned int GetNumFrames() const;
+
+        // Get uncompressed size of recorded frames in bytes.
+        unsigned long long GetRawBytes() const;
+
+        // Get size of encoded frames in bytes.
+        unsigned long long GetEncodedBytes() const;
+
+        // Get total time the encoder thread spent on frames in nanoseconds.
+        long long GetEncodeTime() const;
+
+    private:
+        void EncoderThread();
+
+        FILE* mFile;
+        RecordingHeader mHeader;
+        FramePipeline<RecordingFrame> mPipeline;
+        std::thread mThread;
+        std::vector<RecordingChunk> mChunks;
+        std::vector<unsigned char> mQuantized;
+        std::vector<unsigned char> mPrevious;
+        std::vector<unsigned char> mPrevious2;
+        std::vector<unsigned char> mDelta;
+        std::vector<unsigned char> mCompressed;
+        unsigned long long mOffset;
+        unsigned int mNumFrames;
+        unsigned long long mEncodedBytes;
+        long long mEncodeTime;
+        bool mFailed;
+        bool mClosed;
+};
+
+// Plays back a recording. Frames are decoded in sequence, seeking decodes from the start of the frame's chunk.
+class RecordingPlayer
+{
+    public:
+        // Constructor.
+        RecordingPlayer();
+
+        // Destructor.
+        ~RecordingPlayer();
+
+        // Open recording and read its seek index.
+        // path File path.
+        // Returns whether file is a valid recording of this version with at least one frame.
+        bool Open(const std::string& path);
+
+        // Get header.
+        const RecordingHeader& GetHeader() const;
+
+        // Get number of frames.
+        unsigned int GetNumFrames() const;
+
+        // Decode frame.
+        // index Frame index.
+        // frame Decoded frame, arrays are resized to the recorded counts.
+        // Returns whether frame could be read.
+        bool ReadFrame(unsigned int index, RecordingFrame& frame);
+
+    private:
+        // Read frame at the file position and apply its deltas to mQuantized and mPrevious2.
+        // frame Receives time and camera of the frame.
+        bool DecodeNext(RecordingFrame& frame);
+
+        FILE* mFile;
+        RecordingHeader mHeader;
+        std::vector<RecordingChunk> mChunks;
+        std::vector<unsigned char> mQuantized;
+        std::vector<unsigned char> mPrevious2;
+        std::vector<unsigned char> mDelta;
+        std::vector<unsigned char> mCompressed;
+        unsigned int mNumFrames;
+        unsigned int mNextFrame;
+};
@@ -1,22 +1,26 @@
 #include "Renderer.h"
 #include "DxAssert.h"
 #include "Texture.h"
+#include "ParticleDepthSorter.h"
 #include "ParticleRenderer.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
-Renderer::Renderer(unsigned int width, unsigned int height) 
+Renderer::Renderer(unsigned int width, unsigned int height, KernelCache& kernelCache) 
 {
     mWidth = width;
     mHeight = height;
     mClose = false;
     Initialise();
-    mParticleRenderer = new ParticleRenderer(mDevice, mDeviceContext);
+    mParticleRenderer = new ParticleRenderer(mDevice, mDeviceContext, kernelCache);
+    mParticleDepthSorter = nullptr;
+    mAlphaBlending = false;
 }
 
 Renderer::~Renderer() 
 {
     delete mParticleRenderer;
+    delete mParticleDepthSorter;
     mDevice->Release();
     mDeviceContext->Release();
     mSwapChain->Release();
@@ -53,16 +57,46 @@ void Renderer::Close()
     mClose = true;
 }
 
-void Renderer::Render(Scene& scene) const
+void Renderer::SetAlphaBlending(bool alphaBlending)
+{
+    mAlphaBlending = alphaBlending;
+}
+
+bool Renderer::GetAlphaBlending() const
+{
+    return mAlphaBlending;
+}
+
+void Renderer::Render(Scene& scene)
 {
     // Clear render target.
     float clrColor[4] = { 0.f, 0.f, 0.f, 0.f };
     mDeviceContext->ClearRenderTargetView(mBackBufferRTV, clrColor);
 
     // Render particles.
-    mParticleRenderer->Bind(mBackBufferRTV, nullptr);
-    glm::mat4 vpMatrix = glm::transpose(glm::perspectiveFovLH(45.f, (float)mWidth, (float)mHeight, 0.01f, 2000.f) * scene.mCamera.mViewMatrix);
-    mParticleRenderer->Render(vpMatrix, scene.mCamera.mPosition, scene);
+    glm::mat4 vpMatrix = glm::perspectiveFovLH(45.f, (float)mWidth, (float)mHeight, 0.01f, 2000.f) * scene.mCamera.mViewMatrix;
+    if (mAlphaBlending)
+    {
+        // Sort visible particles back to front.
+        if (mParticleDepthSorter == nullptr || mParticles.size() < scene.mMaxNumParticles)
+        {
+            delete mParticleDepthSorter;
+            mParticleDepthSorter = new ParticleDepthSorter(scene.mMaxNumParticles);
+            mParticles.resize(scene.mMaxNumParticles);
+        }
+        scene.mParticlesGPUSwapBuffer->ReadBack(mParticles.data(), scene.mNumParticles);
+        unsigned int numIndices = mParticleDepthSorter->Sort(mParticles.data(), scene.mNumParticles, vpMatrix, true);
+
+        mParticleRenderer->SetBlendMode(ParticleRenderer::ALPHA);
+        mParticleRenderer->Bind(mBackBufferRTV, nullptr);
+        mParticleRenderer->Render(glm::transpose(vpMatrix), scene.mCamera.mPosition, scene, mParticleDepthSorter->GetSortedIndices(), numIndices);
+    }
+    else
+    {
+        mParticleRenderer->SetBlendMode(ParticleRenderer::ADDITIVE);
+        mParticleRenderer->Bind(mBackBufferRTV, nullptr);
+        mParticleRenderer->Render(glm::transpose(vpMatrix), scene.mCamera.mPosition, scene);
+    }
     mParticleRenderer->Unbind();
 
     // Present to window.
@@ -13,6 +13,8 @@
 
 #include "Scene.h"
 
+class KernelCache;
+class ParticleDepthSorter;
 class ParticleRenderer;
 
 // Window call back procedure.
@@ -25,7 +27,8 @@ class Renderer
         // Constructor.
         // mWidth Window width in pixels.
         // mHeight Window height in pixels.
-        Renderer(unsigned int mWidth, unsigned int mHeight);
+        // kernelCache Kernel cache holding the kernels registered by ParticleRenderer::AddKernels.
+        Renderer(unsigned int mWidth, unsigned int mHeight, KernelCache& kernelCache);
 
         // Destructor.
         ~Renderer();
@@ -38,7 +41,15 @@ class Renderer
 
         // Render scene.
         // scene Scene to render.
-        void Render(Scene& scene) const;
+        void Render(Scene& scene);
+
+        // Set whether particles are alpha blended. Alpha blending reads back the particles every frame to sort them
+        // back to front on the CPU, which stalls until the GPU has finished the frame.
+        // alphaBlending Whether to alpha blend, additive blending otherwise.
+        void SetAlphaBlending(bool alphaBlending);
+
+        // Get whether particles are alpha blended.
+        bool GetAlphaBlending() const;
 
         // Get key status.
         // vKey Windows virtual key.
@@ -88,6 +99,15 @@ class Renderer
         // Particle renderer used to renderer particles.
         ParticleRenderer* mParticleRenderer;
 
+        // Depth sorter of alpha blended particles, created on first use and recreated when the scene grows.
+        ParticleDepthSorter* mParticleDepthSorter;
+
+        // Particles read back for the depth sort.
+        std::vector<Particle> mParticles;
+
+        // Whether particles are alpha blended.
+        bool mAlphaBlending;
+
         // Window should close.
         bool mClose;
 };
@@ -1,115 +1,201 @@
 #include "Scene.h"
 
 #include "DxHelp.h"
+#include "ParticleCloudSorter.h"
+#include "Profiler.h"
+#include "SceneBuilder.h"
 
-#include <random>
 #include <time.h>
 #include <vector>
 
-Scene::Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int maxNumParticles, unsigned int maxNumParticleClouds)
+Scene::Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, JobSystem* jobSystem)
 {
     mpDevice = pDevice;
     mpDeviceContext = pDeviceContext;
 
+    // Cloud capacity is rounded up for the sorter, padding clouds are never live.
     mMaxNumParticles = maxNumParticles;
-    mMaxNumParticleClouds = maxNumParticleClouds;
+    mMaxNumParticleClouds = ParticleCloudSorter::GetCapacity(maxNumParticleClouds);
+    mNumParticles = maxNumParticles;
+    mNumParticleClouds = maxNumParticleClouds;
 
     // Populate particles array.
-    std::vector<Particle> particles;
-    std::vector<ParticleCloud> particleClouds;
-
-    float space = 0.5f;
-    int yAxis, xAxis;
-    yAxis = xAxis = sqrt(mMaxNumParticleClouds);
-
-    std::default_random_engine rng(time(0));
-    std::uniform_int_distribution<int> dist(-1000, 1000);
-
-    unsigned int index = 0;
-    for (int y = 0; y < yAxis; ++y)
-    {
-        for (int x = 0; x < xAxis; ++x)
-        {
-            ParticleCloud particleCloud;
-            particleCloud.mPosition = glm::vec3(x, 0.f, y) * space; // dist(rng) / 1000.f
-            particleCloud.mRadius = 0.2f;
-            particleCloud.mNumParticles = 8;
-            particleCloud.mParticleStartID = index;
-            index += particleCloud.mNumParticles;
-            particleCloud.mVelocity = -glm::normalize(particleCloud.mPosition + glm::vec3(0.01f, 0.f, 0.01f)) * (float)((x + y) == 0);
-            particleCloud.mColor = glm::vec3(0.f, 0.2f, 0.f);
-            particleCloud.mSpawntime = 0.01f + abs(dist(rng) / 1000.f) * 0.05f;
-            particleClouds.push_back(particleCloud);
-
-            for (unsigned int i = 0; i < particleCloud.mNumParticles; ++i)
-            {
-                Particle particle;
-                particle.mPosition = particleCloud.mPosition;
-                particle.mPosition.y = 5.f * ((float)i / particleCloud.mNumParticles);
-                particle.mScale = glm::vec2(0.2f, 0.2f) * 1.f;
-                particle.mColor = glm::vec3(i % 3, i % 2, 1.f);
-                particle.mVelocity = glm::vec3(particleCloud.mVelocity.x, 0.f, particleCloud.mVelocity.z);
-                particle.mLifetime = -1.f; // particleCloud.mNumParticles - i;
-                particles.push_back(particle);
-            }
-        }
-    }
-
-    //float r = 5.f;
-    //float s = r / std::cbrt(mMaxNumParticles) * 2; // Works-ish.
-    //for (float z = -r; z <= r; z += s) 
-    //{
-    //    for (float y = -r; y <= r; y += s)
-    //    {
-    //        for (float x = -r; x <= r; x += s)
-    //        {
-    //            if (mParticles.Size() < mMaxNumParticles) {
-    //                Particle particle = Particle();
-    //                particle.mPosition = glm::vec3(x + 0.01f * y + 0.01f * z, y, z);
-    //                particle.mScale = glm::vec2(0.2f, 0.2f);
-    //                particle.mVelocity = glm::vec3(0.f, 0.f, 0.f);
-    //                particle.mColor = glm::abs(glm::normalize(particle.mPosition));
-    //                mParticles.Push(particle);
-    //            }
-    //        }
-    //    }
-    //}
-
-    //for (int x = 0; x < mMaxNumParticles; ++x)
-    //{
-    //    Particle particle = Particle();
-    //    particle.mPosition = glm::vec3(x, 0, (float)x / mMaxNumParticles * 12);
-    //    particle.mScale = glm::vec2(0.45f, 0.45f);
-    //    particle.mVelocity = glm::vec3(-((float)x/ mMaxNumParticles * (float)x / mMaxNumParticles), 0.f, 0.f);
-    //    particle.mColor = glm::vec3(0.f, 0.2f, 0.f);
-    //    mParticles.Push(particle);
-    //}
-
-    //for (int x = 0; x < mMaxNumParticles; ++x)
-    //{
-    //    Particle particle = Particle();
-    //    particle.mPosition = glm::vec3(x, (float)x / mMaxNumParticles, 0);
-    //    particle.mScale = glm::vec2(0.45f, 0.45f);
-    //    particle.mVelocity = glm::vec3(0.f, 0.f, 0.f);
-    //    particle.mColor = glm::vec3((float)x / mMaxNumParticles, 0.2f, 0.f);
-    //    mParticles.Push(particle);
-    //}
+    long long startTime = Profiler::Now();
+    std::vector<Particle> particles(mMaxNumParticles);
+    std::vector<ParticleCloud> particleClouds(mMaxNumParticleClouds);
+    mStartupTimings.allocate = Profiler::Now() - startTime;
+    mSeed = static_cast<unsigned int>(time(0));
+    mDistribution = SceneBuilder::GRID;
+    SceneBuilder::Build(mDistribution, mNumParticles, mNumParticleClouds, mSeed, particles.data(), particleClouds.data(), jobSystem, &mStartupTimings);
 
     // Create buffer and init particle data.
-    if (particles.size() < mMaxNumParticles)
-        for (unsigned int i = particles.size(); i < mMaxNumParticles; ++i)
-            particles.push_back(Particle());
-    //if (particleClouds.size() < mMaxNumParticleClouds)
-    //    for (unsigned int i = 0; i < mMaxNumParticles - particleClouds.size(); ++i)
-    //        particleClouds.push_back(ParticleCloud());
-    assert(particles.size() == mMaxNumParticles);
-    assert(particleClouds.size() == mMaxNumParticleClouds);
+    long long uploadTime = Profiler::Now();
     mParticlesGPUSwapBuffer = new GPUSwapBuffer<Particle>(mpDevice, mpDeviceContext, mMaxNumParticles, particles.data());
     mParticleCloudsGPUSwapBuffer = new GPUSwapBuffer<ParticleCloud>(mpDevice, mpDeviceContext, mMaxNumParticleClouds, particleClouds.data());
+    mStartupTimings.upload = Profiler::Now() - uploadTime;
+
+#if WORK_COUNTERS
+    mWorkCounters = new GPUWorkCounters(mpDevice, mpDeviceContext);
+#endif
+}
+
+Scene::Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const SceneBuilder::Description& description, JobSystem* jobSystem)
+{
+    mpDevice = pDevice;
+    mpDeviceContext = pDeviceContext;
+
+    // Cloud capacity is rounded up for the sorter, padding clouds are never live.
+    mNumParticleClouds = SceneBuilder::GetNumParticleClouds(description);
+    mNumParticles = mNumParticleClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+    mMaxNumParticleClouds = ParticleCloudSorter::GetCapacity(mNumParticleClouds);
+    mMaxNumParticles = mNumParticles;
+
+    // Expand description into particles array.
+    long long startTime = Profiler::Now();
+    std::vector<Particle> particles(mMaxNumParticles);
+    std::vector<ParticleCloud> particleClouds(mMaxNumParticleClouds);
+    mStartupTimings.allocate = Profiler::Now() - startTime;
+    mSeed = description.seed;
+    mDistribution = description.groups.front().distribution;
+    SceneBuilder::Build(description, mNumParticles, particles.data(), particleClouds.data(), jobSystem, &mStartupTimings);
+
+    // Create buffer and init particle data.
+    long long uploadTime = Profiler::Now();
+    mParticlesGPUSwapBuffer = new GPUSwapBuffer<Particle>(mpDevice, mpDeviceContext, mMaxNumParticles, particles.data());
+    mParticleCloudsGPUSwapBuffer = new GPUSwapBuffer<ParticleCloud>(mpDevice, mpDeviceContext, mMaxNumParticleClouds, particleClouds.data());
+    mStartupTimings.upload = Profiler::Now() - uploadTime;
+
+#if WORK_COUNTERS
+    mWorkCounters = new GPUWorkCounters(mpDevice, mpDeviceContext);
+#endif
+}
+
+Scene::Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const Snapshot& snapshot)
+{
+    mpDevice = pDevice;
+    mpDeviceContext = pDeviceContext;
+
+    const SnapshotHeader& header = snapshot.GetHeader();
+    mMaxNumParticles = header.numParticles;
+    mMaxNumParticleClouds = ParticleCloudSorter::GetCapacity(header.numParticleClouds);
+    mNumParticles = header.numParticles;
+    mNumParticleClouds = header.numParticleClouds;
+    mSeed = header.seed;
+    mDistribution = static_cast<SceneBuilder::Distribution>(header.distribution);
+    mCamera.mPosition = header.cameraPosition;
+    mCamera.mFrontDirection = header.cameraFrontDirection;
+    mCamera.mUpDirection = header.cameraUpDirection;
+    mCamera.mRightDirection = header.cameraRightDirection;
+
+    // Create buffers from mapped snapshot.
+    mStartupTimings.allocate = 0;
+    mStartupTimings.generate = 0;
+    mStartupTimings.clear = 0;
+    long long uploadTime = Profiler::Now();
+    mParticlesGPUSwapBuffer = new GPUSwapBuffer<Particle>(mpDevice, mpDeviceContext, mMaxNumParticles, snapshot.GetParticles());
+    // The snapshot only holds the live clouds, the padding of the rounded up capacity is left uninitialised.
+    mParticleCloudsGPUSwapBuffer = new GPUSwapBuffer<ParticleCloud>(mpDevice, mpDeviceContext, mMaxNumParticleClouds);
+    mParticleCloudsGPUSwapBuffer->Write(snapshot.GetParticleClouds(), 0, mNumParticleClouds);
+    mStartupTimings.upload = Profiler::Now() - uploadTime;
+
+#if WORK_COUNTERS
+    mWorkCounters = new GPUWorkCounters(mpDevice, mpDeviceContext);
+#endif
 }
 
 Scene::~Scene()
 {
     delete mParticlesGPUSwapBuffer;
     delete mParticleCloudsGPUSwapBuffer;
+#if WORK_COUNTERS
+    delete mWorkCounters;
+#endif
+}
+
+bool Scene::Checkpoint(SnapshotWriter& writer, const std::string& path, unsigned long long frame, double time)
+{
+    Particle* particles;
+    ParticleCloud* particleClouds;
+    if (!writer.Begin(mNumParticles, mNumParticleClouds, &particles, &particleClouds))
+        return false;
+
+    // Read back directly into the writer's staging arrays.
+    mParticlesGPUSwapBuffer->ReadBack(particles, mNumParticles);
+    mParticleCloudsGPUSwapBuffer->ReadBack(particleClouds, mNumParticleClouds);
+
+    SnapshotHeader header = Snapshot::CreateHeader(mNumParticles, mNumParticleClouds);
+    header.seed = mSeed;
+    header.distribution = mDistribution;
+    header.frame = frame;
+    header.time = time;
+    header.cameraPosition = mCamera.mPosition;
+    header.cameraFrontDirection = mCamera.mFrontDirection;
+    header.cameraUpDirection = mCamera.mUpDirection;
+    header.cameraRightDirection = mCamera.mRightDirection;
+    writer.End(path, header);
+    return true;
+}
+
+void Scene::Reserve(unsigned int numParticleClouds)
+{
+    // Clouds grow to at least the sorter's capacity, so they stay sortable however the capacity was reached.
+    mParticleCloudsGPUSwapBuffer->Reserve(ParticleCloudSorter::GetCapacity(numParticleClouds), mNumParticleClouds);
+    mParticlesGPUSwapBuffer->Reserve(mParticleCloudsGPUSwapBuffer->GetCapacity() * SceneBuilder::PARTICLES_PER_CLOUD, mNumParticles);
+    mMaxNumParticleClouds = mParticleCloudsGPUSwapBuffer->GetCapacity();
+    mMaxNumParticles = mParticlesGPUSwapBuffer->GetCapacity();
+}
+
+void Scene::AddParticleClouds(const ParticleCloud* particleClouds, const Particle* particles, unsigned int numParticleClouds)
+{
+    if (numParticleClouds == 0)
+        return;
+
+    // Clouds own consecutive particle ranges, new clouds start at the first particle after the live ones.
+    std::vector<ParticleCloud> rebasedParticleClouds(particleClouds, particleClouds + numParticleClouds);
+    unsigned int firstParticle = (mNumParticles + SceneBuilder::PARTICLES_PER_CLOUD - 1) / SceneBuilder::PARTICLES_PER_CLOUD * SceneBuilder::PARTICLES_PER_CLOUD;
+    for (unsigned int i = 0; i < numParticleClouds; ++i)
+        rebasedParticleClouds[i].mParticleStartID = firstParticle + i * SceneBuilder::PARTICLES_PER_CLOUD;
+
+    Reserve(mNumParticleClouds + numParticleClouds);
+    unsigned int numParticles = numParticleClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+    mParticlesGPUSwapBuffer->Reserve(firstParticle + numParticles, mNumParticles);
+    mMaxNumParticles = mParticlesGPUSwapBuffer->GetCapacity();
+    mParticleCloudsGPUSwapBuffer->Write(rebasedParticleClouds.data(), mNumParticleClouds, numParticleClouds);
+    mParticlesGPUSwapBuffer->Write(particles, firstParticle, numParticles);
+    mNumParticleClouds += numParticleClouds;
+    mNumParticles = firstParticle + numParticles;
+}
+
+bool Scene::Record(Recorder& recorder, double time)
+{
+    // Frames of a recording have fixed counts.
+    const RecordingHeader& header = recorder.GetHeader();
+    if (header.numParticles != mNumParticles || header.numParticleClouds != mNumParticleClouds)
+        return false;
+
+    RecordingFrame* frame = recorder.BeginFrame();
+    if (frame == nullptr)
+        return false;
+
+    // Read back directly into the recorder's pipeline slot.
+    mParticlesGPUSwapBuffer->ReadBack(frame->particles.data(), static_cast<unsigned int>(frame->particles.size()));
+    mParticleCloudsGPUSwapBuffer->ReadBack(frame->particleClouds.data(), static_cast<unsigned int>(frame->particleClouds.size()));
+    frame->time = time;
+    frame->cameraPosition = mCamera.mPosition;
+    frame->cameraFrontDirection = mCamera.mFrontDirection;
+    frame->cameraUpDirection = mCamera.mUpDirection;
+    recorder.EndFrame();
+    return true;
+}
+
+void Scene::Play(const RecordingFrame& frame)
+{
+    mNumParticleClouds = static_cast<unsigned int>(frame.particleClouds.size());
+    mNumParticles = static_cast<unsigned int>(frame.particles.size());
+    mParticleCloudsGPUSwapBuffer->Reserve(ParticleCloudSorter::GetCapacity(mNumParticleClouds), 0);
+    mParticlesGPUSwapBuffer->Reserve(mNumParticles, 0);
+    mMaxNumParticleClouds = mParticleCloudsGPUSwapBuffer->GetCapacity();
+    mMaxNumParticles = mParticlesGPUSwapBuffer->GetCapacity();
+    mParticlesGPUSwapBuffer->Upload(frame.particles.data(), mNumParticles);
+    mParticleCloudsGPUSwapBuffer->Upload(frame.particleClouds.data(), mNumParticleClouds);
 }
@@ -7,8 +7,14 @@
 
 #include "Camera.h"
 #include "GPUSwapBuffer.h"
+#include "GPUWorkCounters.h"
 #include "Particle.h"
 #include "ParticleCloud.h"
+#include "Recording.h"
+#include "SceneBuilder.h"
+#include "Snapshot.h"
+
+class JobSystem;
 
 class Scene
 {
@@ -18,26 +24,86 @@ class Scene
         // pDeviceContext Pointer to D3D11 device context.
         // maxNumParticles Max number of particles.
         // maxNumParticleClouds Max number of particle clouds.
-        Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int maxNumParticles, unsigned int maxNumParticleClouds);
+        // jobSystem Job system to generate the scene in parallel, nullptr to generate on the calling thread.
+        Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, JobSystem* jobSystem = nullptr);
+
+        // Constructor. Capacity is sized from the scene description.
+        // pDevice Pointer to D3D11 device.
+        // pDeviceContext Pointer to D3D11 device context.
+        // description Scene description.
+        // jobSystem Job system to expand the description in parallel, nullptr to expand on the calling thread.
+        Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const SceneBuilder::Description& description, JobSystem* jobSystem = nullptr);
+
+        // Constructor. Restores scene from snapshot, the mapped arrays are uploaded without intermediate copies.
+        // pDevice Pointer to D3D11 device.
+        // pDeviceContext Pointer to D3D11 device context.
+        // snapshot Loaded snapshot.
+        Scene(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const Snapshot& snapshot);
 
         // Destructor.
         ~Scene();
 
+        // Read back simulation state and write it as snapshot on the writer thread. Stalls until the GPU has finished the frame.
+        // writer Snapshot writer.
+        // path File path.
+        // frame Number of simulated frames.
+        // time Simulated time in seconds.
+        // Returns false if the writer is still busy with the previous snapshot.
+        bool Checkpoint(SnapshotWriter& writer, const std::string& path, unsigned long long frame, double time);
+
+        // Grow capacity to hold at least numParticleClouds particle clouds and their particles. Live contents are kept.
+        // numParticleClouds Min number of particle clouds.
+        void Reserve(unsigned int numParticleClouds);
+
+        // Append particle clouds. Capacity grows geometrically when full.
+        // particleClouds Particle clouds, their particle start IDs are rebased to follow the live particles.
+        // particles Particles of the clouds, numParticleClouds * SceneBuilder::PARTICLES_PER_CLOUD elements.
+        // numParticleClouds Number of particle clouds.
+        void AddParticleClouds(const ParticleCloud* particleClouds, const Particle* particles, unsigned int numParticleClouds);
+
+        // Read back simulation state into the recorder's next frame. Stalls until the GPU has finished the frame.
+        // recorder Recorder created with mNumParticles and mNumParticleClouds.
+        // time Simulated time in seconds.
+        // Returns false if the recording is closed or clouds were added since the recorder was created.
+        bool Record(Recorder& recorder, double time);
+
+        // Replace simulation state with a recorded frame. Capacity grows to the frame's counts.
+        // frame Frame decoded by RecordingPlayer.
+        void Play(const RecordingFrame& frame);
+
         // Camera.
         Camera mCamera;
 
-        // Max number paricles.
+        // Max number paricles, capacity of the particles buffers.
         unsigned int mMaxNumParticles;
 
-        // Max number paricle clouds.
+        // Max number paricle clouds, capacity of the particle clouds buffers. At least ParticleCloudSorter::GetCapacity(mNumParticleClouds).
         unsigned int mMaxNumParticleClouds;
 
+        // Number of live particles. Systems dispatch on live counts.
+        unsigned int mNumParticles;
+
+        // Number of live particle clouds.
+        unsigned int mNumParticleClouds;
+
         // Partilce cloud GPU swap buffer.
         GPUSwapBuffer<ParticleCloud>* mParticleCloudsGPUSwapBuffer;
 
         // Particles GPU swap buffer.
         GPUSwapBuffer<Particle>* mParticlesGPUSwapBuffer;
 
+        // Random seed and distribution the scene was generated with.
+        unsigned int mSeed;
+        SceneBuilder::Distribution mDistribution;
+
+        // Durations of startup stages.
+        SceneBuilder::Timings mStartupTimings;
+
+#if WORK_COUNTERS
+        // Simulation work counters.
+        GPUWorkCounters* mWorkCounters;
+#endif
+
     private:
         ID3D11Device* mpDevice;
         ID3D11DeviceContext* mpDeviceContext;
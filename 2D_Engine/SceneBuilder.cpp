@@ -0,0 +1,357 @@
+#include "SceneBuilder.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+// Number of clusters of the clustered distribution.
+#define SCENEBUILDER_NUM_CLUSTERS 16U
+
+// Number of clouds per job.
+#define SCENEBUILDER_GRAIN 4096U
+
+namespace
+{
+    // Random streams. Each stream is an independent random sequence indexed by cloud or cluster.
+    enum Stream
+    {
+        POSITION_X,
+        POSITION_Z,
+        OFFSET_X,
+        OFFSET_Z,
+        SPAWNTIME,
+        CLUSTER_X,
+        CLUSTER_Z,
+        // Second uniform number of normal distributed streams.
+        NORMAL_PAIR = 0x100
+    };
+
+    // Counter-based random number. SplitMix64 output of the index-th state of the (seed, stream) sequence.
+    unsigned int Random(unsigned int seed, unsigned int index, unsigned int stream)
+    {
+        unsigned long long z = ((static_cast<unsigned long long>(seed) << 32) | stream) + (index + 1ULL) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return static_cast<unsigned int>((z ^ (z >> 31)) >> 32);
+    }
+
+    // Uniform random number in [0, 1).
+    float RandomUniform(unsigned int seed, unsigned int index, unsigned int stream)
+    {
+        return (Random(seed, index, stream) >> 8) * (1.f / 16777216.f);
+    }
+
+    // Standard normal random number, Box-Muller transform of two uniform numbers.
+    float RandomNormal(unsigned int seed, unsigned int index, unsigned int stream)
+    {
+        float u1 = 1.f - RandomUniform(seed, index, stream);
+        float u2 = RandomUniform(seed, index, stream | NORMAL_PAIR);
+        return std::sqrt(-2.f * std::log(u1)) * std::cos(6.28318531f * u2);
+    }
+}
+
+const char* SceneBuilder::GetDistributionName(Distribution distribution)
+{
+    switch (distribution)
+    {
+        case GRID: return "grid";
+        case UNIFORM: return "uniform";
+        case CLUSTERED: return "clustered";
+        case LINE: return "line";
+        default: return "unknown";
+    }
+}
+
+bool SceneBuilder::FindDistribution(const char* name, Distribution& distribution)
+{
+    for (unsigned int d = 0; d < NUM_DISTRIBUTIONS; ++d)
+    {
+        if (strcmp(name, GetDistributionName(static_cast<Distribution>(d))) == 0)
+        {
+            distribution = static_cast<Distribution>(d);
+            return true;
+        }
+    }
+    return false;
+}
+
+SceneBuilder::EmitterGroup SceneBuilder::CreateEmitterGroup(Distribution distribution, unsigned int numParticleClouds)
+{
+    EmitterGroup group;
+    group.distribution = distribution;
+    group.numParticleClouds = numParticleClouds;
+    group.numParticlesPerCloud = PARTICLES_PER_CLOUD;
+    group.origin = glm::vec3(0.f, 0.f, 0.f);
+    group.spacing = 0.5f;
+    group.radius = 0.2f;
+    group.color = glm::vec3(0.f, 0.2f, 0.f);
+    group.minSpawntime = 0.01f;
+    group.maxSpawntime = 0.06f;
+    group.scale = 0.2f;
+    group.height = 5.f;
+    return group;
+}
+
+unsigned int SceneBuilder::GetNumParticleClouds(const Description& description)
+{
+    unsigned int numParticleClouds = 0;
+    for (const EmitterGroup& group : description.groups)
+        numParticleClouds += group.numParticleClouds;
+    return numParticleClouds;
+}
+
+bool SceneBuilder::Parse(std::istream& stream, Description& description, std::string& error)
+{
+    description.seed = 1;
+    description.groups.clear();
+
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(stream, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword))
+            continue;
+
+        std::string reason;
+        EmitterGroup* group = description.groups.empty() ? nullptr : &description.groups.back();
+        if (keyword == "seed")
+        {
+            tokens >> description.seed;
+        }
+        else if (keyword == "group")
+        {
+            description.groups.push_back(CreateEmitterGroup(GRID, 0));
+        }
+        else if (group == nullptr)
+        {
+            reason = "'" + keyword + "' outside of group";
+        }
+        else if (keyword == "distribution")
+        {
+            std::string name;
+            tokens >> name;
+            if (!tokens.fail() && !FindDistribution(name.c_str(), group->distribution))
+                reason = "unknown distribution '" + name + "'";
+        }
+        else if (keyword == "clouds")
+        {
+            tokens >> group->numParticleClouds;
+        }
+        else if (keyword == "particles")
+        {
+            tokens >> group->numParticlesPerCloud;
+            if (!tokens.fail() && group->numParticlesPerCloud > PARTICLES_PER_CLOUD)
+                reason = "more than " + std::to_string(PARTICLES_PER_CLOUD) + " particles per cloud";
+        }
+        else if (keyword == "origin")
+        {
+            tokens >> group->origin.x >> group->origin.y >> group->origin.z;
+        }
+        else if (keyword == "spacing")
+        {
+            tokens >> group->spacing;
+        }
+        else if (keyword == "radius")
+        {
+            tokens >> group->radius;
+        }
+        else if (keyword == "color")
+        {
+            tokens >> group->color.x >> group->color.y >> group->color.z;
+        }
+        else if (keyword == "spawntime")
+        {
+            tokens >> group->minSpawntime >> group->maxSpawntime;
+            if (!tokens.fail() && (group->minSpawntime <= 0.f || group->maxSpawntime < group->minSpawntime))
+                reason = "spawntime needs 0 < min <= max";
+        }
+        else if (keyword == "scale")
+        {
+            tokens >> group->scale;
+        }
+        else if (keyword == "height")
+        {
+            tokens >> group->height;
+        }
+        else
+        {
+            reason = "unknown keyword '" + keyword + "'";
+        }
+
+        std::string rest;
+        if (reason.empty() && tokens.fail())
+            reason = "missing or invalid value of '" + keyword + "'";
+        else if (reason.empty() && tokens >> rest)
+            reason = "unexpected '" + rest + "'";
+        if (!reason.empty())
+        {
+            error = "line " + std::to_string(lineNumber) + ": " + reason;
+            return false;
+        }
+    }
+
+    // Particle indices must fit the 32-bit particle start ID.
+    unsigned long long numParticleClouds = 0;
+    for (const EmitterGroup& group : description.groups)
+        numParticleClouds += group.numParticleClouds;
+    if (numParticleClouds == 0 || numParticleClouds * PARTICLES_PER_CLOUD > UINT_MAX)
+    {
+        error = numParticleClouds == 0 ? "no particle clouds" : "too many particle clouds";
+        return false;
+    }
+    return true;
+}
+
+bool SceneBuilder::Load(const std::string& path, Description& description, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        error = "could not open file";
+        return false;
+    }
+    return Parse(file, description, error);
+}
+
+void SceneBuilder::Build(const Description& description, unsigned int maxNumParticles, Particle* particles, ParticleCloud* particleClouds, JobSystem* jobSystem, Timings* timings)
+{
+    unsigned int seed = description.seed;
+    unsigned int numGroups = static_cast<unsigned int>(description.groups.size());
+    unsigned int maxNumParticleClouds = GetNumParticleClouds(description);
+    assert(maxNumParticles >= maxNumParticleClouds * PARTICLES_PER_CLOUD);
+
+    // Lay out groups. Group g owns clouds [groupStarts[g], groupStarts[g + 1]).
+    std::vector<unsigned int> groupStarts(numGroups + 1, 0);
+    std::vector<unsigned int> xAxes(numGroups);
+    std::vector<float> extents(numGroups);
+    std::vector<glm::vec3> clusterCenters(numGroups * SCENEBUILDER_NUM_CLUSTERS);
+    for (unsigned int g = 0; g < numGroups; ++g)
+    {
+        const EmitterGroup& group = description.groups[g];
+        groupStarts[g + 1] = groupStarts[g] + group.numParticleClouds;
+        // Fill rows of a square grid, last row may be partial.
+        xAxes[g] = std::max(1U, static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(group.numParticleClouds)))));
+        extents[g] = xAxes[g] * group.spacing;
+        for (unsigned int i = 0; i < SCENEBUILDER_NUM_CLUSTERS; ++i)
+        {
+            unsigned int cluster = g * SCENEBUILDER_NUM_CLUSTERS + i;
+            clusterCenters[cluster] = group.origin + glm::vec3(RandomUniform(seed, cluster, CLUSTER_X), 0.f, RandomUniform(seed, cluster, CLUSTER_Z)) * extents[g];
+        }
+    }
+
+    // Generate clouds, cloud c owns particles [c * PARTICLES_PER_CLOUD, (c + 1) * PARTICLES_PER_CLOUD).
+    auto generate = [&](unsigned int begin, unsigned int end)
+    {
+        unsigned int g = static_cast<unsigned int>(std::upper_bound(groupStarts.begin(), groupStarts.end(), begin) - groupStarts.begin()) - 1;
+        for (unsigned int c = begin; c < end; ++c)
+        {
+            while (c >= groupStarts[g + 1])
+                ++g;
+            const EmitterGroup& group = description.groups[g];
+            unsigned int local = c - groupStarts[g];
+            int x = local % xAxes[g];
+            int y = local / xAxes[g];
+
+            ParticleCloud particleCloud;
+            switch (group.distribution)
+            {
+                case UNIFORM:
+                    particleCloud.mPosition = group.origin + glm::vec3(RandomUniform(seed, c, POSITION_X), 0.f, RandomUniform(seed, c, POSITION_Z)) * extents[g];
+                    break;
+                case CLUSTERED:
+                    particleCloud.mPosition = clusterCenters[g * SCENEBUILDER_NUM_CLUSTERS + local % SCENEBUILDER_NUM_CLUSTERS] + glm::vec3(RandomNormal(seed, c, OFFSET_X), 0.f, RandomNormal(seed, c, OFFSET_Z)) * (extents[g] / SCENEBUILDER_NUM_CLUSTERS);
+                    break;
+                case LINE:
+                    particleCloud.mPosition = group.origin + glm::vec3(0.f, 0.f, local * group.spacing);
+                    break;
+                default:
+                    particleCloud.mPosition = group.origin + glm::vec3(x, 0.f, y) * group.spacing;
+                    break;
+            }
+            particleCloud.mRadius = group.radius;
+            particleCloud.mNumParticles = group.numParticlesPerCloud;
+            particleCloud.mParticleStartID = c * PARTICLES_PER_CLOUD;
+            particleCloud.mVelocity = -glm::normalize(particleCloud.mPosition + glm::vec3(0.01f, 0.f, 0.01f)) * (float)((x + y) == 0);
+            particleCloud.mColor = group.color;
+            particleCloud.mSpawntime = group.minSpawntime + RandomUniform(seed, c, SPAWNTIME) * (group.maxSpawntime - group.minSpawntime);
+            particleClouds[c] = particleCloud;
+
+            for (unsigned int i = 0; i < particleCloud.mNumParticles; ++i)
+            {
+                Particle& particle = particles[particleCloud.mParticleStartID + i];
+                particle.mPosition = particleCloud.mPosition;
+                particle.mPosition.y = group.height * ((float)i / particleCloud.mNumParticles);
+                particle.mScale = glm::vec2(group.scale, group.scale);
+                particle.mColor = glm::vec3(i % 3, i % 2, 1.f);
+                particle.mVelocity = glm::vec3(particleCloud.mVelocity.x, 0.f, particleCloud.mVelocity.z);
+                particle.mLifetime = -1.f; // particleCloud.mNumParticles - i;
+            }
+            for (unsigned int i = particleCloud.mNumParticles; i < PARTICLES_PER_CLOUD; ++i)
+                particles[particleCloud.mParticleStartID + i] = Particle();
+        }
+    };
+
+    // Clear unused particles.
+    auto clear = [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+            particles[i] = Particle();
+    };
+
+    long long startTime = Profiler::Now();
+    if (jobSystem != nullptr)
+        jobSystem->ParallelFor(0, maxNumParticleClouds, SCENEBUILDER_GRAIN, generate);
+    else
+        generate(0, maxNumParticleClouds);
+
+    long long generateTime = Profiler::Now();
+    unsigned int numUsedParticles = maxNumParticleClouds * PARTICLES_PER_CLOUD;
+    if (jobSystem != nullptr)
+        jobSystem->ParallelFor(numUsedParticles, maxNumParticles, SCENEBUILDER_GRAIN * PARTICLES_PER_CLOUD, clear);
+    else
+        clear(numUsedParticles, maxNumParticles);
+
+    if (timings != nullptr)
+    {
+        timings->generate = generateTime - startTime;
+        timings->clear = Profiler::Now() - generateTime;
+    }
+}
+
+void SceneBuilder::Build(Distribution distribution, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, unsigned int seed, Particle* particles, ParticleCloud* particleClouds, JobSystem* jobSystem, Timings* timings)
+{
+    Description description;
+    description.seed = seed;
+    description.groups.push_back(CreateEmitterGroup(distribution, maxNumParticleClouds));
+    Build(description, maxNumParticles, particles, particleClouds, jobSystem, timings);
+}
+
+void SceneBuilder::Build(Distribution distribution, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, unsigned int seed, std::vector<Particle>& particles, std::vector<ParticleCloud>& particleClouds, JobSystem* jobSystem)
+{
+    particles.resize(maxNumParticles);
+    particleClouds.resize(maxNumParticleClouds);
+    Build(distribution, maxNumParticles, maxNumParticleClouds, seed, particles.data(), particleClouds.data(), jobSystem);
+}
+
+void SceneBuilder::PrintTimings(const Timings& timings, std::ostream& stream)
+{
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3)
+        << "Startup: allocate " << timings.allocate / 1e6 << " ms, generate " << timings.generate / 1e6 << " ms, clear " << timings.clear / 1e6
+        << " ms, upload " << timings.upload / 1e6 << " ms, total " << (timings.allocate + timings.generate + timings.clear + timings.upload) / 1e6 << " ms" << std::endl;
+    stream.flags(flags);
+    stream.precision(precision);
+}
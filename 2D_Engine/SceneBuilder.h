@@ -0,0 +1,152 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Particle.h"
+#include "ParticleCloud.h"
+
+class JobSystem;
+
+// Generates initial particle and particle cloud data of a scene.
+namespace SceneBuilder
+{
+    // Number of particles per particle cloud.
+    const unsigned int PARTICLES_PER_CLOUD = 8;
+
+    // Spatial distribution of particle clouds.
+    enum Distribution
+    {
+        // Square grid in the xz-plane.
+        GRID,
+        // Uniform random in the xz-plane, same extent as the grid.
+        UNIFORM,
+        // Gaussian clusters in the xz-plane, same extent as the grid.
+        CLUSTERED,
+        // Degenerate line where all clouds share the same x-coordinate.
+        LINE,
+        NUM_DISTRIBUTIONS
+    };
+
+    // Group of particle clouds sharing a distribution and emitter parameters.
+    struct EmitterGroup
+    {
+        // Spatial distribution of the group's clouds.
+        Distribution distribution;
+        // Number of particle clouds.
+        unsigned int numParticleClouds;
+        // Number of particles emitted by each cloud, at most PARTICLES_PER_CLOUD.
+        unsigned int numParticlesPerCloud;
+        // Position of the first grid cell. Uniform and clustered clouds spread over the grid's extent from here.
+        glm::vec3 origin;
+        // Distance between grid cells.
+        float spacing;
+        // Cloud radius.
+        float radius;
+        // Cloud color.
+        glm::vec3 color;
+        // Range of cloud spawn intervals in seconds.
+        float minSpawntime;
+        float maxSpawntime;
+        // Particle scale.
+        float scale;
+        // Height of the initial particle column.
+        float height;
+    };
+
+    // Scene made of emitter groups. Groups expand to consecutive particle clouds in file order.
+    struct Description
+    {
+        // Random seed.
+        unsigned int seed;
+        // Emitter groups.
+        std::vector<EmitterGroup> groups;
+    };
+
+    // Durations of scene startup stages in nanoseconds. Build fills generate and clear, callers fill allocate and upload.
+    struct Timings
+    {
+        // Allocate destination arrays.
+        long long allocate;
+        // Generate clouds and their particles.
+        long long generate;
+        // Clear particles not owned by a cloud.
+        long long clear;
+        // Upload to device buffers.
+        long long upload;
+    };
+
+    // Get distribution name.
+    // distribution Distribution.
+    const char* GetDistributionName(Distribution distribution);
+
+    // Get distribution by name.
+    // name Distribution name.
+    // distribution Found distribution.
+    // Returns whether name matched a distribution.
+    bool FindDistribution(const char* name, Distribution& distribution);
+
+    // Create emitter group with the parameters of the built-in scene.
+    // distribution Spatial distribution of clouds.
+    // numParticleClouds Number of particle clouds.
+    EmitterGroup CreateEmitterGroup(Distribution distribution, unsigned int numParticleClouds);
+
+    // Get total number of particle clouds of a scene description.
+    // description Scene description.
+    unsigned int GetNumParticleClouds(const Description& description);
+
+    // Parse scene description. Lines hold a keyword and its values, # starts a comment.
+    // "seed n" sets the random seed, "group" starts an emitter group with default parameters and the following lines set its
+    // distribution, clouds, particles, origin, spacing, radius, color, spawntime (min max), scale and height.
+    // stream Input stream.
+    // description Parsed description.
+    // error Line and reason of the first error.
+    // Returns whether the description was valid.
+    bool Parse(std::istream& stream, Description& description, std::string& error);
+
+    // Load scene description file.
+    // path File path.
+    // description Parsed description.
+    // error Line and reason of the first error.
+    // Returns whether the file could be read and was valid.
+    bool Load(const std::string& path, Description& description, std::string& error);
+
+    // Build scene of a description into preallocated arrays. Emitter groups are expanded in parallel chunks of clouds,
+    // each cloud draws from a counter-based random sequence of (seed, cloud index), so the result does not depend on the number of threads.
+    // description Scene description.
+    // maxNumParticles Max number of particles, at least GetNumParticleClouds(description) * PARTICLES_PER_CLOUD. Unused particles are inactive.
+    // particles Destination array of maxNumParticles particles.
+    // particleClouds Destination array of GetNumParticleClouds(description) particle clouds.
+    // jobSystem Job system to generate in parallel, nullptr to generate on the calling thread.
+    // timings Durations of generate and clear stages, can be nullptr.
+    void Build(const Description& description, unsigned int maxNumParticles, Particle* particles, ParticleCloud* particleClouds, JobSystem* jobSystem = nullptr, Timings* timings = nullptr);
+
+    // Build scene of a single emitter group with default parameters into preallocated arrays.
+    // distribution Spatial distribution of clouds.
+    // maxNumParticles Max number of particles, at least maxNumParticleClouds * PARTICLES_PER_CLOUD. Unused particles are inactive.
+    // maxNumParticleClouds Number of particle clouds.
+    // seed Random seed.
+    // particles Destination array of maxNumParticles particles.
+    // particleClouds Destination array of maxNumParticleClouds particle clouds.
+    // jobSystem Job system to generate in parallel, nullptr to generate on the calling thread.
+    // timings Durations of generate and clear stages, can be nullptr.
+    void Build(Distribution distribution, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, unsigned int seed, Particle* particles, ParticleCloud* particleClouds, JobSystem* jobSystem = nullptr, Timings* timings = nullptr);
+
+    // Build scene into vectors. Vectors are resized to maxNumParticles and maxNumParticleClouds.
+    // distribution Spatial distribution of clouds.
+    // maxNumParticles Max number of particles, unused particles are inactive.
+    // maxNumParticleClouds Number of particle clouds.
+    // seed Random seed.
+    // particles Generated particles.
+    // particleClouds Generated particle clouds.
+    // jobSystem Job system to generate in parallel, nullptr to generate on the calling thread.
+    void Build(Distribution distribution, unsigned int maxNumParticles, unsigned int maxNumParticleClouds, unsigned int seed, std::vector<Particle>& particles, std::vector<ParticleCloud>& particleClouds, JobSystem* jobSystem = nullptr);
+
+    // Print startup timings.
+    // timings Timings to print.
+    // stream Output stream.
+    void PrintTimings(const Timings& timings, std::ostream& stream);
+}
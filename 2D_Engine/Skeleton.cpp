@@ -1,16 +1,32 @@
 #include "Skeleton.h"
 #include "Animation.h"
 #include <assimp/scene.h>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 #include "MathFunctions.h"
+#include "JobSystem.h"
+
+// Min number of nodes in a tree to animate its sub trees in parallel.
+#define SKELETON_PARALLEL_NODES 64U
+
+// Number of nodes or bones per job when animating the flattened skeleton in parallel.
+#define SKELETON_GRAIN 16U
+
+// Max relative deviation of a transformation from uniform scale to take the uniform scale inverse transpose.
+#define SKELETON_UNIFORM_SCALE_TOLERANCE 0.0001f
 
 using namespace Geometry;
 
 Skeleton::Skeleton() {
-
+    boundAnimation = nullptr;
+    uniformScaleNodes = false;
+    uniformScaleAnimation = false;
 }
 
 Skeleton::Skeleton(const aiScene* aScene) {
+    boundAnimation = nullptr;
+    uniformScaleNodes = false;
+    uniformScaleAnimation = false;
     Load(aScene);
 }
 
@@ -50,61 +66,101 @@ void Skeleton::Load(const aiScene* aScene) {
     bones.resize(countBones);
     finalTransforms.resize(countBones);
     finalTransformsIT.resize(countBones);
+
+    // Flatten node tree and resolve bones once, so animating needs no name lookups.
+    nodeNames.clear();
+    nodeParents.clear();
+    nodeTransforms.clear();
+    nodeBones.clear();
+    FlattenNodeTree(&rootNode, -1);
+    ResolveBones();
+}
+
+void Skeleton::ResolveBones() {
+    globalTransforms.resize(nodeParents.size());
+    boneNodes.assign(bones.size(), -1);
+    for (std::size_t i = 0; i < nodeBones.size(); ++i) {
+        if (nodeBones[i] != static_cast<std::size_t>(-1))
+            boneNodes[nodeBones[i]] = static_cast<int>(i);
+    }
+
+    uniformScaleNodes = IsUniformScale(glm::mat3(globalInverseTransform), SKELETON_UNIFORM_SCALE_TOLERANCE);
+    for (const glm::mat4& transformation : nodeTransforms)
+        uniformScaleNodes = uniformScaleNodes && IsUniformScale(glm::mat3(transformation), SKELETON_UNIFORM_SCALE_TOLERANCE);
+    for (const glm::mat4& bone : bones)
+        uniformScaleNodes = uniformScaleNodes && IsUniformScale(glm::mat3(bone), SKELETON_UNIFORM_SCALE_TOLERANCE);
+
+    boundAnimation = nullptr;
+    uniformScaleAnimation = false;
+    nodeChannels.assign(nodeParents.size(), nullptr);
+    nodeCursors.assign(nodeParents.size(), Animation::KeyCursor());
 }
 
 std::size_t Skeleton::GetNumBones() const {
     return bones.size();
 }
 
-void Skeleton::Animate(const Geometry::Animation* animation, const float timeInSeconds) {
-    float animationTime = 0;
-    float ticksPerSecond = (float)(animation->ticksPerSecond != 0 ? animation->ticksPerSecond : 25.0f);
-    float timeInTicks = timeInSeconds * ticksPerSecond;
-    animationTime = fmod(timeInTicks, static_cast<float>(animation->duration));
+void Skeleton::Animate(const Geometry::Animation* animation, const float timeInSeconds, JobSystem* jobSystem) {
+    if (animation != boundAnimation)
+        BindAnimation(animation);
+
+    EvaluateNodes(animation, CalcAnimationTime(animation, timeInSeconds), jobSystem);
+}
+
+void Skeleton::AnimateHierarchy(const Geometry::Animation* animation, const float timeInSeconds, JobSystem* jobSystem) {
+    ReadNodeHeirarchy(animation, CalcAnimationTime(animation, timeInSeconds), &rootNode, glm::mat4(), jobSystem);
+}
 
-    ReadNodeHeirarchy(animation, animationTime, &rootNode, glm::mat4());
+void Skeleton::BindAnimation(const Geometry::Animation* animation) {
+    boundAnimation = animation;
+    uniformScaleAnimation = true;
+    for (std::size_t i = 0; i < nodeChannels.size(); ++i) {
+        nodeChannels[i] = animation != nullptr ? animation->FindChannel(nodeNames[i]) : nullptr;
+        if (nodeChannels[i] == nullptr)
+            continue;
+        for (const glm::vec3& scaling : nodeChannels[i]->sclValues) {
+            const float tolerance = SKELETON_UNIFORM_SCALE_TOLERANCE * std::abs(scaling.x);
+            uniformScaleAnimation = uniformScaleAnimation && std::abs(scaling.y - scaling.x) <= tolerance && std::abs(scaling.z - scaling.x) <= tolerance;
+        }
+    }
+    nodeCursors.assign(nodeChannels.size(), Animation::KeyCursor());
 }
 
 void Skeleton::BindPose() {
-    ReadNodeHeirarchy(nullptr, 0, &rootNode, glm::mat4());
+    EvaluateNodes(nullptr, 0, nullptr);
 }
 
-void Skeleton::LoadNodeTree(aiNode* aNode, Node* node, Node* parentNode) {
+std::size_t Skeleton::LoadNodeTree(aiNode* aNode, Node* node, Node* parentNode) {
     node->name = aNode->mName.C_Str();
     CpyMat(node->transformation, aNode->mTransformation);
     node->parent = parentNode;
     node->children.resize(aNode->mNumChildren);
+    node->numNodes = 1;
     for (std::size_t i = 0; i < aNode->mNumChildren; ++i) {
-        LoadNodeTree(aNode->mChildren[i], &node->children[i], node);
+        node->numNodes += LoadNodeTree(aNode->mChildren[i], &node->children[i], node);
     }
+    return node->numNodes;
 }
 
-void Skeleton::ReadNodeHeirarchy(const Geometry::Animation* animation, float animationTime, Node* node, const glm::mat4& parentTransform) {
+void Skeleton::FlattenNodeTree(const Node* node, int parentIndex) {
+    // Pre-order, so every parent is evaluated before its children.
+    int index = static_cast<int>(nodeParents.size());
+    nodeNames.push_back(node->name);
+    nodeParents.push_back(parentIndex);
+    nodeTransforms.push_back(node->transformation);
+    const auto& it = boneIndexMap.find(node->name);
+    nodeBones.push_back(it != boneIndexMap.end() ? it->second : static_cast<std::size_t>(-1));
+    for (const Node& child : node->children)
+        FlattenNodeTree(&child, index);
+}
+
+void Skeleton::ReadNodeHeirarchy(const Geometry::Animation* animation, float animationTime, Node* node, const glm::mat4& parentTransform, JobSystem* jobSystem) {
     glm::mat4 nodeTransformation(node->transformation);
 
     if (animation != nullptr) {
         const Animation::AnimChannel* channel = animation->FindChannel(node->name);
-        if (channel != nullptr) {
-            // Interpolate scaling and generate scaling transformation matrix.
-            glm::vec3 scaling;
-            Animation::CalcInterpolatedScaling(scaling, animationTime, channel);
-            glm::mat4 scalingM(glm::scale(glm::mat4(), scaling));
-
-            // Interpolate rotation and generate rotation transformation matrix.
-            aiQuaternion rotationQ;
-            Animation::CalcInterpolatedRotation(rotationQ, animationTime, channel);
-            glm::mat4 rotationM;
-            aiMatrix3x3 aMat = rotationQ.GetMatrix();
-            CpyMat(rotationM, aiMatrix4x4(aMat));
-
-            // Interpolate translation and generate translation transformation matrix.
-            glm::vec3 translation;
-            Animation::CalcInterpolatedPosition(translation, animationTime, channel);
-            glm::mat4 translationM(glm::translate(glm::mat4(), translation));
-
-            // Combine the above transformations.
-            nodeTransformation = scalingM * rotationM * glm::transpose(translationM);
-        }
+        if (channel != nullptr)
+            nodeTransformation = CalcNodeTransformation(channel, animationTime, nullptr);
     }
 
     glm::mat4 globalTransformation = nodeTransformation * parentTransform;
@@ -113,12 +169,81 @@ void Skeleton::ReadNodeHeirarchy(const Geometry::Animation* animation, float ani
     if (it != this->boneIndexMap.end()) {
         size_t boneIndex = it->second;
         finalTransforms[boneIndex] = glm::transpose(bones[boneIndex] * (globalTransformation * this->globalInverseTransform));
-        finalTransformsIT[boneIndex] = glm::mat3(glm::transpose(glm::inverse(finalTransforms[boneIndex])));
+        InverseTransposeAffine(&finalTransforms[boneIndex], &finalTransformsIT[boneIndex], 1, false);
     }
 
-    for (std::size_t i = 0; i < node->children.size(); ++i) {
-        ReadNodeHeirarchy(animation, animationTime, &node->children[i], globalTransformation);
-    }
+    // Sub trees write disjoint bones, large trees are split between threads.
+    auto readChildren = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i)
+            ReadNodeHeirarchy(animation, animationTime, &node->children[i], globalTransformation, jobSystem);
+    };
+    if (jobSystem != nullptr && node->children.size() > 1 && node->numNodes >= SKELETON_PARALLEL_NODES)
+        jobSystem->ParallelFor(0, static_cast<unsigned int>(node->children.size()), 1, readChildren);
+    else
+        readChildren(0, static_cast<unsigned int>(node->children.size()));
+}
+
+void Skeleton::EvaluateNodes(const Geometry::Animation* animation, float animationTime, JobSystem* jobSystem) {
+    const std::size_t numNodes = nodeParents.size();
+    const bool parallel = jobSystem != nullptr && numNodes >= SKELETON_PARALLEL_NODES;
+
+    // Local transformations are independent of each other.
+    auto evaluateLocal = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            const Animation::AnimChannel* channel = animation != nullptr ? nodeChannels[i] : nullptr;
+            globalTransforms[i] = channel != nullptr ? CalcNodeTransformation(channel, animationTime, &nodeCursors[i]) : nodeTransforms[i];
+        }
+    };
+    if (parallel)
+        jobSystem->ParallelFor(0, static_cast<unsigned int>(numNodes), SKELETON_GRAIN, evaluateLocal);
+    else
+        evaluateLocal(0, static_cast<unsigned int>(numNodes));
+
+    // Parents precede their children, so one pass concatenates the whole tree.
+    for (std::size_t i = 1; i < numNodes; ++i)
+        globalTransforms[i] = globalTransforms[i] * globalTransforms[nodeParents[i]];
+
+    // Bones without a node keep their identity transformation, whose inverse transpose is the identity again.
+    const bool uniformScale = uniformScaleNodes && (animation == nullptr || uniformScaleAnimation);
+    auto evaluateBones = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int b = begin; b < end; ++b) {
+            if (boneNodes[b] >= 0)
+                finalTransforms[b] = glm::transpose(bones[b] * (globalTransforms[boneNodes[b]] * this->globalInverseTransform));
+        }
+        InverseTransposeAffine(&finalTransforms[begin], &finalTransformsIT[begin], end - begin, uniformScale);
+    };
+    if (parallel)
+        jobSystem->ParallelFor(0, static_cast<unsigned int>(bones.size()), SKELETON_GRAIN, evaluateBones);
+    else
+        evaluateBones(0, static_cast<unsigned int>(bones.size()));
+}
+
+float Skeleton::CalcAnimationTime(const Geometry::Animation* animation, float timeInSeconds) {
+    float ticksPerSecond = (float)(animation->ticksPerSecond != 0 ? animation->ticksPerSecond : 25.0f);
+    float timeInTicks = timeInSeconds * ticksPerSecond;
+    return fmod(timeInTicks, static_cast<float>(animation->duration));
+}
+
+glm::mat4 Skeleton::CalcNodeTransformation(const Animation::AnimChannel* channel, float animationTime, Animation::KeyCursor* cursor) {
+    // Interpolate scaling and generate scaling transformation matrix.
+    glm::vec3 scaling;
+    Animation::CalcInterpolatedScaling(scaling, animationTime, channel, cursor);
+    glm::mat4 scalingM(glm::scale(glm::mat4(), scaling));
+
+    // Interpolate rotation and generate rotation transformation matrix.
+    aiQuaternion rotationQ;
+    Animation::CalcInterpolatedRotation(rotationQ, animationTime, channel, cursor);
+    glm::mat4 rotationM;
+    aiMatrix3x3 aMat = rotationQ.GetMatrix();
+    CpyMat(rotationM, aiMatrix4x4(aMat));
+
+    // Interpolate translation and generate translation transformation matrix.
+    glm::vec3 translation;
+    Animation::CalcInterpolatedPosition(translation, animationTime, channel, cursor);
+    glm::mat4 translationM(glm::translate(glm::mat4(), translation));
+
+    // Combine the above transformations.
+    return scalingM * rotationM * glm::transpose(translationM);
 }
 
 const glm::mat4* Skeleton::FindBone(const std::string& name) const {
@@ -2,15 +2,17 @@
 
 #include <glm/glm.hpp>
 #include <map>
+#include <string>
 #include <vector>
 
+#include "Animation.h"
+
 struct aiScene;
 struct aiNode;
+class JobSystem;
 
 namespace Geometry {
 
-    class Animation;
-
     /// A skeleton loaded from a file.
     class Skeleton {
     public:
@@ -50,11 +52,30 @@ namespace Geometry {
 
         /// Animate skeleton.
         /**
+        * Evaluates the flattened node array in a linear loop. Channels are bound on the first call with an animation.
         * Use GetFinalTransformations after animation to get matrices.
         * @param animation Animation to animate skeleton.
         * @param timeInSeconds Time to find animation frame.
+        * @param jobSystem Job system to animate large skeletons in parallel, nullptr to animate on the calling thread.
         */
-        void Animate(const Geometry::Animation* animation, const float timeInSeconds);
+        void Animate(const Geometry::Animation* animation, const float timeInSeconds, JobSystem* jobSystem = nullptr);
+
+        /// Animate skeleton by walking the node tree.
+        /**
+        * Looks up channel and bone of every node by name. Reference for Animate, which gives equal results.
+        * Use GetFinalTransformations after animation to get matrices.
+        * @param animation Animation to animate skeleton.
+        * @param timeInSeconds Time to find animation frame.
+        * @param jobSystem Job system to animate large sub trees in parallel, nullptr to animate on the calling thread.
+        */
+        void AnimateHierarchy(const Geometry::Animation* animation, const float timeInSeconds, JobSystem* jobSystem = nullptr);
+
+        /// Resolve the channel of every node.
+        /**
+        * Called by Animate when the animation changes. Call again after reloading the bound animation.
+        * @param animation Animation to bind, nullptr to unbind.
+        */
+        void BindAnimation(const Geometry::Animation* animation);
 
         /// Update skeleton to bind pose.
         /**
@@ -77,15 +98,24 @@ namespace Geometry {
         const std::vector<glm::mat3>& GetFinalTransformationsIT() const;
 
     private:
+        friend class CookedAsset;
+        friend class SkeletonBatch;
+
         struct Node {
             std::string name;
             glm::mat4 transformation;
             Node* parent;
             std::vector<Node> children;
+            std::size_t numNodes;
         };
 
-        static void LoadNodeTree(aiNode* aNode, Node* node, Node* parentNode);
-        void ReadNodeHeirarchy(const Geometry::Animation* animation, float animationTime, Node* node, const glm::mat4& parentTransform);
+        static std::size_t LoadNodeTree(aiNode* aNode, Node* node, Node* parentNode);
+        void FlattenNodeTree(const Node* node, int parentIndex);
+        void ResolveBones();
+        void ReadNodeHeirarchy(const Geometry::Animation* animation, float animationTime, Node* node, const glm::mat4& parentTransform, JobSystem* jobSystem);
+        void EvaluateNodes(const Geometry::Animation* animation, float animationTime, JobSystem* jobSystem);
+        static float CalcAnimationTime(const Geometry::Animation* animation, float timeInSeconds);
+        static glm::mat4 CalcNodeTransformation(const Animation::AnimChannel* channel, float animationTime, Animation::KeyCursor* cursor);
         const glm::mat4* FindBone(const std::string& name) const;
 
         glm::mat4 globalInverseTransform;
@@ -94,5 +124,23 @@ namespace Geometry {
         std::vector<glm::mat4> finalTransforms;
         std::vector<glm::mat3> finalTransformsIT;
         std::map<std::string, std::size_t> boneIndexMap;
+
+        // Flattened node tree, parents before children.
+        std::vector<std::string> nodeNames;
+        std::vector<int> nodeParents;
+        std::vector<glm::mat4> nodeTransforms;
+        std::vector<std::size_t> nodeBones;
+        std::vector<int> boneNodes;
+        std::vector<glm::mat4> globalTransforms;
+
+        // Node, bone and inverse root transformations, and the scaling keys of the bound animation, have uniform
+        // scale. Bone inverse transposes then skip the full inverse.
+        bool uniformScaleNodes;
+        bool uniformScaleAnimation;
+
+        // Channel of every node for the bound animation, nullptr if the node is not animated, and its playback cursor.
+        const Geometry::Animation* boundAnimation;
+        std::vector<const Animation::AnimChannel*> nodeChannels;
+        std::vector<Animation::KeyCursor> nodeCursors;
     };
 }
\ No newline at end of file
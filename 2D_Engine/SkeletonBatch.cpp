@@ -0,0 +1,289 @@
+#include "SkeletonBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "JobSystem.h"
+#include "MathFunctions.h"
+#include "Skeleton.h"
+
+using namespace Geometry;
+
+namespace {
+    typedef float Lanes[SKELETONBATCH_LANES];
+
+    // Interpolate vector track of every lane.
+    void SampleVectorTrack(const Animation::AnimChannel* channel, const std::vector<float>& times, const std::vector<glm::vec3>& values, const Lanes& animationTimes, Lanes* result) {
+        Lanes factor, start[3], end[3];
+        for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l) {
+            std::size_t key, nextKey;
+            factor[l] = channel->FindKeys(times, animationTimes[l], 0, key, nextKey);
+            for (unsigned int i = 0; i < 3; ++i) {
+                start[i][l] = values[key][i];
+                end[i][l] = values[nextKey][i];
+            }
+        }
+
+        for (unsigned int i = 0; i < 3; ++i)
+            for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l)
+                result[i][l] = start[i][l] + factor[l] * (end[i][l] - start[i][l]);
+    }
+
+    // Spherically interpolate rotation track of every lane, as aiQuaternion::Interpolate followed by Normalize.
+    void SampleRotationTrack(const Animation::AnimChannel* channel, const Lanes& animationTimes, Lanes* result) {
+        Lanes factor, start[4], end[4];
+        for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l) {
+            std::size_t key, nextKey;
+            factor[l] = channel->FindKeys(channel->rotTimes, animationTimes[l], 0, key, nextKey);
+            const aiQuaternion& startQ = channel->rotValues[key];
+            const aiQuaternion& endQ = channel->rotValues[nextKey];
+            start[0][l] = startQ.x; start[1][l] = startQ.y; start[2][l] = startQ.z; start[3][l] = startQ.w;
+            end[0][l] = endQ.x; end[1][l] = endQ.y; end[2][l] = endQ.z; end[3][l] = endQ.w;
+        }
+
+        const float* const starts[4] = { start[0], start[1], start[2], start[3] };
+        const float* const ends[4] = { end[0], end[1], end[2], end[3] };
+        float* const results[4] = { result[0], result[1], result[2], result[3] };
+        SlerpQuats(starts, ends, factor, results, SKELETONBATCH_LANES);
+    }
+
+    // Compose scaling * rotation * transpose(translation) of every lane as in Skeleton.
+    void ComposeLanes(const Lanes* scaling, const Lanes* rotation, const Lanes* translation, SkeletonBatch::AffineLanes& result) {
+        for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l) {
+            // Rows of aiQuaternion::GetMatrix.
+            const float x = rotation[0][l], y = rotation[1][l], z = rotation[2][l], w = rotation[3][l];
+            const float rows[3][3] = {
+                { 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y - z * w), 2.0f * (x * z + y * w) },
+                { 2.0f * (x * y + z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z - x * w) },
+                { 2.0f * (x * z - y * w), 2.0f * (y * z + x * w), 1.0f - 2.0f * (x * x + y * y) }
+            };
+            for (unsigned int c = 0; c < 3; ++c) {
+                for (unsigned int r = 0; r < 3; ++r)
+                    result.m[c][r][l] = scaling[r][l] * rows[c][r];
+                result.m[c][3][l] = translation[c][l];
+            }
+        }
+    }
+
+    // result = a * b, both per lane.
+    void MultiplyLanes(const SkeletonBatch::AffineLanes& a, const SkeletonBatch::AffineLanes& b, SkeletonBatch::AffineLanes& result) {
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l)
+                    result.m[c][r][l] = a.m[0][r][l] * b.m[c][0][l] + a.m[1][r][l] * b.m[c][1][l] + a.m[2][r][l] * b.m[c][2][l] + (r == 3 ? b.m[c][3][l] : 0.0f);
+    }
+
+    // result = a * b, a per lane.
+    void MultiplyLanes(const SkeletonBatch::AffineLanes& a, const glm::mat4& b, SkeletonBatch::AffineLanes& result) {
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l)
+                    result.m[c][r][l] = a.m[0][r][l] * b[c][0] + a.m[1][r][l] * b[c][1] + a.m[2][r][l] * b[c][2] + (r == 3 ? b[c][3] : 0.0f);
+    }
+
+    // result = a * b, b per lane.
+    void MultiplyLanes(const glm::mat4& a, const SkeletonBatch::AffineLanes& b, SkeletonBatch::AffineLanes& result) {
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l)
+                    result.m[c][r][l] = a[0][r] * b.m[c][0][l] + a[1][r] * b.m[c][1][l] + a[2][r] * b.m[c][2][l] + a[3][r] * b.m[c][3][l];
+    }
+
+    // Same matrix in every lane.
+    void BroadcastLanes(const glm::mat4& matrix, SkeletonBatch::AffineLanes& result) {
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l)
+                    result.m[c][r][l] = matrix[c][r];
+    }
+
+}
+
+SkeletonBatch::SkeletonBatch() {
+    maxNumNodes = 0;
+}
+
+SkeletonBatch::~SkeletonBatch() {
+
+}
+
+void SkeletonBatch::Animate(const Instance* instances, std::size_t numInstances, JobSystem* jobSystem) {
+    // Palettes are laid out in instance order.
+    paletteOffsets.resize(numInstances);
+    std::size_t numBones = 0;
+    for (std::size_t i = 0; i < numInstances; ++i) {
+        paletteOffsets[i] = numBones;
+        numBones += instances[i].skeleton->GetNumBones();
+    }
+    finalTransforms.resize(numBones);
+    finalTransformsIT.resize(numBones);
+
+    // Group instances by skeleton and animation.
+    order.resize(numInstances);
+    for (std::size_t i = 0; i < numInstances; ++i)
+        order[i] = static_cast<unsigned int>(i);
+    std::sort(order.begin(), order.end(), [instances](unsigned int a, unsigned int b) {
+        std::less<const void*> less;
+        if (instances[a].skeleton != instances[b].skeleton)
+            return less(instances[a].skeleton, instances[b].skeleton);
+        if (instances[a].animation != instances[b].animation)
+            return less(instances[a].animation, instances[b].animation);
+        return a < b;
+    });
+
+    groups.clear();
+    chunks.clear();
+    maxNumNodes = 0;
+    for (std::size_t i = 0; i < numInstances; ++i) {
+        const Instance& instance = instances[order[i]];
+        if (groups.empty() || groups.back().skeleton != instance.skeleton || groups.back().animation != instance.animation) {
+            Group group;
+            group.skeleton = instance.skeleton;
+            group.animation = instance.animation;
+            group.binding = FindBinding(instance.skeleton, instance.animation);
+            groups.push_back(group);
+            maxNumNodes = std::max(maxNumNodes, instance.skeleton->nodeParents.size());
+        }
+        const unsigned int groupIndex = static_cast<unsigned int>(groups.size() - 1);
+        if (chunks.empty() || chunks.back().group != groupIndex || chunks.back().count == SKELETONBATCH_LANES) {
+            Chunk chunk;
+            chunk.group = groupIndex;
+            chunk.first = static_cast<unsigned int>(i);
+            chunk.count = 0;
+            chunks.push_back(chunk);
+        }
+        ++chunks.back().count;
+    }
+
+    // Chunks write disjoint palettes. Scratch is kept across calls and indexed by thread, so jobs do not allocate.
+    const unsigned int numThreads = jobSystem != nullptr ? jobSystem->GetNumThreads() : 1;
+    if (globalTransforms.size() < numThreads * maxNumNodes)
+        globalTransforms.resize(numThreads * maxNumNodes);
+    auto animateChunks = [&](unsigned int begin, unsigned int end) {
+        AffineLanes* threadTransforms = globalTransforms.data() + (jobSystem != nullptr ? jobSystem->GetThreadIndex() : 0) * maxNumNodes;
+        for (unsigned int c = begin; c < end; ++c)
+            AnimateChunk(instances, chunks[c], threadTransforms);
+    };
+    if (jobSystem != nullptr)
+        jobSystem->ParallelFor(0, static_cast<unsigned int>(chunks.size()), SKELETONBATCH_CHUNKS_PER_JOB, animateChunks);
+    else
+        animateChunks(0, static_cast<unsigned int>(chunks.size()));
+}
+
+void SkeletonBatch::ClearBindings() {
+    bindings.clear();
+}
+
+std::size_t SkeletonBatch::GetPaletteOffset(std::size_t instance) const {
+    return paletteOffsets[instance];
+}
+
+const std::vector<glm::mat4>& SkeletonBatch::GetFinalTransformations() const {
+    return finalTransforms;
+}
+
+const std::vector<glm::mat3>& SkeletonBatch::GetFinalTransformationsIT() const {
+    return finalTransformsIT;
+}
+
+const SkeletonBatch::Binding* SkeletonBatch::FindBinding(const Skeleton* skeleton, const Animation* animation) {
+    if (animation == nullptr)
+        return nullptr;
+
+    const auto key = std::make_pair(skeleton, animation);
+    auto it = bindings.find(key);
+    if (it == bindings.end()) {
+        Binding binding(skeleton->nodeNames.size());
+        for (std::size_t i = 0; i < binding.size(); ++i)
+            binding[i] = animation->FindChannel(skeleton->nodeNames[i]);
+        it = bindings.insert(std::make_pair(key, binding)).first;
+    }
+    return &it->second;
+}
+
+void SkeletonBatch::AnimateChunk(const Instance* instances, const Chunk& chunk, AffineLanes* globalTransforms) {
+    const Group& group = groups[chunk.group];
+    const Skeleton& skeleton = *group.skeleton;
+
+    // Unused lanes repeat the last instance and are not written.
+    Lanes animationTimes;
+    unsigned int instanceIndices[SKELETONBATCH_LANES];
+    for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l) {
+        instanceIndices[l] = order[chunk.first + std::min(l, chunk.count - 1)];
+        animationTimes[l] = group.animation != nullptr ? Skeleton::CalcAnimationTime(group.animation, instances[instanceIndices[l]].timeInSeconds) : 0.0f;
+    }
+
+    // Parents precede their children.
+    for (std::size_t i = 0; i < skeleton.nodeParents.size(); ++i) {
+        const Animation::AnimChannel* channel = group.binding != nullptr ? (*group.binding)[i] : nullptr;
+        const int parent = skeleton.nodeParents[i];
+        AffineLanes& global = globalTransforms[i];
+        if (channel == nullptr && parent < 0) {
+            BroadcastLanes(skeleton.nodeTransforms[i], global);
+            continue;
+        }
+
+        AffineLanes local;
+        if (channel != nullptr) {
+            Lanes scaling[3], rotation[4], translation[3];
+            SampleVectorTrack(channel, channel->sclTimes, channel->sclValues, animationTimes, scaling);
+            SampleRotationTrack(channel, animationTimes, rotation);
+            SampleVectorTrack(channel, channel->posTimes, channel->posValues, animationTimes, translation);
+            ComposeLanes(scaling, rotation, translation, local);
+        } else {
+            BroadcastLanes(skeleton.nodeTransforms[i], local);
+        }
+
+        if (parent < 0)
+            global = local;
+        else
+            MultiplyLanes(local, globalTransforms[parent], global);
+    }
+
+    for (std::size_t b = 0; b < skeleton.bones.size(); ++b) {
+        const int node = skeleton.boneNodes[b];
+        if (node < 0) {
+            for (unsigned int l = 0; l < chunk.count; ++l) {
+                finalTransforms[paletteOffsets[instanceIndices[l]] + b] = glm::mat4();
+                finalTransformsIT[paletteOffsets[instanceIndices[l]] + b] = glm::mat3();
+            }
+            continue;
+        }
+
+        // bones[b] * (global * globalInverseTransform), transposed on output.
+        AffineLanes rootSpace, bone;
+        MultiplyLanes(globalTransforms[node], skeleton.globalInverseTransform, rootSpace);
+        MultiplyLanes(skeleton.bones[b], rootSpace, bone);
+
+        // Inverse of the upper 3x3, which is the inverse transpose of the transposed bone.
+        Lanes inverse[3][3];
+        for (unsigned int l = 0; l < SKELETONBATCH_LANES; ++l) {
+            const float m00 = bone.m[0][0][l], m01 = bone.m[0][1][l], m02 = bone.m[0][2][l];
+            const float m10 = bone.m[1][0][l], m11 = bone.m[1][1][l], m12 = bone.m[1][2][l];
+            const float m20 = bone.m[2][0][l], m21 = bone.m[2][1][l], m22 = bone.m[2][2][l];
+            const float oneOverDeterminant = 1.0f / (m00 * (m11 * m22 - m21 * m12) - m10 * (m01 * m22 - m21 * m02) + m20 * (m01 * m12 - m11 * m02));
+            inverse[0][0][l] = (m11 * m22 - m21 * m12) * oneOverDeterminant;
+            inverse[1][0][l] = -(m10 * m22 - m20 * m12) * oneOverDeterminant;
+            inverse[2][0][l] = (m10 * m21 - m20 * m11) * oneOverDeterminant;
+            inverse[0][1][l] = -(m01 * m22 - m21 * m02) * oneOverDeterminant;
+            inverse[1][1][l] = (m00 * m22 - m20 * m02) * oneOverDeterminant;
+            inverse[2][1][l] = -(m00 * m21 - m20 * m01) * oneOverDeterminant;
+            inverse[0][2][l] = (m01 * m12 - m11 * m02) * oneOverDeterminant;
+            inverse[1][2][l] = -(m00 * m12 - m10 * m02) * oneOverDeterminant;
+            inverse[2][2][l] = (m00 * m11 - m10 * m01) * oneOverDeterminant;
+        }
+
+        for (unsigned int l = 0; l < chunk.count; ++l) {
+            const std::size_t index = paletteOffsets[instanceIndices[l]] + b;
+            glm::mat4& finalTransform = finalTransforms[index];
+            for (unsigned int c = 0; c < 4; ++c) {
+                for (unsigned int r = 0; r < 3; ++r)
+                    finalTransform[c][r] = bone.m[r][c][l];
+                finalTransform[c][3] = c == 3 ? 1.0f : 0.0f;
+            }
+            glm::mat3& finalTransformIT = finalTransformsIT[index];
+            for (unsigned int c = 0; c < 3; ++c)
+                for (unsigned int r = 0; r < 3; ++r)
+                    finalTransformIT[c][r] = inverse[c][r][l];
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Animation.h"
+
+class JobSystem;
+
+// Number of instances evaluated together in structure of arrays form.
+#define SKELETONBATCH_LANES 8U
+
+// Number of lane chunks per job when animating in parallel.
+#define SKELETONBATCH_CHUNKS_PER_JOB 4U
+
+namespace Geometry {
+
+    class Skeleton;
+
+    /// Animates many skeleton instances in one call.
+    /**
+    * Instances are grouped by skeleton and animation and evaluated SKELETONBATCH_LANES at a time, with every
+    * matrix element stored as an array over the instances, so the loops vectorize across instances. Bone palettes
+    * of all instances are written to one contiguous buffer.
+    */
+    class SkeletonBatch {
+    public:
+        /// Skeleton pose to evaluate.
+        struct Instance {
+            /// Skeleton to animate.
+            const Skeleton* skeleton;
+            /// Animation to animate skeleton with, nullptr for bind pose.
+            const Animation* animation;
+            /// Time to find animation frame.
+            float timeInSeconds;
+        };
+
+        /// Columns 0 to 2 of an affine matrix per lane, indexed [column][row][lane].
+        /**
+        * Node, bone and inverse root transformations are affine, column 3 of every matrix is (0, 0, 0, 1).
+        */
+        struct AffineLanes {
+            float m[3][4][SKELETONBATCH_LANES];
+        };
+
+        /// Create new batch.
+        SkeletonBatch();
+
+        /// Destructor.
+        ~SkeletonBatch();
+
+        /// Animate instances.
+        /**
+        * Channels are resolved once per skeleton and animation pair, call ClearBindings after reloading either.
+        * Use GetFinalTransformations after animation to get matrices.
+        * @param instances Instances to animate.
+        * @param numInstances Number of instances.
+        * @param jobSystem Job system to animate instances in parallel, nullptr to animate on the calling thread.
+        */
+        void Animate(const Instance* instances, std::size_t numInstances, JobSystem* jobSystem = nullptr);
+
+        /// Forget the channels resolved for all skeleton and animation pairs.
+        void ClearBindings();
+
+        /// Get index of the first bone of an instance in the final transformations.
+        /**
+        * @param instance Instance index.
+        * @return Index of the instance's first bone.
+        */
+        std::size_t GetPaletteOffset(std::size_t instance) const;
+
+        /// Get bone transformations of all instances.
+        /**
+        * Bones of an instance are contiguous, starting at GetPaletteOffset.
+        * @return Vector of bone transformations.
+        */
+        const std::vector<glm::mat4>& GetFinalTransformations() const;
+
+        /// Get bone inverse transpose transformations of all instances.
+        /**
+        * Bones of an instance are contiguous, starting at GetPaletteOffset.
+        * @return Vector of bone inverse transpose transformations.
+        */
+        const std::vector<glm::mat3>& GetFinalTransformationsIT() const;
+
+    private:
+        // Channel of every node of a skeleton for an animation.
+        typedef std::vector<const Animation::AnimChannel*> Binding;
+
+        // Instances of one skeleton and animation.
+        struct Group {
+            const Skeleton* skeleton;
+            const Animation* animation;
+            const Binding* binding;
+        };
+
+        // Up to SKELETONBATCH_LANES instances of a group, evaluated together.
+        struct Chunk {
+            unsigned int group;
+            unsigned int first;
+            unsigned int count;
+        };
+
+        const Binding* FindBinding(const Skeleton* skeleton, const Animation* animation);
+        void AnimateChunk(const Instance* instances, const Chunk& chunk, AffineLanes* globalTransforms);
+
+        std::map<std::pair<const Skeleton*, const Animation*>, Binding> bindings;
+        std::vector<Group> groups;
+        std::vector<Chunk> chunks;
+        std::vector<unsigned int> order;
+        std::vector<std::size_t> paletteOffsets;
+        std::vector<glm::mat4> finalTransforms;
+        std::vector<glm::mat3> finalTransformsIT;
+        // Global transformations of the nodes of a chunk, maxNumNodes per job system thread.
+        std::vector<AffineLanes> globalTransforms;
+        std::size_t maxNumNodes;
+    };
+}
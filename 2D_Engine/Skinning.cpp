@@ -0,0 +1,174 @@
+#include "Skinning.h"
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+
+// Same targets as MATHFUNCTIONS_SSE.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNING_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace Geometry;
+
+namespace {
+    // Columns of a bone in the palette.
+    const std::size_t kBoneStride = 7;
+
+    // Number of weights up to the last non-zero weight, at least one.
+    inline unsigned int CountInfluences(const SkinVertex& vertex) {
+        unsigned int numInfluences = 4;
+        while (numInfluences > 1 && vertex.weights[numInfluences - 1] == 0.0f)
+            --numInfluences;
+        return numInfluences;
+    }
+
+    // Normalize vector, zero stays zero.
+    inline glm::vec3 Normalize(const glm::vec3& v) {
+        float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+        return v * (length > 0.0f ? 1.0f / length : 0.0f);
+    }
+
+    // Skin one vertex, in the order of operations of SkinVertices4.
+    void SkinVertex1(const SkinVertex& vertex, const glm::vec4* palette, SkinnedVertex& result) {
+        glm::vec3 columns[kBoneStride];
+        const unsigned int numInfluences = CountInfluences(vertex);
+        for (unsigned int k = 0; k < numInfluences; ++k) {
+            const float weight = vertex.weights[k];
+            const glm::vec4* bone = palette + vertex.boneIDs[k] * kBoneStride;
+            for (std::size_t c = 0; c < kBoneStride; ++c)
+                columns[c] = k == 0 ? glm::vec3(bone[c]) * weight : columns[c] + glm::vec3(bone[c]) * weight;
+        }
+
+        const glm::vec3& p = vertex.position;
+        const glm::vec3& n = vertex.normal;
+        const glm::vec3& t = vertex.tangent;
+        result.position = columns[0] * p.x + columns[1] * p.y + columns[2] * p.z + columns[3];
+        result.normal = Normalize(columns[4] * n.x + columns[5] * n.y + columns[6] * n.z);
+        result.tangent = Normalize(columns[0] * t.x + columns[1] * t.y + columns[2] * t.z);
+    }
+
+#ifdef SKINNING_SSE
+    template <int i>
+    inline __m128 Broadcast(__m128 v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i));
+    }
+
+    // Transform the vector in the first three elements of v by three columns.
+    inline __m128 Transform(const __m128* columns, __m128 v) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], Broadcast<0>(v)), _mm_mul_ps(columns[1], Broadcast<1>(v))), _mm_mul_ps(columns[2], Broadcast<2>(v)));
+    }
+
+    // Normalize four vectors as Normalize, transposed so one square root and division serve all four.
+    inline void Normalize4(__m128* v) {
+        __m128 x = v[0], y = v[1], z = v[2], w = v[3];
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 inv = _mm_and_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()), _mm_div_ps(_mm_set1_ps(1.0f), length));
+        v[0] = _mm_mul_ps(v[0], Broadcast<0>(inv));
+        v[1] = _mm_mul_ps(v[1], Broadcast<1>(inv));
+        v[2] = _mm_mul_ps(v[2], Broadcast<2>(inv));
+        v[3] = _mm_mul_ps(v[3], Broadcast<3>(inv));
+    }
+
+    // Skin four vertices. The bone columns of every vertex are blended a column per register, weights past the
+    // last influence are skipped. Loads of the fourth element of an attribute read the next attribute, which is
+    // ignored.
+    void SkinVertices4(const SkinVertex* vertices, const glm::vec4* palette, SkinnedVertex* result) {
+        __m128 positions[4];
+        __m128 normals[4];
+        __m128 tangents[4];
+        for (unsigned int v = 0; v < 4; ++v) {
+            const SkinVertex& vertex = vertices[v];
+            __m128 columns[kBoneStride];
+            const unsigned int numInfluences = CountInfluences(vertex);
+            for (unsigned int k = 0; k < numInfluences; ++k) {
+                const __m128 weight = _mm_set1_ps(vertex.weights[k]);
+                const float* bone = &palette[vertex.boneIDs[k] * kBoneStride].x;
+                if (k == 0) {
+                    columns[0] = _mm_mul_ps(_mm_loadu_ps(bone), weight);
+                    columns[1] = _mm_mul_ps(_mm_loadu_ps(bone + 4), weight);
+                    columns[2] = _mm_mul_ps(_mm_loadu_ps(bone + 8), weight);
+                    columns[3] = _mm_mul_ps(_mm_loadu_ps(bone + 12), weight);
+                    columns[4] = _mm_mul_ps(_mm_loadu_ps(bone + 16), weight);
+                    columns[5] = _mm_mul_ps(_mm_loadu_ps(bone + 20), weight);
+                    columns[6] = _mm_mul_ps(_mm_loadu_ps(bone + 24), weight);
+                } else {
+                    columns[0] = _mm_add_ps(columns[0], _mm_mul_ps(_mm_loadu_ps(bone), weight));
+                    columns[1] = _mm_add_ps(columns[1], _mm_mul_ps(_mm_loadu_ps(bone + 4), weight));
+                    columns[2] = _mm_add_ps(columns[2], _mm_mul_ps(_mm_loadu_ps(bone + 8), weight));
+                    columns[3] = _mm_add_ps(columns[3], _mm_mul_ps(_mm_loadu_ps(bone + 12), weight));
+                    columns[4] = _mm_add_ps(columns[4], _mm_mul_ps(_mm_loadu_ps(bone + 16), weight));
+                    columns[5] = _mm_add_ps(columns[5], _mm_mul_ps(_mm_loadu_ps(bone + 20), weight));
+                    columns[6] = _mm_add_ps(columns[6], _mm_mul_ps(_mm_loadu_ps(bone + 24), weight));
+                }
+            }
+            positions[v] = _mm_add_ps(Transform(columns, _mm_loadu_ps(&vertex.position.x)), columns[3]);
+            normals[v] = Transform(columns + 4, _mm_loadu_ps(&vertex.normal.x));
+            tangents[v] = Transform(columns, _mm_loadu_ps(&vertex.tangent.x));
+        }
+        Normalize4(normals);
+        Normalize4(tangents);
+
+        // Each store writes one float past the attribute, which the next store overwrites. Only the last tangent
+        // is stored as three floats.
+        for (unsigned int v = 0; v < 4; ++v) {
+            _mm_storeu_ps(&result[v].position.x, positions[v]);
+            _mm_storeu_ps(&result[v].normal.x, normals[v]);
+            if (v < 3) {
+                _mm_storeu_ps(&result[v].tangent.x, tangents[v]);
+            } else {
+                float values[4];
+                _mm_storeu_ps(values, tangents[v]);
+                result[v].tangent = glm::vec3(values[0], values[1], values[2]);
+            }
+        }
+    }
+#endif
+
+    void SkinRange(const SkinVertex* vertices, std::size_t begin, std::size_t end, const glm::vec4* palette, SkinnedVertex* output) {
+        std::size_t i = begin;
+#ifdef SKINNING_SSE
+        for (; i + 4 <= end; i += 4)
+            SkinVertices4(vertices + i, palette, output + i);
+#endif
+        for (; i < end; ++i)
+            SkinVertex1(vertices[i], palette, output[i]);
+    }
+}
+
+Skinning::Skinning() {
+
+}
+
+Skinning::~Skinning() {
+
+}
+
+void Skinning::SetBones(const glm::mat4* bones, const glm::mat3* bonesIT, std::size_t numBones) {
+    palette.resize(numBones * kBoneStride);
+    for (std::size_t b = 0; b < numBones; ++b) {
+        glm::vec4* bone = &palette[b * kBoneStride];
+        for (unsigned int c = 0; c < 4; ++c)
+            bone[c] = bones[b][c];
+        for (unsigned int c = 0; c < 3; ++c)
+            bone[4 + c] = glm::vec4(bonesIT != nullptr ? bonesIT[b][c] : glm::vec3(bones[b][c]), 0.0f);
+    }
+}
+
+void Skinning::Skin(const SkinVertex* vertices, std::size_t numVertices, SkinnedVertex* output, JobSystem* jobSystem) const {
+    // Chunks write disjoint ranges of the output.
+    const glm::vec4* bones = palette.data();
+    const unsigned int numChunks = static_cast<unsigned int>((numVertices + SKINNING_CHUNK_VERTICES - 1) / SKINNING_CHUNK_VERTICES);
+    auto skinChunks = [&](unsigned int begin, unsigned int end) {
+        SkinRange(vertices, static_cast<std::size_t>(begin) * SKINNING_CHUNK_VERTICES, std::min(static_cast<std::size_t>(end) * SKINNING_CHUNK_VERTICES, numVertices), bones, output);
+    };
+    if (jobSystem != nullptr && numChunks > 1)
+        jobSystem->ParallelFor(0, numChunks, 1, skinChunks);
+    else
+        skinChunks(0, numChunks);
+}
+
+std::size_t Skinning::GetNumBones() const {
+    return palette.size() / kBoneStride;
+}
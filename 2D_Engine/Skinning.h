@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "SkinVertex.h"
+
+class JobSystem;
+
+// Number of vertices skinned by one job. Input and output of a chunk fit in the L2 cache, a multiple of 4.
+#define SKINNING_CHUNK_VERTICES 1024U
+
+namespace Geometry {
+
+    /// Vertex attributes deformed by skinning.
+    struct SkinnedVertex {
+        /// Position.
+        glm::vec3 position;
+        /// Normal, normalized.
+        glm::vec3 normal;
+        /// Tangent vector, normalized.
+        glm::vec3 tangent;
+    };
+
+    /// Skins vertices on the CPU.
+    /**
+    * Blends the bone transformations of every vertex by its weights and transforms position, normal and tangent
+    * with the result. With SSE2 the blended matrix of a vertex is held a column per register and four vertices are
+    * normalized together. Vertices are skinned in chunks of SKINNING_CHUNK_VERTICES.
+    */
+    class Skinning {
+    public:
+        /// Create new skinning without bones.
+        /**
+        * Bones have to be set later using SetBones.
+        */
+        Skinning();
+
+        /// Destructor.
+        ~Skinning();
+
+        /// Set bone transformations.
+        /**
+        * Copies the bones into the palette. Call again after the skeleton is animated.
+        * @param bones Bone transformations, e.g. Skeleton::GetFinalTransformations.
+        * @param bonesIT Bone inverse transpose transformations for normals, nullptr to use bones, which is exact for rotations with uniform scale.
+        * @param numBones Number of bones.
+        */
+        void SetBones(const glm::mat4* bones, const glm::mat3* bonesIT, std::size_t numBones);
+
+        /// Skin vertices.
+        /**
+        * Weights should sum to one, vertices without weights collapse to the origin.
+        * @param vertices Vertices to skin, bone IDs have to be less than GetNumBones.
+        * @param numVertices Number of vertices.
+        * @param output Preallocated array of numVertices skinned vertices.
+        * @param jobSystem Job system to skin chunks in parallel, nullptr to skin on the calling thread.
+        */
+        void Skin(const SkinVertex* vertices, std::size_t numVertices, SkinnedVertex* output, JobSystem* jobSystem = nullptr) const;
+
+        /// Get number of bones.
+        /**
+        * @return Number of bones.
+        */
+        std::size_t GetNumBones() const;
+
+    private:
+        // Columns of every bone, followed by the columns of its inverse transpose with 0 in the fourth row.
+        std::vector<glm::vec4> palette;
+    };
+}
@@ -0,0 +1,227 @@
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    // Round offset up to SNAPSHOT_ALIGNMENT.
+    unsigned long long Align(unsigned long long offset)
+    {
+        return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+    // Write zeros until file position reaches offset.
+    bool Pad(FILE* file, unsigned long long position, unsigned long long offset)
+    {
+        static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+        return position == offset || fwrite(zeros, 1, static_cast<size_t>(offset - position), file) == offset - position;
+    }
+}
+
+Snapshot::Snapshot()
+{
+    mHeader = nullptr;
+}
+
+Snapshot::~Snapshot()
+{
+
+}
+
+bool Snapshot::Load(const std::string& path)
+{
+    mHeader = nullptr;
+    if (!mFile.Open(path))
+        return false;
+
+    // Check layout before any array is touched.
+    const SnapshotHeader* header = static_cast<const SnapshotHeader*>(mFile.GetData());
+    SnapshotHeader expected = CreateHeader(0, 0);
+    bool valid = mFile.GetSize() >= sizeof(SnapshotHeader) &&
+        header->magic == expected.magic &&
+        header->version == expected.version &&
+        header->headerSize == expected.headerSize &&
+        header->particleSize == expected.particleSize &&
+        header->particleCloudSize == expected.particleCloudSize;
+    if (valid)
+    {
+        expected = CreateHeader(header->numParticles, header->numParticleClouds);
+        valid = header->particlesOffset == expected.particlesOffset &&
+            header->particleCloudsOffset == expected.particleCloudsOffset &&
+            header->fileSize == expected.fileSize &&
+            header->fileSize <= mFile.GetSize();
+    }
+    if (valid)
+    {
+        // Clouds index the particle array with their particle range.
+        const ParticleCloud* particleClouds = reinterpret_cast<const ParticleCloud*>(static_cast<const char*>(mFile.GetData()) + header->particleCloudsOffset);
+        for (unsigned int i = 0; i < header->numParticleClouds && valid; ++i)
+            valid = static_cast<unsigned long long>(particleClouds[i].mParticleStartID) + particleClouds[i].mNumParticles <= header->numParticles;
+    }
+    if (!valid)
+    {
+        mFile.Close();
+        return false;
+    }
+
+    mHeader = header;
+    return true;
+}
+
+void Snapshot::Close()
+{
+    mFile.Close();
+    mHeader = nullptr;
+}
+
+const SnapshotHeader& Snapshot::GetHeader() const
+{
+    return *mHeader;
+}
+
+const Particle* Snapshot::GetParticles() const
+{
+    return reinterpret_cast<const Particle*>(static_cast<const char*>(mFile.GetData()) + mHeader->particlesOffset);
+}
+
+const ParticleCloud* Snapshot::GetParticleClouds() const
+{
+    return reinterpret_cast<const ParticleCloud*>(static_cast<const char*>(mFile.GetData()) + mHeader->particleCloudsOffset);
+}
+
+SnapshotHeader Snapshot::CreateHeader(unsigned int numParticles, unsigned int numParticleClouds)
+{
+    SnapshotHeader header = SnapshotHeader();
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.particleSize = sizeof(Particle);
+    header.particleCloudSize = sizeof(ParticleCloud);
+    header.numParticles = numParticles;
+    header.numParticleClouds = numParticleClouds;
+    header.particlesOffset = Align(sizeof(SnapshotHeader));
+    header.particleCloudsOffset = Align(header.particlesOffset + static_cast<unsigned long long>(numParticles) * sizeof(Particle));
+    header.fileSize = header.particleCloudsOffset + static_cast<unsigned long long>(numParticleClouds) * sizeof(ParticleCloud);
+    return header;
+}
+
+bool Snapshot::Write(const std::string& path, const SnapshotHeader& header, const Particle* particles, const ParticleCloud* particleClouds)
+{
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    unsigned long long particlesSize = static_cast<unsigned long long>(header.numParticles) * sizeof(Particle);
+    unsigned long long particleCloudsSize = static_cast<unsigned long long>(header.numParticleClouds) * sizeof(ParticleCloud);
+    bool written = fwrite(&header, sizeof(SnapshotHeader), 1, file) == 1 &&
+        Pad(file, sizeof(SnapshotHeader), header.particlesOffset) &&
+        fwrite(particles, 1, static_cast<size_t>(particlesSize), file) == particlesSize &&
+        Pad(file, header.particlesOffset + particlesSize, header.particleCloudsOffset) &&
+        fwrite(particleClouds, 1, static_cast<size_t>(particleCloudsSize), file) == particleCloudsSize;
+    written &= fclose(file) == 0;
+
+    // Rename does not replace existing files on Windows.
+    if (written)
+    {
+        remove(path.c_str());
+        written = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!written)
+        remove(temporaryPath.c_str());
+    return written;
+}
+
+SnapshotWriter::SnapshotWriter()
+{
+    mBusy = false;
+    mPending = false;
+    mQuit = false;
+    mResult = true;
+    mThread = std::thread(&SnapshotWriter::WriterThread, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+bool SnapshotWriter::Begin(unsigned int numParticles, unsigned int numParticleClouds, Particle** particles, ParticleCloud** particleClouds)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mBusy)
+            return false;
+        mBusy = true;
+    }
+
+    mParticles.resize(numParticles);
+    mParticleClouds.resize(numParticleClouds);
+    *particles = mParticles.data();
+    *particleClouds = mParticleClouds.data();
+    return true;
+}
+
+void SnapshotWriter::End(const std::string& path, const SnapshotHeader& header)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPath = path;
+        mHeader = header;
+        mPending = true;
+    }
+    mCondition.notify_all();
+}
+
+bool SnapshotWriter::Write(const std::string& path, const SnapshotHeader& header, const Particle* particles, const ParticleCloud* particleClouds)
+{
+    Particle* stagingParticles;
+    ParticleCloud* stagingParticleClouds;
+    if (!Begin(header.numParticles, header.numParticleClouds, &stagingParticles, &stagingParticleClouds))
+        return false;
+
+    std::copy(particles, particles + header.numParticles, stagingParticles);
+    std::copy(particleClouds, particleClouds + header.numParticleClouds, stagingParticleClouds);
+    End(path, header);
+    return true;
+}
+
+bool SnapshotWriter::IsBusy()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBusy;
+}
+
+bool SnapshotWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this] { return !mBusy; });
+    return mResult;
+}
+
+void SnapshotWriter::WriterThread()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mCondition.wait(lock, [this] { return mQuit || mPending; });
+        if (!mPending)
+            return;
+
+        // Staging is owned by this thread until mBusy is cleared.
+        lock.unlock();
+        bool result = Snapshot::Write(mPath, mHeader, mParticles.data(), mParticleClouds.data());
+        lock.lock();
+
+        mResult = result;
+        mPending = false;
+        mBusy = false;
+        mCondition.notify_all();
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <condition_variable>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Particle.h"
+#include "ParticleCloud.h"
+
+// Snapshot file identifier, "PSNP" in a little-endian file.
+#define SNAPSHOT_MAGIC 0x504E5350U
+
+// Snapshot format version. Increment when the header, Particle or ParticleCloud layout changes.
+#define SNAPSHOT_VERSION 1U
+
+// Alignment of arrays in a snapshot file. Page size, so mapped arrays are aligned like allocated ones.
+#define SNAPSHOT_ALIGNMENT 4096U
+
+// Header at the start of a snapshot file. The particle and particle cloud arrays follow at aligned offsets.
+struct SnapshotHeader
+{
+    // SNAPSHOT_MAGIC.
+    unsigned int magic;
+    // SNAPSHOT_VERSION.
+    unsigned int version;
+    // sizeof(SnapshotHeader), sizeof(Particle) and sizeof(ParticleCloud) of the writer.
+    unsigned int headerSize;
+    unsigned int particleSize;
+    unsigned int particleCloudSize;
+    // Number of particles and particle clouds.
+    unsigned int numParticles;
+    unsigned int numParticleClouds;
+    // Scene random seed and distribution. Scene generation is counter-based, so the seed is the whole random state.
+    unsigned int seed;
+    unsigned int distribution;
+    unsigned int reserved;
+    // Number of simulated frames and simulated time in seconds.
+    unsigned long long frame;
+    double time;
+    // Camera.
+    glm::vec3 cameraPosition;
+    glm::vec3 cameraFrontDirection;
+    glm::vec3 cameraUpDirection;
+    glm::vec3 cameraRightDirection;
+    // Byte offsets of the arrays and size of the file.
+    unsigned long long particlesOffset;
+    unsigned long long particleCloudsOffset;
+    unsigned long long fileSize;
+};
+
+// Simulation state loaded from a memory mapped snapshot file. Arrays point into the mapping and are used in place.
+class Snapshot
+{
+    public:
+        // Constructor.
+        Snapshot();
+
+        // Destructor. Unmaps file, arrays become invalid.
+        ~Snapshot();
+
+        // Map and validate snapshot file. Particle ranges of the clouds are checked against the particle array.
+        // path File path.
+        // Returns whether file is a valid snapshot of this version and layout.
+        bool Load(const std::string& path);
+
+        // Unmap file, arrays and header become invalid. Lets the file be replaced, e.g. by a checkpoint.
+        void Close();
+
+        // Get header.
+        const SnapshotHeader& GetHeader() const;
+
+        // Get particles, GetHeader().numParticles elements.
+        const Particle* GetParticles() const;
+
+        // Get particle clouds, GetHeader().numParticleClouds elements.
+        const ParticleCloud* GetParticleClouds() const;
+
+        // Create header with layout fields and offsets filled in. Remaining fields are zero.
+        // numParticles Number of particles.
+        // numParticleClouds Number of particle clouds.
+        static SnapshotHeader CreateHeader(unsigned int numParticles, unsigned int numParticleClouds);
+
+        // Write snapshot file on the calling thread. Writes to a temporary file and renames it, so a crash never leaves a partial snapshot.
+        // path File path.
+        // header Header created by CreateHeader.
+        // particles Particles, header.numParticles elements.
+        // particleClouds Particle clouds, header.numParticleClouds elements.
+        // Returns whether file was written.
+        static bool Write(const std::string& path, const SnapshotHeader& header, const Particle* particles, const ParticleCloud* particleClouds);
+
+    private:
+        MappedFile mFile;
+        const SnapshotHeader* mHeader;
+};
+
+// Writes snapshots on a background thread. State is copied into preallocated staging arrays, so the simulation
+// continues while the file is written. Staging only grows, repeated snapshots of a scene do not allocate.
+class SnapshotWriter
+{
+    public:
+        // Constructor. Starts writer thread.
+        SnapshotWriter();
+
+        // Destructor. Finishes pending snapshot.
+        ~SnapshotWriter();
+
+        // Get staging arrays of next snapshot. Does not block.
+        // numParticles Number of particles.
+        // numParticleClouds Number of particle clouds.
+        // particles Staging particles to fill.
+        // particleClouds Staging particle clouds to fill.
+        // Returns false if the previous snapshot is still being written.
+        bool Begin(unsigned int numParticles, unsigned int numParticleClouds, Particle** particles, ParticleCloud** particleClouds);
+
+        // Write staged snapshot on the writer thread.
+        // path File path.
+        // header Header created by Snapshot::CreateHeader with the counts passed to Begin.
+        void End(const std::string& path, const SnapshotHeader& header);
+
+        // Copy state and write it on the writer thread. Does not block.
+        // path File path.
+        // header Header created by Snapshot::CreateHeader.
+        // particles Particles, header.numParticles elements.
+        // particleClouds Particle clouds, header.numParticleClouds elements.
+        // Returns false if the previous snapshot is still being written.
+        bool Write(const std::string& path, const SnapshotHeader& header, const Particle* particles, const ParticleCloud* particleClouds);
+
+        // Get whether a snapshot is being written.
+        bool IsBusy();
+
+        // Wait for pending snapshot.
+        // Returns whether the last snapshot was written.
+        bool Wait();
+
+    private:
+        void WriterThread();
+
+        std::thread mThread;
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        bool mBusy;
+        bool mPending;
+        bool mQuit;
+        bool mResult;
+        std::string mPath;
+        SnapshotHeader mHeader;
+        std::vector<Particle> mParticles;
+        std::vector<ParticleCloud> mParticleClouds;
+};
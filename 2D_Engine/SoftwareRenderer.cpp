@@ -0,0 +1,91 @@
+#include "SoftwareRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// Max splat radius in pixels, bounds the cost of particles close to the camera.
+#define SOFTWARERENDERER_MAX_SPLAT_RADIUS 64.f
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height, unsigned int maxNumParticles) : mDepthSorter(maxNumParticles)
+{
+    mWidth = width;
+    mHeight = height;
+    mColorBuffer.resize(width * height);
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+
+}
+
+unsigned int SoftwareRenderer::Render(const Particle* particles, unsigned int numParticles, const glm::mat4& vpMatrix)
+{
+    // Clear render target.
+    std::fill(mColorBuffer.begin(), mColorBuffer.end(), glm::vec3(0.f, 0.f, 0.f));
+
+    // Sort visible particles back to front.
+    unsigned int numVisible = mDepthSorter.Sort(particles, numParticles, vpMatrix, true);
+    const unsigned int* indices = mDepthSorter.GetSortedIndices();
+
+    // Pixels per world unit at w = 1.
+    float scaleX = glm::length(glm::vec3(vpMatrix[0][0], vpMatrix[1][0], vpMatrix[2][0])) * mWidth * 0.5f;
+    float scaleY = glm::length(glm::vec3(vpMatrix[0][1], vpMatrix[1][1], vpMatrix[2][1])) * mHeight * 0.5f;
+
+    for (unsigned int i = 0; i < numVisible; ++i)
+    {
+        const Particle& particle = particles[indices[i]];
+        glm::vec4 clipPosition = vpMatrix * glm::vec4(particle.mPosition, 1.f);
+        float invW = 1.f / clipPosition.w;
+
+        // Splat center and radius in pixels.
+        float centerX = (clipPosition.x * invW * 0.5f + 0.5f) * mWidth;
+        float centerY = (0.5f - clipPosition.y * invW * 0.5f) * mHeight;
+        float radiusX = std::min(particle.mScale.x * scaleX * invW, SOFTWARERENDERER_MAX_SPLAT_RADIUS);
+        float radiusY = std::min(particle.mScale.y * scaleY * invW, SOFTWARERENDERER_MAX_SPLAT_RADIUS);
+        if (radiusX <= 0.f || radiusY <= 0.f)
+            continue;
+
+        int minX = std::max(static_cast<int>(centerX - radiusX), 0);
+        int maxX = std::min(static_cast<int>(centerX + radiusX), static_cast<int>(mWidth) - 1);
+        int minY = std::max(static_cast<int>(centerY - radiusY), 0);
+        int maxY = std::min(static_cast<int>(centerY + radiusY), static_cast<int>(mHeight) - 1);
+        for (int y = minY; y <= maxY; ++y)
+        {
+            float dy = (y + 0.5f - centerY) / radiusY;
+            for (int x = minX; x <= maxX; ++x)
+            {
+                // Same falloff as Particles_Render_PS.hlsl.
+                float dx = (x + 0.5f - centerX) / radiusX;
+                float factor = std::max(1.f - std::sqrt(dx * dx + dy * dy), 0.f);
+                float alpha = 1.f - std::sin(3.14159265f / 2.f * (factor + 1.f));
+                glm::vec3& color = mColorBuffer[y * mWidth + x];
+                color = color * (1.f - alpha) + particle.mColor * alpha;
+            }
+        }
+    }
+
+    return numVisible;
+}
+
+const glm::vec3* SoftwareRenderer::GetColorBuffer() const
+{
+    return mColorBuffer.data();
+}
+
+bool SoftwareRenderer::WritePPM(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file << "P6\n" << mWidth << " " << mHeight << "\n255\n";
+    for (const glm::vec3& color : mColorBuffer)
+    {
+        glm::vec3 clamped = glm::clamp(color, 0.f, 1.f) * 255.f;
+        unsigned char rgb[3] = { static_cast<unsigned char>(clamped.r), static_cast<unsigned char>(clamped.g), static_cast<unsigned char>(clamped.b) };
+        file.write(reinterpret_cast<const char*>(rgb), 3);
+    }
+
+    return file.good();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "Particle.h"
+#include "ParticleDepthSorter.h"
+
+// Renders particles on the CPU into a color buffer. Used for headless runs without a D3D11 device.
+// Particles are splatted as round billboards, blended back to front like ParticleRenderer in alpha mode.
+class SoftwareRenderer
+{
+    public:
+        // Constructor.
+        // width Color buffer width.
+        // height Color buffer height.
+        // maxNumParticles Max number of particles to render.
+        SoftwareRenderer(unsigned int width, unsigned int height, unsigned int maxNumParticles);
+
+        // Destructor.
+        ~SoftwareRenderer();
+
+        // Clear color buffer and render particles.
+        // particles Array of particles.
+        // numParticles Number of particles.
+        // vpMatrix View projection matrix (not transposed).
+        // Returns number of rendered particles.
+        unsigned int Render(const Particle* particles, unsigned int numParticles, const glm::mat4& vpMatrix);
+
+        // Get color buffer, width * height pixels in row order from the top.
+        const glm::vec3* GetColorBuffer() const;
+
+        // Write color buffer as binary PPM image.
+        // path File path.
+        // Returns whether file could be written.
+        bool WritePPM(const std::string& path) const;
+
+        // Color buffer width.
+        unsigned int mWidth;
+
+        // Color buffer height.
+        unsigned int mHeight;
+
+    private:
+        std::vector<glm::vec3> mColorBuffer;
+        ParticleDepthSorter mDepthSorter;
+};
@@ -0,0 +1,369 @@
+#include "Telemetry.h"
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <csignal>
+#include <iomanip>
+
+// Linear sub-buckets per power of two.
+#define HISTOGRAM_SUB_BUCKET_BITS 6U
+#define HISTOGRAM_SUB_BUCKETS (1U << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_NUM_BUCKETS ((64U - HISTOGRAM_SUB_BUCKET_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+// Number of stutters kept for the summary.
+#define TELEMETRY_MAX_STUTTERS 32U
+
+// Min number of frames in rolling window before stutters are detected.
+#define TELEMETRY_MIN_WINDOW 16U
+
+namespace
+{
+    volatile std::sig_atomic_t gSignal = 0;
+
+    void SignalHandler(int signal)
+    {
+        gSignal = signal;
+    }
+
+    unsigned int HighestBit(unsigned long long value)
+    {
+        unsigned int bit = 0;
+        while (value >>= 1)
+            ++bit;
+        return bit;
+    }
+}
+
+Histogram::Histogram()
+{
+    mBuckets.resize(HISTOGRAM_NUM_BUCKETS);
+    Reset();
+}
+
+Histogram::~Histogram()
+{
+
+}
+
+unsigned int Histogram::BucketIndex(long long value)
+{
+    unsigned long long v = value > 0 ? static_cast<unsigned long long>(value) : 0;
+    if (v < HISTOGRAM_SUB_BUCKETS)
+        return static_cast<unsigned int>(v);
+    unsigned int msb = HighestBit(v);
+    unsigned int shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + static_cast<unsigned int>((v >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+long long Histogram::BucketValue(unsigned int index)
+{
+    if (index < HISTOGRAM_SUB_BUCKETS)
+        return index;
+    unsigned int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    unsigned long long sub = index % HISTOGRAM_SUB_BUCKETS;
+    // Middle of bucket.
+    unsigned long long lower = (HISTOGRAM_SUB_BUCKETS + sub) << shift;
+    return static_cast<long long>(lower + ((1ULL << shift) >> 1));
+}
+
+void Histogram::Record(long long value)
+{
+    ++mBuckets[BucketIndex(value)];
+    ++mCount;
+    mSum += static_cast<double>(value);
+    mMin = std::min(mMin, value);
+    mMax = std::max(mMax, value);
+}
+
+long long Histogram::Percentile(double percentile) const
+{
+    if (mCount == 0)
+        return 0;
+
+    unsigned long long rank = static_cast<unsigned long long>(percentile * mCount + 0.999999);
+    rank = std::min(std::max(rank, 1ULL), mCount);
+    unsigned long long count = 0;
+    for (unsigned int i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i)
+    {
+        count += mBuckets[i];
+        if (count >= rank)
+            return std::min(std::max(BucketValue(i), mMin), mMax);
+    }
+    return mMax;
+}
+
+unsigned long long Histogram::Count() const
+{
+    return mCount;
+}
+
+double Histogram::Mean() const
+{
+    return mCount > 0 ? mSum / mCount : 0.0;
+}
+
+long long Histogram::Min() const
+{
+    return mCount > 0 ? mMin : 0;
+}
+
+long long Histogram::Max() const
+{
+    return mCount > 0 ? mMax : 0;
+}
+
+void Histogram::Merge(const Histogram& other)
+{
+    for (unsigned int i = 0; i < HISTOGRAM_NUM_BUCKETS; ++i)
+        mBuckets[i] += other.mBuckets[i];
+    if (other.mCount > 0)
+    {
+        mMin = std::min(mMin, other.mMin);
+        mMax = std::max(mMax, other.mMax);
+    }
+    mCount += other.mCount;
+    mSum += other.mSum;
+}
+
+void Histogram::Reset()
+{
+    std::fill(mBuckets.begin(), mBuckets.end(), 0ULL);
+    mCount = 0;
+    mSum = 0.0;
+    mMin = 0x7FFFFFFFFFFFFFFFLL;
+    mMax = 0;
+}
+
+Telemetry::Telemetry(float stutterFactor, unsigned int windowSize, bool deferredStages)
+{
+    mStutterFactor = stutterFactor;
+    mWindowSize = windowSize;
+    mDeferredStages = deferredStages;
+    mNumFrames = 0;
+    mNumStageFrames = 0;
+    mNumStutters = 0;
+    mFrameStart = 0;
+    mFrameWindow.resize(windowSize);
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+    {
+        mStageStutters[s] = 0;
+        mStageStart[s] = 0;
+        mStageTime[s] = 0;
+        mStageWindows[s].resize(windowSize);
+    }
+    mScratch.reserve(windowSize);
+    mStutters.reserve(TELEMETRY_MAX_STUTTERS);
+}
+
+Telemetry::~Telemetry()
+{
+
+}
+
+void Telemetry::BeginFrame()
+{
+    mFrameStart = Profiler::Now();
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+        mStageTime[s] = 0;
+}
+
+void Telemetry::EndFrame()
+{
+    long long frameTime = Profiler::Now() - mFrameStart;
+    mFrameHistogram.Record(frameTime);
+
+    // Check for stutter against rolling medians of previous frames.
+    unsigned int windowFill = static_cast<unsigned int>(std::min(mNumFrames, (unsigned long long)mWindowSize));
+    if (windowFill >= TELEMETRY_MIN_WINDOW)
+    {
+        long long medianFrameTime = Median(mFrameWindow.data(), windowFill, mScratch);
+        if (frameTime > mStutterFactor * medianFrameTime)
+        {
+            // Deferred stages are blamed by AddStageTimes, until then the stage is unknown.
+            Stutter stutter;
+            stutter.frame = mNumFrames;
+            stutter.frameTime = frameTime;
+            stutter.medianFrameTime = medianFrameTime;
+            stutter.stage = mDeferredStages ? NUM_STAGES : FindCulprit(mStageTime, windowFill);
+            stutter.stageTime = mDeferredStages ? 0 : mStageTime[stutter.stage];
+            if (mStutters.size() < TELEMETRY_MAX_STUTTERS)
+                mStutters.push_back(stutter);
+            else
+                mStutters[mNumStutters % TELEMETRY_MAX_STUTTERS] = stutter;
+
+            if (!mDeferredStages)
+                ++mStageStutters[stutter.stage];
+            ++mNumStutters;
+        }
+    }
+
+    // Update rolling windows.
+    unsigned int slot = static_cast<unsigned int>(mNumFrames % mWindowSize);
+    mFrameWindow[slot] = frameTime;
+    if (!mDeferredStages)
+    {
+        for (unsigned int s = 0; s < NUM_STAGES; ++s)
+            mStageWindows[s][slot] = mStageTime[s];
+    }
+
+    ++mNumFrames;
+}
+
+void Telemetry::AddStageTimes(unsigned long long frame, const long long* stageTimes)
+{
+    long long times[NUM_STAGES];
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+    {
+        times[s] = std::max(stageTimes[s], 0LL);
+        if (stageTimes[s] >= 0)
+            mStageHistograms[s].Record(stageTimes[s]);
+    }
+
+    // Blame a stutter of the frame if it is still kept.
+    unsigned int windowFill = static_cast<unsigned int>(std::min(mNumStageFrames, (unsigned long long)mWindowSize));
+    for (Stutter& stutter : mStutters)
+    {
+        if (stutter.frame == frame && stutter.stage == NUM_STAGES)
+        {
+            stutter.stage = FindCulprit(times, windowFill);
+            stutter.stageTime = times[stutter.stage];
+            ++mStageStutters[stutter.stage];
+        }
+    }
+
+    unsigned int slot = static_cast<unsigned int>(mNumStageFrames % mWindowSize);
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+        mStageWindows[s][slot] = times[s];
+    ++mNumStageFrames;
+}
+
+Telemetry::Stage Telemetry::FindCulprit(const long long* stageTimes, unsigned int windowFill)
+{
+    Stage culprit = SORT;
+    long long maxExcess = -0x7FFFFFFFFFFFFFFFLL;
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+    {
+        long long median = windowFill > 0 ? Median(mStageWindows[s].data(), windowFill, mScratch) : 0;
+        long long excess = stageTimes[s] - median;
+        if (excess > maxExcess)
+        {
+            maxExcess = excess;
+            culprit = static_cast<Stage>(s);
+        }
+    }
+    return culprit;
+}
+
+void Telemetry::BeginStage(Stage stage)
+{
+    mStageStart[stage] = Profiler::Now();
+}
+
+void Telemetry::EndStage(Stage stage)
+{
+    long long stageTime = Profiler::Now() - mStageStart[stage];
+    mStageTime[stage] += stageTime;
+    mStageHistograms[stage].Record(stageTime);
+}
+
+const Histogram& Telemetry::GetFrameHistogram() const
+{
+    return mFrameHistogram;
+}
+
+const Histogram& Telemetry::GetStageHistogram(Stage stage) const
+{
+    return mStageHistograms[stage];
+}
+
+unsigned long long Telemetry::GetNumFrames() const
+{
+    return mNumFrames;
+}
+
+unsigned long long Telemetry::GetNumStutters() const
+{
+    return mNumStutters;
+}
+
+void Telemetry::DumpSummary(std::ostream& stream) const
+{
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(3);
+
+    auto dumpHistogram = [&stream](const char* name, const Histogram& histogram) {
+        stream << std::setw(16) << std::left << name << std::right
+            << " n " << histogram.Count()
+            << ", mean " << histogram.Mean() / 1000000.0 << " ms"
+            << ", p50 " << histogram.Percentile(0.50) / 1000000.0 << " ms"
+            << ", p90 " << histogram.Percentile(0.90) / 1000000.0 << " ms"
+            << ", p99 " << histogram.Percentile(0.99) / 1000000.0 << " ms"
+            << ", p99.9 " << histogram.Percentile(0.999) / 1000000.0 << " ms"
+            << ", max " << histogram.Max() / 1000000.0 << " ms" << std::endl;
+    };
+
+    stream << "----- Telemetry: " << mNumFrames << " frames" << (mDeferredStages ? ", GPU stage times" : "") << " -----" << std::endl;
+    dumpHistogram("Frame", mFrameHistogram);
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+        dumpHistogram(GetStageName(static_cast<Stage>(s)), mStageHistograms[s]);
+
+    stream << "Stutters (> " << mStutterFactor << "x rolling median): " << mNumStutters << std::endl;
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+        if (mStageStutters[s] > 0)
+            stream << "  " << GetStageName(static_cast<Stage>(s)) << " : " << mStageStutters[s] << std::endl;
+    // Once the ring has wrapped, the oldest kept stutter is at the next slot to overwrite.
+    std::size_t first = 0;
+    if (mNumStutters > mStutters.size())
+    {
+        first = static_cast<std::size_t>(mNumStutters % TELEMETRY_MAX_STUTTERS);
+        stream << "  showing last " << mStutters.size() << " of " << mNumStutters << std::endl;
+    }
+    for (std::size_t i = 0; i < mStutters.size(); ++i)
+    {
+        const Stutter& stutter = mStutters[(first + i) % mStutters.size()];
+        stream << "  frame " << stutter.frame << " : " << stutter.frameTime / 1000000.0 << " ms (median "
+            << stutter.medianFrameTime / 1000000.0 << " ms), " << GetStageName(stutter.stage) << " "
+            << stutter.stageTime / 1000000.0 << " ms" << std::endl;
+    }
+
+    stream.flags(flags);
+    stream.precision(precision);
+}
+
+const char* Telemetry::GetStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case SORT: return "Sort";
+        case CLOUD_UPDATE: return "Cloud update";
+        case PARTICLE_UPDATE: return "Particle update";
+        case RENDER: return "Render";
+        default: return "Unknown";
+    }
+}
+
+void Telemetry::InstallSignalHandlers()
+{
+    std::signal(SIGINT, SignalHandler);
+    std::signal(SIGTERM, SignalHandler);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, SignalHandler);
+#endif
+}
+
+int Telemetry::PollSignal()
+{
+    int signal = gSignal;
+    gSignal = 0;
+    return signal;
+}
+
+long long Telemetry::Median(const long long* window, unsigned int count, std::vector<long long>& scratch)
+{
+    scratch.assign(window, window + count);
+    std::size_t mid = scratch.size() / 2;
+    std::nth_element(scratch.begin(), scratch.begin() + mid, scratch.end());
+    return scratch[mid];
+}
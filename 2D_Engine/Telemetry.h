@@ -0,0 +1,180 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+// HDR-style histogram. Buckets are logarithmic with 64 linear sub-buckets per power of two (~1.6% precision).
+class Histogram
+{
+    public:
+        // Constructor.
+        Histogram();
+
+        // Destructor.
+        ~Histogram();
+
+        // Record value.
+        // value Value to record, e.g. duration in nanoseconds.
+        void Record(long long value);
+
+        // Get value at percentile.
+        // percentile Percentile in range [0, 1].
+        // Returns value, 0 if empty.
+        long long Percentile(double percentile) const;
+
+        // Number of recorded values.
+        unsigned long long Count() const;
+
+        // Mean of recorded values.
+        double Mean() const;
+
+        // Min recorded value.
+        long long Min() const;
+
+        // Max recorded value.
+        long long Max() const;
+
+        // Add all values of other histogram.
+        // other Histogram to merge.
+        void Merge(const Histogram& other);
+
+        // Remove all values.
+        void Reset();
+
+    private:
+        static unsigned int BucketIndex(long long value);
+        static long long BucketValue(unsigned int index);
+
+        std::vector<unsigned long long> mBuckets;
+        unsigned long long mCount;
+        double mSum;
+        long long mMin;
+        long long mMax;
+};
+
+// Records frame and stage times, detects stutters and reports tail latency.
+class Telemetry
+{
+    public:
+        // Frame stage.
+        enum Stage
+        {
+            SORT,
+            CLOUD_UPDATE,
+            PARTICLE_UPDATE,
+            RENDER,
+            NUM_STAGES
+        };
+
+        // Constructor.
+        // stutterFactor Frame is a stutter if frame time exceeds stutterFactor times the rolling median.
+        // windowSize Number of frames in the rolling median window.
+        // deferredStages Whether stage times are passed to AddStageTimes after the frame, e.g. by GPUStageTimer,
+        // instead of being measured with BeginStage and EndStage.
+        Telemetry(float stutterFactor = 2.f, unsigned int windowSize = 128, bool deferredStages = false);
+
+        // Destructor.
+        ~Telemetry();
+
+        // Begin frame.
+        void BeginFrame();
+
+        // End frame. Records frame time and checks for stutter.
+        void EndFrame();
+
+        // Begin stage.
+        // stage Stage to begin.
+        void BeginStage(Stage stage);
+
+        // End stage.
+        // stage Stage to end.
+        void EndStage(Stage stage);
+
+        // Record stage times of an ended frame. Stutters of the frame are blamed when its stage times arrive, frames
+        // whose stage times never arrive keep an unknown stage.
+        // frame Frame index, GetNumFrames() before the frame's EndFrame.
+        // stageTimes Time of every stage in nanoseconds, negative for stages the frame did not run.
+        void AddStageTimes(unsigned long long frame, const long long* stageTimes);
+
+        // Scoped stage.
+        class StageScope
+        {
+            public:
+                StageScope(Telemetry& telemetry, Stage stage) : mTelemetry(telemetry), mStage(stage) { mTelemetry.BeginStage(mStage); }
+                ~StageScope() { mTelemetry.EndStage(mStage); }
+            private:
+                Telemetry& mTelemetry;
+                Stage mStage;
+        };
+
+        // Get frame time histogram (nanoseconds).
+        const Histogram& GetFrameHistogram() const;
+
+        // Get stage time histogram (nanoseconds).
+        // stage Stage.
+        const Histogram& GetStageHistogram(Stage stage) const;
+
+        // Get number of recorded frames.
+        unsigned long long GetNumFrames() const;
+
+        // Get number of detected stutters.
+        unsigned long long GetNumStutters() const;
+
+        // Print summary of frame and stage percentiles and stutters.
+        // stream Output stream.
+        void DumpSummary(std::ostream& stream) const;
+
+        // Get stage name.
+        // stage Stage.
+        static const char* GetStageName(Stage stage);
+
+        // Install SIGINT/SIGTERM (and SIGUSR1 where available) handlers that request a summary dump.
+        static void InstallSignalHandlers();
+
+        // Get and clear last received signal.
+        // Returns signal number, 0 if none.
+        static int PollSignal();
+
+    private:
+        // Detected stutter.
+        struct Stutter
+        {
+            unsigned long long frame;
+            long long frameTime;
+            long long medianFrameTime;
+            Stage stage;
+            long long stageTime;
+        };
+
+        // Get median of rolling window.
+        // window Window values.
+        // count Number of values.
+        // scratch Scratch memory.
+        static long long Median(const long long* window, unsigned int count, std::vector<long long>& scratch);
+
+        // Get stage that exceeded its own rolling median the most.
+        // stageTimes Time of every stage.
+        // windowFill Number of frames in the stage windows.
+        Stage FindCulprit(const long long* stageTimes, unsigned int windowFill);
+
+        float mStutterFactor;
+        unsigned int mWindowSize;
+        bool mDeferredStages;
+        unsigned long long mNumFrames;
+        unsigned long long mNumStageFrames;
+        unsigned long long mNumStutters;
+        unsigned long long mStageStutters[NUM_STAGES];
+
+        long long mFrameStart;
+        long long mStageStart[NUM_STAGES];
+        long long mStageTime[NUM_STAGES];
+
+        Histogram mFrameHistogram;
+        Histogram mStageHistograms[NUM_STAGES];
+
+        std::vector<long long> mFrameWindow;
+        std::vector<long long> mStageWindows[NUM_STAGES];
+        std::vector<long long> mScratch;
+
+        std::vector<Stutter> mStutters;
+};
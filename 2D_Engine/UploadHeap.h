@@ -0,0 +1,117 @@
+#pragma once
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <assert.h>
+#include <cstring>
+#include <vector>
+
+#include "DxAssert.h"
+
+template <typename T>
+// Dynamic structured buffer suballocated into slots of one element, each with its own view.
+// All elements of a frame are written with a single map instead of one map per pass. The map discards, so passes
+// already queued keep reading the elements of the previous upload.
+class UploadHeap
+{
+    public:
+        // Constructor.
+        // pDevice Pointer to D3D11 device.
+        // pDeviceContext Pointer to D3D11 device context.
+        // capacity Number of slots.
+        UploadHeap(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int capacity);
+
+        // Destructor.
+        ~UploadHeap();
+
+        // Write elements to slots 0 to numOfElements - 1.
+        // data Source of numOfElements elements.
+        // numOfElements Number of elements, at most the capacity.
+        void Upload(const T* data, unsigned int numOfElements);
+
+        // Get view of a slot, bound as StructuredBuffer<T> whose element 0 is the slot.
+        // slot Slot index.
+        ID3D11ShaderResourceView* GetView(unsigned int slot);
+
+        // Get number of slots.
+        unsigned int GetCapacity() const;
+
+        // Get number of maps since construction.
+        unsigned long long GetNumUploads() const;
+
+    private:
+        ID3D11DeviceContext* mpDeviceContext;
+        ID3D11Buffer* mBuffer;
+        std::vector<ID3D11ShaderResourceView*> mViews;
+        unsigned long long mNumUploads;
+};
+
+template <typename T>
+inline UploadHeap<T>::UploadHeap(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int capacity)
+{
+    mpDeviceContext = pDeviceContext;
+    mNumUploads = 0;
+
+    D3D11_BUFFER_DESC bDesc;
+    ZeroMemory(&bDesc, sizeof(D3D11_BUFFER_DESC));
+    bDesc.ByteWidth = sizeof(T) * capacity;
+    bDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    bDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    bDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    bDesc.StructureByteStride = sizeof(T);
+    DxAssert(pDevice->CreateBuffer(&bDesc, NULL, &mBuffer), S_OK);
+
+    mViews.resize(capacity);
+    for (unsigned int i = 0; i < capacity; ++i)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+        ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+        srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        srvDesc.Buffer.FirstElement = i;
+        srvDesc.Buffer.NumElements = 1;
+        DxAssert(pDevice->CreateShaderResourceView(mBuffer, &srvDesc, &mViews[i]), S_OK);
+    }
+}
+
+template <typename T>
+inline UploadHeap<T>::~UploadHeap()
+{
+    for (ID3D11ShaderResourceView* view : mViews)
+        view->Release();
+    mBuffer->Release();
+}
+
+template <typename T>
+inline void UploadHeap<T>::Upload(const T* data, unsigned int numOfElements)
+{
+    assert(numOfElements <= mViews.size());
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    ZeroMemory(&mappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
+    DxAssert(mpDeviceContext->Map(mBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource), S_OK);
+    memcpy(mappedResource.pData, data, sizeof(T) * numOfElements);
+    mpDeviceContext->Unmap(mBuffer, 0);
+    ++mNumUploads;
+}
+
+template <typename T>
+inline ID3D11ShaderResourceView* UploadHeap<T>::GetView(unsigned int slot)
+{
+    return mViews[slot];
+}
+
+template <typename T>
+inline unsigned int UploadHeap<T>::GetCapacity() const
+{
+    return static_cast<unsigned int>(mViews.size());
+}
+
+template <typename T>
+inline unsigned long long UploadHeap<T>::GetNumUploads() const
+{
+    return mNumUploads;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <ostream>
+
+// Work counters are compiled in debug builds. Define WORK_COUNTERS as 0 or 1 to override.
+#ifndef WORK_COUNTERS
+#ifdef NDEBUG
+#define WORK_COUNTERS 0
+#else
+#define WORK_COUNTERS 1
+#endif
+#endif
+
+// Work done by the simulation passes during one frame.
+// Layout matches the counter buffer written by the compute shaders (byte offset = 4 * member index).
+struct WorkCounters
+{
+    // Cloud pair tests (OnXIntersection calls).
+    unsigned int pairTests;
+
+    // Pair tests where clouds intersect.
+    unsigned int xIntersections;
+
+    // Batches loaded into groupshared memory.
+    unsigned int batchesLoaded;
+
+    // Spawned particles.
+    unsigned int spawns;
+
+    // Alive particles after particle update.
+    unsigned int aliveParticles;
+
+    // Sort passes.
+    unsigned int sortPasses;
+
+    unsigned int pad[2];
+
+    // Clear all counters.
+    void Reset()
+    {
+        pairTests = xIntersections = batchesLoaded = spawns = aliveParticles = sortPasses = 0;
+        pad[0] = pad[1] = 0;
+    }
+
+    // Print counters.
+    // stream Output stream.
+    void Print(std::ostream& stream) const
+    {
+        stream << "Pair tests: " << pairTests << ", x-intersections: " << xIntersections << ", batches loaded: " << batchesLoaded
+            << ", spawns: " << spawns << ", alive particles: " << aliveParticles << ", sort passes: " << sortPasses << std::endl;
+    }
+};
+
+// Counts simulation work. Compiles to nothing when counters are disabled.
+template <bool enabled>
+class WorkCounter
+{
+    public:
+        // Constructor.
+        WorkCounter() : mCount(0) {}
+
+        // Add to count.
+        // n Amount to add.
+        void Add(unsigned int n = 1) { mCount += n; }
+
+        // Get count.
+        unsigned int Get() const { return mCount; }
+
+    private:
+        unsigned int mCount;
+};
+
+template <>
+class WorkCounter<false>
+{
+    public:
+        void Add(unsigned int = 1) {}
+        unsigned int Get() const { return 0; }
+};
+
+// Work counter of the current build configuration.
+typedef WorkCounter<WORK_COUNTERS != 0> FrameWorkCounter;
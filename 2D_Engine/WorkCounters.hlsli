@@ -0,0 +1,16 @@
+// Work counters shared by the simulation kernels. Define WORK_COUNTERS_REGISTER as the counter buffer's UAV slot
+// before including.
+
+#ifdef WORK_COUNTERS
+// Work counters. Indices match WorkCounters in WorkCounters.h.
+#define PAIR_TESTS 0
+#define X_INTERSECTIONS 1
+#define BATCHES_LOADED 2
+#define SPAWNS 3
+#define ALIVE_PARTICLES 4
+#define SORT_PASSES 5
+RWStructuredBuffer<uint> g_WorkCounters : register(WORK_COUNTERS_REGISTER);
+#define WORK_COUNT(counter, n) InterlockedAdd(g_WorkCounters[counter], n)
+#else
+#define WORK_COUNT(counter, n)
+#endif
@@ -3,86 +3,335 @@
 #define _CRTDBG_MAP_ALLOC
 #include <stdlib.h>
 #include <chrono>
+#include <csignal>
 #include <crtdbg.h>
 #include <iostream>
+#include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 #include "Particle.h"
 #include "ParticleCloud.h"
 #include "ParticleCloudSorter.h"
 #include "ParticleCloudSystem.h"
+#include "ParticleRenderer.h"
 #include "ParticleSystem.h"
 #include "Scene.h"
 
+#include "D3DKernelCompiler.h"
 #include "DxAssert.h"
+#include "FrameArena.h"
+#include "FramePipeline.h"
+#include "GPUStageTimer.h"
+#include "JobSystem.h"
+#include "KernelCache.h"
 #include "Profiler.h"
+#include "Recording.h"
 #include "Renderer.h"
+#include "Snapshot.h"
+#include "Telemetry.h"
 
 glm::vec2 Arrowinput(float speed);
 float ZXinput(float speed);
 
 using namespace std::chrono;
 
-int main() 
+// Number of frames between profiler statistics dumps.
+#define PROFILER_DUMP_INTERVAL 512
+
+// Snapshot written when F5 is pressed.
+#define CHECKPOINT_PATH "checkpoint.snap"
+
+// Number of particle clouds added when F6 is pressed.
+#define GROWTH_NUM_PARTICLE_CLOUDS 4096
+
+// Scene description loaded when no other scene is given.
+#define SCENE_PATH "Default.scene"
+
+// Usage: 2D_Engine [--scene path] [--record path] [--play path] [snapshot]
+// snapshot Restores the snapshot instead of generating a scene.
+// --scene Generates the scene of a description file instead of SCENE_PATH.
+// --record Records every simulated frame.
+// --play Replaces the simulation with a recording, looped.
+int main(int argc, char* argv[])
 {
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 
+    // Parse arguments.
+    const char* snapshotPath = nullptr;
+    const char* scenePath = SCENE_PATH;
+    const char* recordPath = nullptr;
+    const char* playPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--scene" && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (argument == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (argument == "--play" && i + 1 < argc)
+            playPath = argv[++i];
+        else
+            snapshotPath = argv[i];
+    }
+
+    // Open recording to play.
+    RecordingPlayer player;
+    RecordingFrame playFrame;
+    if (playPath != nullptr && (!player.Open(playPath) || player.GetNumFrames() == 0))
+    {
+        std::cout << "Failed to open recording " << playPath << std::endl;
+        playPath = nullptr;
+    }
+
     // Max number of particles.
     unsigned int maxNumParticleClouds = pow(2, 16);
     unsigned int maxNumParticles = maxNumParticleClouds * 8;
+    if (playPath != nullptr)
+    {
+        maxNumParticleClouds = player.GetHeader().numParticleClouds;
+        maxNumParticles = player.GetHeader().numParticles;
+    }
+
+    // Create job system.
+    JobSystem jobSystem;
+
+    // Build kernels of all systems up front, cache misses compile in parallel.
+    KernelCache kernelCache(&D3DKernelCompiler::Compile, D3DKERNELCOMPILER_NAME, D3DKERNELCOMPILER_CACHE_DIRECTORY);
+    ParticleSystem::AddKernels(kernelCache);
+    ParticleCloudSystem::AddKernels(kernelCache);
+    ParticleCloudSorter::AddKernels(kernelCache);
+    ParticleRenderer::AddKernels(kernelCache);
+    bool kernelsBuilt = kernelCache.Build(&jobSystem);
+    kernelCache.PrintStatistics(std::cout);
+    if (!kernelsBuilt)
+        return 1;
 
     // Create renderer.
-    Renderer renderer(1024, 1024);
+    Renderer renderer(1024, 1024, kernelCache);
 
-    // Create scene.
-    Scene scene(renderer.mDevice, renderer.mDeviceContext, maxNumParticles, maxNumParticleClouds);
+    // Create scene, restored from snapshot if one is given.
+    Scene* pScene = nullptr;
+    unsigned long long firstFrame = 0;
+    double firstTime = 0.0;
+    if (snapshotPath != nullptr && playPath == nullptr)
+    {
+        Snapshot snapshot;
+        if (snapshot.Load(snapshotPath))
+        {
+            pScene = new Scene(renderer.mDevice, renderer.mDeviceContext, snapshot);
+            firstFrame = snapshot.GetHeader().frame;
+            firstTime = snapshot.GetHeader().time;
+            std::cout << "Restored " << snapshotPath << " at frame " << firstFrame << std::endl;
+        }
+        else
+        {
+            std::cout << "Failed to load snapshot " << snapshotPath << std::endl;
+        }
+    }
+    if (pScene == nullptr)
+    {
+        // Generate scene of the description file, capacity is sized from the file. A recording sets its own capacity.
+        SceneBuilder::Description description;
+        std::string error;
+        if (playPath == nullptr && SceneBuilder::Load(scenePath, description, error))
+        {
+            pScene = new Scene(renderer.mDevice, renderer.mDeviceContext, description, &jobSystem);
+        }
+        else
+        {
+            if (playPath == nullptr)
+                std::cout << "Failed to load scene " << scenePath << ": " << error << std::endl;
+            pScene = new Scene(renderer.mDevice, renderer.mDeviceContext, maxNumParticles, maxNumParticleClouds, &jobSystem);
+        }
+        pScene->mCamera.mPosition = glm::vec3(0.f, 0.f, -5.f);
+    }
+    Scene& scene = *pScene;
     Camera& camera = scene.mCamera;
-    camera.mPosition = glm::vec3(0.f, 0.f, -5.f);
+
+    // Create snapshot writer.
+    SnapshotWriter snapshotWriter;
+    bool checkpointKeyPressed = false;
+    bool growthKeyPressed = false;
+    bool blendKeyPressed = false;
+    unsigned int numGrowths = 0;
+
+    // Create recorder.
+    Recorder* pRecorder = nullptr;
+    if (recordPath != nullptr)
+    {
+        pRecorder = new Recorder(recordPath, scene.mNumParticles, scene.mNumParticleClouds);
+        if (!pRecorder->IsOpen())
+            std::cout << "Failed to create recording " << recordPath << std::endl;
+    }
 
     // Create particle system.
-    ParticleSystem particleSystem(renderer.mDevice, renderer.mDeviceContext);
+    ParticleSystem particleSystem(renderer.mDevice, renderer.mDeviceContext, kernelCache);
 
     // Create particle cloud system.
-    ParticleCloudSystem partilceCloudSystem(renderer.mDevice, renderer.mDeviceContext);
+    ParticleCloudSystem partilceCloudSystem(renderer.mDevice, renderer.mDeviceContext, kernelCache);
 
     // Create particle cloud sorter.
-    ParticleCloudSorter particleCloudSorter(renderer.mDevice, renderer.mDeviceContext);
+    ParticleCloudSorter particleCloudSorter(renderer.mDevice, renderer.mDeviceContext, kernelCache);
 
-    // Set Frame Latency.
+    // Set Frame Latency. The device context stays on this thread, so the GPU queue is the render stage of the pipeline.
     IDXGIDevice1 * pDXGIDevice;
     DxAssert(renderer.mDevice->QueryInterface(__uuidof(IDXGIDevice), (void **)&pDXGIDevice), S_OK);
-    DxAssert(pDXGIDevice->SetMaximumFrameLatency(1), S_OK);
+    DxAssert(pDXGIDevice->SetMaximumFrameLatency(FRAME_PIPELINE_LATENCY), S_OK);
     pDXGIDevice->Release();
 
+    // Create arena for transient per-frame data.
+    FrameArena frameArena;
+
+    // Create telemetry. Dispatches run asynchronously, so stage times are GPU timestamps read back frames later.
+    Telemetry telemetry(2.f, 128, true);
+    GPUStageTimer gpuStageTimer(renderer.mDevice, renderer.mDeviceContext);
+    Telemetry::InstallSignalHandlers();
+
+    std::cout << "Particles: " << scene.mNumParticles << ", particle clouds: " << scene.mNumParticleClouds << std::endl;
+    SceneBuilder::PrintTimings(scene.mStartupTimings, std::cout);
+
     long long lastTime = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
     float dt = 0.f;
     float duration = 0.f;
     unsigned int frameCounter = 0;
     while (renderer.Running()) {
         frameCounter++;
-        { PROFILE("FRAME: " + std::to_string(scene.mMaxNumParticles), true);
+        frameArena.BeginFrame();
+        telemetry.BeginFrame();
+        gpuStageTimer.BeginFrame(telemetry.GetNumFrames());
+        { PROFILE("FRAME");
             long long newTime = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
             duration += dt = static_cast<float>(newTime - lastTime)/1000.f;
             lastTime = newTime;
 
             // Camera.
-            camera.Update(20.f, dt, &renderer);
+            { PROFILE("Camera");
+                camera.Update(20.f, dt, &renderer);
+            }
+
+#if WORK_COUNTERS
+            scene.mWorkCounters->BeginFrame();
+#endif
 
-            // Particle clouds sort.
-            particleCloudSorter.Sort(scene);
+            if (playPath != nullptr)
+            {
+                // Recorded frame replaces the simulation.
+                { PROFILE("Play");
+                    if (player.ReadFrame((frameCounter - 1) % player.GetNumFrames(), playFrame))
+                        scene.Play(playFrame);
+                }
+            }
+            else
+            {
+                // Particle clouds sort.
+                { PROFILE("Sort"); GPUStageTimer::StageScope stage(gpuStageTimer, Telemetry::SORT);
+                    particleCloudSorter.Sort(scene, frameArena);
+                }
 
-            // Particle clouds update.
-            partilceCloudSystem.Update(scene, dt);
+                // Particle clouds update.
+                { PROFILE("Cloud update"); GPUStageTimer::StageScope stage(gpuStageTimer, Telemetry::CLOUD_UPDATE);
+                    partilceCloudSystem.Update(scene, dt);
+                }
 
-            // Particles update.
-            particleSystem.Update(scene, dt);
+                // Particles update.
+                { PROFILE("Particle update"); GPUStageTimer::StageScope stage(gpuStageTimer, Telemetry::PARTICLE_UPDATE);
+                    particleSystem.Update(scene, dt);
+                }
+            }
+
+#if WORK_COUNTERS
+            scene.mWorkCounters->EndFrame();
+#endif
         
             // Renderer.
-            renderer.Render(scene);
+            { PROFILE("Render"); GPUStageTimer::StageScope stage(gpuStageTimer, Telemetry::RENDER);
+                renderer.Render(scene);
+            }
+
+            // Recording. Read back stalls until the GPU has finished the frame.
+            if (pRecorder != nullptr)
+            { PROFILE("Record");
+                scene.Record(*pRecorder, firstTime + duration);
+            }
 
             //MessageBox(NULL, "", "", 0);
         }
+        gpuStageTimer.EndFrame(telemetry);
+        telemetry.EndFrame();
+
+        // Checkpoint on F5. The file is written in the background, a press while it is written is ignored.
+        bool checkpointKey = GetAsyncKeyState(VK_F5) != 0;
+        if (checkpointKey && !checkpointKeyPressed)
+        {
+            if (scene.Checkpoint(snapshotWriter, CHECKPOINT_PATH, firstFrame + frameCounter, firstTime + duration))
+                std::cout << "Checkpoint " << CHECKPOINT_PATH << " at frame " << firstFrame + frameCounter << std::endl;
+        }
+        checkpointKeyPressed = checkpointKey;
+
+        // Add a grid of particle clouds behind the scene on F6. Buffers grow geometrically when full.
+        // Recordings have fixed counts, so the scene does not grow while recording.
+        bool growthKey = GetAsyncKeyState(VK_F6) != 0;
+        if (growthKey && !growthKeyPressed && playPath == nullptr && pRecorder == nullptr)
+        {
+            ++numGrowths;
+            SceneBuilder::Description description;
+            description.seed = scene.mSeed + numGrowths;
+            description.groups.push_back(SceneBuilder::CreateEmitterGroup(SceneBuilder::GRID, GROWTH_NUM_PARTICLE_CLOUDS));
+            description.groups.front().origin.z = -description.groups.front().spacing * std::sqrt(static_cast<float>(GROWTH_NUM_PARTICLE_CLOUDS)) * numGrowths;
+            std::vector<Particle> particles(GROWTH_NUM_PARTICLE_CLOUDS * SceneBuilder::PARTICLES_PER_CLOUD);
+            std::vector<ParticleCloud> particleClouds(GROWTH_NUM_PARTICLE_CLOUDS);
+            SceneBuilder::Build(description, static_cast<unsigned int>(particles.size()), particles.data(), particleClouds.data(), &jobSystem);
+            scene.AddParticleClouds(particleClouds.data(), particles.data(), GROWTH_NUM_PARTICLE_CLOUDS);
+            std::cout << "Particle clouds: " << scene.mNumParticleClouds << " of " << scene.mMaxNumParticleClouds << std::endl;
+        }
+        growthKeyPressed = growthKey;
+
+        // Toggle between additive and sorted alpha blending on F7.
+        bool blendKey = GetAsyncKeyState(VK_F7) != 0;
+        if (blendKey && !blendKeyPressed)
+        {
+            renderer.SetAlphaBlending(!renderer.GetAlphaBlending());
+            std::cout << "Blending: " << (renderer.GetAlphaBlending() ? "alpha, sorted back to front" : "additive") << std::endl;
+        }
+        blendKeyPressed = blendKey;
+
+        // Print zone statistics.
+        if (frameCounter % PROFILER_DUMP_INTERVAL == 0)
+        {
+            Profiler::DumpStats(std::cout);
+            Profiler::Reset();
+            frameArena.PrintStatistics(std::cout);
+#if WORK_COUNTERS
+            scene.mWorkCounters->GetCounters().Print(std::cout);
+#endif
+        }
+
+        // Dump telemetry on signal, quit on interrupt/terminate.
+        int signal = Telemetry::PollSignal();
+        if (signal != 0)
+        {
+            telemetry.DumpSummary(std::cout);
+            if (signal == SIGINT || signal == SIGTERM)
+                renderer.Close();
+        }
+    }
+
+    telemetry.DumpSummary(std::cout);
+
+    Profiler::ExportChromeTrace("profile.json");
+
+    if (!snapshotWriter.Wait())
+        std::cout << "Failed to write " << CHECKPOINT_PATH << std::endl;
+    if (pRecorder != nullptr)
+    {
+        if (pRecorder->Close())
+            std::cout << "Recorded " << pRecorder->GetNumFrames() << " frames, " << pRecorder->GetEncodedBytes() << " of " << pRecorder->GetRawBytes() << " bytes" << std::endl;
+        else
+            std::cout << "Failed to write " << recordPath << std::endl;
+        delete pRecorder;
     }
+    delete pScene;
 
     return 0;
 }
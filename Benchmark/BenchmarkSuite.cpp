@@ -0,0 +1,249 @@
+#include "BenchmarkSuite.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+#include "CPUParticleCloudSorter.h"
+#include "CPUParticleCloudSystem.h"
+#include "CPUParticleSystem.h"
+#include "CPUScene.h"
+#include "Profiler.h"
+
+namespace
+{
+    // Nearest-rank percentile of sorted durations.
+    double Percentile(const std::vector<double>& sorted, double p)
+    {
+        std::size_t rank = static_cast<std::size_t>(p * sorted.size() + 0.999999);
+        return sorted[std::min(std::max(rank, (std::size_t)1), sorted.size()) - 1];
+    }
+
+    // Find string value of key in JSON line.
+    // Returns whether key was found.
+    bool FindString(const std::string& line, const char* key, std::string& value)
+    {
+        std::string pattern = std::string("\"") + key + "\":\"";
+        std::size_t start = line.find(pattern);
+        if (start == std::string::npos)
+            return false;
+        start += pattern.size();
+        std::size_t end = line.find('"', start);
+        if (end == std::string::npos)
+            return false;
+        value = line.substr(start, end - start);
+        return true;
+    }
+
+    // Find number value of key in JSON line.
+    // Returns whether key was found.
+    bool FindNumber(const std::string& line, const char* key, double& value)
+    {
+        std::string pattern = std::string("\"") + key + "\":";
+        std::size_t start = line.find(pattern);
+        if (start == std::string::npos)
+            return false;
+        value = strtod(line.c_str() + start + pattern.size(), nullptr);
+        return true;
+    }
+}
+
+BenchmarkSuite::BenchmarkSuite(const Settings& settings)
+{
+    mSettings = settings;
+}
+
+BenchmarkSuite::~BenchmarkSuite()
+{
+
+}
+
+void BenchmarkSuite::Run()
+{
+    mResults.clear();
+    for (SceneBuilder::Distribution distribution : mSettings.distributions)
+    {
+        for (unsigned int log2Clouds = mSettings.minLog2Clouds; log2Clouds <= mSettings.maxLog2Clouds; ++log2Clouds)
+        {
+            if (!RunCase(distribution, 1U << log2Clouds))
+            {
+                if (log2Clouds < mSettings.maxLog2Clouds)
+                    printf("  %s: skipping %u..%u clouds, frame exceeded %.0f ms budget\n", SceneBuilder::GetDistributionName(distribution), 1U << (log2Clouds + 1), 1U << mSettings.maxLog2Clouds, mSettings.caseBudgetMs);
+                break;
+            }
+        }
+    }
+}
+
+bool BenchmarkSuite::RunCase(SceneBuilder::Distribution distribution, unsigned int numClouds)
+{
+    unsigned int numParticles = numClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+
+    std::vector<Particle> particles;
+    std::vector<ParticleCloud> particleClouds;
+    SceneBuilder::Build(distribution, numParticles, numClouds, 1, particles, particleClouds);
+
+    CPUScene scene(numParticles, numClouds, particles.data(), particleClouds.data());
+    CPUParticleCloudSorter sorter(numClouds);
+    CPUParticleCloudSystem cloudSystem;
+    CPUParticleSystem particleSystem;
+
+    // Run frames, first frame is warm up.
+    float dt = 1.f / 60.f;
+    long long budget = static_cast<long long>(mSettings.caseBudgetMs * 1000000.0);
+    bool withinBudget = true;
+    std::vector<double> durations[NUM_STAGES];
+    for (unsigned int frame = 0; frame <= mSettings.numIterations && withinBudget; ++frame)
+    {
+        scene.mWorkCounters.Reset();
+        long long times[NUM_STAGES + 1];
+        times[0] = Profiler::Now();
+        sorter.Sort(scene);
+        times[1] = Profiler::Now();
+        cloudSystem.Update(scene, dt);
+        times[2] = Profiler::Now();
+        particleSystem.Update(scene, dt);
+        times[3] = Profiler::Now();
+
+        // Keep warm up frame only if no other frame gets measured.
+        if (frame == 1)
+            for (unsigned int s = 0; s < NUM_STAGES; ++s)
+                durations[s].clear();
+        for (unsigned int s = 0; s < NUM_STAGES; ++s)
+            durations[s].push_back((times[s + 1] - times[s]) / 1000000.0);
+
+        withinBudget = times[NUM_STAGES] - times[0] <= budget;
+    }
+
+    for (unsigned int s = 0; s < NUM_STAGES; ++s)
+    {
+        std::vector<double>& stageDurations = durations[s];
+        std::sort(stageDurations.begin(), stageDurations.end());
+        double sum = 0.0;
+        for (double duration : stageDurations)
+            sum += duration;
+
+        Result result;
+        result.stage = static_cast<Stage>(s);
+        result.distribution = distribution;
+        result.numClouds = numClouds;
+        result.numParticles = numParticles;
+        result.numIterations = static_cast<unsigned int>(stageDurations.size());
+        result.mean = sum / stageDurations.size();
+        result.p50 = Percentile(stageDurations, 0.50);
+        result.p90 = Percentile(stageDurations, 0.90);
+        result.p99 = Percentile(stageDurations, 0.99);
+        result.max = stageDurations.back();
+        unsigned int numElements = result.stage == PARTICLE_UPDATE ? numParticles : numClouds;
+        result.throughput = result.p50 > 0.0 ? numElements / (result.p50 / 1000.0) : 0.0;
+        result.workCounters = scene.mWorkCounters;
+        mResults.push_back(result);
+
+        printf("  %-15s %-9s %8u clouds : p50 %10.3f ms, p99 %10.3f ms, %12.0f elements/s\n", GetStageName(result.stage),
+            SceneBuilder::GetDistributionName(distribution), numClouds, result.p50, result.p99, result.throughput);
+    }
+
+    return withinBudget;
+}
+
+const std::vector<BenchmarkSuite::Result>& BenchmarkSuite::GetResults() const
+{
+    return mResults;
+}
+
+bool BenchmarkSuite::WriteJSON(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+
+    file << std::fixed << std::setprecision(6);
+    file << "{\n\"workCounters\":" << (WORK_COUNTERS ? "true" : "false") << ",\n\"results\":[";
+    for (std::size_t i = 0; i < mResults.size(); ++i)
+    {
+        const Result& result = mResults[i];
+        file << (i == 0 ? "\n" : ",\n")
+            << "{\"stage\":\"" << GetStageName(result.stage) << "\""
+            << ",\"distribution\":\"" << SceneBuilder::GetDistributionName(result.distribution) << "\""
+            << ",\"clouds\":" << result.numClouds
+            << ",\"particles\":" << result.numParticles
+            << ",\"iterations\":" << result.numIterations
+            << ",\"mean_ms\":" << result.mean
+            << ",\"p50_ms\":" << result.p50
+            << ",\"p90_ms\":" << result.p90
+            << ",\"p99_ms\":" << result.p99
+            << ",\"max_ms\":" << result.max
+            << ",\"throughput\":" << result.throughput;
+#if WORK_COUNTERS
+        const WorkCounters& counters = result.workCounters;
+        file << ",\"pair_tests\":" << counters.pairTests
+            << ",\"x_intersections\":" << counters.xIntersections
+            << ",\"batches_loaded\":" << counters.batchesLoaded
+            << ",\"spawns\":" << counters.spawns
+            << ",\"alive_particles\":" << counters.aliveParticles
+            << ",\"sort_passes\":" << counters.sortPasses;
+#endif
+        file << "}";
+    }
+    file << "\n]\n}\n";
+
+    return file.good();
+}
+
+int BenchmarkSuite::CompareBaseline(const std::string& path, float threshold) const
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return -1;
+
+    int numRegressions = 0;
+    int numMissing = 0;
+    unsigned int numCompared = 0;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::string stage, distribution;
+        double clouds, p50;
+        if (!FindString(line, "stage", stage) || !FindString(line, "distribution", distribution) || !FindNumber(line, "clouds", clouds) || !FindNumber(line, "p50_ms", p50))
+            continue;
+
+        bool found = false;
+        for (const Result& result : mResults)
+        {
+            if (stage != GetStageName(result.stage) || distribution != SceneBuilder::GetDistributionName(result.distribution) || static_cast<unsigned int>(clouds) != result.numClouds)
+                continue;
+
+            found = true;
+            ++numCompared;
+            double change = p50 > 0.0 ? result.p50 / p50 - 1.0 : 0.0;
+            bool regressed = change > threshold;
+            if (regressed)
+                ++numRegressions;
+            printf("  %-15s %-9s %8u clouds : %10.3f ms -> %10.3f ms (%+6.1f%%)%s\n", stage.c_str(), distribution.c_str(), result.numClouds, p50, result.p50, change * 100.0, regressed ? " REGRESSION" : "");
+        }
+
+        // A case that was not run, e.g. skipped over budget, can not be shown to be within threshold.
+        if (!found)
+        {
+            ++numMissing;
+            printf("  %-15s %-9s %8u clouds : %10.3f ms -> %10s MISSING\n", stage.c_str(), distribution.c_str(), static_cast<unsigned int>(clouds), p50, "-");
+        }
+    }
+
+    printf("Compared %u results against baseline, %d regressions, %d missing (threshold %.1f%%)\n", numCompared, numRegressions, numMissing, threshold * 100.f);
+    return numRegressions + numMissing;
+}
+
+const char* BenchmarkSuite::GetStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case SORT: return "sort";
+        case CLOUD_UPDATE: return "cloud_update";
+        case PARTICLE_UPDATE: return "particle_update";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SceneBuilder.h"
+#include "WorkCounters.h"
+
+// Benchmarks the CPU sort, cloud update and particle update over cloud counts and spatial distributions.
+class BenchmarkSuite
+{
+    public:
+        // Pipeline stage.
+        enum Stage
+        {
+            SORT,
+            CLOUD_UPDATE,
+            PARTICLE_UPDATE,
+            NUM_STAGES
+        };
+
+        // Suite settings.
+        struct Settings
+        {
+            // Smallest number of clouds, log2.
+            unsigned int minLog2Clouds = 10;
+            // Largest number of clouds, log2.
+            unsigned int maxLog2Clouds = 20;
+            // Measured frames per case.
+            unsigned int numIterations = 10;
+            // Distributions to run.
+            std::vector<SceneBuilder::Distribution> distributions = { SceneBuilder::GRID, SceneBuilder::UNIFORM, SceneBuilder::CLUSTERED, SceneBuilder::LINE };
+            // A frame exceeding this duration ends the case early and skips larger cloud counts of the distribution.
+            float caseBudgetMs = 2000.f;
+        };
+
+        // Result of one stage, distribution and cloud count. Durations in milliseconds.
+        struct Result
+        {
+            Stage stage;
+            SceneBuilder::Distribution distribution;
+            unsigned int numClouds;
+            unsigned int numParticles;
+            unsigned int numIterations;
+            double mean;
+            double p50;
+            double p90;
+            double p99;
+            double max;
+            // Processed elements (clouds or particles) per second, based on p50.
+            double throughput;
+            // Work counters of the last frame.
+            WorkCounters workCounters;
+        };
+
+        // Constructor.
+        // settings Suite settings.
+        BenchmarkSuite(const Settings& settings);
+
+        // Destructor.
+        ~BenchmarkSuite();
+
+        // Run all cases, prints progress.
+        void Run();
+
+        // Get results.
+        const std::vector<Result>& GetResults() const;
+
+        // Write results as JSON, one result object per line.
+        // path File path.
+        // Returns whether file could be written.
+        bool WriteJSON(const std::string& path) const;
+
+        // Compare p50 of results against a baseline JSON written by WriteJSON.
+        // path Baseline file path.
+        // threshold Allowed relative slowdown, e.g. 0.1 for 10%.
+        // Returns number of regressed results plus baseline results missing from this run, -1 if baseline could not be read.
+        int CompareBaseline(const std::string& path, float threshold) const;
+
+        // Get stage name.
+        // stage Stage.
+        static const char* GetStageName(Stage stage);
+
+    private:
+        // Run frames of one distribution and cloud count.
+        // distribution Spatial distribution.
+        // numClouds Number of clouds.
+        // Returns whether frames stayed within the case budget.
+        bool RunCase(SceneBuilder::Distribution distribution, unsigned int numClouds);
+
+        Settings mSettings;
+        std::vector<Result> mResults;
+};
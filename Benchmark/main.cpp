@@ -0,0 +1,1432 @@
+// Benchmarks CPU implementations of the particle pipeline stages.
+// Run with --help for options, e.g. --json results.json --baseline baseline.json --threshold 0.1.
+// Portable, builds without D3D11. On Linux:
+// g++ -std=c++14 -O2 -pthread -I../2D_Engine -I../2D_Engine/externals/glm -I../2D_Engine/externals/assimp/include main.cpp BenchmarkSuite.cpp ../2D_Engine/Animation.cpp ../2D_Engine/CompressedAnimation.cpp ../2D_Engine/CPUParticleCloudSorter.cpp ../2D_Engine/CPUParticleCloudSystem.cpp ../2D_Engine/CPUParticleSystem.cpp ../2D_Engine/CPUScene.cpp ../2D_Engine/CPUSceneBatch.cpp ../2D_Engine/JobSystem.cpp ../2D_Engine/KernelCache.cpp ../2D_Engine/MathFunctions.cpp ../2D_Engine/Particle.cpp ../2D_Engine/ParticleCloud.cpp ../2D_Engine/ParticleDepthSorter.cpp ../2D_Engine/Profiler.cpp ../2D_Engine/RadixSort.cpp ../2D_Engine/SceneBuilder.cpp ../2D_Engine/Skinning.cpp -o Benchmark
+// Add -DBENCHMARK_ASSIMP ../2D_Engine/CookedAsset.cpp ../2D_Engine/MappedFile.cpp ../2D_Engine/PoseTable.cpp ../2D_Engine/Skeleton.cpp ../2D_Engine/SkeletonBatch.cpp -lassimp to benchmark skeleton evaluation on an FBX file.
+
+#include <algorithm>
+#include <assimp/anim.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Animation.h"
+#include "CompressedAnimation.h"
+#ifdef BENCHMARK_ASSIMP
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include "CookedAsset.h"
+#include "PoseTable.h"
+#include "Skeleton.h"
+#include "SkeletonBatch.h"
+#endif
+#include "BenchmarkSuite.h"
+#include "CPUParticleCloudSorter.h"
+#include "CPUParticleCloudSystem.h"
+#include "CPUParticleSystem.h"
+#include "CPUScene.h"
+#include "CPUSceneBatch.h"
+#include "DynamicArray.hpp"
+#include "JobSystem.h"
+#include "KernelCache.h"
+#include "MathFunctions.h"
+#include "Particle.h"
+#include "ParticleDepthSorter.h"
+#include "Profiler.h"
+#include "Skinning.h"
+
+using namespace std::chrono;
+
+// Frame budget in milliseconds (60 Hz).
+#define FRAME_BUDGET_MS 16.6f
+
+// Run function and measure duration.
+// numIterations Number of iterations.
+// function Function to measure.
+// Returns mean duration in milliseconds.
+template <typename Function>
+float Measure(unsigned int numIterations, Function function)
+{
+    // Warm up.
+    function();
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for (unsigned int i = 0; i < numIterations; ++i)
+        function();
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+
+    return duration_cast<nanoseconds>(end - start).count() / 1000000.f / numIterations;
+}
+
+// Benchmark particle depth sort at full capacity.
+// numParticles Number of particles.
+void BenchmarkDepthSort(unsigned int numParticles)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-100.f, 100.f);
+
+    std::vector<Particle> particles(numParticles);
+    for (Particle& particle : particles)
+    {
+        particle.mPosition = glm::vec3(dist(rng), dist(rng), dist(rng));
+        particle.mScale = glm::vec2(0.2f, 0.2f);
+        particle.mLifetime = 1.f;
+    }
+
+    glm::mat4 vpMatrix = glm::perspectiveFovLH(45.f, 1024.f, 1024.f, 0.01f, 2000.f) * glm::lookAtLH(glm::vec3(0.f, 0.f, -150.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+
+    ParticleDepthSorter sorter(numParticles);
+
+    float allMs = Measure(20, [&]() { sorter.Sort(particles.data(), numParticles, vpMatrix, false); });
+    unsigned int numAll = sorter.GetNumSortedIndices();
+
+    float visibleMs = Measure(20, [&]() { sorter.Sort(particles.data(), numParticles, vpMatrix, true); });
+    unsigned int numVisible = sorter.GetNumSortedIndices();
+
+    // Verify back to front order.
+    const unsigned int* indices = sorter.GetSortedIndices();
+    glm::vec4 rowW(vpMatrix[0][3], vpMatrix[1][3], vpMatrix[2][3], vpMatrix[3][3]);
+    bool sorted = true;
+    for (unsigned int i = 1; i < numVisible; ++i)
+        sorted &= glm::dot(rowW, glm::vec4(particles[indices[i - 1]].mPosition, 1.f)) >= glm::dot(rowW, glm::vec4(particles[indices[i]].mPosition, 1.f));
+
+    // Reference comparison sort.
+    std::vector<std::pair<float, unsigned int>> reference(numParticles);
+    float referenceMs = Measure(5, [&]() {
+        for (unsigned int i = 0; i < numParticles; ++i)
+            reference[i] = std::make_pair(-glm::dot(rowW, glm::vec4(particles[i].mPosition, 1.f)), i);
+        std::sort(reference.begin(), reference.end());
+    });
+
+    printf("DepthSort %u particles\n", numParticles);
+    printf("  all     : %u sorted in %.3f ms (%u passes)\n", numAll, allMs, sorter.GetNumPasses());
+    printf("  visible : %u sorted in %.3f ms\n", numVisible, visibleMs);
+    printf("  std::sort reference : %.3f ms\n", referenceMs);
+    printf("  order %s, %s frame budget (%.1f ms)\n", sorted ? "OK" : "INVALID", allMs < FRAME_BUDGET_MS ? "fits" : "exceeds", FRAME_BUDGET_MS);
+}
+
+// Benchmark DynamicArray against std::vector and std::sort.
+// numElements Number of elements.
+void BenchmarkDynamicArray(unsigned int numElements)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-100.f, 100.f);
+    std::vector<float> keys(numElements);
+    for (float& key : keys)
+        key = dist(rng);
+    // Read back a filled element, so fills are not optimised away.
+    volatile float sink = 0.f;
+
+    // Append one by one from empty.
+    float vectorPushMs = Measure(10, [&]() {
+        std::vector<float> vector;
+        for (unsigned int i = 0; i < numElements; ++i)
+            vector.push_back(keys[i]);
+        sink = vector.back();
+    });
+    float arrayPushMs = Measure(10, [&]() {
+        DynamicArray<float> array;
+        for (unsigned int i = 0; i < numElements; ++i)
+            array.Push(keys[i]);
+        sink = array.At(numElements - 1);
+    });
+
+    // Bulk fill.
+    float vectorFillMs = Measure(10, [&]() {
+        std::vector<float> vector(numElements);
+        std::copy(keys.begin(), keys.end(), vector.begin());
+        sink = vector.back();
+    });
+    float arrayFillMs = Measure(10, [&]() {
+        DynamicArray<float> array;
+        std::copy(keys.begin(), keys.end(), array.AppendUninitialized(numElements));
+        sink = array.At(numElements - 1);
+    });
+
+    // Sort, each iteration restores the unsorted keys.
+    std::vector<float> vector(numElements);
+    float vectorSortMs = Measure(5, [&]() {
+        std::copy(keys.begin(), keys.end(), vector.begin());
+        std::sort(vector.begin(), vector.end());
+    });
+    DynamicArray<float> array;
+    array.AppendUninitialized(numElements);
+    float arraySortMs = Measure(5, [&]() {
+        std::copy(keys.begin(), keys.end(), array.GetArrPointer());
+        array.Sort();
+    });
+    bool sorted = std::equal(vector.begin(), vector.end(), array.GetArrPointer());
+
+    JobSystem jobSystem;
+    float arrayParallelSortMs = Measure(5, [&]() {
+        std::copy(keys.begin(), keys.end(), array.GetArrPointer());
+        array.ParallelSort(jobSystem);
+    });
+    sorted &= std::equal(vector.begin(), vector.end(), array.GetArrPointer());
+
+    printf("DynamicArray %u floats\n", numElements);
+    printf("  push          : %8.3f ms, std::vector %8.3f ms\n", arrayPushMs, vectorPushMs);
+    printf("  bulk fill     : %8.3f ms, std::vector %8.3f ms\n", arrayFillMs, vectorFillMs);
+    printf("  sort          : %8.3f ms, std::sort   %8.3f ms\n", arraySortMs, vectorSortMs);
+    printf("  parallel sort : %8.3f ms (%u threads)\n", arrayParallelSortMs, jobSystem.GetNumThreads());
+    printf("  order %s\n", sorted ? "OK" : "INVALID");
+}
+
+// Benchmark overhead of a profiled zone.
+void BenchmarkProfiler()
+{
+    const unsigned int numZones = 1000000;
+    volatile unsigned int sink = 0;
+
+    float emptyMs = Measure(5, [&]() {
+        for (unsigned int i = 0; i < numZones; ++i)
+            sink = sink + 1;
+    });
+
+    float zoneMs = Measure(5, [&]() {
+        for (unsigned int i = 0; i < numZones; ++i)
+        {
+            PROFILE("Benchmark zone");
+            sink = sink + 1;
+        }
+    });
+    Profiler::Reset();
+
+    printf("Profiler\n");
+    printf("  overhead : %.1f ns per zone\n", (zoneMs - emptyMs) * 1000000.f / numZones);
+}
+
+// Benchmark scaling of the CPU pipeline stages with the number of job system threads.
+// numClouds Number of clouds.
+// maxNumThreads Max number of threads.
+// numIterations Measured frames per thread count.
+void BenchmarkScaling(unsigned int numClouds, unsigned int maxNumThreads, unsigned int numIterations)
+{
+    unsigned int numParticles = numClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+    std::vector<Particle> particles;
+    std::vector<ParticleCloud> particleClouds;
+    SceneBuilder::Build(SceneBuilder::UNIFORM, numParticles, numClouds, 1, particles, particleClouds);
+
+    printf("Scaling %u clouds, %u iterations\n", numClouds, numIterations);
+    std::vector<Particle> reference;
+    double referenceMs[3] = { 0.0, 0.0, 0.0 };
+    for (unsigned int numThreads = 1; numThreads <= maxNumThreads; ++numThreads)
+    {
+        JobSystem jobSystem(numThreads);
+        CPUScene scene(numParticles, numClouds, particles.data(), particleClouds.data());
+        CPUParticleCloudSorter sorter(numClouds, &jobSystem);
+        CPUParticleCloudSystem cloudSystem(&jobSystem);
+        CPUParticleSystem particleSystem(&jobSystem);
+
+        // Run frames, first frame is warm up.
+        float dt = 1.f / 60.f;
+        double ms[3] = { 0.0, 0.0, 0.0 };
+        for (unsigned int frame = 0; frame <= numIterations; ++frame)
+        {
+            long long times[4];
+            times[0] = Profiler::Now();
+            sorter.Sort(scene);
+            times[1] = Profiler::Now();
+            cloudSystem.Update(scene, dt);
+            times[2] = Profiler::Now();
+            particleSystem.Update(scene, dt);
+            times[3] = Profiler::Now();
+            if (frame > 0)
+                for (unsigned int s = 0; s < 3; ++s)
+                    ms[s] += (times[s + 1] - times[s]) / 1000000.0 / numIterations;
+        }
+
+        // Results may not depend on the number of threads.
+        const Particle* result = scene.mParticlesSwapBuffer->GetTargetBuffer();
+        if (numThreads == 1)
+        {
+            reference.assign(result, result + numParticles);
+            std::copy(ms, ms + 3, referenceMs);
+        }
+        bool match = memcmp(reference.data(), result, numParticles * sizeof(Particle)) == 0;
+
+        printf("  %2u threads : sort %8.3f ms (%4.2fx), cloud update %8.3f ms (%4.2fx), particle update %8.3f ms (%4.2fx), results %s\n", numThreads,
+            ms[0], referenceMs[0] / ms[0], ms[1], referenceMs[1] / ms[1], ms[2], referenceMs[2] / ms[2], match ? "OK" : "DIFFER");
+    }
+}
+
+// Benchmark independent scenes simulated one by one against the same scenes packed into one batch.
+// numScenes Number of scenes.
+// numCloudsPerScene Number of clouds per scene.
+// numIterations Measured frames.
+void BenchmarkBatch(unsigned int numScenes, unsigned int numCloudsPerScene, unsigned int numIterations)
+{
+    // Generate all scenes packed, one emitter group per scene. Scenes overlap in space, only the batch keeps them apart.
+    SceneBuilder::Description description;
+    description.seed = 1;
+    for (unsigned int s = 0; s < numScenes; ++s)
+        description.groups.push_back(SceneBuilder::CreateEmitterGroup(SceneBuilder::UNIFORM, numCloudsPerScene));
+    unsigned int numClouds = numScenes * numCloudsPerScene;
+    unsigned int numParticles = numClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+    std::vector<Particle> particles(numParticles);
+    std::vector<ParticleCloud> particleClouds(numClouds);
+    SceneBuilder::Build(description, numParticles, particles.data(), particleClouds.data());
+
+    JobSystem jobSystem;
+    CPUParticleCloudSystem cloudSystem(&jobSystem);
+    CPUParticleSystem particleSystem(&jobSystem);
+    float dt = 1.f / 60.f;
+
+    // N scenes x 1, each scene with its own scene, sorter and dispatches. Particle start IDs are rebased to each scene.
+    std::vector<CPUScene*> scenes;
+    std::vector<CPUParticleCloudSorter*> sorters;
+    for (unsigned int s = 0; s < numScenes; ++s)
+    {
+        std::vector<ParticleCloud> sceneParticleClouds(particleClouds.begin() + s * numCloudsPerScene, particleClouds.begin() + (s + 1) * numCloudsPerScene);
+        for (ParticleCloud& particleCloud : sceneParticleClouds)
+            particleCloud.mParticleStartID -= s * numCloudsPerScene * SceneBuilder::PARTICLES_PER_CLOUD;
+        scenes.push_back(new CPUScene(numCloudsPerScene * SceneBuilder::PARTICLES_PER_CLOUD, numCloudsPerScene, particles.data() + s * numCloudsPerScene * SceneBuilder::PARTICLES_PER_CLOUD, sceneParticleClouds.data()));
+        sorters.push_back(new CPUParticleCloudSorter(numCloudsPerScene, &jobSystem));
+    }
+    float scenesMs = Measure(numIterations, [&]() {
+        for (unsigned int s = 0; s < numScenes; ++s)
+        {
+            sorters[s]->Sort(*scenes[s]);
+            cloudSystem.Update(*scenes[s], dt);
+            particleSystem.Update(*scenes[s], dt);
+        }
+    });
+
+    // 1 batch x N, one sort and one update pass over all scenes.
+    std::vector<unsigned int> numBatchClouds(numScenes, numCloudsPerScene);
+    CPUSceneBatch batch(numBatchClouds, particles.data(), particleClouds.data());
+    CPUParticleCloudSorter batchSorter(numClouds, &jobSystem);
+    float batchMs = Measure(numIterations, [&]() {
+        batchSorter.Sort(batch);
+        cloudSystem.Update(batch, dt);
+        particleSystem.Update(*batch.mScene, dt);
+    });
+
+    // Both ran the same number of frames, every scene must match its batched copy.
+    bool match = true;
+    for (unsigned int s = 0; s < numScenes; ++s)
+    {
+        const CPUSceneBatch::Range& range = batch.GetRange(s);
+        match &= memcmp(scenes[s]->mParticlesSwapBuffer->GetTargetBuffer(), batch.mScene->mParticlesSwapBuffer->GetTargetBuffer() + range.firstParticle, range.numParticles * sizeof(Particle)) == 0;
+        delete scenes[s];
+        delete sorters[s];
+    }
+
+    printf("Batch %u scenes x %u clouds, %u iterations, %u threads\n", numScenes, numCloudsPerScene, numIterations, jobSystem.GetNumThreads());
+    printf("  %u scenes x 1 : %8.3f ms\n", numScenes, scenesMs);
+    printf("  1 batch x %u  : %8.3f ms (%4.2fx), results %s\n", numScenes, batchMs, scenesMs / batchMs, match ? "OK" : "DIFFER");
+}
+
+// Generate animation with one key per tick.
+// aAnimation Animation to fill.
+// numChannels Number of channels.
+// numKeys Number of keys per channel.
+void GenerateAnimation(aiAnimation& aAnimation, unsigned int numChannels, unsigned int numKeys)
+{
+    aAnimation.mDuration = numKeys;
+    aAnimation.mTicksPerSecond = 25.0;
+    aAnimation.mNumChannels = numChannels;
+    aAnimation.mChannels = new aiNodeAnim*[numChannels];
+    for (unsigned int c = 0; c < numChannels; ++c)
+    {
+        aiNodeAnim* aChannel = aAnimation.mChannels[c] = new aiNodeAnim();
+        aChannel->mNodeName.Set("Bone" + std::to_string(c));
+        aChannel->mNumPositionKeys = aChannel->mNumRotationKeys = aChannel->mNumScalingKeys = numKeys;
+        aChannel->mPositionKeys = new aiVectorKey[numKeys];
+        aChannel->mRotationKeys = new aiQuatKey[numKeys];
+        aChannel->mScalingKeys = new aiVectorKey[numKeys];
+        for (unsigned int k = 0; k < numKeys; ++k)
+        {
+            aChannel->mPositionKeys[k] = aiVectorKey(k, aiVector3D(static_cast<float>(c), static_cast<float>(k), 0.f));
+            aChannel->mRotationKeys[k] = aiQuatKey(k, aiQuaternion(aiVector3D(0.f, 1.f, 0.f), k * 0.01f));
+            aChannel->mScalingKeys[k] = aiVectorKey(k, aiVector3D(1.f, 1.f, 1.f));
+        }
+    }
+}
+
+// Benchmark array math kernels against their per element versions and validate their results.
+// count Number of elements.
+void BenchmarkMathKernels(unsigned int count)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::uniform_real_distribution<float> positive(0.5f, 2.f);
+
+    // Structure of arrays inputs, q1 and q2 are unit quaternions.
+    std::vector<float> data(22 * count);
+    float* q1[4];
+    float* q2[4];
+    float* p[3];
+    float* s[3];
+    float* r[4];
+    float* t = &data[21 * count];
+    for (unsigned int c = 0; c < 4; ++c)
+    {
+        q1[c] = &data[c * count];
+        q2[c] = &data[(4 + c) * count];
+        r[c] = &data[(14 + c) * count];
+    }
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+        p[c] = &data[(8 + c) * count];
+        s[c] = &data[(11 + c) * count];
+    }
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        glm::quat a = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        glm::quat b = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+            q1[c][i] = a[c];
+            q2[c][i] = b[c];
+            r[c][i] = a[c] * positive(rng);
+        }
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            p[c][i] = dist(rng) * 100.f;
+            s[c][i] = positive(rng);
+        }
+        t[i] = dist(rng) * 0.5f + 0.5f;
+    }
+    float* result[4];
+    std::vector<float> resultData(4 * count);
+    for (unsigned int c = 0; c < 4; ++c)
+        result[c] = &resultData[c * count];
+    std::vector<glm::quat> quats(count);
+    std::vector<glm::mat4> matrices(count);
+    std::vector<glm::mat4> referenceMatrices(count);
+    std::vector<glm::mat3> inverses(count);
+    std::vector<glm::mat3> referenceInverses(count);
+    volatile float sink = 0.f;
+
+    printf("Math kernels %u elements\n", count);
+    auto report = [](const char* name, float scalarMs, float arrayMs, float maxError)
+    {
+        printf("  %-24s: %8.4f ms, scalar %8.4f ms (%4.2fx), max error %g\n", name, arrayMs, scalarMs, scalarMs / arrayMs, maxError);
+    };
+
+    // Mix.
+    float scalarMs = Measure(10, [&]()
+    {
+        for (unsigned int i = 0; i < count; ++i)
+            Geometry::MixQuat(glm::quat(q1[3][i], q1[0][i], q1[1][i], q1[2][i]), glm::quat(q2[3][i], q2[0][i], q2[1][i], q2[2][i]), t[i], quats[i]);
+        sink = quats[count - 1].w;
+    });
+    float arrayMs = Measure(10, [&]() { Geometry::MixQuats(q1, q2, t, result, count); });
+    float maxError = 0.f;
+    for (unsigned int i = 0; i < count; ++i)
+        for (unsigned int c = 0; c < 4; ++c)
+            maxError = std::max(maxError, std::abs(result[c][i] - quats[i][c]));
+    report("MixQuats", scalarMs, arrayMs, maxError);
+
+    // Spherical interpolation against assimp.
+    std::vector<aiQuaternion> aiQuats(count);
+    scalarMs = Measure(10, [&]()
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            aiQuaternion::Interpolate(aiQuats[i], aiQuaternion(q1[3][i], q1[0][i], q1[1][i], q1[2][i]), aiQuaternion(q2[3][i], q2[0][i], q2[1][i], q2[2][i]), t[i]);
+            aiQuats[i].Normalize();
+        }
+        sink = aiQuats[count - 1].w;
+    });
+    arrayMs = Measure(10, [&]() { Geometry::SlerpQuats(q1, q2, t, result, count); });
+    maxError = 0.f;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        maxError = std::max(maxError, std::abs(result[0][i] - aiQuats[i].x));
+        maxError = std::max(maxError, std::abs(result[1][i] - aiQuats[i].y));
+        maxError = std::max(maxError, std::abs(result[2][i] - aiQuats[i].z));
+        maxError = std::max(maxError, std::abs(result[3][i] - aiQuats[i].w));
+    }
+    report("SlerpQuats", scalarMs, arrayMs, maxError);
+
+    // Normalize, each iteration restores the unnormalized quaternions.
+    scalarMs = Measure(10, [&]()
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            quats[i] = glm::quat(r[3][i], r[0][i], r[1][i], r[2][i]);
+            Geometry::NormalizeQuat(quats[i]);
+        }
+    });
+    arrayMs = Measure(10, [&]()
+    {
+        for (unsigned int c = 0; c < 4; ++c)
+            std::copy(r[c], r[c] + count, result[c]);
+        Geometry::NormalizeQuats(result, count);
+    });
+    maxError = 0.f;
+    for (unsigned int i = 0; i < count; ++i)
+        for (unsigned int c = 0; c < 4; ++c)
+            maxError = std::max(maxError, std::abs(result[c][i] - quats[i][c]));
+    report("NormalizeQuats", scalarMs, arrayMs, maxError);
+
+    // Compose.
+    scalarMs = Measure(10, [&]()
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            glm::quat rotation(q1[3][i], q1[0][i], q1[1][i], q1[2][i]);
+            Geometry::ComposeMatrix(glm::vec3(p[0][i], p[1][i], p[2][i]), rotation, glm::vec3(s[0][i], s[1][i], s[2][i]), referenceMatrices[i]);
+        }
+    });
+    arrayMs = Measure(10, [&]() { Geometry::ComposeMatrices(p, q1, s, matrices.data(), count); });
+    maxError = 0.f;
+    for (unsigned int i = 0; i < count; ++i)
+        for (unsigned int c = 0; c < 4; ++c)
+            for (unsigned int e = 0; e < 4; ++e)
+                maxError = std::max(maxError, std::abs(matrices[i][c][e] - referenceMatrices[i][c][e]));
+    report("ComposeMatrices", scalarMs, arrayMs, maxError);
+
+    // Inverse transpose of affine matrices with non-uniform and uniform scale against the full inverse.
+    for (unsigned int uniform = 0; uniform < 2; ++uniform)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            glm::vec3 scale = uniform != 0 ? glm::vec3(s[0][i]) : glm::vec3(s[0][i], s[1][i], s[2][i]);
+            matrices[i] = glm::translate(glm::mat4(), glm::vec3(p[0][i], p[1][i], p[2][i])) * glm::mat4_cast(glm::quat(q1[3][i], q1[0][i], q1[1][i], q1[2][i])) * glm::scale(glm::mat4(), scale);
+        }
+        scalarMs = Measure(10, [&]()
+        {
+            for (unsigned int i = 0; i < count; ++i)
+                referenceInverses[i] = glm::mat3(glm::transpose(glm::inverse(matrices[i])));
+        });
+        arrayMs = Measure(10, [&]() { Geometry::InverseTransposeAffine(matrices.data(), inverses.data(), count, uniform != 0); });
+        maxError = 0.f;
+        for (unsigned int i = 0; i < count; ++i)
+            for (unsigned int c = 0; c < 3; ++c)
+                for (unsigned int e = 0; e < 3; ++e)
+                    maxError = std::max(maxError, std::abs(inverses[i][c][e] - referenceInverses[i][c][e]));
+        report(uniform != 0 ? "InverseTransposeAffine u" : "InverseTransposeAffine", scalarMs, arrayMs, maxError);
+    }
+}
+
+// Benchmark CPU skinning against blending a matrix per vertex.
+// numVertices Number of skinned vertices.
+// numBones Number of bones of the palette.
+void BenchmarkSkinning(unsigned int numVertices, unsigned int numBones)
+{
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::uniform_real_distribution<float> positive(0.5f, 2.f);
+    std::uniform_int_distribution<int> bone(0, numBones - 1);
+    std::uniform_int_distribution<int> influences(1, 4);
+
+    // Rotations with non-uniform scale, so normals need the inverse transposes.
+    std::vector<glm::mat4> bones(numBones);
+    std::vector<glm::mat3> bonesIT(numBones);
+    for (unsigned int b = 0; b < numBones; ++b)
+    {
+        glm::quat rotation = glm::normalize(glm::quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+        bones[b] = glm::translate(glm::mat4(), glm::vec3(dist(rng), dist(rng), dist(rng)) * 10.f) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(), glm::vec3(positive(rng), positive(rng), positive(rng)));
+    }
+    Geometry::InverseTransposeAffine(bones.data(), bonesIT.data(), numBones, false);
+
+    // Weights sorted largest first, as converted meshes have them.
+    std::vector<Geometry::SkinVertex> vertices(numVertices);
+    for (Geometry::SkinVertex& vertex : vertices)
+    {
+        vertex.position = glm::vec3(dist(rng), dist(rng), dist(rng)) * 10.f;
+        vertex.textureCoordinate = glm::vec2(0.f);
+        vertex.normal = glm::normalize(glm::vec3(dist(rng), dist(rng), dist(rng)));
+        vertex.tangent = glm::normalize(glm::cross(vertex.normal, glm::vec3(0.f, 0.f, 1.f)));
+        vertex.boneIDs = glm::ivec4(0);
+        vertex.weights = glm::vec4(0.f);
+        int numInfluences = influences(rng);
+        float sum = 0.f;
+        for (int k = 0; k < numInfluences; ++k)
+        {
+            vertex.boneIDs[k] = bone(rng);
+            vertex.weights[k] = positive(rng);
+            sum += vertex.weights[k];
+        }
+        std::sort(&vertex.weights[0], &vertex.weights[0] + numInfluences, [](float a, float b) { return a > b; });
+        vertex.weights /= sum;
+    }
+
+    std::vector<Geometry::SkinnedVertex> reference(numVertices);
+    std::vector<Geometry::SkinnedVertex> skinned(numVertices);
+    float referenceMs = Measure(20, [&]()
+    {
+        for (unsigned int i = 0; i < numVertices; ++i)
+        {
+            const Geometry::SkinVertex& vertex = vertices[i];
+            glm::mat4 matrix(0.f);
+            glm::mat3 matrixIT(0.f);
+            for (unsigned int k = 0; k < 4; ++k)
+            {
+                matrix += bones[vertex.boneIDs[k]] * vertex.weights[k];
+                matrixIT += bonesIT[vertex.boneIDs[k]] * vertex.weights[k];
+            }
+            reference[i].position = glm::vec3(matrix * glm::vec4(vertex.position, 1.f));
+            reference[i].normal = glm::normalize(matrixIT * vertex.normal);
+            reference[i].tangent = glm::normalize(glm::mat3(matrix) * vertex.tangent);
+        }
+    });
+    Geometry::Skinning skinning;
+    skinning.SetBones(bones.data(), bonesIT.data(), numBones);
+    float skinMs = Measure(20, [&]()
+    {
+        skinning.Skin(vertices.data(), numVertices, skinned.data());
+    });
+    float maxError = 0.f;
+    for (unsigned int i = 0; i < numVertices; ++i)
+    {
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            maxError = std::max(maxError, std::abs(skinned[i].position[c] - reference[i].position[c]));
+            maxError = std::max(maxError, std::abs(skinned[i].normal[c] - reference[i].normal[c]));
+            maxError = std::max(maxError, std::abs(skinned[i].tangent[c] - reference[i].tangent[c]));
+        }
+    }
+
+    JobSystem jobSystem;
+    std::vector<Geometry::SkinnedVertex> parallel(numVertices);
+    float parallelMs = Measure(20, [&]()
+    {
+        skinning.Skin(vertices.data(), numVertices, parallel.data(), &jobSystem);
+    });
+    bool match = memcmp(parallel.data(), skinned.data(), numVertices * sizeof(Geometry::SkinnedVertex)) == 0;
+
+    printf("Skinning %u vertices, %u bones\n", numVertices, numBones);
+    printf("  reference : %8.3f ms\n", referenceMs);
+    printf("  skin      : %8.3f ms (%4.2fx), max error %g\n", skinMs, referenceMs / skinMs, maxError);
+    printf("  parallel  : %8.3f ms (%4.2fx, %u threads), results %s\n", parallelMs, referenceMs / parallelMs, jobSystem.GetNumThreads(), match ? "OK" : "DIFFER");
+}
+
+// Benchmark sampling every channel of an animation with playback cursors against seeking every frame.
+// numChannels Number of channels of the generated animation.
+// numKeys Number of keys per channel.
+void BenchmarkAnimationSampling(unsigned int numChannels, unsigned int numKeys)
+{
+    aiAnimation aAnimation;
+    GenerateAnimation(aAnimation, numChannels, numKeys);
+    Geometry::Animation animation(&aAnimation);
+    std::vector<const Geometry::Animation::AnimChannel*> channels(numChannels);
+    for (unsigned int c = 0; c < numChannels; ++c)
+        channels[c] = animation.FindChannel("Bone" + std::to_string(c));
+    std::vector<Geometry::Animation::KeyCursor> cursors(numChannels);
+
+    // Play the whole clip at 4 frames per key.
+    const unsigned int numFrames = numKeys * 4;
+    volatile float sink = 0.f;
+    auto sample = [&](bool useCursors)
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+        {
+            float animationTime = f * 0.25f;
+            for (unsigned int c = 0; c < numChannels; ++c)
+            {
+                glm::vec3 translation;
+                Geometry::Animation::CalcInterpolatedPosition(translation, animationTime, channels[c], useCursors ? &cursors[c] : nullptr);
+                sink = sink + translation.y;
+            }
+        }
+    };
+    float seekMs = Measure(1, [&]() { sample(false); }) / numFrames;
+    float cursorMs = Measure(1, [&]() { sample(true); }) / numFrames;
+
+    printf("Animation sampling %u channels, %u keys\n", numChannels, numKeys);
+    printf("  seek   : %8.4f ms/frame\n", seekMs);
+    printf("  cursor : %8.4f ms/frame (%4.2fx)\n", cursorMs, seekMs / cursorMs);
+}
+
+// Benchmark compressed animation size, error and decode speed against the source animation.
+// label Name of the animation in the output.
+// animation Animation to compress.
+void BenchmarkAnimationCompression(const std::string& label, const Geometry::Animation& animation)
+{
+    Geometry::CompressedAnimation compressed(animation, Geometry::CompressedAnimation::Settings());
+    Geometry::CompressedAnimation::Decoder decoder(compressed);
+    const std::size_t numChannels = animation.GetNumChannels();
+    std::vector<std::size_t> channelIndices(numChannels);
+    for (std::size_t c = 0; c < numChannels; ++c)
+        channelIndices[c] = compressed.FindChannel(animation.GetChannel(c).trgNodeName);
+
+    // Play the whole clip at 4 frames per tick.
+    const unsigned int numFrames = static_cast<unsigned int>(animation.duration * 4.0) + 1;
+    std::vector<Geometry::Animation::KeyCursor> cursors(numChannels);
+    float maxTranslationError = 0.f;
+    float maxRotationError = 0.f;
+    for (unsigned int f = 0; f < numFrames; ++f)
+    {
+        float animationTime = f * 0.25f;
+        decoder.Sample(animationTime);
+        for (std::size_t c = 0; c < numChannels; ++c)
+        {
+            glm::vec3 translation;
+            aiQuaternion rotation;
+            Geometry::Animation::CalcInterpolatedPosition(translation, animationTime, &animation.GetChannel(c), &cursors[c]);
+            Geometry::Animation::CalcInterpolatedRotation(rotation, animationTime, &animation.GetChannel(c), &cursors[c]);
+            const aiQuaternion& decoded = decoder.GetRotation(channelIndices[c]);
+            float dot = std::abs(rotation.x * decoded.x + rotation.y * decoded.y + rotation.z * decoded.z + rotation.w * decoded.w);
+            maxTranslationError = std::max(maxTranslationError, glm::length(translation - decoder.GetTranslation(channelIndices[c])));
+            maxRotationError = std::max(maxRotationError, 2.f * std::acos(std::min(dot, 1.f)));
+        }
+    }
+
+    volatile float sink = 0.f;
+    float sourceMs = Measure(1, [&]()
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+        {
+            for (std::size_t c = 0; c < numChannels; ++c)
+            {
+                glm::vec3 scaling, translation;
+                aiQuaternion rotation;
+                Geometry::Animation::CalcInterpolatedScaling(scaling, f * 0.25f, &animation.GetChannel(c), &cursors[c]);
+                Geometry::Animation::CalcInterpolatedRotation(rotation, f * 0.25f, &animation.GetChannel(c), &cursors[c]);
+                Geometry::Animation::CalcInterpolatedPosition(translation, f * 0.25f, &animation.GetChannel(c), &cursors[c]);
+                sink = sink + scaling.x + rotation.w + translation.x;
+            }
+        }
+    }) / numFrames;
+    float decodeMs = Measure(1, [&]()
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+            decoder.Sample(f * 0.25f);
+    }) / numFrames;
+
+    const Geometry::CompressedAnimation::Statistics& statistics = compressed.GetStatistics();
+    printf("Animation compression %s, %zu channels\n", label.c_str(), numChannels);
+    printf("  size   : %10zu -> %10zu bytes (%5.1fx), keys %zu -> %zu, %zu constant tracks\n", animation.GetNumBytes(), compressed.GetNumBytes(),
+        static_cast<double>(animation.GetNumBytes()) / compressed.GetNumBytes(), statistics.numSourceKeys, statistics.numStoredKeys, statistics.numConstantTracks);
+    printf("  error  : translation %g, rotation %g rad\n", maxTranslationError, maxRotationError);
+    printf("  source : %8.4f ms/frame\n", sourceMs);
+    printf("  decode : %8.4f ms/frame (%4.2fx)\n", decodeMs, sourceMs / decodeMs);
+}
+
+#ifdef BENCHMARK_ASSIMP
+// Benchmark compression of every animation of a file.
+// path Path of the file.
+void BenchmarkAnimationCompression(const std::string& path)
+{
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, 0);
+    if (aScene == nullptr)
+    {
+        printf("Animation compression: failed to load %s\n", path.c_str());
+        return;
+    }
+
+    for (unsigned int a = 0; a < aScene->mNumAnimations; ++a)
+    {
+        Geometry::Animation animation(aScene->mAnimations[a]);
+        BenchmarkAnimationCompression(path + " " + animation.name, animation);
+    }
+}
+#endif
+
+// Benchmark scaling of animation loading with the number of job system threads.
+// numChannels Number of channels of the generated animation.
+// numKeys Number of keys per channel.
+// maxNumThreads Max number of threads.
+void BenchmarkAnimationScaling(unsigned int numChannels, unsigned int numKeys, unsigned int maxNumThreads)
+{
+    aiAnimation aAnimation;
+    GenerateAnimation(aAnimation, numChannels, numKeys);
+
+    printf("Animation scaling %u channels, %u keys\n", numChannels, numKeys);
+    float referenceMs = 0.f;
+    for (unsigned int numThreads = 1; numThreads <= maxNumThreads; ++numThreads)
+    {
+        JobSystem jobSystem(numThreads);
+        float loadMs = Measure(5, [&]() { Geometry::Animation animation(&aAnimation, &jobSystem); });
+        if (numThreads == 1)
+            referenceMs = loadMs;
+        printf("  %2u threads : load %8.3f ms (%4.2fx)\n", numThreads, loadMs, referenceMs / loadMs);
+    }
+}
+
+#ifdef BENCHMARK_ASSIMP
+// Benchmark flattened skeleton evaluation against walking the node tree.
+// path Path of a file with a skinned mesh and an animation.
+// numFrames Number of animated frames.
+void BenchmarkSkeleton(const std::string& path, unsigned int numFrames)
+{
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, 0);
+    if (aScene == nullptr || aScene->mNumAnimations == 0)
+    {
+        printf("Skeleton: failed to load %s\n", path.c_str());
+        return;
+    }
+
+    Geometry::Skeleton treeSkeleton(aScene);
+    Geometry::Skeleton flatSkeleton(aScene);
+    Geometry::Animation animation(aScene->mAnimations[0]);
+    const float frameTime = 1.f / 60.f;
+
+    // Both paths have to agree on every frame.
+    bool match = true;
+    for (unsigned int f = 0; f < numFrames; ++f)
+    {
+        treeSkeleton.AnimateHierarchy(&animation, f * frameTime);
+        flatSkeleton.Animate(&animation, f * frameTime);
+        match &= treeSkeleton.GetFinalTransformations() == flatSkeleton.GetFinalTransformations();
+    }
+
+    float treeMs = Measure(1, [&]()
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+            treeSkeleton.AnimateHierarchy(&animation, f * frameTime);
+    });
+    float flatMs = Measure(1, [&]()
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+            flatSkeleton.Animate(&animation, f * frameTime);
+    });
+
+    printf("Skeleton %s, %zu bones, %u frames\n", path.c_str(), flatSkeleton.GetNumBones(), numFrames);
+    printf("  tree : %8.3f ms/frame\n", treeMs / numFrames);
+    printf("  flat : %8.3f ms/frame (%4.2fx), results %s\n", flatMs / numFrames, treeMs / flatMs, match ? "OK" : "DIFFER");
+}
+
+// Benchmark scaling of skeleton animation with the number of job system threads.
+// path Path of a file with a skinned mesh and an animation.
+// numFrames Number of animated frames.
+// maxNumThreads Max number of threads.
+void BenchmarkSkeletonScaling(const std::string& path, unsigned int numFrames, unsigned int maxNumThreads)
+{
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, 0);
+    if (aScene == nullptr || aScene->mNumAnimations == 0)
+    {
+        printf("Skeleton scaling: failed to load %s\n", path.c_str());
+        return;
+    }
+
+    Geometry::Skeleton skeleton(aScene);
+    Geometry::Animation animation(aScene->mAnimations[0]);
+    const float frameTime = 1.f / 60.f;
+
+    printf("Skeleton scaling %s, %zu bones, %u frames\n", path.c_str(), skeleton.GetNumBones(), numFrames);
+    float referenceMs = 0.f;
+    for (unsigned int numThreads = 1; numThreads <= maxNumThreads; ++numThreads)
+    {
+        JobSystem jobSystem(numThreads);
+        float animateMs = Measure(1, [&]()
+        {
+            for (unsigned int f = 0; f < numFrames; ++f)
+                skeleton.Animate(&animation, f * frameTime, &jobSystem);
+        }) / numFrames;
+        if (numThreads == 1)
+            referenceMs = animateMs;
+        printf("  %2u threads : animate %8.4f ms/frame (%4.2fx)\n", numThreads, animateMs, referenceMs / animateMs);
+    }
+}
+
+// Benchmark sampling baked pose tables against animating the skeleton.
+// path Path of a file with a skinned mesh and an animation.
+// numFrames Number of sampled frames.
+void BenchmarkPoseTable(const std::string& path, unsigned int numFrames)
+{
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, 0);
+    if (aScene == nullptr || aScene->mNumAnimations == 0)
+    {
+        printf("Pose table: failed to load %s\n", path.c_str());
+        return;
+    }
+
+    Geometry::Skeleton skeleton(aScene);
+    Geometry::Animation animation(aScene->mAnimations[0]);
+    const std::size_t numBones = skeleton.GetNumBones();
+    std::vector<glm::mat4> finalTransforms(numBones);
+    std::vector<glm::mat3> finalTransformsIT(numBones);
+    const float frameTime = 1.f / 60.f;
+
+    float skeletonMs = Measure(1, [&]()
+    {
+        for (unsigned int f = 0; f < numFrames; ++f)
+            skeleton.Animate(&animation, f * frameTime);
+    });
+    printf("Pose table %s, %zu bones, %u frames\n", path.c_str(), numBones, numFrames);
+    printf("  skeleton           : %8.4f ms/frame\n", skeletonMs / numFrames);
+
+    const float rates[] = { 15.f, 30.f, 60.f };
+    for (unsigned int format = 0; format < 2; ++format)
+    {
+        for (float rate : rates)
+        {
+            for (unsigned int interpolate = 0; interpolate < 2; ++interpolate)
+            {
+                Geometry::PoseTable::Settings settings;
+                settings.framesPerSecond = rate;
+                settings.format = format == 0 ? Geometry::PoseTable::FORMAT_AFFINE : Geometry::PoseTable::FORMAT_QUATERNION;
+                settings.interpolate = interpolate != 0;
+                Geometry::PoseTable table;
+                float bakeMs = Measure(1, [&]()
+                {
+                    table.Bake(skeleton, animation, settings);
+                });
+
+                // Largest difference of a matrix element to the animated skeleton.
+                float maxError = 0.f;
+                for (unsigned int f = 0; f < numFrames; ++f)
+                {
+                    skeleton.Animate(&animation, f * frameTime);
+                    table.Sample(f * frameTime, finalTransforms.data());
+                    for (std::size_t b = 0; b < numBones; ++b)
+                        for (unsigned int c = 0; c < 4; ++c)
+                            for (unsigned int r = 0; r < 4; ++r)
+                                maxError = std::max(maxError, std::abs(finalTransforms[b][c][r] - skeleton.GetFinalTransformations()[b][c][r]));
+                }
+
+                float sampleMs = Measure(1, [&]()
+                {
+                    for (unsigned int f = 0; f < numFrames; ++f)
+                        table.Sample(f * frameTime, finalTransforms.data(), finalTransformsIT.data());
+                });
+                printf("  %-6s %2.0f fps %-7s: %8.4f ms/frame (%5.1fx), %8zu bytes, bake %7.2f ms, max error %g\n", format == 0 ? "affine" : "quat", rate,
+                    interpolate != 0 ? "lerp" : "nearest", sampleMs / numFrames, skeletonMs / sampleMs, table.GetNumBytes(), bakeMs, maxError);
+            }
+        }
+    }
+}
+
+// Benchmark loading a cooked asset against importing the source file.
+// path Path of a file with a skinned mesh and an animation.
+void BenchmarkCookedAsset(const std::string& path)
+{
+    const unsigned int flags = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
+    const std::string cookedPath = path + ".cooked";
+    Geometry::CompressedAnimation::Settings settings;
+    bool cooked = false;
+    float cookMs = Measure(1, [&]()
+    {
+        Assimp::Importer importer;
+        const aiScene* aScene = importer.ReadFile(path, flags);
+        cooked = aScene != nullptr && Geometry::CookedAsset::Cook(aScene, settings, cookedPath);
+    });
+    if (!cooked)
+    {
+        printf("Cooked asset: failed to cook %s\n", path.c_str());
+        return;
+    }
+
+    // Everything the runtime needs: vertex and index streams, skeleton and compressed clips.
+    std::size_t numVertices = 0;
+    float importMs = Measure(1, [&]()
+    {
+        Assimp::Importer importer;
+        const aiScene* aScene = importer.ReadFile(path, flags);
+        Geometry::Skeleton skeleton(aScene);
+        std::vector<Geometry::CookedAsset::Mesh> meshes;
+        std::vector<Geometry::SkinVertex> vertices;
+        std::vector<std::uint32_t> indices;
+        Geometry::CookedAsset::ConvertMeshes(aScene, skeleton, meshes, vertices, indices);
+        std::vector<Geometry::CompressedAnimation> clips(aScene->mNumAnimations);
+        for (unsigned int a = 0; a < aScene->mNumAnimations; ++a)
+            clips[a].Compress(Geometry::Animation(aScene->mAnimations[a]), settings);
+        numVertices = vertices.size();
+    });
+
+    bool loaded = false;
+    bool match = true;
+    std::size_t numBytes = 0;
+    float loadMs = Measure(1, [&]()
+    {
+        Geometry::CookedAsset asset;
+        loaded = asset.Load(cookedPath);
+        if (!loaded)
+            return;
+        Geometry::Skeleton skeleton;
+        asset.LoadSkeleton(skeleton);
+        std::vector<Geometry::CompressedAnimation> clips(asset.GetHeader().numClips);
+        for (std::size_t a = 0; a < clips.size(); ++a)
+            asset.LoadClip(a, clips[a]);
+        match = asset.GetHeader().numVertices == numVertices;
+        numBytes = static_cast<std::size_t>(asset.GetHeader().fileSize);
+    });
+    remove(cookedPath.c_str());
+
+    printf("Cooked asset %s, %zu vertices, %zu bytes\n", path.c_str(), numVertices, numBytes);
+    printf("  cook   : %8.3f ms\n", cookMs);
+    printf("  import : %8.3f ms\n", importMs);
+    printf("  cooked : %8.3f ms (%5.1fx), %s\n", loadMs, importMs / loadMs, loaded && match ? "OK" : "FAILED");
+}
+
+// Benchmark crowd animation, one skeleton at a time against one batch.
+// path Path of a file with a skinned mesh and an animation.
+// numInstances Number of animated instances.
+void BenchmarkSkeletonBatch(const std::string& path, unsigned int numInstances)
+{
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, 0);
+    if (aScene == nullptr || aScene->mNumAnimations == 0)
+    {
+        printf("Skeleton batch: failed to load %s\n", path.c_str());
+        return;
+    }
+
+    Geometry::Skeleton skeleton(aScene);
+    Geometry::Animation animation(aScene->mAnimations[0]);
+    const std::size_t numBones = skeleton.GetNumBones();
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> time(0.f, 10.f);
+    std::vector<Geometry::SkeletonBatch::Instance> instances(numInstances);
+    for (Geometry::SkeletonBatch::Instance& instance : instances)
+    {
+        instance.skeleton = &skeleton;
+        instance.animation = &animation;
+        instance.timeInSeconds = time(rng);
+    }
+
+    // One skeleton animated per instance and its palette copied out, as without the batch.
+    std::vector<glm::mat4> palettes(numInstances * numBones);
+    float singleMs = Measure(3, [&]()
+    {
+        for (unsigned int i = 0; i < numInstances; ++i)
+        {
+            skeleton.Animate(&animation, instances[i].timeInSeconds);
+            std::copy(skeleton.GetFinalTransformations().begin(), skeleton.GetFinalTransformations().end(), palettes.begin() + i * numBones);
+        }
+    });
+
+    Geometry::SkeletonBatch batch;
+    float batchMs = Measure(3, [&]() { batch.Animate(instances.data(), instances.size()); });
+
+    JobSystem jobSystem;
+    float parallelMs = Measure(3, [&]() { batch.Animate(instances.data(), instances.size(), &jobSystem); });
+
+    // Both paths evaluate the same math, in a different order.
+    float maxError = 0.f;
+    for (std::size_t i = 0; i < palettes.size(); ++i)
+        for (unsigned int c = 0; c < 4; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                maxError = std::max(maxError, std::abs(palettes[i][c][r] - batch.GetFinalTransformations()[i][c][r]));
+
+    printf("Skeleton batch %u instances, %zu bones\n", numInstances, numBones);
+    printf("  single   : %8.3f ms, %10.1f instances/ms\n", singleMs, numInstances / singleMs);
+    printf("  batch    : %8.3f ms, %10.1f instances/ms (%4.2fx)\n", batchMs, numInstances / batchMs, singleMs / batchMs);
+    printf("  parallel : %8.3f ms, %10.1f instances/ms (%4.2fx, %u threads), max error %g\n", parallelMs, numInstances / parallelMs, singleMs / parallelMs, jobSystem.GetNumThreads(), maxError);
+}
+#endif
+
+// Directory of the kernel cache self-check, holding its sources and blobs.
+#define KERNELCACHE_CHECK_DIRECTORY "KernelCacheCheck"
+
+// Number of stub compilations.
+std::atomic<unsigned int> gNumStubCompiles(0);
+
+// Stub compile function. The blob is the source followed by the defines, sources containing #error fail.
+bool StubCompile(const KernelDesc& desc, const std::string& source, std::vector<unsigned char>& blob, std::string& error)
+{
+    ++gNumStubCompiles;
+    if (source.find("#error") != std::string::npos)
+    {
+        error = desc.path + ": #error";
+        return false;
+    }
+
+    std::string output = source;
+    for (const std::pair<std::string, std::string>& define : desc.defines)
+        output += "\n" + define.first + "=" + define.second;
+    blob.assign(output.begin(), output.end());
+    return true;
+}
+
+// Write file of the kernel cache self-check.
+bool WriteCheckFile(const std::string& path, const std::string& contents)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    return fclose(file) == 0 && written;
+}
+
+// Check kernel cache hits, misses and failure reporting with a stub compiler.
+// Returns whether every check passed.
+bool CheckKernelCache()
+{
+    const std::string directory = KERNELCACHE_CHECK_DIRECTORY;
+    const std::string sourcePath = directory + "/Check_CS.hlsl";
+    const std::string includePath = directory + "/Check.hlsli";
+    const std::string failingPath = directory + "/Failing_CS.hlsl";
+    std::vector<std::string> blobPaths;
+
+    unsigned int numChecks = 0;
+    unsigned int numFailed = 0;
+    auto check = [&](bool passed, const char* name)
+    {
+        ++numChecks;
+        if (!passed)
+        {
+            ++numFailed;
+            printf("  FAILED: %s\n", name);
+        }
+    };
+
+    // Build desc in a fresh cache, as on the next start.
+    auto build = [&](const KernelDesc& desc, Kernel& kernel, KernelCache::Statistics& statistics)
+    {
+        KernelCache cache(StubCompile, "stub", directory);
+        unsigned int id = cache.Add(desc);
+        bool valid = cache.Build();
+        kernel = cache.Get(id);
+        statistics = cache.GetStatistics();
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", kernel.hash);
+        blobPaths.push_back(directory + "/" + name + KERNELCACHE_EXTENSION);
+        return valid;
+    };
+
+    printf("Kernel cache\n");
+    // The cache creates its directory, the sources are written into it.
+    KernelCache(StubCompile, "stub", directory);
+    std::string source = "#include \"Check.hlsli\"\nvoid main() {}\n";
+    bool written = WriteCheckFile(sourcePath, source) && WriteCheckFile(includePath, "#define CHECK 1\n") && WriteCheckFile(failingPath, "#error\n");
+    check(written, "write sources");
+
+    KernelDesc desc;
+    desc.path = sourcePath;
+    desc.entryPoint = "main";
+    desc.target = "cs_5_0";
+    desc.includes.push_back(includePath);
+    Kernel kernel;
+    KernelCache::Statistics statistics;
+
+    // Miss, then hit with the same blob.
+    unsigned int numCompiles = gNumStubCompiles;
+    bool valid = build(desc, kernel, statistics);
+    check(valid && statistics.numMisses == 1 && statistics.numHits == 0 && !kernel.cached && gNumStubCompiles == numCompiles + 1, "first build compiles");
+    std::vector<unsigned char> blob = kernel.blob;
+    valid = build(desc, kernel, statistics);
+    check(valid && statistics.numHits == 1 && statistics.numMisses == 0 && kernel.cached && gNumStubCompiles == numCompiles + 1, "second build loads");
+    check(kernel.blob == blob && !blob.empty(), "loaded blob matches compiled blob");
+
+    // Changed define and changed include miss.
+    KernelDesc defined = desc;
+    defined.defines.push_back(std::make_pair(std::string("WORK_COUNTERS"), std::string("1")));
+    valid = build(defined, kernel, statistics);
+    check(valid && statistics.numMisses == 1 && kernel.blob != blob, "define change compiles");
+    check(WriteCheckFile(includePath, "#define CHECK 2\n") && build(desc, kernel, statistics) && statistics.numMisses == 1, "include change compiles");
+
+    // Failures are reported and not cached.
+    KernelDesc failing = desc;
+    failing.path = failingPath;
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        valid = build(failing, kernel, statistics);
+        check(!valid && statistics.numFailures == 1 && statistics.numMisses == 1 && kernel.built && kernel.blob.empty() && kernel.error.find("#error") != std::string::npos, "compile failure is reported and not cached");
+    }
+    KernelDesc missing = desc;
+    missing.path = directory + "/Missing_CS.hlsl";
+    {
+        KernelCache cache(StubCompile, "stub", directory);
+        unsigned int id = cache.Add(missing);
+        valid = cache.Build();
+        check(!valid && cache.GetStatistics().numFailures == 1 && !cache.Get(id).error.empty(), "missing source is reported");
+    }
+
+    // Remove sources, blobs and directory.
+    remove(sourcePath.c_str());
+    remove(includePath.c_str());
+    remove(failingPath.c_str());
+    for (const std::string& path : blobPaths)
+        remove(path.c_str());
+#ifdef _WIN32
+    _rmdir(directory.c_str());
+#else
+    rmdir(directory.c_str());
+#endif
+
+    printf("  %u checks, %u failed\n", numChecks, numFailed);
+    return numFailed == 0;
+}
+
+#ifdef BENCHMARK_ASSIMP
+// Check that loading rejects a cooked file with any of its indexing fields corrupted.
+// cookedPath Valid cooked file, corrupted copies are written next to it.
+// Returns whether every check passed.
+bool CheckCookedFile(const std::string& cookedPath)
+{
+    typedef Geometry::CookedAsset CookedAsset;
+    std::string original;
+    FILE* file = fopen(cookedPath.c_str(), "rb");
+    if (file != nullptr)
+    {
+        char chunk[4096];
+        std::size_t numRead;
+        while ((numRead = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            original.append(chunk, numRead);
+        fclose(file);
+    }
+
+    unsigned int numChecks = 0;
+    unsigned int numFailed = 0;
+    auto check = [&](bool passed, const char* name)
+    {
+        ++numChecks;
+        if (!passed)
+        {
+            ++numFailed;
+            printf("  FAILED: %s\n", name);
+        }
+    };
+
+    // Load a copy of the file, the asset is unmapped before the next copy is written.
+    const std::string corruptPath = cookedPath + ".corrupt";
+    auto loads = [&corruptPath](const std::string& contents)
+    {
+        CookedAsset asset;
+        return WriteCheckFile(corruptPath, contents) && asset.Load(corruptPath);
+    };
+    printf("Cooked asset\n");
+    bool valid = original.size() >= sizeof(CookedAsset::Header) && loads(original);
+    check(valid, "cooked file loads");
+    if (!valid)
+    {
+        remove(corruptPath.c_str());
+        printf("  %u checks, %u failed\n", numChecks, numFailed);
+        return false;
+    }
+
+    // Write value at byte offset of a copy and expect the load to fail. Fields the file does not have are skipped.
+    const CookedAsset::Header header = *reinterpret_cast<const CookedAsset::Header*>(original.data());
+    auto corrupt = [&](bool present, std::uint64_t offset, std::uint32_t value, std::size_t size, const char* name)
+    {
+        if (!present)
+        {
+            printf("  skipped: %s, the file has none\n", name);
+            return;
+        }
+        std::string contents = original;
+        memcpy(&contents[static_cast<std::size_t>(offset)], &value, size);
+        check(!loads(contents), name);
+    };
+
+    const CookedAsset::Mesh mesh = header.numMeshes > 0 ? *reinterpret_cast<const CookedAsset::Mesh*>(original.data() + header.meshesOffset) : CookedAsset::Mesh();
+    const std::uint64_t meshOffset = header.meshesOffset;
+    const bool hasMesh = header.numMeshes > 0;
+    corrupt(hasMesh, meshOffset + offsetof(CookedAsset::Mesh, firstVertex), header.numVertices - mesh.numVertices + 1, 4, "mesh firstVertex past the vertices");
+    corrupt(hasMesh, meshOffset + offsetof(CookedAsset::Mesh, numVertices), header.numVertices - mesh.firstVertex + 1, 4, "mesh numVertices past the vertices");
+    corrupt(hasMesh, meshOffset + offsetof(CookedAsset::Mesh, firstIndex), header.numIndices - mesh.numIndices + 1, 4, "mesh firstIndex past the indices");
+    corrupt(hasMesh, meshOffset + offsetof(CookedAsset::Mesh, numIndices), header.numIndices - mesh.firstIndex + 1, 4, "mesh numIndices past the indices");
+    corrupt(hasMesh && mesh.numIndices > 0, header.indicesOffset + mesh.firstIndex * 4ULL, mesh.numVertices, 4, "index past the mesh vertices");
+
+    const std::uint64_t boneIDsOffset = header.verticesOffset + offsetof(Geometry::SkinVertex, boneIDs);
+    corrupt(header.numVertices > 0, boneIDsOffset, std::max(header.numBones, 1U), 4, "bone ID past the bones");
+    corrupt(header.numVertices > 0, boneIDsOffset + 12, static_cast<std::uint32_t>(-1), 4, "negative bone ID");
+
+    // Keys start with a 16 bit time followed by the 16 bit track.
+    const CookedAsset::Clip clip = header.numClips > 0 ? *reinterpret_cast<const CookedAsset::Clip*>(original.data() + header.clipsOffset) : CookedAsset::Clip();
+    const std::uint32_t numTracks = clip.numChannels * 3;
+    corrupt(header.numClips > 0 && clip.numKeys > 0, clip.keysOffset + 2, numTracks, 2, "key track past the tracks");
+    corrupt(header.numClips > 0 && clip.numConstantKeys > 0, clip.constantKeysOffset + 2, numTracks, 2, "constant key track past the tracks");
+
+    remove(corruptPath.c_str());
+    printf("  %u checks, %u failed\n", numChecks, numFailed);
+    return numFailed == 0;
+}
+
+// Cook a file and check that loading rejects corrupted copies.
+// path Path of a file with a skinned mesh and an animation.
+// Returns whether every check passed.
+bool CheckCookedAsset(const std::string& path)
+{
+    const std::string cookedPath = path + ".check.cooked";
+    Assimp::Importer importer;
+    const aiScene* aScene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+    if (aScene == nullptr || !Geometry::CookedAsset::Cook(aScene, Geometry::CompressedAnimation::Settings(), cookedPath))
+    {
+        printf("Cooked asset: failed to cook %s\n", path.c_str());
+        return false;
+    }
+    bool passed = CheckCookedFile(cookedPath);
+    remove(cookedPath.c_str());
+    return passed;
+}
+#endif
+
+// Print usage.
+void PrintUsage()
+{
+    printf("Usage: Benchmark [options]\n");
+    printf("  --min <n>              Smallest cloud count, log2 (default 10).\n");
+    printf("  --max <n>              Largest cloud count, log2 (default 20).\n");
+    printf("  --iterations <n>       Measured frames per case (default 10).\n");
+    printf("  --distributions <list> Comma separated: grid,uniform,clustered,line (default all).\n");
+    printf("  --budget <ms>          Frame budget per case, larger cases are skipped when exceeded (default 2000).\n");
+    printf("  --json <path>          Write results as JSON.\n");
+    printf("  --baseline <path>      Compare results against baseline JSON, exit code 1 on regression or missing case.\n");
+    printf("  --threshold <f>        Allowed relative p50 slowdown against baseline (default 0.1).\n");
+    printf("  --no-micro             Skip depth sort, DynamicArray, profiler, animation and skeleton micro benchmarks.\n");
+    printf("  --scaling <n>          Measure scaling of the CPU stages, animation loading and skeleton animation on 1..n job system threads.\n");
+    printf("  --batch <n>x<c>        Compare n scenes of c clouds simulated one by one against one batch.\n");
+    printf("  --kernel-cache         Check kernel cache hits, misses and failures with a stub compiler and exit, exit code 1 on failure.\n");
+#ifdef BENCHMARK_ASSIMP
+    printf("  --cooked-asset         Check that corrupted cooked files of the --skeleton file fail to load and exit, exit code 1 on failure.\n");
+    printf("  --skeleton <path>      Animated file of the skeleton micro benchmark (default ../2D_Engine/assets/FBXAnimation.fbx).\n");
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkSuite::Settings settings;
+    std::string jsonPath;
+    std::string baselinePath;
+    float threshold = 0.1f;
+    bool micro = true;
+    unsigned int maxNumThreads = 0;
+    unsigned int numBatchScenes = 0;
+    unsigned int numBatchClouds = 0;
+#ifdef BENCHMARK_ASSIMP
+    std::string skeletonPath = "../2D_Engine/assets/FBXAnimation.fbx";
+    bool checkCookedAsset = false;
+#endif
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--min" && hasValue)
+            settings.minLog2Clouds = atoi(argv[++i]);
+        else if (arg == "--max" && hasValue)
+            settings.maxLog2Clouds = atoi(argv[++i]);
+        else if (arg == "--iterations" && hasValue)
+            settings.numIterations = atoi(argv[++i]);
+        else if (arg == "--budget" && hasValue)
+            settings.caseBudgetMs = static_cast<float>(atof(argv[++i]));
+        else if (arg == "--json" && hasValue)
+            jsonPath = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            baselinePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            threshold = static_cast<float>(atof(argv[++i]));
+        else if (arg == "--no-micro")
+            micro = false;
+        else if (arg == "--kernel-cache")
+            return CheckKernelCache() ? 0 : 1;
+        else if (arg == "--scaling" && hasValue)
+            maxNumThreads = atoi(argv[++i]);
+#ifdef BENCHMARK_ASSIMP
+        else if (arg == "--skeleton" && hasValue)
+            skeletonPath = argv[++i];
+        else if (arg == "--cooked-asset")
+            checkCookedAsset = true;
+#endif
+        else if (arg == "--batch" && hasValue)
+        {
+            if (sscanf(argv[++i], "%ux%u", &numBatchScenes, &numBatchClouds) != 2)
+            {
+                PrintUsage();
+                return 2;
+            }
+        }
+        else if (arg == "--distributions" && hasValue)
+        {
+            settings.distributions.clear();
+            std::string list = argv[++i];
+            std::size_t start = 0;
+            while (start <= list.size())
+            {
+                std::size_t end = std::min(list.find(',', start), list.size());
+                SceneBuilder::Distribution distribution;
+                if (!SceneBuilder::FindDistribution(list.substr(start, end - start).c_str(), distribution))
+                {
+                    printf("Unknown distribution: %s\n", list.substr(start, end - start).c_str());
+                    return 2;
+                }
+                settings.distributions.push_back(distribution);
+                start = end + 1;
+            }
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+#ifdef BENCHMARK_ASSIMP
+    if (checkCookedAsset)
+        return CheckCookedAsset(skeletonPath) ? 0 : 1;
+#endif
+
+    // Cloud counts are 1 << log2, which is undefined from 32 on.
+    if (settings.minLog2Clouds >= 32 || settings.maxLog2Clouds >= 32 || settings.minLog2Clouds > settings.maxLog2Clouds)
+    {
+        printf("Invalid cloud range: --min %u --max %u, expected min <= max < 32\n", settings.minLog2Clouds, settings.maxLog2Clouds);
+        return 2;
+    }
+
+    if (micro)
+    {
+        BenchmarkDepthSort(1 << 19);
+        BenchmarkDynamicArray(1 << 20);
+        BenchmarkProfiler();
+        BenchmarkMathKernels(1 << 16);
+        BenchmarkSkinning(1 << 15, 128);
+        BenchmarkAnimationSampling(256, 4096);
+        {
+            aiAnimation aAnimation;
+            GenerateAnimation(aAnimation, 256, 4096);
+            BenchmarkAnimationCompression("generated", Geometry::Animation(&aAnimation));
+        }
+#ifdef BENCHMARK_ASSIMP
+        BenchmarkSkeleton(skeletonPath, 1000);
+        BenchmarkPoseTable(skeletonPath, 1000);
+        BenchmarkCookedAsset(skeletonPath);
+        BenchmarkSkeletonBatch(skeletonPath, 10000);
+        BenchmarkAnimationCompression(std::string("../2D_Engine/assets/FBXAnimation.fbx"));
+        BenchmarkAnimationCompression(std::string("../2D_Engine/assets/FBXModel.fbx"));
+        BenchmarkAnimationCompression(std::string("../2D_Engine/assets/FBXSceneBox.fbx"));
+#endif
+    }
+
+    if (maxNumThreads > 0)
+    {
+        BenchmarkScaling(1 << 14, maxNumThreads, settings.numIterations);
+        BenchmarkAnimationScaling(256, 4096, maxNumThreads);
+#ifdef BENCHMARK_ASSIMP
+        BenchmarkSkeletonScaling(skeletonPath, 1000, maxNumThreads);
+#endif
+    }
+
+    if (numBatchScenes > 0 && numBatchClouds > 0)
+        BenchmarkBatch(numBatchScenes, numBatchClouds, settings.numIterations);
+
+    printf("Suite %u..%u clouds, %u iterations\n", 1U << settings.minLog2Clouds, 1U << settings.maxLog2Clouds, settings.numIterations);
+    BenchmarkSuite suite(settings);
+    suite.Run();
+
+    if (!jsonPath.empty() && !suite.WriteJSON(jsonPath))
+    {
+        printf("Failed to write %s\n", jsonPath.c_str());
+        return 2;
+    }
+
+    if (!baselinePath.empty())
+    {
+        int numRegressions = suite.CompareBaseline(baselinePath, threshold);
+        if (numRegressions < 0)
+        {
+            printf("Failed to read baseline %s\n", baselinePath.c_str());
+            return 2;
+        }
+        if (numRegressions > 0)
+            return 1;
+    }
+
+    return 0;
+}
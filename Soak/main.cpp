@@ -0,0 +1,733 @@
+// Headless soak driver. Runs the CPU particle pipeline for a number of frames or seconds with a scripted camera
+// and reports throughput, frame-time percentiles, resident memory and allocation counts.
+// Exits with code 1 if a budget is exceeded. Run with --help for options.
+// Portable, builds without D3D11. On Linux:
+// g++ -std=c++14 -O2 -pthread -I../2D_Engine -I../2D_Engine/externals/glm main.cpp ../2D_Engine/CPUParticleCloudSorter.cpp ../2D_Engine/CPUParticleCloudSystem.cpp ../2D_Engine/CPUParticleSystem.cpp ../2D_Engine/CPUScene.cpp ../2D_Engine/CPUSceneBatch.cpp ../2D_Engine/JobSystem.cpp ../2D_Engine/MappedFile.cpp ../2D_Engine/Particle.cpp ../2D_Engine/ParticleCloud.cpp ../2D_Engine/ParticleDepthSorter.cpp ../2D_Engine/Profiler.cpp ../2D_Engine/RadixSort.cpp ../2D_Engine/Recording.cpp ../2D_Engine/SceneBuilder.cpp ../2D_Engine/Snapshot.cpp ../2D_Engine/SoftwareRenderer.cpp ../2D_Engine/Telemetry.cpp -o Soak
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "CPUParticleCloudSorter.h"
+#include "CPUParticleCloudSystem.h"
+#include "CPUParticleSystem.h"
+#include "CPUScene.h"
+#include "FramePipeline.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Recording.h"
+#include "SceneBuilder.h"
+#include "Snapshot.h"
+#include "SoftwareRenderer.h"
+#include "Telemetry.h"
+
+// Seconds per camera revolution.
+#define SOAK_CAMERA_PERIOD 20.f
+
+// Number of allocations and allocated bytes, counted by the global operator new.
+static std::atomic<unsigned long long> gNumAllocations(0);
+static std::atomic<unsigned long long> gNumAllocatedBytes(0);
+
+// Allocate for the global operator new, counted.
+void* AllocCounted(std::size_t size)
+{
+    ++gNumAllocations;
+    gNumAllocatedBytes += size;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+// Free memory of AllocCounted. The deletes call this instead of free, which -Wmismatched-new-delete flags when called
+// on a pointer passed to operator delete.
+void AllocFree(void* p)
+{
+    free(p);
+}
+
+void* operator new(std::size_t size)
+{
+    return AllocCounted(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return AllocCounted(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    AllocFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    AllocFree(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    AllocFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    AllocFree(p);
+}
+
+// Get resident memory of process in bytes.
+unsigned long long GetResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#else
+    unsigned long long size = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    if (fscanf(file, "%llu %llu", &size, &resident) != 2)
+        resident = 0;
+    fclose(file);
+    return resident * static_cast<unsigned long long>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Get peak resident memory of process in bytes.
+unsigned long long GetPeakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<unsigned long long>(usage.ru_maxrss) * 1024ULL;
+#endif
+}
+
+// Soak settings.
+struct Settings
+{
+    unsigned int numClouds = 4096;
+    unsigned int numFrames = 1000;
+    float seconds = 0.f;
+    float dt = 1.f / 60.f;
+    unsigned int seed = 1;
+    SceneBuilder::Distribution distribution = SceneBuilder::GRID;
+    std::string scenePath;
+    unsigned int renderWidth = 0;
+    unsigned int renderHeight = 0;
+    std::string imagePath;
+    unsigned int numWarmupFrames = 10;
+    unsigned int pipelineLatency = 0;
+    unsigned int numThreads = 0;
+    std::string checkpointPath;
+    unsigned int checkpointInterval = 0;
+    std::string restorePath;
+    std::string recordPath;
+    std::string playPath;
+
+    // Budgets, negative to disable.
+    float budgetP99Ms = -1.f;
+    float budgetMaxMs = -1.f;
+    float budgetRSSGrowthMB = -1.f;
+    float budgetAllocationsPerFrame = -1.f;
+    float budgetStutters = -1.f;
+};
+
+// Print usage.
+void PrintUsage()
+{
+    printf("Usage: Soak [options]\n");
+    printf("  --clouds <n>             Number of particle clouds (default 4096).\n");
+    printf("  --frames <n>             Number of frames (default 1000).\n");
+    printf("  --seconds <t>            Run for t seconds of wall time instead of a frame count.\n");
+    printf("  --dt <s>                 Fixed simulation time step (default 1/60).\n");
+    printf("  --seed <n>               Scene random seed (default 1).\n");
+    printf("  --distribution <name>    grid, uniform, clustered or line (default grid).\n");
+    printf("  --scene <path>           Load scene description, replaces --clouds, --seed and --distribution.\n");
+    printf("  --render <w>x<h>         Render with the software renderer.\n");
+    printf("  --image <path>           Write last rendered frame as PPM.\n");
+    printf("  --pipeline <n>           Render on a separate thread with n snapshot slots, 0 renders in sequence (default 0).\n");
+    printf("  --threads <n>            Simulate on n job system threads, 0 simulates on the main thread only (default 0).\n");
+    printf("  --checkpoint <path>      Write snapshot of the simulation state when the run ends.\n");
+    printf("  --checkpoint-interval <n> Also write the snapshot every n frames on a background thread (default 0).\n");
+    printf("  --restore <path>         Continue from snapshot instead of generating a scene.\n");
+    printf("  --record <path>          Record particles and clouds of every frame.\n");
+    printf("  --play <path>            Play back recording instead of simulating, looping for --frames frames.\n");
+    printf("  --warmup <n>             Frames before memory and allocation baselines are taken (default 10).\n");
+    printf("  --budget-p99 <ms>        Max p99 frame time.\n");
+    printf("  --budget-max <ms>        Max frame time.\n");
+    printf("  --budget-rss <mb>        Max resident memory growth after warm up.\n");
+    printf("  --budget-allocs <n>      Max allocations per frame after warm up.\n");
+    printf("  --budget-stutters <n>    Max number of stutters.\n");
+}
+
+// Parse command line.
+// Returns whether command line was valid.
+bool ParseArguments(int argc, char* argv[], Settings& settings)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+        if (arg == "--clouds")
+            settings.numClouds = atoi(value);
+        else if (arg == "--frames")
+            settings.numFrames = atoi(value);
+        else if (arg == "--seconds")
+            settings.seconds = static_cast<float>(atof(value));
+        else if (arg == "--dt")
+            settings.dt = static_cast<float>(atof(value));
+        else if (arg == "--seed")
+            settings.seed = atoi(value);
+        else if (arg == "--distribution")
+        {
+            if (!SceneBuilder::FindDistribution(value, settings.distribution))
+                return false;
+        }
+        else if (arg == "--scene")
+            settings.scenePath = value;
+        else if (arg == "--render")
+        {
+            if (sscanf(value, "%ux%u", &settings.renderWidth, &settings.renderHeight) != 2)
+                return false;
+        }
+        else if (arg == "--image")
+            settings.imagePath = value;
+        else if (arg == "--pipeline")
+            settings.pipelineLatency = atoi(value);
+        else if (arg == "--threads")
+            settings.numThreads = atoi(value);
+        else if (arg == "--checkpoint")
+            settings.checkpointPath = value;
+        else if (arg == "--checkpoint-interval")
+            settings.checkpointInterval = atoi(value);
+        else if (arg == "--restore")
+            settings.restorePath = value;
+        else if (arg == "--record")
+            settings.recordPath = value;
+        else if (arg == "--play")
+            settings.playPath = value;
+        else if (arg == "--warmup")
+            settings.numWarmupFrames = atoi(value);
+        else if (arg == "--budget-p99")
+            settings.budgetP99Ms = static_cast<float>(atof(value));
+        else if (arg == "--budget-max")
+            settings.budgetMaxMs = static_cast<float>(atof(value));
+        else if (arg == "--budget-rss")
+            settings.budgetRSSGrowthMB = static_cast<float>(atof(value));
+        else if (arg == "--budget-allocs")
+            settings.budgetAllocationsPerFrame = static_cast<float>(atof(value));
+        else if (arg == "--budget-stutters")
+            settings.budgetStutters = static_cast<float>(atof(value));
+        else
+            return false;
+    }
+    return settings.numClouds > 0 && (settings.pipelineLatency == 0 || settings.renderWidth > 0) && (settings.checkpointInterval == 0 || !settings.checkpointPath.empty());
+}
+
+// Particles and camera of a simulated frame, handed to the render thread.
+struct FrameSnapshot
+{
+    std::vector<Particle> particles;
+    glm::mat4 vpMatrix;
+    // Time simulation of the frame ended.
+    long long simulatedTime;
+};
+
+// Render snapshots until pipeline is closed.
+// pipeline Frame pipeline.
+// renderer Software renderer.
+// renderHistogram Render times.
+// latencyHistogram Times from end of simulation to end of render.
+// numRenderedParticles Total number of rendered particles.
+void RenderThread(FramePipeline<FrameSnapshot>* pipeline, SoftwareRenderer* renderer, Histogram* renderHistogram, Histogram* latencyHistogram, unsigned long long* numRenderedParticles)
+{
+    const FrameSnapshot* snapshot;
+    while ((snapshot = pipeline->BeginRead()) != nullptr)
+    {
+        long long renderStart = Profiler::Now();
+        *numRenderedParticles += renderer->Render(snapshot->particles.data(), static_cast<unsigned int>(snapshot->particles.size()), snapshot->vpMatrix);
+        long long renderEnd = Profiler::Now();
+        renderHistogram->Record(renderEnd - renderStart);
+        latencyHistogram->Record(renderEnd - snapshot->simulatedTime);
+        pipeline->EndRead();
+    }
+}
+
+// Get position of the orbiting camera.
+// center Orbit center.
+// orbitRadius Orbit radius.
+// frame Number of simulated frames, including frames simulated before a restore.
+// dt Simulation time step.
+glm::vec3 GetCameraPosition(const glm::vec3& center, float orbitRadius, unsigned long long frame, float dt)
+{
+    float angle = 2.f * 3.14159265f * static_cast<float>(frame * dt / SOAK_CAMERA_PERIOD);
+    return center + glm::vec3(std::cos(angle), 0.5f, std::sin(angle)) * orbitRadius;
+}
+
+// Create snapshot header of the simulation state.
+// scene Simulated scene.
+// settings Soak settings.
+// center Orbit center.
+// orbitRadius Orbit radius.
+// frame Number of simulated frames, including frames simulated before a restore.
+SnapshotHeader CreateSnapshotHeader(const CPUScene& scene, const Settings& settings, const glm::vec3& center, float orbitRadius, unsigned long long frame)
+{
+    SnapshotHeader header = Snapshot::CreateHeader(scene.mMaxNumParticles, scene.mMaxNumParticleClouds);
+    header.seed = settings.seed;
+    header.distribution = settings.distribution;
+    header.frame = frame;
+    header.time = frame * static_cast<double>(settings.dt);
+    header.cameraPosition = GetCameraPosition(center, orbitRadius, frame, settings.dt);
+    header.cameraFrontDirection = glm::normalize(center - header.cameraPosition);
+    header.cameraRightDirection = glm::normalize(glm::cross(glm::vec3(0.f, 1.f, 0.f), header.cameraFrontDirection));
+    header.cameraUpDirection = glm::cross(header.cameraFrontDirection, header.cameraRightDirection);
+    return header;
+}
+
+// Play back recording. Frames are decoded and rendered without simulating.
+// settings Soak settings.
+// Returns exit code.
+int Play(const Settings& settings)
+{
+    RecordingPlayer player;
+    if (!player.Open(settings.playPath) || player.GetNumFrames() == 0)
+    {
+        printf("Failed to open recording %s\n", settings.playPath.c_str());
+        return 2;
+    }
+    const RecordingHeader& header = player.GetHeader();
+
+    SoftwareRenderer* renderer = nullptr;
+    if (settings.renderWidth > 0 && settings.renderHeight > 0)
+        renderer = new SoftwareRenderer(settings.renderWidth, settings.renderHeight, header.numParticles);
+    glm::mat4 projectionMatrix = glm::perspectiveFovLH(45.f, (float)glm::max(settings.renderWidth, 1U), (float)glm::max(settings.renderHeight, 1U), 0.01f, 2000.f);
+
+    printf("Play: %s, %u frames, %u clouds, %u particles\n", settings.playPath.c_str(), player.GetNumFrames(), header.numParticleClouds, header.numParticles);
+
+    RecordingFrame frame;
+    Histogram decodeHistogram;
+    Histogram renderHistogram;
+    unsigned long long numRenderedParticles = 0;
+    long long startTime = Profiler::Now();
+    unsigned int numFrames = 0;
+    for (; numFrames < settings.numFrames; ++numFrames)
+    {
+        long long decodeStart = Profiler::Now();
+        if (!player.ReadFrame(numFrames % player.GetNumFrames(), frame))
+        {
+            printf("Failed to read frame %u\n", numFrames % player.GetNumFrames());
+            break;
+        }
+        long long decodeEnd = Profiler::Now();
+        decodeHistogram.Record(decodeEnd - decodeStart);
+
+        if (renderer != nullptr)
+        {
+            glm::mat4 vpMatrix = projectionMatrix * glm::lookAtLH(frame.cameraPosition, frame.cameraPosition + frame.cameraFrontDirection, frame.cameraUpDirection);
+            numRenderedParticles += renderer->Render(frame.particles.data(), header.numParticles, vpMatrix);
+            renderHistogram.Record(Profiler::Now() - decodeEnd);
+        }
+
+        if (Telemetry::PollSignal() != 0)
+            break;
+    }
+    double elapsed = (Profiler::Now() - startTime) / 1e9;
+
+    printf("Frames: %u in %.3f s, %.1f frames/s\n", numFrames, elapsed, numFrames / elapsed);
+    printf("Decode: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", decodeHistogram.Percentile(0.5) / 1e6, decodeHistogram.Percentile(0.99) / 1e6, decodeHistogram.Max() / 1e6);
+    if (renderer != nullptr && numFrames > 0)
+        printf("Rendered: %.0f particles/frame, render p50 %.3f ms, p99 %.3f ms\n", static_cast<double>(numRenderedParticles) / numFrames, renderHistogram.Percentile(0.5) / 1e6, renderHistogram.Percentile(0.99) / 1e6);
+
+    if (renderer != nullptr && !settings.imagePath.empty() && !renderer->WritePPM(settings.imagePath))
+        printf("Failed to write %s\n", settings.imagePath.c_str());
+    delete renderer;
+
+    return numFrames == settings.numFrames ? 0 : 1;
+}
+
+// Check value against budget and print result.
+// name Budget name.
+// value Measured value.
+// budget Budget, negative if disabled.
+// Returns whether value is within budget.
+bool CheckBudget(const char* name, double value, float budget)
+{
+    if (budget < 0.f)
+        return true;
+    bool within = value <= budget;
+    printf("  %-24s %12.3f / %12.3f %s\n", name, value, budget, within ? "OK" : "EXCEEDED");
+    return within;
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    if (!ParseArguments(argc, argv, settings))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    Telemetry::InstallSignalHandlers();
+
+    if (!settings.playPath.empty())
+        return Play(settings);
+
+    // Create job system.
+    JobSystem* jobSystem = settings.numThreads > 0 ? new JobSystem(settings.numThreads) : nullptr;
+
+    // Create scene. A restored scene is used in place from the mapped snapshot, only the scene's own buffers are filled.
+    SceneBuilder::Timings startupTimings;
+    std::vector<Particle> particles;
+    std::vector<ParticleCloud> particleClouds;
+    Snapshot restoredSnapshot;
+    SnapshotHeader restoredHeader = SnapshotHeader();
+    const Particle* initParticles;
+    const ParticleCloud* initParticleClouds;
+    unsigned int numClouds = settings.numClouds;
+    unsigned int numParticles = numClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+    unsigned long long firstFrame = 0;
+    long long allocateTime = Profiler::Now();
+    if (!settings.restorePath.empty())
+    {
+        if (!restoredSnapshot.Load(settings.restorePath))
+        {
+            printf("Failed to load snapshot %s\n", settings.restorePath.c_str());
+            delete jobSystem;
+            return 2;
+        }
+        restoredHeader = restoredSnapshot.GetHeader();
+        const SnapshotHeader& header = restoredHeader;
+        numClouds = header.numParticleClouds;
+        numParticles = header.numParticles;
+        settings.seed = header.seed;
+        settings.distribution = static_cast<SceneBuilder::Distribution>(header.distribution);
+        firstFrame = header.frame;
+        initParticles = restoredSnapshot.GetParticles();
+        initParticleClouds = restoredSnapshot.GetParticleClouds();
+        startupTimings.allocate = Profiler::Now() - allocateTime;
+        startupTimings.generate = 0;
+        startupTimings.clear = 0;
+    }
+    else
+    {
+        // Capacity is sized from the scene description.
+        SceneBuilder::Description description;
+        description.seed = settings.seed;
+        description.groups.push_back(SceneBuilder::CreateEmitterGroup(settings.distribution, settings.numClouds));
+        std::string error;
+        if (!settings.scenePath.empty() && !SceneBuilder::Load(settings.scenePath, description, error))
+        {
+            printf("Failed to load scene %s: %s\n", settings.scenePath.c_str(), error.c_str());
+            delete jobSystem;
+            return 2;
+        }
+        settings.seed = description.seed;
+        settings.distribution = description.groups.front().distribution;
+        numClouds = SceneBuilder::GetNumParticleClouds(description);
+        numParticles = numClouds * SceneBuilder::PARTICLES_PER_CLOUD;
+
+        allocateTime = Profiler::Now();
+        particles.resize(numParticles);
+        particleClouds.resize(numClouds);
+        startupTimings.allocate = Profiler::Now() - allocateTime;
+        SceneBuilder::Build(description, numParticles, particles.data(), particleClouds.data(), jobSystem, &startupTimings);
+        initParticles = particles.data();
+        initParticleClouds = particleClouds.data();
+    }
+    long long uploadTime = Profiler::Now();
+    CPUScene scene(numParticles, numClouds, initParticles, initParticleClouds);
+    startupTimings.upload = Profiler::Now() - uploadTime;
+
+    // The scene holds its own copy, unmap the snapshot so checkpoints can replace its file.
+    restoredSnapshot.Close();
+
+    // Camera orbits the scene center. A restored camera continues its orbit: generated scenes lie in the xz-plane,
+    // so the orbit center is where the view direction meets it and the camera is half a radius above it.
+    glm::vec3 center;
+    float orbitRadius;
+    if (!settings.restorePath.empty())
+    {
+        const SnapshotHeader& header = restoredHeader;
+        orbitRadius = 2.f * header.cameraPosition.y;
+        center = header.cameraPosition + header.cameraFrontDirection * (orbitRadius * std::sqrt(1.25f));
+    }
+    else
+    {
+        glm::vec3 minPosition = particleClouds[0].mPosition;
+        glm::vec3 maxPosition = particleClouds[0].mPosition;
+        for (const ParticleCloud& particleCloud : particleClouds)
+        {
+            minPosition = glm::min(minPosition, particleCloud.mPosition);
+            maxPosition = glm::max(maxPosition, particleCloud.mPosition);
+        }
+        center = (minPosition + maxPosition) * 0.5f;
+        orbitRadius = glm::max(glm::length(maxPosition - minPosition), 1.f);
+    }
+
+    CPUParticleCloudSorter sorter(numClouds, jobSystem);
+    CPUParticleCloudSystem cloudSystem(jobSystem);
+    CPUParticleSystem particleSystem(jobSystem);
+    SoftwareRenderer* renderer = nullptr;
+    if (settings.renderWidth > 0 && settings.renderHeight > 0)
+        renderer = new SoftwareRenderer(settings.renderWidth, settings.renderHeight, numParticles);
+    glm::mat4 projectionMatrix = glm::perspectiveFovLH(45.f, (float)glm::max(settings.renderWidth, 1U), (float)glm::max(settings.renderHeight, 1U), 0.01f, 2000.f);
+
+    // Create telemetry.
+    Telemetry telemetry;
+    Histogram renderHistogram;
+    Histogram latencyHistogram;
+    unsigned long long numRenderedParticles = 0;
+
+    // Create frame pipeline and render thread.
+    FramePipeline<FrameSnapshot>* pipeline = nullptr;
+    std::thread renderThread;
+    if (settings.pipelineLatency > 0)
+    {
+        pipeline = new FramePipeline<FrameSnapshot>(settings.pipelineLatency);
+        for (unsigned int i = 0; i < pipeline->GetLatency(); ++i)
+            pipeline->GetSlot(i).particles.resize(numParticles);
+        renderThread = std::thread(RenderThread, pipeline, renderer, &renderHistogram, &latencyHistogram, &numRenderedParticles);
+    }
+
+    // Create snapshot writer.
+    SnapshotWriter* snapshotWriter = settings.checkpointInterval > 0 ? new SnapshotWriter() : nullptr;
+    Histogram checkpointHistogram;
+    unsigned int numCheckpoints = 0;
+    unsigned int numSkippedCheckpoints = 0;
+
+    // Create recorder.
+    Recorder* recorder = nullptr;
+    Histogram recordHistogram;
+    if (!settings.recordPath.empty())
+    {
+        recorder = new Recorder(settings.recordPath, numParticles, numClouds);
+        if (!recorder->IsOpen())
+            printf("Failed to create recording %s\n", settings.recordPath.c_str());
+    }
+
+    printf("Soak: %s, %u clouds, %u particles, %u threads, %s%s\n", settings.scenePath.empty() ? SceneBuilder::GetDistributionName(settings.distribution) : settings.scenePath.c_str(), numClouds, numParticles, jobSystem != nullptr ? jobSystem->GetNumThreads() : 1,
+        settings.seconds > 0.f ? (std::to_string(settings.seconds) + " s").c_str() : (std::to_string(settings.numFrames) + " frames").c_str(),
+        renderer == nullptr ? "" : pipeline == nullptr ? ", software render" : (", pipelined software render, latency " + std::to_string(pipeline->GetLatency())).c_str());
+    if (!settings.restorePath.empty())
+        printf("Restored %s at frame %llu\n", settings.restorePath.c_str(), firstFrame);
+    SceneBuilder::PrintTimings(startupTimings, std::cout);
+
+    unsigned long long warmupAllocations = 0;
+    unsigned long long warmupResidentBytes = 0;
+    long long startTime = Profiler::Now();
+    long long warmupTime = startTime;
+    long long endTime = startTime + static_cast<long long>(settings.seconds * 1e9);
+    unsigned int frame = 0;
+    bool running = settings.seconds > 0.f || settings.numFrames > 0;
+    while (running)
+    {
+        if (frame == settings.numWarmupFrames)
+        {
+            warmupAllocations = gNumAllocations;
+            warmupResidentBytes = GetResidentBytes();
+            warmupTime = Profiler::Now();
+        }
+
+        scene.mWorkCounters.Reset();
+        telemetry.BeginFrame();
+        {
+            // Particle clouds sort.
+            { Telemetry::StageScope stage(telemetry, Telemetry::SORT);
+                sorter.Sort(scene);
+            }
+
+            // Particle clouds update.
+            { Telemetry::StageScope stage(telemetry, Telemetry::CLOUD_UPDATE);
+                cloudSystem.Update(scene, settings.dt);
+            }
+
+            // Particles update.
+            { Telemetry::StageScope stage(telemetry, Telemetry::PARTICLE_UPDATE);
+                particleSystem.Update(scene, settings.dt);
+            }
+
+            // Renderer. When pipelined the stage only covers waiting for a free slot and copying the snapshot.
+            if (renderer != nullptr)
+            {
+                Telemetry::StageScope stage(telemetry, Telemetry::RENDER);
+                glm::mat4 vpMatrix = projectionMatrix * glm::lookAtLH(GetCameraPosition(center, orbitRadius, firstFrame + frame, settings.dt), center, glm::vec3(0.f, 1.f, 0.f));
+                const Particle* simulatedParticles = scene.mParticlesSwapBuffer->GetTargetBuffer();
+                long long simulatedTime = Profiler::Now();
+                if (pipeline == nullptr)
+                {
+                    numRenderedParticles += renderer->Render(simulatedParticles, numParticles, vpMatrix);
+                    long long renderEnd = Profiler::Now();
+                    renderHistogram.Record(renderEnd - simulatedTime);
+                    latencyHistogram.Record(renderEnd - simulatedTime);
+                }
+                else
+                {
+                    FrameSnapshot* snapshot = pipeline->BeginWrite();
+                    std::copy(simulatedParticles, simulatedParticles + numParticles, snapshot->particles.begin());
+                    snapshot->vpMatrix = vpMatrix;
+                    snapshot->simulatedTime = simulatedTime;
+                    pipeline->EndWrite();
+                }
+            }
+        }
+        // Record. The frame only pays for copying into a free slot, it waits if the encoder falls behind.
+        if (recorder != nullptr)
+        {
+            long long recordStart = Profiler::Now();
+            RecordingFrame* recordingFrame = recorder->BeginFrame();
+            const Particle* simulatedParticles = scene.mParticlesSwapBuffer->GetTargetBuffer();
+            const ParticleCloud* simulatedParticleClouds = scene.mParticleCloudsSwapBuffer->GetTargetBuffer();
+            std::copy(simulatedParticles, simulatedParticles + numParticles, recordingFrame->particles.begin());
+            std::copy(simulatedParticleClouds, simulatedParticleClouds + numClouds, recordingFrame->particleClouds.begin());
+            recordingFrame->time = (firstFrame + frame + 1) * static_cast<double>(settings.dt);
+            recordingFrame->cameraPosition = GetCameraPosition(center, orbitRadius, firstFrame + frame, settings.dt);
+            recordingFrame->cameraFrontDirection = glm::normalize(center - recordingFrame->cameraPosition);
+            recordingFrame->cameraUpDirection = glm::vec3(0.f, 1.f, 0.f);
+            recorder->EndFrame();
+            recordHistogram.Record(Profiler::Now() - recordStart);
+        }
+        telemetry.EndFrame();
+        ++frame;
+
+        // Checkpoint. The frame only pays for copying into staging, a checkpoint still being written skips this one.
+        if (snapshotWriter != nullptr && frame % settings.checkpointInterval == 0)
+        {
+            long long checkpointStart = Profiler::Now();
+            SnapshotHeader header = CreateSnapshotHeader(scene, settings, center, orbitRadius, firstFrame + frame);
+            if (snapshotWriter->Write(settings.checkpointPath, header, scene.mParticlesSwapBuffer->GetTargetBuffer(), scene.mParticleCloudsSwapBuffer->GetTargetBuffer()))
+            {
+                checkpointHistogram.Record(Profiler::Now() - checkpointStart);
+                ++numCheckpoints;
+            }
+            else
+            {
+                ++numSkippedCheckpoints;
+            }
+        }
+
+        // Dump telemetry on signal, stop on interrupt/terminate.
+        int signal = Telemetry::PollSignal();
+        if (signal != 0)
+        {
+            telemetry.DumpSummary(std::cout);
+            if (signal == SIGINT || signal == SIGTERM)
+                running = false;
+        }
+
+        if (settings.seconds > 0.f)
+            running &= Profiler::Now() < endTime;
+        else
+            running &= frame < settings.numFrames;
+    }
+    if (pipeline != nullptr)
+    {
+        pipeline->Close();
+        renderThread.join();
+    }
+    long long stopTime = Profiler::Now();
+
+    // Finish recording.
+    if (recorder != nullptr)
+    {
+        if (!recorder->Close())
+            printf("Failed to write %s\n", settings.recordPath.c_str());
+        if (recorder->GetNumFrames() > 0)
+        {
+            printf("Recorded: %u frames, %.2f MB/frame raw, %.3f MB/frame encoded (%.1fx), encode %.3f ms/frame, frame cost p50 %.3f ms, max %.3f ms\n", recorder->GetNumFrames(),
+                recorder->GetRawBytes() / (1024.0 * 1024.0) / recorder->GetNumFrames(), recorder->GetEncodedBytes() / (1024.0 * 1024.0) / recorder->GetNumFrames(),
+                static_cast<double>(recorder->GetRawBytes()) / recorder->GetEncodedBytes(), recorder->GetEncodeTime() / 1e6 / recorder->GetNumFrames(),
+                recordHistogram.Percentile(0.5) / 1e6, recordHistogram.Max() / 1e6);
+        }
+        delete recorder;
+    }
+
+    // Final checkpoint.
+    if (snapshotWriter != nullptr && !snapshotWriter->Wait())
+        printf("Failed to write %s\n", settings.checkpointPath.c_str());
+    delete snapshotWriter;
+    if (!settings.checkpointPath.empty())
+    {
+        SnapshotHeader header = CreateSnapshotHeader(scene, settings, center, orbitRadius, firstFrame + frame);
+        if (Snapshot::Write(settings.checkpointPath, header, scene.mParticlesSwapBuffer->GetTargetBuffer(), scene.mParticleCloudsSwapBuffer->GetTargetBuffer()))
+            printf("Checkpoint %s at frame %llu\n", settings.checkpointPath.c_str(), header.frame);
+        else
+            printf("Failed to write %s\n", settings.checkpointPath.c_str());
+    }
+
+    // Report.
+    double elapsed = (stopTime - startTime) / 1e9;
+    unsigned int numSteadyFrames = frame > settings.numWarmupFrames ? frame - settings.numWarmupFrames : 0;
+    double steadyElapsed = numSteadyFrames > 0 ? (stopTime - warmupTime) / 1e9 : 0.0;
+    double allocationsPerFrame = numSteadyFrames > 0 ? static_cast<double>(gNumAllocations - warmupAllocations) / numSteadyFrames : 0.0;
+    unsigned long long residentBytes = GetResidentBytes();
+    double residentGrowthMB = numSteadyFrames > 0 ? (static_cast<double>(residentBytes) - static_cast<double>(warmupResidentBytes)) / (1024.0 * 1024.0) : 0.0;
+
+    telemetry.DumpSummary(std::cout);
+    printf("Frames: %u in %.3f s, %.1f frames/s\n", frame, elapsed, frame / elapsed);
+    if (steadyElapsed > 0.0)
+    {
+        printf("Throughput: %.0f clouds/s, %.0f particles/s\n", static_cast<double>(numClouds) * numSteadyFrames / steadyElapsed, static_cast<double>(numParticles) * numSteadyFrames / steadyElapsed);
+    }
+    if (renderer != nullptr)
+    {
+        printf("Rendered: %.0f particles/frame, render p50 %.3f ms, p99 %.3f ms\n", static_cast<double>(numRenderedParticles) / frame, renderHistogram.Percentile(0.5) / 1e6, renderHistogram.Percentile(0.99) / 1e6);
+        printf("Latency (simulation end to render end): p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", latencyHistogram.Percentile(0.5) / 1e6, latencyHistogram.Percentile(0.99) / 1e6, latencyHistogram.Max() / 1e6);
+    }
+    if (numCheckpoints + numSkippedCheckpoints > 0)
+        printf("Checkpoints: %u written, %u skipped while busy, frame cost p50 %.3f ms, max %.3f ms\n", numCheckpoints, numSkippedCheckpoints, checkpointHistogram.Percentile(0.5) / 1e6, checkpointHistogram.Max() / 1e6);
+    printf("Memory: resident %.1f MB, peak %.1f MB, growth after warm up %.3f MB\n", residentBytes / (1024.0 * 1024.0), glm::max(GetPeakResidentBytes(), residentBytes) / (1024.0 * 1024.0), residentGrowthMB);
+    printf("Allocations: %llu total (%.1f MB), %.3f per frame after warm up\n", static_cast<unsigned long long>(gNumAllocations), gNumAllocatedBytes / (1024.0 * 1024.0), allocationsPerFrame);
+#if WORK_COUNTERS
+    printf("Last frame: ");
+    fflush(stdout);
+    scene.mWorkCounters.Print(std::cout);
+#endif
+
+    if (renderer != nullptr && !settings.imagePath.empty() && !renderer->WritePPM(settings.imagePath))
+        printf("Failed to write %s\n", settings.imagePath.c_str());
+    delete pipeline;
+    delete renderer;
+    delete jobSystem;
+
+    // Check budgets.
+    bool withinBudget = true;
+    printf("Budgets:\n");
+    withinBudget &= CheckBudget("p99 frame time (ms)", telemetry.GetFrameHistogram().Percentile(0.99) / 1e6, settings.budgetP99Ms);
+    withinBudget &= CheckBudget("max frame time (ms)", telemetry.GetFrameHistogram().Max() / 1e6, settings.budgetMaxMs);
+    withinBudget &= CheckBudget("RSS growth (MB)", residentGrowthMB, settings.budgetRSSGrowthMB);
+    withinBudget &= CheckBudget("allocations per frame", allocationsPerFrame, settings.budgetAllocationsPerFrame);
+    withinBudget &= CheckBudget("stutters", static_cast<double>(telemetry.GetNumStutters()), settings.budgetStutters);
+    printf("%s\n", withinBudget ? "PASSED" : "FAILED");
+
+    return withinBudget ? 0 : 1;
+}